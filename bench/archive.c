@@ -0,0 +1,195 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> /* getpid */
+
+#include <cjson/cJSON.h>
+
+#include "bench.h"
+#include "../src/include/archive.h"
+#include "../src/include/arena.h"
+#include "../src/include/buffer.h"
+#include "../src/include/post.h"
+#include "../src/include/pretty.h"
+#include "../src/include/util.h"
+#include "../src/include/main.h"
+
+/*
+ * Input of the archive benchmarks. The same threads are stored as JSON strings
+ * and in an archive file.
+ */
+typedef struct {
+    const Buffer* jsons;
+    size_t jsons_num;
+    const char* archive_path;
+    Arena arena;
+    Buffer out;
+} ArchiveBench;
+
+/*
+ * Parse each thread JSON and render it, like the program does after receiving
+ * a thread.
+ */
+static void run_json_render(void* ctx) {
+    ArchiveBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->jsons_num; i++) {
+        cJSON* thread = arena_parse_json(&bench->arena,
+                                         bench->jsons[i].data,
+                                         bench->jsons[i].sz);
+
+        buffer_clear(&bench->out);
+        pretty_render_thread(&bench->out, thread, DEFAULT_BOARD);
+        arena_reset(&bench->arena);
+    }
+}
+
+/*
+ * Map the archive and render all of its threads, like the program does with
+ * '-r'.
+ */
+static void run_archive_render(void* ctx) {
+    ArchiveBench* bench = ctx;
+
+    Archive archive;
+    if (!archive_open(&archive, bench->archive_path))
+        return;
+
+    for (size_t i = 0; i < archive.threads_num; i++) {
+        const ArchiveThread* thread = &archive.threads[i];
+
+        buffer_clear(&bench->out);
+        for (size_t j = 0; j < thread->posts_num; j++) {
+            Post post;
+            archive_get_post(&archive,
+                             &archive.posts[thread->first_post + j],
+                             &post);
+            pretty_render_post(&bench->out, &post, NULL, DEFAULT_BOARD, j > 0);
+        }
+    }
+
+    archive_close(&archive);
+}
+
+/*
+ * Only parse each thread JSON, without rendering it.
+ */
+static void run_json_parse(void* ctx) {
+    ArchiveBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->jsons_num; i++) {
+        arena_parse_json(&bench->arena,
+                         bench->jsons[i].data,
+                         bench->jsons[i].sz);
+        arena_reset(&bench->arena);
+    }
+}
+
+/*
+ * Only map the archive and read the fields of every post, without rendering
+ * them.
+ */
+static void run_archive_read(void* ctx) {
+    ArchiveBench* bench = ctx;
+
+    Archive archive;
+    if (!archive_open(&archive, bench->archive_path))
+        return;
+
+    size_t total_len = 0;
+    for (size_t i = 0; i < archive.posts_num; i++) {
+        Post post;
+        archive_get_post(&archive, &archive.posts[i], &post);
+        if (post.com != NULL)
+            total_len += strlen(post.com);
+    }
+
+    /* Make sure that the loop is not optimized away */
+    volatile size_t sink = total_len;
+    (void)sink;
+
+    archive_close(&archive);
+}
+
+void bench_archive(const BenchCorpus* corpus) {
+    ArchiveBench bench = {
+        .jsons     = corpus->threads,
+        .jsons_num = corpus->threads_num,
+        .arena     = ARENA_EMPTY,
+        .out       = BUFFER_EMPTY,
+    };
+
+    ArchiveWriter writer;
+    archive_writer_init(&writer);
+
+    /* The corpus only has valid threads, so they can all be archived */
+    bool success = true;
+    for (size_t i = 0; success && i < bench.jsons_num; i++) {
+        cJSON* thread = arena_parse_json(&bench.arena,
+                                         bench.jsons[i].data,
+                                         bench.jsons[i].sz);
+        success       = archive_writer_add_thread(&writer, i, thread);
+        arena_reset(&bench.arena);
+    }
+
+    char archive_path[256];
+    const char* tmp_dir = getenv("TMPDIR");
+    snprintf(archive_path,
+             sizeof(archive_path),
+             "%s/4cli-bench.%ld.arc",
+             (tmp_dir != NULL && *tmp_dir != '\0') ? tmp_dir : "/tmp",
+             (long)getpid());
+    bench.archive_path = archive_path;
+
+    if (success && archive_writer_save(&writer, archive_path)) {
+        /* The throughput is relative to the size of the JSON */
+        const size_t json_bytes = corpus->threads_sz;
+        const size_t posts_num  = corpus->posts_num;
+
+        bench_report("json_parse",
+                     corpus->name,
+                     bench_run(run_json_parse, &bench),
+                     json_bytes,
+                     posts_num);
+        bench_report("archive_read",
+                     corpus->name,
+                     bench_run(run_archive_read, &bench),
+                     json_bytes,
+                     posts_num);
+        bench_report("json_parse+render",
+                     corpus->name,
+                     bench_run(run_json_render, &bench),
+                     json_bytes,
+                     posts_num);
+        bench_report("archive_render",
+                     corpus->name,
+                     bench_run(run_archive_render, &bench),
+                     json_bytes,
+                     posts_num);
+
+        remove(archive_path);
+    }
+
+    archive_writer_free(&writer);
+    arena_free(&bench.arena);
+    buffer_free(&bench.out);
+}
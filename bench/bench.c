@@ -0,0 +1,479 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h> /* getopt */
+
+#include <cjson/cJSON.h>
+
+#include "bench.h"
+#include "../src/include/arena.h"
+#include "../src/include/buffer.h"
+#include "../src/include/replay.h"
+#include "../src/include/thread.h"
+#include "../src/include/util.h"
+#include "../src/include/main.h"
+
+/*
+ * Maximum number of results in the baseline file.
+ */
+#define MAX_BASELINE 1024
+
+/*
+ * Result of a previous run, used for comparing the current one.
+ */
+typedef struct {
+    char name[64];
+    char input[64];
+    double ns;
+} BaselineEntry;
+
+/*
+ * File where the results are written in a machine-readable format, or NULL.
+ */
+static FILE* output_fp = NULL;
+
+/*
+ * Results of a previous run, loaded from the file specified with '-b'.
+ */
+static BaselineEntry baseline[MAX_BASELINE];
+static size_t baseline_num = 0;
+
+/*
+ * Generate the JSON of a synthetic thread, with a mix of quotes, quotelinks,
+ * line breaks and long lines.
+ */
+static void generate_thread(Buffer* json, size_t posts_num) {
+    static const char* const pieces[] = {
+        "<a href=\\\"#p123456\\\" class=\\\"quotelink\\\">"
+        "&gt;&gt;123456</a><br>",
+        "<span class=\\\"quote\\\">"
+        "&gt;implying this is a quote</span><br>",
+        "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+        "eiusmod tempor incididunt ut labore et dolore magna aliqua. ",
+        "std::vector&lt;int&gt; v; <br><br>",
+    };
+
+    buffer_append_str(json, "{\"posts\":[");
+    for (size_t i = 0; i < posts_num; i++) {
+        buffer_printf(json,
+                      "%s{\"no\":%zu,\"tim\":1700000000%03zu,\"ext\":\".png\","
+                      "\"filename\":\"image\",\"com\":\"",
+                      (i == 0) ? "" : ",",
+                      100000 + i,
+                      i % 1000);
+        for (size_t j = 0; j < 2 + i % 6; j++)
+            buffer_append_str(json, pieces[(i + j) % ARRLEN(pieces)]);
+        buffer_append_str(json, "\"}");
+    }
+    buffer_append_str(json, "]}");
+}
+
+/*
+ * Generate the JSON of a synthetic thread list, with 15 threads per page.
+ */
+static void generate_thread_list(Buffer* json, size_t threads_num) {
+    buffer_append_str(json, "[");
+    for (size_t i = 0; i < threads_num; i++) {
+        if (i % 15 == 0)
+            buffer_printf(json,
+                          "%s{\"page\":%zu,\"threads\":[",
+                          (i == 0) ? "" : "]},",
+                          i / 15 + 1);
+        else
+            buffer_append_str(json, ",");
+
+        buffer_printf(json,
+                      "{\"no\":%zu,\"last_modified\":%zu,\"replies\":%zu}",
+                      100000 + i,
+                      1700000000 + i,
+                      i % 300);
+    }
+    buffer_append_str(json, "]}]");
+}
+
+bool bench_load_thread_json(Buffer* dst, const char* path) {
+    buffer_clear(dst);
+
+    if (path == NULL) {
+        generate_thread(dst, BENCH_SYNTHETIC_POSTS);
+        return dst->data != NULL;
+    }
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        ERR("Could not open '%s'.", path);
+        return false;
+    }
+
+    char chunk[BUFSIZ];
+    size_t read_sz;
+    while ((read_sz = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        buffer_append(dst, chunk, read_sz);
+    fclose(fp);
+
+    return dst->data != NULL;
+}
+
+/*
+ * Check that the last thread JSON loaded into the corpus can be parsed, and
+ * add it to the corpus. Otherwise, its buffer is freed.
+ */
+static void commit_thread(BenchCorpus* corpus, Arena* arena, const char* name) {
+    Buffer* json  = &corpus->threads[corpus->threads_num];
+    cJSON* thread = arena_parse_json(arena, json->data, json->sz);
+    cJSON* posts  = cJSON_GetObjectItemCaseSensitive(thread, "posts");
+
+    const bool is_valid    = cJSON_IsArray(posts);
+    const size_t posts_num = is_valid ? (size_t)cJSON_GetArraySize(posts) : 0;
+    arena_reset(arena);
+
+    if (!is_valid) {
+        ERR("Could not parse '%s' as a thread.", name);
+        buffer_free(json);
+        return;
+    }
+
+    corpus->posts_num += posts_num;
+    corpus->threads_sz += json->sz;
+    corpus->threads_num++;
+}
+
+/*
+ * Load the thread list and all of its threads from a replay source.
+ */
+static bool load_capture(BenchCorpus* corpus, const char* path, Arena* arena) {
+    if (!replay_open(path))
+        return false;
+
+    bool result = false;
+    if (!replay_load(API_URL "/" DEFAULT_BOARD "/threads.json",
+                     &corpus->thread_list)) {
+        ERR("The capture '%s' has no thread list.", path);
+        goto done;
+    }
+
+    static ThreadInfo threads[MAX_THREADS];
+    cJSON* list_json = arena_parse_json(arena,
+                                        corpus->thread_list.data,
+                                        corpus->thread_list.sz);
+    const size_t threads_num =
+      threads_from_json(threads, ARRLEN(threads), list_json);
+    arena_reset(arena);
+
+    corpus->threads = calloc(threads_num, sizeof(Buffer));
+    if (corpus->threads == NULL)
+        goto done;
+
+    for (size_t i = 0; i < threads_num; i++) {
+        char url[255];
+        snprintf(url,
+                 sizeof(url),
+                 API_URL "/" DEFAULT_BOARD "/thread/%lu.json",
+                 threads[i].id);
+
+        if (!replay_load(url, &corpus->threads[corpus->threads_num])) {
+            ERR("The capture '%s' has no response for '%s'.", path, url);
+            continue;
+        }
+
+        commit_thread(corpus, arena, url);
+    }
+
+    result = corpus->threads_num > 0;
+
+done:
+    replay_close();
+    return result;
+}
+
+bool bench_corpus_load(BenchCorpus* corpus, const char* replay_path,
+                       char** paths, size_t paths_num) {
+    const Buffer empty = BUFFER_EMPTY;
+
+    corpus->thread_list = empty;
+    corpus->threads     = NULL;
+    corpus->threads_num = 0;
+    corpus->threads_sz  = 0;
+    corpus->posts_num   = 0;
+
+    Arena arena = ARENA_EMPTY;
+    bool result = false;
+
+    if (replay_path != NULL) {
+        const char* name = strrchr(replay_path, '/');
+        snprintf(corpus->name,
+                 sizeof(corpus->name),
+                 "%s",
+                 (name != NULL && name[1] != '\0') ? name + 1 : replay_path);
+
+        result = load_capture(corpus, replay_path, &arena);
+        goto done;
+    }
+
+    /* A single synthetic thread, and a thread list of the usual size */
+    const bool synthetic = (paths_num == 0);
+    if (synthetic) {
+        snprintf(corpus->name, sizeof(corpus->name), "synthetic");
+        generate_thread_list(&corpus->thread_list, BENCH_SYNTHETIC_THREADS);
+        paths_num = 1;
+    } else {
+        snprintf(corpus->name, sizeof(corpus->name), "%zu files", paths_num);
+    }
+
+    corpus->threads = calloc(paths_num, sizeof(Buffer));
+    if (corpus->threads == NULL)
+        goto done;
+
+    for (size_t i = 0; i < paths_num; i++) {
+        const char* path = synthetic ? NULL : paths[i];
+        if (!bench_load_thread_json(&corpus->threads[corpus->threads_num],
+                                    path))
+            continue;
+
+        commit_thread(corpus, &arena, synthetic ? "synthetic" : path);
+    }
+
+    result = corpus->threads_num > 0;
+
+done:
+    arena_free(&arena);
+    return result;
+}
+
+void bench_corpus_free(BenchCorpus* corpus) {
+    buffer_free(&corpus->thread_list);
+
+    for (size_t i = 0; i < corpus->threads_num; i++)
+        buffer_free(&corpus->threads[i]);
+
+    free(corpus->threads);
+    corpus->threads     = NULL;
+    corpus->threads_num = 0;
+}
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Total number of allocations made by buffers, arenas and cJSON, which are the
+ * ones reported by the program with '-v'.
+ */
+static size_t alloc_count(void) {
+    ArenaStats stats;
+    arena_get_stats(&stats);
+    return buffer_alloc_count() + stats.chunk_allocs + stats.cjson_allocs;
+}
+
+BenchResult bench_run(BenchFunc func, void* ctx) {
+    /* Warm up the caches before measuring */
+    func(ctx);
+
+    uint64_t iterations  = 0;
+    const size_t allocs  = alloc_count();
+    const uint64_t start = bench_now_ns();
+    uint64_t elapsed;
+    do {
+        func(ctx);
+        iterations++;
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < BENCH_MIN_TIME_NS);
+
+    const BenchResult result = {
+        .ns     = (double)elapsed / (double)iterations,
+        .allocs = (double)(alloc_count() - allocs) / (double)iterations,
+    };
+    return result;
+}
+
+/*
+ * Find the result of the specified benchmark in the baseline. Returns NULL if
+ * it's not there.
+ */
+static const BaselineEntry* find_baseline(const char* name,
+                                          const char* input) {
+    for (size_t i = 0; i < baseline_num; i++)
+        if (strcmp(baseline[i].name, name) == 0 &&
+            strcmp(baseline[i].input, input) == 0)
+            return &baseline[i];
+
+    return NULL;
+}
+
+void bench_report(const char* name, const char* input, BenchResult result,
+                  size_t bytes, size_t items) {
+    const double ns_per_item = (items == 0) ? 0 : result.ns / (double)items;
+    const double mb_per_sec =
+      (bytes == 0) ? 0 : (bytes / (1024.0 * 1024.0)) / (result.ns / 1e9);
+
+    char item_str[32] = "-";
+    char mb_str[32]   = "-";
+    if (items != 0)
+        snprintf(item_str, sizeof(item_str), "%.1f", ns_per_item);
+    if (bytes != 0)
+        snprintf(mb_str, sizeof(mb_str), "%.1f", mb_per_sec);
+
+    printf("%-28s %-16s %14.1f %10s %10s %10.1f",
+           name,
+           input,
+           result.ns,
+           item_str,
+           mb_str,
+           result.allocs);
+
+    const BaselineEntry* prev = find_baseline(name, input);
+    if (prev != NULL && prev->ns > 0)
+        printf(" %+7.1f%%", (result.ns - prev->ns) / prev->ns * 100.0);
+    putchar('\n');
+
+    if (output_fp != NULL)
+        fprintf(output_fp,
+                "%s\t%s\t%.1f\t%.1f\t%.1f\t%.2f\n",
+                name,
+                input,
+                result.ns,
+                ns_per_item,
+                mb_per_sec,
+                result.allocs);
+}
+
+/*
+ * Load the results of a previous run, written with '-o'.
+ */
+static bool load_baseline(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        ERR("Could not open baseline '%s'.", path);
+        return false;
+    }
+
+    char line[512];
+    while (baseline_num < ARRLEN(baseline) &&
+           fgets(line, sizeof(line), fp) != NULL) {
+        BaselineEntry* entry = &baseline[baseline_num];
+        if (sscanf(line,
+                   "%63[^\t]\t%63[^\t]\t%lf",
+                   entry->name,
+                   entry->input,
+                   &entry->ns) == 3)
+            baseline_num++;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+static void print_usage(FILE* fp, const char* self) {
+    fprintf(fp,
+            "Usage: %s [-h] [-R SOURCE] [-o OUTPUT] [-b BASELINE] "
+            "[THREAD.json...]\n"
+            "  -h           Show this help and exit.\n"
+            "  -R SOURCE    Use the threads of a capture directory or\n"
+            "               tarball, written by 4cli with '-K'.\n"
+            "  -o OUTPUT    Write the results to a tab-separated file.\n"
+            "  -b BASELINE  Compare the time of each benchmark with the\n"
+            "               results of a previous run, written with '-o'.\n",
+            self);
+}
+
+int main(int argc, char** argv) {
+    const char* replay_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hR:o:b:")) != -1) {
+        switch (opt) {
+            case 'h':
+                print_usage(stdout, argv[0]);
+                return EXIT_SUCCESS;
+
+            case 'R':
+                replay_path = optarg;
+                break;
+
+            case 'o':
+                output_fp = fopen(optarg, "w");
+                if (output_fp == NULL) {
+                    ERR("Could not open '%s' for writing.", optarg);
+                    return EXIT_FAILURE;
+                }
+                fprintf(output_fp,
+                        "name\tinput\tns_per_op\tns_per_item\tmib_per_s\t"
+                        "allocs_per_op\n");
+                break;
+
+            case 'b':
+                if (!load_baseline(optarg))
+                    return EXIT_FAILURE;
+                break;
+
+            default:
+                print_usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* Same as the program, so parsed JSON can be allocated from arenas */
+    arena_init_cjson_hooks();
+
+    BenchCorpus corpus;
+    if (!bench_corpus_load(&corpus,
+                           replay_path,
+                           &argv[optind],
+                           (size_t)(argc - optind))) {
+        ERR("Could not load the benchmark corpus.");
+        bench_corpus_free(&corpus);
+        return EXIT_FAILURE;
+    }
+
+    /* The benchmarks of the scanner are meaningless if its output is wrong */
+    if (!bench_jsonscan_check(&corpus)) {
+        bench_corpus_free(&corpus);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-28s %-16s %14s %10s %10s %10s\n",
+           "benchmark",
+           "input",
+           "ns/op",
+           "ns/item",
+           "MiB/s",
+           "allocs/op");
+
+    bench_stages(&corpus);
+    bench_html();
+    bench_pretty(&corpus);
+    bench_jsonscan(&corpus);
+    bench_render(&corpus);
+    bench_archive(&corpus);
+    bench_pipeline(&corpus);
+    bench_index();
+    bench_filter(&corpus);
+
+    bench_corpus_free(&corpus);
+    if (output_fp != NULL)
+        fclose(output_fp);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../src/include/buffer.h"
+
+/*
+ * Minimum time spent running each benchmark, in nanoseconds.
+ */
+#define BENCH_MIN_TIME_NS 200000000ULL
+
+/*
+ * Number of posts in the synthetic thread, used if no corpus is specified.
+ */
+#define BENCH_SYNTHETIC_POSTS 300
+
+/*
+ * Number of threads in the synthetic thread list.
+ */
+#define BENCH_SYNTHETIC_THREADS 150
+
+/*
+ * Function that runs a single iteration of a benchmark.
+ */
+typedef void (*BenchFunc)(void* ctx);
+
+/*
+ * Average cost of a single iteration of a benchmark.
+ */
+typedef struct {
+    double ns;
+    double allocs; /* Allocations of buffers, arena chunks and cJSON */
+} BenchResult;
+
+/*
+ * Threads used as the input of the benchmarks. They are loaded from a list of
+ * thread JSON files, from a capture of the program (see '-K'), or generated.
+ */
+typedef struct {
+    char name[64];
+
+    /* JSON of the thread list, empty if it's not available */
+    Buffer thread_list;
+
+    /* JSON of each thread */
+    Buffer* threads;
+    size_t threads_num;
+
+    /* Total size of the thread JSONs, and number of posts in them */
+    size_t threads_sz;
+    size_t posts_num;
+} BenchCorpus;
+
+/*
+ * Return the value of a monotonic clock, in nanoseconds.
+ */
+uint64_t bench_now_ns(void);
+
+/*
+ * Run the specified function repeatedly for at least BENCH_MIN_TIME_NS, and
+ * return the average cost of each iteration.
+ */
+BenchResult bench_run(BenchFunc func, void* ctx);
+
+/*
+ * Print the result of a benchmark, and write it to the output file, if any.
+ * The 'bytes' and 'items' arguments are the number of bytes and items (e.g.
+ * posts) processed in each iteration, used for calculating the throughput and
+ * the time per item. If they are zero, those values are not reported.
+ */
+void bench_report(const char* name, const char* input, BenchResult result,
+                  size_t bytes, size_t items);
+
+/*
+ * Load the thread JSON at the specified path into a buffer, replacing its
+ * contents. If the path is NULL, a synthetic thread is generated instead, with
+ * a mix of quotes, quotelinks, line breaks and long lines.
+ */
+bool bench_load_thread_json(Buffer* dst, const char* path);
+
+/*
+ * Load a corpus from the thread list and the threads captured in a replay
+ * source (see 'replay_open'). If 'replay_path' is NULL, the specified list of
+ * thread JSON files is used instead, without a thread list. If that list is
+ * also empty, a synthetic corpus is generated.
+ */
+bool bench_corpus_load(BenchCorpus* corpus, const char* replay_path,
+                       char** paths, size_t paths_num);
+
+/*
+ * Free the data of a corpus.
+ */
+void bench_corpus_free(BenchCorpus* corpus);
+
+/*
+ * Benchmarks of each module.
+ */
+void bench_html(void);
+
+/*
+ * Benchmarks of each stage of the program, from the thread list to the
+ * rendered threads, in isolation.
+ */
+void bench_stages(const BenchCorpus* corpus);
+
+/*
+ * Benchmarks of the renderer, compared with the previous implementation.
+ */
+void bench_pretty(const BenchCorpus* corpus);
+
+/*
+ * Benchmarks of the on-demand scanner, with each implementation supported by
+ * the processor, compared with parsing the same corpus with cJSON.
+ */
+void bench_jsonscan(const BenchCorpus* corpus);
+
+/*
+ * Check that the scanner renders the threads of the corpus, and a few threads
+ * with unusual escape sequences, like cJSON does, with every implementation
+ * supported by the processor. Returns false if any of them differ.
+ */
+bool bench_jsonscan_check(const BenchCorpus* corpus);
+
+/*
+ * Benchmarks of exporting the corpus with each renderer, compared with removing
+ * the colors from the output of the pretty printer.
+ */
+void bench_render(const BenchCorpus* corpus);
+
+/*
+ * Benchmarks of the archive format, compared with parsing the same corpus as
+ * JSON.
+ */
+void bench_archive(const BenchCorpus* corpus);
+
+/*
+ * Benchmarks of the pipeline of worker threads, with an increasing number of
+ * workers, compared with parsing and rendering on the main thread.
+ */
+void bench_pipeline(const BenchCorpus* corpus);
+
+/*
+ * Benchmarks of the full-text index, with synthetic posts.
+ */
+void bench_index(void);
+
+/*
+ * Benchmarks of the filters, with thousands of keywords, compared with
+ * searching for each keyword separately.
+ */
+void bench_filter(const BenchCorpus* corpus);
+
+#endif /* BENCH_H_ */
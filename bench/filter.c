@@ -0,0 +1,238 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/include/arena.h"
+#include "../src/include/buffer.h"
+#include "../src/include/filter.h"
+#include "../src/include/jsonscan.h"
+#include "../src/include/post.h"
+#include "../src/include/util.h"
+
+/*
+ * Maximum length of the generated keywords, including the null terminator.
+ */
+#define KEYWORD_SZ 16
+
+/*
+ * Number of keywords compared with the naive implementation, which searches
+ * for each of them separately.
+ */
+#define NAIVE_KEYWORDS 100
+
+/*
+ * Input of the filter benchmarks: every post of the corpus, decoded once.
+ */
+typedef struct {
+    const Post* posts;
+    size_t posts_num;
+
+    /* Keywords of the naive implementation */
+    char (*keywords)[KEYWORD_SZ];
+    size_t keywords_num;
+
+    /* Number of hidden posts, so the work is not optimized out */
+    size_t hidden;
+} FilterBench;
+
+static void run_filter(void* ctx) {
+    FilterBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->posts_num; i++)
+        if (filter_post_hidden(&bench->posts[i]))
+            bench->hidden++;
+}
+
+/*
+ * Search for each keyword in a field separately, like a simple filter would.
+ */
+static bool naive_matches(const FilterBench* bench, const char* text) {
+    if (text == NULL)
+        return false;
+
+    for (size_t i = 0; i < bench->keywords_num; i++)
+        if (strstr(text, bench->keywords[i]) != NULL)
+            return true;
+
+    return false;
+}
+
+static void run_naive(void* ctx) {
+    FilterBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->posts_num; i++) {
+        const Post* post = &bench->posts[i];
+        if (naive_matches(bench, post->sub) ||
+            naive_matches(bench, post->com) ||
+            naive_matches(bench, post->filename))
+            bench->hidden++;
+    }
+}
+
+/*
+ * Simple deterministic pseudo-random number generator, so every run uses the
+ * same keywords.
+ */
+static uint32_t next_random(uint64_t* state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(*state >> 33);
+}
+
+/*
+ * Generate a random lowercase keyword, of 5 to 10 characters.
+ */
+static void random_keyword(char dst[KEYWORD_SZ], uint64_t* state) {
+    const size_t len = 5 + next_random(state) % 6;
+    for (size_t i = 0; i < len; i++)
+        dst[i] = 'a' + next_random(state) % 26;
+    dst[len] = '\0';
+}
+
+/*
+ * Add the specified number of generated keywords to the filters, hiding the
+ * posts that contain any of them in any field, and compile them. If 'regex' is
+ * true, each keyword is added as a regular expression instead.
+ */
+static bool add_rules(char (*keywords)[KEYWORD_SZ], size_t keywords_num,
+                      bool regex) {
+    uint64_t state = 1;
+    for (size_t i = 0; i < keywords_num; i++) {
+        random_keyword(keywords[i], &state);
+
+        char rule[64];
+        snprintf(rule,
+                 sizeof(rule),
+                 regex ? "hide any /%s[0-9]*/" : "hide any %s",
+                 keywords[i]);
+        if (!filter_add_rule(rule))
+            return false;
+    }
+
+    return filter_compile();
+}
+
+/*
+ * Decode every post of the corpus into 'posts', with the strings allocated in
+ * the specified arena.
+ */
+static bool decode_posts(const BenchCorpus* corpus, Buffer* posts,
+                         Arena* arena) {
+    for (size_t i = 0; i < corpus->threads_num; i++) {
+        JsonScanner scanner;
+        if (!json_scan_thread(&scanner,
+                              corpus->threads[i].data,
+                              corpus->threads[i].sz))
+            return false;
+
+        JsonPostRaw raw;
+        while (json_scan_next_post(&scanner, &raw)) {
+            Post post;
+            if (!json_post_decode(&post, &raw, arena) ||
+                !buffer_append(posts, (const char*)&post, sizeof(post)))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Compare the throughput of matching the posts of the corpus against an
+ * increasing number of keywords, which are compiled into a single automaton,
+ * with searching for each keyword separately and with regular expressions. The
+ * throughput is calculated from the size of the matched fields.
+ */
+void bench_filter(const BenchCorpus* corpus) {
+    static const size_t keyword_counts[] = { 100, 1000, 10000 };
+
+    Buffer posts = BUFFER_EMPTY;
+    Arena arena  = ARENA_EMPTY;
+    char(*keywords)[KEYWORD_SZ] =
+      malloc(keyword_counts[ARRLEN(keyword_counts) - 1] * KEYWORD_SZ);
+
+    json_scan_select(json_scan_best());
+    if (keywords == NULL || !decode_posts(corpus, &posts, &arena)) {
+        fprintf(stderr, "Could not decode the posts of the corpus.\n");
+        goto done;
+    }
+
+    FilterBench bench = {
+        .posts        = (const Post*)posts.data,
+        .posts_num    = posts.sz / sizeof(Post),
+        .keywords     = keywords,
+        .keywords_num = NAIVE_KEYWORDS,
+        .hidden       = 0,
+    };
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < bench.posts_num; i++) {
+        const Post* post = &bench.posts[i];
+        if (post->sub != NULL)
+            bytes += strlen(post->sub);
+        if (post->com != NULL)
+            bytes += strlen(post->com);
+        if (post->filename != NULL)
+            bytes += strlen(post->filename);
+    }
+
+    for (size_t i = 0; i < ARRLEN(keyword_counts); i++) {
+        if (!add_rules(keywords, keyword_counts[i], false))
+            goto done;
+
+        char name[64];
+        snprintf(name, sizeof(name), "filter_keywords_%zu", keyword_counts[i]);
+        bench_report(name,
+                     corpus->name,
+                     bench_run(run_filter, &bench),
+                     bytes,
+                     bench.posts_num);
+        filter_free();
+    }
+
+    /* The keywords of the last run start with the ones of the naive one */
+    bench_report("filter_naive_100",
+                 corpus->name,
+                 bench_run(run_naive, &bench),
+                 bytes,
+                 bench.posts_num);
+
+    if (!add_rules(keywords, NAIVE_KEYWORDS, true))
+        goto done;
+
+    bench_report("filter_regex_100",
+                 corpus->name,
+                 bench_run(run_filter, &bench),
+                 bytes,
+                 bench.posts_num);
+
+done:
+    /* The other benchmarks use cJSON */
+    json_scan_select(JSON_SCAN_NONE);
+
+    filter_free();
+    arena_free(&arena);
+    buffer_free(&posts);
+    free(keywords);
+}
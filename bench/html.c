@@ -0,0 +1,240 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/include/html.h"
+#include "../src/include/util.h"
+
+/*
+ * Previous implementation of 'html_decode_entities', which searched each entity
+ * separately and shifted the rest of the string on every match. Kept as a
+ * reference for comparing the new one.
+ */
+typedef struct {
+    const char* html_str;
+    size_t html_str_len;
+    char character;
+} HtmlEntityPair;
+
+#define HTML_ENTITY_PAIR(HTML, CH)                                             \
+    { .html_str = HTML, .html_str_len = STRLEN(HTML), .character = CH }
+
+static char* legacy_replace_html_entities(char* str) {
+    static const HtmlEntityPair entity_map[] = {
+        HTML_ENTITY_PAIR("&quot;", '\"'), HTML_ENTITY_PAIR("&apos;", '\''),
+        HTML_ENTITY_PAIR("&amp;", '&'),   HTML_ENTITY_PAIR("&lt;", '<'),
+        HTML_ENTITY_PAIR("&gt;", '>'),    HTML_ENTITY_PAIR("&#034;", '\"'),
+        HTML_ENTITY_PAIR("&#039;", '\''), HTML_ENTITY_PAIR("&#038;", '&'),
+        HTML_ENTITY_PAIR("&#060;", '<'),  HTML_ENTITY_PAIR("&#062;", '>'),
+    };
+
+    for (size_t i = 0; i < ARRLEN(entity_map); i++) {
+        char* cur_ent;
+        while ((cur_ent = strstr(str, entity_map[i].html_str)) != NULL) {
+            *cur_ent = entity_map[i].character;
+            STRMOVE(cur_ent + 1, cur_ent + entity_map[i].html_str_len);
+        }
+    }
+
+    return str;
+}
+
+/*
+ * Previous implementation of 'html2txt', which shifted the rest of the string
+ * after every tag. Kept as a reference for comparing the new one.
+ */
+static char* legacy_html2txt(char* str) {
+    char* const start = str;
+
+    char* label_start = str;
+    bool in_br        = false;
+
+    while (*str != '\0') {
+        switch (*str) {
+            case '<': {
+                label_start = str;
+                str++;
+
+                if (*str++ == 'b' && *str++ == 'r')
+                    in_br = true;
+            } break;
+
+            case '>': {
+                if (in_br) {
+                    *label_start++ = '\n';
+                    in_br          = false;
+                }
+
+                STRMOVE(label_start, str + 1);
+                str = label_start;
+            } break;
+
+            default: {
+                str++;
+            } break;
+        }
+    }
+
+    return start;
+}
+
+/*
+ * Convert a post with the old functions, which needed two passes.
+ */
+static char* legacy_convert(char* str) {
+    return legacy_replace_html_entities(legacy_html2txt(str));
+}
+
+/*
+ * Convert a post with the new tokenizer, which also decodes the entities.
+ */
+static char* tokenizer_convert(char* str) {
+    static HtmlSpans spans = HTML_SPANS_EMPTY;
+    html2txt(str, str, &spans);
+    return str;
+}
+
+/*
+ * Input of a single benchmark. The input is copied to the work buffer before
+ * each iteration, since both functions modify their input.
+ */
+typedef struct {
+    const char* input;
+    size_t input_sz;
+    char* work;
+    char* (*func)(char*);
+} EntityBench;
+
+static void run_entity_bench(void* ctx) {
+    EntityBench* bench = ctx;
+    memcpy(bench->work, bench->input, bench->input_sz + 1);
+    bench->func(bench->work);
+}
+
+/*
+ * Pieces used for generating synthetic posts. The first set resembles a code
+ * dump, where roughly one in eight characters is part of an entity. The second
+ * one resembles a long reply, with many quotes, quotelinks and line breaks.
+ */
+static const char* const entity_pieces[] = {
+    "if (a &lt; b &amp;&amp; c &gt; d) ",
+    "{ return &quot;str&quot;; } ",
+    "&#039;c&#039; ",
+    "std::vector&lt;int&gt; v; ",
+    "plain text without entities ",
+    "&#x3bb;x &rarr; x &hellip; ",
+};
+
+static const char* const tag_pieces[] = {
+    "<a href=\"#p123456\" class=\"quotelink\">&gt;&gt;123456</a><br>",
+    "<span class=\"quote\">&gt;implying this is a quote</span><br>",
+    "some normal text, with a link: https://example.com/<wbr>long/<wbr>path",
+    "<br><br>",
+    "and a <s>spoiler</s> ",
+};
+
+/*
+ * Generate a synthetic post of the specified size, by repeating the specified
+ * pieces.
+ */
+static char* generate_post(size_t sz, const char* const* pieces,
+                           size_t pieces_num) {
+    char* post = malloc(sz + 1);
+    if (post == NULL)
+        return NULL;
+
+    size_t written = 0;
+    for (size_t i = 0; written < sz; i++) {
+        const char* piece = pieces[i % pieces_num];
+        size_t len        = strlen(piece);
+        if (written + len > sz)
+            len = sz - written;
+        memcpy(&post[written], piece, len);
+        written += len;
+    }
+    post[sz] = '\0';
+
+    return post;
+}
+
+/*
+ * Compare the legacy and the new function with synthetic posts of different
+ * sizes, generated from the specified pieces.
+ */
+static void compare_funcs(const char* legacy_name, char* (*legacy)(char*),
+                          const char* new_name, char* (*new_func)(char*),
+                          const char* const* pieces, size_t pieces_num) {
+    static const size_t sizes[] = { 1024, 16 * 1024, 128 * 1024 };
+
+    for (size_t i = 0; i < ARRLEN(sizes); i++) {
+        char* input = generate_post(sizes[i], pieces, pieces_num);
+        char* work  = malloc(sizes[i] + 1);
+        if (input == NULL || work == NULL) {
+            free(input);
+            free(work);
+            return;
+        }
+
+        char input_name[32];
+        snprintf(input_name, sizeof(input_name), "%zu KiB", sizes[i] / 1024);
+
+        EntityBench bench = {
+            .input    = input,
+            .input_sz = sizes[i],
+            .work     = work,
+        };
+
+        bench.func = legacy;
+        bench_report(legacy_name,
+                     input_name,
+                     bench_run(run_entity_bench, &bench),
+                     sizes[i],
+                     0);
+
+        bench.func = new_func;
+        bench_report(new_name,
+                     input_name,
+                     bench_run(run_entity_bench, &bench),
+                     sizes[i],
+                     0);
+
+        free(input);
+        free(work);
+    }
+}
+
+void bench_html(void) {
+    compare_funcs("legacy_replace_entities",
+                  legacy_replace_html_entities,
+                  "html_decode_entities",
+                  html_decode_entities,
+                  entity_pieces,
+                  ARRLEN(entity_pieces));
+
+    compare_funcs("legacy_html2txt+entities",
+                  legacy_convert,
+                  "html2txt",
+                  tokenizer_convert,
+                  tag_pieces,
+                  ARRLEN(tag_pieces));
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h> /* getpid */
+
+#include "bench.h"
+#include "../src/include/buffer.h"
+#include "../src/include/index.h"
+#include "../src/include/post.h"
+#include "../src/include/util.h"
+
+/*
+ * Number of synthetic posts in the index, and number of words in each one.
+ */
+#define INDEX_POSTS      250000
+#define INDEX_POST_WORDS 24
+
+/*
+ * Number of distinct words in the synthetic posts. Lower words are much more
+ * frequent than higher ones, like in real text.
+ */
+#define INDEX_VOCABULARY 20000
+
+/*
+ * Input of a single query benchmark.
+ */
+typedef struct {
+    const Index* index;
+    const char* query;
+    IndexMatches matches;
+} QueryBench;
+
+static void run_query(void* ctx) {
+    QueryBench* bench = ctx;
+    index_search(bench->index, bench->query, &bench->matches);
+}
+
+/*
+ * Simple deterministic pseudo-random number generator, so every run uses the
+ * same index.
+ */
+static uint32_t next_random(uint64_t* state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(*state >> 33);
+}
+
+/*
+ * Get a random word number, with a skewed distribution.
+ */
+static uint32_t random_word(uint64_t* state) {
+    const double r = (double)next_random(state) / (double)UINT32_MAX;
+    return (uint32_t)(r * r * r * INDEX_VOCABULARY);
+}
+
+/*
+ * Build an index of synthetic posts at the specified path.
+ */
+static bool build_index(const char* path) {
+    IndexBuilder builder;
+    if (!index_builder_init(&builder, path))
+        return false;
+
+    uint64_t state = 1;
+    Buffer text    = BUFFER_EMPTY;
+    bool result    = true;
+    for (size_t i = 0; result && i < INDEX_POSTS; i++) {
+        buffer_clear(&text);
+        for (size_t j = 0; j < INDEX_POST_WORDS; j++)
+            buffer_printf(&text, "w%u ", random_word(&state));
+
+        const Post post = {
+            .no      = 100000000 + i,
+            .time    = 1700000000 + (long long)i,
+            .replies = -1,
+            .images  = -1,
+            .com     = text.data,
+        };
+        result = index_builder_add_post(&builder, 1000 + i / 300, &post);
+    }
+
+    result = result && index_builder_save(&builder);
+    buffer_free(&text);
+    index_builder_free(&builder);
+    return result;
+}
+
+/*
+ * Input of the benchmark of the index builder.
+ */
+typedef struct {
+    const char* path;
+    bool result;
+} BuildBench;
+
+/*
+ * The existing index is removed first, since otherwise all posts would be
+ * skipped as already indexed.
+ */
+static void run_build(void* ctx) {
+    BuildBench* bench = ctx;
+    remove(bench->path);
+    bench->result = bench->result && build_index(bench->path);
+}
+
+void bench_index(void) {
+    static const char* const queries[] = {
+        "w0",
+        "w5000",
+        "w1 w2",
+        "w3 w400",
+        "\"w0 w1\"",
+        "\"w10 w11 w12\"",
+    };
+
+    char path[256];
+    const char* tmp_dir = getenv("TMPDIR");
+    snprintf(path,
+             sizeof(path),
+             "%s/4cli-bench.%ld.idx",
+             (tmp_dir != NULL && *tmp_dir != '\0') ? tmp_dir : "/tmp",
+             (long)getpid());
+
+    BuildBench build = {
+        .path   = path,
+        .result = true,
+    };
+    const BenchResult build_result = bench_run(run_build, &build);
+    if (!build.result) {
+        ERR("Could not build the index.");
+        remove(path);
+        return;
+    }
+
+    char input_name[32];
+    snprintf(input_name, sizeof(input_name), "%d posts", INDEX_POSTS);
+    bench_report("index_build", input_name, build_result, 0, INDEX_POSTS);
+
+    Index index;
+    if (!index_open(&index, path)) {
+        remove(path);
+        return;
+    }
+
+    for (size_t i = 0; i < ARRLEN(queries); i++) {
+        QueryBench bench = {
+            .index   = &index,
+            .query   = queries[i],
+            .matches = INDEX_MATCHES_EMPTY,
+        };
+
+        const BenchResult result = bench_run(run_query, &bench);
+
+        char name[64];
+        snprintf(name,
+                 sizeof(name),
+                 "query %s (%zu)",
+                 queries[i],
+                 bench.matches.num);
+        bench_report(name, input_name, result, 0, 0);
+
+        index_matches_free(&bench.matches);
+    }
+
+    index_close(&index);
+    remove(path);
+}
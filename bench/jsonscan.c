@@ -0,0 +1,306 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cjson/cJSON.h>
+
+#include "bench.h"
+#include "../src/include/arena.h"
+#include "../src/include/buffer.h"
+#include "../src/include/jsonscan.h"
+#include "../src/include/post.h"
+#include "../src/include/pretty.h"
+#include "../src/include/util.h"
+#include "../src/include/main.h"
+
+/*
+ * Input of the parser benchmarks. Each thread is parsed from its raw JSON in
+ * every iteration.
+ */
+typedef struct {
+    const BenchCorpus* corpus;
+
+    /* Used for the parsed trees and the decoded strings */
+    Arena arena;
+    Buffer out;
+
+    /* Number of extracted posts, so they are not optimized away */
+    size_t posts_num;
+} ParserBench;
+
+/*
+ * Build the tree of each thread with cJSON, and fill a 'Post' from each post
+ * object, like the program does with '-P cjson'.
+ */
+static void run_parse_cjson(void* ctx) {
+    ParserBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->corpus->threads_num; i++) {
+        const Buffer* json = &bench->corpus->threads[i];
+        cJSON* thread = arena_parse_json(&bench->arena, json->data, json->sz);
+        cJSON* posts  = cJSON_GetObjectItemCaseSensitive(thread, "posts");
+
+        cJSON* post_json;
+        cJSON_ArrayForEach(post_json, posts) {
+            Post post;
+            if (post_from_json(&post, post_json))
+                bench->posts_num++;
+        }
+
+        arena_reset(&bench->arena);
+    }
+}
+
+/*
+ * Locate the posts of each thread with the selected scanner, and fill a 'Post'
+ * from each one, decoding its strings.
+ */
+static void run_parse_scan(void* ctx) {
+    ParserBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->corpus->threads_num; i++) {
+        const Buffer* json = &bench->corpus->threads[i];
+
+        JsonScanner scanner;
+        if (!json_scan_thread(&scanner, json->data, json->sz))
+            continue;
+
+        JsonPostRaw raw;
+        while (json_scan_next_post(&scanner, &raw)) {
+            Post post;
+            if (json_post_decode(&post, &raw, &bench->arena))
+                bench->posts_num++;
+        }
+
+        arena_reset(&bench->arena);
+    }
+}
+
+static void run_render_cjson(void* ctx) {
+    ParserBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->corpus->threads_num; i++) {
+        const Buffer* json = &bench->corpus->threads[i];
+        cJSON* thread = arena_parse_json(&bench->arena, json->data, json->sz);
+
+        buffer_clear(&bench->out);
+        pretty_render_thread(&bench->out, thread, DEFAULT_BOARD);
+        arena_reset(&bench->arena);
+    }
+}
+
+static void run_render_scan(void* ctx) {
+    ParserBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->corpus->threads_num; i++) {
+        const Buffer* json = &bench->corpus->threads[i];
+
+        buffer_clear(&bench->out);
+        pretty_render_thread_scan(&bench->out,
+                                  json->data,
+                                  json->sz,
+                                  DEFAULT_BOARD,
+                                  0,
+                                  NULL);
+    }
+}
+
+/*
+ * Threads with the escape sequences that the scanner decodes by itself, which
+ * are rare in the corpus: every single-character escape, BMP and astral code
+ * points, and unpaired UTF-16 surrogates.
+ */
+static const char* const edge_threads[] = {
+    "{\"posts\":[{\"no\":1,\"time\":1700000000,\"resto\":0,"
+    "\"sub\":\"\\\"quoted\\\" \\\\ back\\/slash\","
+    "\"com\":\"tab\\tcr\\rlf\\nbs\\bff\\f&gt;&amp;\\u0041\\u00e9\\u4E2D\","
+    "\"filename\":\"file\\u00f1\",\"ext\":\".jpg\",\"tim\":1700000000000},"
+    "{\"no\":2,\"time\":1700000001,\"resto\":1,"
+    "\"com\":\"pair \\ud83d\\ude00 upper \\uD83D\\uDE00\"}]}",
+
+    "{\"posts\":[{\"no\":1,\"time\":1700000000,\"resto\":0,"
+    "\"sub\":\"high \\ud800 alone\","
+    "\"com\":\"low \\udc00 alone<br>high then char \\ud800x<br>"
+    "high high \\ud800\\ud83d\\ude00<br>high then bmp \\ud800\\u0041\"},"
+    "{\"no\":2,\"time\":1700000001,\"resto\":1,"
+    "\"com\":\"high at the end \\udbff\"},"
+    "{\"no\":3,\"time\":1700000002,\"resto\":1,\"com\":\"\\udfff\"}]}",
+};
+
+/*
+ * Replace the unpaired surrogates that cJSON encodes as if they were code
+ * points, which is not valid UTF-8, with U+FFFD, like the scanner does. Both
+ * take three bytes, so it's done in place.
+ */
+static void replace_surrogates(Buffer* buf) {
+    unsigned char* data = (unsigned char*)buf->data;
+    for (size_t i = 0; i + 2 < buf->sz; i++) {
+        if (data[i] != 0xED || data[i + 1] < 0xA0 || data[i + 1] > 0xBF)
+            continue;
+
+        data[i]     = 0xEF;
+        data[i + 1] = 0xBF;
+        data[i + 2] = 0xBD;
+        i += 2;
+    }
+}
+
+/*
+ * Render a thread with cJSON, like '-P cjson', and with every implementation
+ * of the scanner supported by this processor, like '-P scan', and check that
+ * the output is the same. Returns false if it's not.
+ */
+static bool check_thread(ParserBench* bench, Buffer* expected,
+                         const char* name, const char* json, size_t json_sz) {
+    static const JsonScanImpl impls[] = {
+        JSON_SCAN_SCALAR,
+        JSON_SCAN_SSE2,
+        JSON_SCAN_AVX2,
+    };
+
+    json_scan_select(JSON_SCAN_NONE);
+    cJSON* thread = arena_parse_json(&bench->arena, json, json_sz);
+    buffer_clear(expected);
+    const bool expected_ok =
+      thread != NULL && pretty_render_thread(expected, thread, DEFAULT_BOARD);
+    arena_reset(&bench->arena);
+    replace_surrogates(expected);
+
+    bool result = true;
+    for (size_t i = 0; i < ARRLEN(impls); i++) {
+        if (!json_scan_select(impls[i]))
+            continue;
+
+        buffer_clear(&bench->out);
+        const bool ok = pretty_render_thread_scan(&bench->out,
+                                                  json,
+                                                  json_sz,
+                                                  DEFAULT_BOARD,
+                                                  0,
+                                                  NULL);
+        if (ok != expected_ok || bench->out.sz != expected->sz ||
+            memcmp(bench->out.data, expected->data, expected->sz) != 0) {
+            ERR("The '%s' scanner doesn't render %s like cJSON.",
+                json_scan_name(impls[i]),
+                name);
+            result = false;
+        }
+    }
+
+    json_scan_select(JSON_SCAN_NONE);
+    return result;
+}
+
+bool bench_jsonscan_check(const BenchCorpus* corpus) {
+    ParserBench bench = {
+        .corpus    = corpus,
+        .arena     = ARENA_EMPTY,
+        .out       = BUFFER_EMPTY,
+        .posts_num = 0,
+    };
+    Buffer expected = BUFFER_EMPTY;
+
+    bool result = true;
+    char name[64];
+    for (size_t i = 0; i < corpus->threads_num; i++) {
+        snprintf(name, sizeof(name), "thread %zu of the corpus", i);
+        if (!check_thread(&bench,
+                          &expected,
+                          name,
+                          corpus->threads[i].data,
+                          corpus->threads[i].sz))
+            result = false;
+    }
+
+    for (size_t i = 0; i < ARRLEN(edge_threads); i++) {
+        snprintf(name, sizeof(name), "edge case %zu", i);
+        if (!check_thread(&bench,
+                          &expected,
+                          name,
+                          edge_threads[i],
+                          strlen(edge_threads[i])))
+            result = false;
+    }
+
+    buffer_free(&expected);
+    buffer_free(&bench.out);
+    arena_free(&bench.arena);
+    return result;
+}
+
+void bench_jsonscan(const BenchCorpus* corpus) {
+    ParserBench bench = {
+        .corpus    = corpus,
+        .arena     = ARENA_EMPTY,
+        .out       = BUFFER_EMPTY,
+        .posts_num = 0,
+    };
+
+    bench_report("parse_posts_cjson",
+                 corpus->name,
+                 bench_run(run_parse_cjson, &bench),
+                 corpus->threads_sz,
+                 corpus->posts_num);
+
+    /* Every implementation supported by this processor */
+    static const JsonScanImpl impls[] = {
+        JSON_SCAN_SCALAR,
+        JSON_SCAN_SSE2,
+        JSON_SCAN_AVX2,
+    };
+
+    for (size_t i = 0; i < ARRLEN(impls); i++) {
+        if (!json_scan_select(impls[i]))
+            continue;
+
+        char name[64];
+        snprintf(name,
+                 sizeof(name),
+                 "parse_posts_scan_%s",
+                 json_scan_name(impls[i]));
+        bench_report(name,
+                     corpus->name,
+                     bench_run(run_parse_scan, &bench),
+                     corpus->threads_sz,
+                     corpus->posts_num);
+    }
+
+    /* Parsing and rendering, as done by the pipeline */
+    bench_report("render_thread_cjson",
+                 corpus->name,
+                 bench_run(run_render_cjson, &bench),
+                 corpus->threads_sz,
+                 corpus->posts_num);
+
+    json_scan_select(json_scan_best());
+    bench_report("render_thread_scan",
+                 corpus->name,
+                 bench_run(run_render_scan, &bench),
+                 corpus->threads_sz,
+                 corpus->posts_num);
+
+    /* The other benchmarks use cJSON */
+    json_scan_select(JSON_SCAN_NONE);
+
+    buffer_free(&bench.out);
+    arena_free(&bench.arena);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h> /* sysconf */
+
+#include <cjson/cJSON.h>
+
+#include "bench.h"
+#include "../src/include/arena.h"
+#include "../src/include/buffer.h"
+#include "../src/include/pipeline.h"
+#include "../src/include/pretty.h"
+#include "../src/include/util.h"
+#include "../src/include/main.h"
+
+/*
+ * Input of the pipeline benchmarks.
+ */
+typedef struct {
+    const BenchCorpus* corpus;
+    size_t workers;
+
+    /* Total size of the rendered threads, so they are not optimized away */
+    size_t out_sz;
+
+    /* Used by the main thread, when there is no pipeline */
+    Arena arena;
+    Buffer out;
+} PipelineBench;
+
+/*
+ * Parse and render each thread on the main thread, like the program does with
+ * '-p 0'.
+ */
+static void run_serial(void* ctx) {
+    PipelineBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->corpus->threads_num; i++) {
+        const Buffer* json = &bench->corpus->threads[i];
+        cJSON* thread = arena_parse_json(&bench->arena, json->data, json->sz);
+
+        buffer_clear(&bench->out);
+        pretty_render_thread(&bench->out, thread, DEFAULT_BOARD);
+        bench->out_sz += bench->out.sz;
+        arena_reset(&bench->arena);
+    }
+}
+
+static void on_output(void* user_data, PipelineJob* job) {
+    PipelineBench* bench = user_data;
+    bench->out_sz += job->out.sz;
+}
+
+/*
+ * Pass each thread through a pipeline with the specified number of workers.
+ * The threads are copied into the jobs, like the program does when receiving
+ * them.
+ */
+static void run_pipeline(void* ctx) {
+    PipelineBench* bench = ctx;
+
+    Pipeline* pipeline = pipeline_new(bench->workers, on_output, bench);
+    if (pipeline == NULL)
+        return;
+
+    for (size_t i = 0; i < bench->corpus->threads_num; i++) {
+        const Buffer* json = &bench->corpus->threads[i];
+
+        PipelineJob* job = pipeline_next_job(pipeline);
+        job->id          = i + 1;
+        buffer_append(&job->body, json->data, json->sz);
+        pipeline_submit(pipeline);
+        pipeline_flush(pipeline);
+    }
+
+    pipeline_finish(pipeline);
+    pipeline_free(pipeline);
+}
+
+void bench_pipeline(const BenchCorpus* corpus) {
+    PipelineBench bench = {
+        .corpus = corpus,
+        .arena  = ARENA_EMPTY,
+        .out    = BUFFER_EMPTY,
+    };
+
+    bench_report("pipeline_serial",
+                 corpus->name,
+                 bench_run(run_serial, &bench),
+                 corpus->threads_sz,
+                 corpus->threads_num);
+
+    /* Powers of two, and the number of processors */
+    const long processors    = sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t max_workers = (processors > 0) ? (size_t)processors : 1;
+
+    size_t workers = 1;
+    for (;;) {
+        bench.workers = workers;
+
+        char name[64];
+        snprintf(name, sizeof(name), "pipeline_workers_%zu", workers);
+        bench_report(name,
+                     corpus->name,
+                     bench_run(run_pipeline, &bench),
+                     corpus->threads_sz,
+                     corpus->threads_num);
+
+        if (workers >= max_workers)
+            break;
+        workers = (workers * 2 > max_workers) ? max_workers : workers * 2;
+    }
+
+    buffer_free(&bench.out);
+    arena_free(&bench.arena);
+}
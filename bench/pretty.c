@@ -0,0 +1,329 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h> /* isspace */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cjson/cJSON.h>
+
+#include "bench.h"
+#include "../src/include/arena.h"
+#include "../src/include/buffer.h"
+#include "../src/include/html.h"
+#include "../src/include/pretty.h"
+#include "../src/include/util.h"
+#include "../src/include/main.h"
+
+/*
+ * Previous implementation of the renderer, which wrote each character, padding
+ * space and color sequence to the file separately. Kept as a reference for
+ * comparing the new one. The only difference is that the post contents are
+ * converted into a separate buffer, so the same tree can be rendered again.
+ */
+#define LEGACY_MAX_COLUMN 80
+#define LEGACY_POST_PAD   6
+
+typedef enum {
+    LEGACY_STYLE_UNKNOWN,
+    LEGACY_STYLE_POST,
+    LEGACY_STYLE_QUOTE,
+    LEGACY_STYLE_XPOST,
+} LegacyStyle;
+
+static void legacy_print_pad(FILE* fp, int amount) {
+    for (int i = 0; i < amount; i++)
+        fputc(' ', fp);
+}
+
+static LegacyStyle legacy_style_at(const HtmlSpans* spans, size_t* first,
+                                   size_t pos, bool* in_quote) {
+    while (*first < spans->num && spans->data[*first].end <= pos)
+        (*first)++;
+
+    LegacyStyle result = LEGACY_STYLE_POST;
+    bool quote         = false;
+    for (size_t i = *first; i < spans->num && spans->data[i].start <= pos;
+         i++) {
+        const HtmlSpan* span = &spans->data[i];
+        if (pos >= span->end)
+            continue;
+
+        if (span->kind == HTML_SPAN_QUOTELINK ||
+            span->kind == HTML_SPAN_DEADLINK) {
+            result = LEGACY_STYLE_XPOST;
+        } else if (span->kind == HTML_SPAN_QUOTE) {
+            quote = true;
+            if (result != LEGACY_STYLE_XPOST)
+                result = LEGACY_STYLE_QUOTE;
+        }
+    }
+
+    if (in_quote != NULL)
+        *in_quote = quote;
+    return result;
+}
+
+static const char* legacy_style_color(LegacyStyle style) {
+    switch (style) {
+        case LEGACY_STYLE_QUOTE:
+            return COL_QUOTE;
+        case LEGACY_STYLE_XPOST:
+            return COL_XPOST;
+        default:
+            return COL_POST;
+    }
+}
+
+static void legacy_print_post_contents(FILE* fp, const char* str,
+                                       const HtmlSpans* spans, bool use_pad) {
+    size_t first          = 0;
+    LegacyStyle cur_style = LEGACY_STYLE_POST;
+
+    size_t last_newline_idx = 0, last_space_idx = 0;
+
+    size_t max_column = LEGACY_MAX_COLUMN;
+    if (use_pad)
+        max_column -= LEGACY_POST_PAD;
+
+    for (size_t i = 0; str[i] != '\0'; i++) {
+        if (isspace((unsigned char)str[i])) {
+            last_space_idx = i;
+            if (str[i] == '\n')
+                last_newline_idx = i;
+            continue;
+        }
+
+        if (!isspace((unsigned char)str[i + 1]) && str[i + 1] != '\0')
+            continue;
+
+        const bool is_first_word_of_input_line =
+          (last_space_idx == 0 || str[last_space_idx] == '\n');
+
+        const size_t word_start =
+          (last_space_idx == 0) ? 0 : last_space_idx + 1;
+
+        bool in_quote;
+        legacy_style_at(spans, &first, word_start, &in_quote);
+
+        if (i - last_newline_idx >= max_column) {
+            fputc('\n', fp);
+            last_newline_idx = last_space_idx;
+            if (use_pad)
+                legacy_print_pad(fp, LEGACY_POST_PAD);
+
+            if (in_quote) {
+                fprintf(fp, COL_QUOTE ">");
+                cur_style = LEGACY_STYLE_QUOTE;
+            } else if (cur_style != LEGACY_STYLE_POST) {
+                cur_style = LEGACY_STYLE_UNKNOWN;
+            }
+        } else if (last_space_idx != 0) {
+            fputc(str[last_space_idx], fp);
+            if (str[last_space_idx] == '\n' && cur_style != LEGACY_STYLE_POST)
+                cur_style = LEGACY_STYLE_UNKNOWN;
+        }
+
+        if (is_first_word_of_input_line && use_pad)
+            legacy_print_pad(fp, LEGACY_POST_PAD);
+
+        for (size_t j = word_start; j <= i; j++) {
+            const LegacyStyle style = legacy_style_at(spans, &first, j, NULL);
+            if (style != cur_style) {
+                fprintf(fp, "%s", legacy_style_color(style));
+                cur_style = style;
+            }
+
+            fputc(str[j], fp);
+        }
+    }
+
+    fprintf(fp, "%s", COL_NORM);
+}
+
+static void legacy_print_post(FILE* fp, cJSON* p, bool is_reply) {
+    static Buffer converted = BUFFER_EMPTY;
+    static HtmlSpans spans  = HTML_SPANS_EMPTY;
+
+    cJSON* post_no       = cJSON_GetObjectItemCaseSensitive(p, "no");
+    cJSON* post_replies  = cJSON_GetObjectItemCaseSensitive(p, "replies");
+    cJSON* post_images   = cJSON_GetObjectItemCaseSensitive(p, "images");
+    cJSON* post_title    = cJSON_GetObjectItemCaseSensitive(p, "sub");
+    cJSON* post_filename = cJSON_GetObjectItemCaseSensitive(p, "filename");
+    cJSON* post_ext      = cJSON_GetObjectItemCaseSensitive(p, "ext");
+    cJSON* post_img_url  = cJSON_GetObjectItemCaseSensitive(p, "tim");
+    cJSON* post_content  = cJSON_GetObjectItemCaseSensitive(p, "com");
+
+    fputc('\n', fp);
+    if (is_reply)
+        legacy_print_pad(fp, LEGACY_POST_PAD);
+
+    if (cJSON_IsNumber(post_no))
+        fprintf(fp, COL_INFO "[%d] " COL_NORM, post_no->valueint);
+    else
+        fprintf(fp, COL_INFO "[???] " COL_NORM);
+
+    if (cJSON_IsString(post_title))
+        fprintf(fp, COL_TITLE "%s" COL_NORM, post_title->valuestring);
+    else
+        fprintf(fp, COL_TITLE "Anonymous" COL_NORM);
+
+    if (cJSON_IsNumber(post_replies)) {
+        fprintf(fp, COL_REPLIES " (%d replies", post_replies->valueint);
+        if (cJSON_IsNumber(post_images))
+            fprintf(fp, ", %d images", post_images->valueint);
+        fprintf(fp, ")" COL_NORM);
+    }
+
+    if (cJSON_IsNumber(post_img_url) && cJSON_IsString(post_ext)) {
+        fputc('\n', fp);
+        if (is_reply)
+            legacy_print_pad(fp, LEGACY_POST_PAD);
+
+        fprintf(fp,
+                COL_URL "https://i.4cdn.org/" DEFAULT_BOARD "/%.0f%s" COL_NORM,
+                post_img_url->valuedouble,
+                post_ext->valuestring);
+
+        if (cJSON_IsString(post_filename))
+            fprintf(fp,
+                    " (" COL_FILENAME "%s%s" COL_NORM ")",
+                    post_filename->valuestring,
+                    post_ext->valuestring);
+    }
+
+    if (cJSON_IsString(post_content)) {
+        const char* html = post_content->valuestring;
+
+        buffer_clear(&converted);
+        if (!buffer_reserve(&converted, strlen(html)))
+            return;
+        converted.sz = html2txt(converted.data, html, &spans);
+
+        fputc('\n', fp);
+        legacy_print_post_contents(fp, converted.data, &spans, is_reply);
+    }
+
+    fputc('\n', fp);
+}
+
+static void legacy_print_thread(FILE* fp, cJSON* thread_json) {
+    cJSON* posts = cJSON_GetObjectItemCaseSensitive(thread_json, "posts");
+
+    int post_count = 0;
+    cJSON* p;
+    cJSON_ArrayForEach(p, posts) {
+        legacy_print_post(fp, p, post_count > 0);
+        post_count++;
+    }
+}
+
+/*
+ * Input of a single rendering benchmark.
+ */
+typedef struct {
+    cJSON** threads;
+    size_t threads_num;
+    FILE* fp;
+} RenderBench;
+
+static void run_legacy_render(void* ctx) {
+    RenderBench* bench = ctx;
+    for (size_t i = 0; i < bench->threads_num; i++)
+        legacy_print_thread(bench->fp, bench->threads[i]);
+}
+
+static void run_buffered_render(void* ctx) {
+    RenderBench* bench = ctx;
+    for (size_t i = 0; i < bench->threads_num; i++)
+        pretty_print_thread(bench->fp, bench->threads[i], DEFAULT_BOARD);
+}
+
+/*
+ * Compare the rendering throughput of the legacy and the buffered renderer,
+ * writing to '/dev/null'. The buffered renderer is also measured with
+ * backlinks, which builds the reply graph of each thread. The throughput is
+ * calculated from the number of rendered bytes.
+ */
+void bench_pretty(const BenchCorpus* corpus) {
+    FILE* fp = fopen("/dev/null", "w");
+    if (fp == NULL) {
+        ERR("Could not open '/dev/null'.");
+        return;
+    }
+
+    RenderBench bench = {
+        .threads     = calloc(corpus->threads_num, sizeof(cJSON*)),
+        .threads_num = 0,
+        .fp          = fp,
+    };
+
+    /* The trees are needed until the end */
+    Arena arena        = ARENA_EMPTY;
+    Buffer out          = BUFFER_EMPTY;
+    size_t rendered_sz  = 0;
+    size_t backlinks_sz = 0;
+    for (size_t i = 0; bench.threads != NULL && i < corpus->threads_num;
+         i++) {
+        cJSON* thread = arena_parse_json(&arena,
+                                         corpus->threads[i].data,
+                                         corpus->threads[i].sz);
+        if (thread == NULL)
+            continue;
+
+        buffer_clear(&out);
+        pretty_render_thread(&out, thread, DEFAULT_BOARD);
+        rendered_sz += out.sz;
+
+        pretty_enable_backlinks(true);
+        buffer_clear(&out);
+        pretty_render_thread(&out, thread, DEFAULT_BOARD);
+        backlinks_sz += out.sz;
+        pretty_enable_backlinks(false);
+
+        bench.threads[bench.threads_num++] = thread;
+    }
+
+    if (bench.threads_num > 0) {
+        bench_report("legacy_print_thread",
+                     corpus->name,
+                     bench_run(run_legacy_render, &bench),
+                     rendered_sz,
+                     corpus->posts_num);
+        bench_report("pretty_print_thread",
+                     corpus->name,
+                     bench_run(run_buffered_render, &bench),
+                     rendered_sz,
+                     corpus->posts_num);
+
+        pretty_enable_backlinks(true);
+        bench_report("pretty_print_thread_graph",
+                     corpus->name,
+                     bench_run(run_buffered_render, &bench),
+                     backlinks_sz,
+                     corpus->posts_num);
+        pretty_enable_backlinks(false);
+    }
+
+    free(bench.threads);
+    buffer_free(&out);
+    arena_free(&arena);
+    fclose(fp);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "../src/include/buffer.h"
+#include "../src/include/jsonscan.h"
+#include "../src/include/pretty.h"
+#include "../src/include/render.h"
+#include "../src/include/util.h"
+#include "../src/include/main.h"
+
+/*
+ * Input of the export benchmarks. Each thread is scanned from its raw JSON and
+ * rendered in every iteration, like the pipeline does.
+ */
+typedef struct {
+    const BenchCorpus* corpus;
+    Buffer out;
+
+    /* Remove the colors from the pretty output, see 'strip_colors' */
+    bool strip;
+} ExportBench;
+
+/*
+ * Remove the escape sequences from the rendered text, in place. This is what
+ * programs that ingest the pretty output had to do, so it's measured as the
+ * baseline of the machine-readable formats.
+ */
+static void strip_colors(Buffer* buffer) {
+    size_t dst = 0;
+    for (size_t src = 0; src < buffer->sz; src++) {
+        if (buffer->data[src] != '\x1B') {
+            buffer->data[dst++] = buffer->data[src];
+            continue;
+        }
+
+        /* Skip the "ESC [ ... m" sequence */
+        while (src < buffer->sz && buffer->data[src] != 'm')
+            src++;
+    }
+
+    buffer->sz = dst;
+}
+
+static void run_export(void* ctx) {
+    ExportBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->corpus->threads_num; i++) {
+        const Buffer* json = &bench->corpus->threads[i];
+
+        buffer_clear(&bench->out);
+        pretty_render_thread_scan(&bench->out,
+                                  json->data,
+                                  json->sz,
+                                  DEFAULT_BOARD,
+                                  0,
+                                  NULL);
+        if (bench->strip)
+            strip_colors(&bench->out);
+    }
+}
+
+/*
+ * Compare the throughput of exporting the whole corpus with each renderer. The
+ * throughput is calculated from the size of the thread JSONs, so the formats
+ * can be compared with each other.
+ */
+void bench_render(const BenchCorpus* corpus) {
+    ExportBench bench = {
+        .corpus = corpus,
+        .out    = BUFFER_EMPTY,
+        .strip  = false,
+    };
+
+    static const struct {
+        const char* name;
+        RenderFormat format;
+        bool strip;
+    } exports[] = {
+        { "export_pretty", RENDER_PRETTY, false },
+        { "export_pretty_stripped", RENDER_PRETTY, true },
+        { "export_ndjson", RENDER_NDJSON, false },
+        { "export_tsv", RENDER_TSV, false },
+    };
+
+    json_scan_select(json_scan_best());
+    for (size_t i = 0; i < ARRLEN(exports); i++) {
+        render_select(exports[i].format);
+        bench.strip = exports[i].strip;
+        bench_report(exports[i].name,
+                     corpus->name,
+                     bench_run(run_export, &bench),
+                     corpus->threads_sz,
+                     corpus->posts_num);
+    }
+
+    /* The other benchmarks use cJSON and the pretty printer */
+    json_scan_select(JSON_SCAN_NONE);
+    render_select(RENDER_PRETTY);
+
+    buffer_free(&bench.out);
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cjson/cJSON.h>
+
+#include "bench.h"
+#include "../src/include/arena.h"
+#include "../src/include/buffer.h"
+#include "../src/include/html.h"
+#include "../src/include/post.h"
+#include "../src/include/pretty.h"
+#include "../src/include/thread.h"
+#include "../src/include/util.h"
+#include "../src/include/main.h"
+
+/*
+ * Input of the stage benchmarks. The whole corpus is parsed once, and each
+ * stage only runs on the output of the previous ones.
+ */
+typedef struct {
+    cJSON* thread_list;
+    size_t thread_list_num;
+
+    cJSON** threads;
+    size_t threads_num;
+
+    /* Posts of all threads, and whether each one is a reply */
+    Post* posts;
+    bool* is_reply;
+    size_t posts_num;
+
+    /* Total length of the HTML of the post contents */
+    size_t html_sz, html_num;
+
+    /* Used for the output of each iteration */
+    char* work;
+    HtmlSpans spans;
+    Buffer out;
+} StageBench;
+
+static void run_threads_from_json(void* ctx) {
+    StageBench* bench = ctx;
+
+    static ThreadInfo threads[MAX_THREADS];
+    threads_from_json(threads, ARRLEN(threads), bench->thread_list);
+}
+
+static void run_html2txt(void* ctx) {
+    StageBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->posts_num; i++)
+        if (bench->posts[i].com != NULL)
+            html2txt(bench->work, bench->posts[i].com, &bench->spans);
+}
+
+/*
+ * The entities are decoded in place, so each post is copied to the work buffer
+ * first.
+ */
+static void run_decode_entities(void* ctx) {
+    StageBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->posts_num; i++) {
+        const char* html = bench->posts[i].com;
+        if (html == NULL)
+            continue;
+
+        strcpy(bench->work, html);
+        html_decode_entities(bench->work);
+    }
+}
+
+static void run_render_post(void* ctx) {
+    StageBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->posts_num; i++) {
+        buffer_clear(&bench->out);
+        pretty_render_post(&bench->out,
+                           &bench->posts[i],
+                           NULL,
+                           DEFAULT_BOARD,
+                           bench->is_reply[i]);
+    }
+}
+
+static void run_render_thread(void* ctx) {
+    StageBench* bench = ctx;
+
+    for (size_t i = 0; i < bench->threads_num; i++) {
+        buffer_clear(&bench->out);
+        pretty_render_thread(&bench->out, bench->threads[i], DEFAULT_BOARD);
+    }
+}
+
+/*
+ * Parse the corpus, and extract the posts of all threads.
+ */
+static bool prepare(StageBench* bench, const BenchCorpus* corpus,
+                    Arena* arena) {
+    if (corpus->thread_list.sz > 0) {
+        bench->thread_list = arena_parse_json(arena,
+                                              corpus->thread_list.data,
+                                              corpus->thread_list.sz);
+
+        static ThreadInfo threads[MAX_THREADS];
+        bench->thread_list_num =
+          threads_from_json(threads, ARRLEN(threads), bench->thread_list);
+    }
+
+    bench->threads  = calloc(corpus->threads_num, sizeof(cJSON*));
+    bench->posts    = calloc(corpus->posts_num, sizeof(Post));
+    bench->is_reply = calloc(corpus->posts_num, sizeof(bool));
+    if (bench->threads == NULL || bench->posts == NULL ||
+        bench->is_reply == NULL)
+        return false;
+
+    size_t max_html_len = 0;
+    for (size_t i = 0; i < corpus->threads_num; i++) {
+        cJSON* thread = arena_parse_json(arena,
+                                         corpus->threads[i].data,
+                                         corpus->threads[i].sz);
+        bench->threads[bench->threads_num++] = thread;
+
+        cJSON* posts = cJSON_GetObjectItemCaseSensitive(thread, "posts");
+        cJSON* post_json;
+        cJSON_ArrayForEach(post_json, posts) {
+            Post* post = &bench->posts[bench->posts_num];
+            if (bench->posts_num >= corpus->posts_num ||
+                !post_from_json(post, post_json))
+                continue;
+
+            bench->is_reply[bench->posts_num] = (post_json != posts->child);
+            bench->posts_num++;
+
+            if (post->com != NULL) {
+                const size_t len = strlen(post->com);
+                if (len > max_html_len)
+                    max_html_len = len;
+                bench->html_sz += len;
+                bench->html_num++;
+            }
+        }
+    }
+
+    bench->work = malloc(max_html_len + 1);
+    return bench->work != NULL;
+}
+
+void bench_stages(const BenchCorpus* corpus) {
+    StageBench bench = {
+        .thread_list = NULL,
+        .spans       = HTML_SPANS_EMPTY,
+        .out         = BUFFER_EMPTY,
+    };
+
+    /* The parsed trees are needed until the end */
+    Arena arena = ARENA_EMPTY;
+    if (!prepare(&bench, corpus, &arena)) {
+        ERR("Could not prepare the stage benchmarks.");
+        goto done;
+    }
+
+    if (bench.thread_list_num > 0)
+        bench_report("threads_from_json",
+                     corpus->name,
+                     bench_run(run_threads_from_json, &bench),
+                     corpus->thread_list.sz,
+                     bench.thread_list_num);
+
+    /* The HTML stages are relative to the contents of the posts */
+    bench_report("html2txt",
+                 corpus->name,
+                 bench_run(run_html2txt, &bench),
+                 bench.html_sz,
+                 bench.html_num);
+    bench_report("html_decode_entities",
+                 corpus->name,
+                 bench_run(run_decode_entities, &bench),
+                 bench.html_sz,
+                 bench.html_num);
+
+    /* The rendering stages are relative to the thread JSONs */
+    bench_report("pretty_render_post",
+                 corpus->name,
+                 bench_run(run_render_post, &bench),
+                 corpus->threads_sz,
+                 bench.posts_num);
+    bench_report("pretty_render_thread",
+                 corpus->name,
+                 bench_run(run_render_thread, &bench),
+                 corpus->threads_sz,
+                 bench.posts_num);
+
+done:
+    free(bench.threads);
+    free(bench.posts);
+    free(bench.is_reply);
+    free(bench.work);
+    html_spans_free(&bench.spans);
+    buffer_free(&bench.out);
+    arena_free(&arena);
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>    /* open */
+#include <sys/mman.h> /* mmap */
+#include <sys/stat.h> /* fstat */
+#include <unistd.h>   /* close, getpid */
+
+#include <cjson/cJSON.h>
+
+#include "include/archive.h"
+#include "include/buffer.h"
+#include "include/post.h"
+#include "include/util.h"
+
+void archive_writer_init(ArchiveWriter* writer) {
+    const Buffer empty = BUFFER_EMPTY;
+
+    writer->threads     = empty;
+    writer->posts       = empty;
+    writer->heap        = empty;
+    writer->threads_num = 0;
+    writer->posts_num   = 0;
+}
+
+void archive_writer_free(ArchiveWriter* writer) {
+    buffer_free(&writer->threads);
+    buffer_free(&writer->posts);
+    buffer_free(&writer->heap);
+}
+
+/*
+ * Copy a string to the heap of the archive, including its null terminator, and
+ * return its offset. Returns ARCHIVE_NO_STR for NULL strings, or if the heap is
+ * full.
+ */
+static uint32_t add_string(ArchiveWriter* writer, const char* str) {
+    if (str == NULL)
+        return ARCHIVE_NO_STR;
+
+    const size_t len = strlen(str) + 1;
+    if (writer->heap.sz + len >= ARCHIVE_NO_STR)
+        return ARCHIVE_NO_STR;
+
+    const uint32_t offset = (uint32_t)writer->heap.sz;
+    if (!buffer_append(&writer->heap, str, len))
+        return ARCHIVE_NO_STR;
+
+    return offset;
+}
+
+bool archive_writer_add_thread(ArchiveWriter* writer, ThreadId id,
+                               cJSON* thread_json) {
+    cJSON* posts = cJSON_GetObjectItemCaseSensitive(thread_json, "posts");
+    if (!cJSON_IsArray(posts))
+        return false;
+
+    ArchiveThread thread = {
+        .id         = id,
+        .first_post = writer->posts_num,
+        .posts_num  = 0,
+    };
+
+    cJSON* cur_post;
+    cJSON_ArrayForEach(cur_post, posts) {
+        Post post;
+        if (!post_from_json(&post, cur_post))
+            continue;
+
+        ArchivePost header = {
+            .no       = post.no,
+            .time     = post.time,
+            .tim      = post.tim,
+            .replies  = post.replies,
+            .images   = post.images,
+            .sub      = add_string(writer, post.sub),
+            .name     = add_string(writer, post.name),
+            .filename = add_string(writer, post.filename),
+            .ext      = add_string(writer, post.ext),
+            .com      = add_string(writer, post.com),
+            .reserved = 0,
+        };
+
+        if (!buffer_append(&writer->posts,
+                           (const char*)&header,
+                           sizeof(header)))
+            return false;
+
+        writer->posts_num++;
+        thread.posts_num++;
+    }
+
+    if (!buffer_append(&writer->threads, (const char*)&thread, sizeof(thread)))
+        return false;
+
+    writer->threads_num++;
+    return true;
+}
+
+bool archive_writer_save(const ArchiveWriter* writer, const char* path) {
+    ArchiveHeader header = {
+        .version     = ARCHIVE_VERSION,
+        .byte_order  = ARCHIVE_BYTE_ORDER,
+        .threads_num = writer->threads_num,
+        .posts_num   = writer->posts_num,
+        .heap_sz     = writer->heap.sz,
+    };
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+
+    char tmp_path[1024];
+    const long pid = (long)getpid();
+    const int written =
+      snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", path, pid);
+    if (written <= 0 || (size_t)written >= sizeof(tmp_path))
+        return false;
+
+    /*
+     * Write to a temporary file and rename it, so an archive that is being
+     * read is never left incomplete.
+     */
+    FILE* fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        ERR("Could not create archive '%s'.", tmp_path);
+        return false;
+    }
+
+    const bool success =
+      fwrite(&header, sizeof(header), 1, fp) == 1 &&
+      fwrite(writer->threads.data, 1, writer->threads.sz, fp) ==
+        writer->threads.sz &&
+      fwrite(writer->posts.data, 1, writer->posts.sz, fp) ==
+        writer->posts.sz &&
+      fwrite(writer->heap.data, 1, writer->heap.sz, fp) == writer->heap.sz;
+
+    if (fclose(fp) != 0 || !success || rename(tmp_path, path) != 0) {
+        ERR("Could not write archive '%s'.", path);
+        remove(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Check that the tables of a mapped archive fit in the file, and that they
+ * only refer to valid threads, posts and strings.
+ */
+static bool validate_archive(const Archive* archive) {
+    /* Every string ends before the end of the heap */
+    if (archive->heap_sz > 0 && archive->heap[archive->heap_sz - 1] != '\0')
+        return false;
+
+    for (size_t i = 0; i < archive->threads_num; i++) {
+        const ArchiveThread* thread = &archive->threads[i];
+        if (thread->first_post > archive->posts_num ||
+            thread->posts_num > archive->posts_num - thread->first_post)
+            return false;
+    }
+
+    for (size_t i = 0; i < archive->posts_num; i++) {
+        const ArchivePost* post   = &archive->posts[i];
+        const uint32_t offsets[] = {
+            post->sub, post->name, post->filename, post->ext, post->com,
+        };
+
+        for (size_t j = 0; j < ARRLEN(offsets); j++)
+            if (offsets[j] != ARCHIVE_NO_STR && offsets[j] >= archive->heap_sz)
+                return false;
+    }
+
+    return true;
+}
+
+bool archive_open(Archive* archive, const char* path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERR("Could not open archive '%s'.", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ArchiveHeader)) {
+        ERR("Invalid archive '%s'.", path);
+        close(fd);
+        return false;
+    }
+
+    archive->map_sz = (size_t)st.st_size;
+    archive->map = mmap(NULL, archive->map_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (archive->map == MAP_FAILED) {
+        ERR("Could not map archive '%s'.", path);
+        return false;
+    }
+
+    /* The tables are placed right after the header, and they are aligned */
+    const ArchiveHeader* header = archive->map;
+    const size_t available      = archive->map_sz - sizeof(ArchiveHeader);
+    if (memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ARCHIVE_VERSION ||
+        header->byte_order != ARCHIVE_BYTE_ORDER ||
+        header->threads_num > available / sizeof(ArchiveThread) ||
+        header->posts_num > available / sizeof(ArchivePost) ||
+        header->threads_num * sizeof(ArchiveThread) +
+            header->posts_num * sizeof(ArchivePost) + header->heap_sz !=
+          available) {
+        ERR("Invalid archive '%s'.", path);
+        archive_close(archive);
+        return false;
+    }
+
+    const char* tables = (const char*)archive->map + sizeof(ArchiveHeader);
+
+    archive->threads_num = header->threads_num;
+    archive->posts_num   = header->posts_num;
+    archive->heap_sz     = header->heap_sz;
+    archive->threads     = (const ArchiveThread*)tables;
+    archive->posts =
+      (const ArchivePost*)(tables +
+                           archive->threads_num * sizeof(ArchiveThread));
+    archive->heap = (const char*)(archive->posts + archive->posts_num);
+
+    if (!validate_archive(archive)) {
+        ERR("Invalid archive '%s'.", path);
+        archive_close(archive);
+        return false;
+    }
+
+    return true;
+}
+
+void archive_close(Archive* archive) {
+    munmap(archive->map, archive->map_sz);
+    archive->map    = NULL;
+    archive->map_sz = 0;
+}
+
+/*
+ * Get a pointer to a string in the heap of an archive, or NULL for
+ * ARCHIVE_NO_STR.
+ */
+static inline const char* get_string(const Archive* archive, uint32_t offset) {
+    return (offset == ARCHIVE_NO_STR) ? NULL : &archive->heap[offset];
+}
+
+void archive_get_post(const Archive* archive, const ArchivePost* src,
+                      Post* dst) {
+    dst->no       = src->no;
+    dst->time     = src->time;
+    dst->tim      = src->tim;
+    dst->replies  = src->replies;
+    dst->images   = src->images;
+    dst->sub      = get_string(archive, src->sub);
+    dst->name     = get_string(archive, src->name);
+    dst->filename = get_string(archive, src->filename);
+    dst->ext      = get_string(archive, src->ext);
+    dst->com      = get_string(archive, src->com);
+}
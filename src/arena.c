@@ -0,0 +1,192 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <cjson/cJSON.h>
+
+#include "include/arena.h"
+#include "include/util.h"
+
+/*
+ * Alignment of every allocation, and minimum size of a new chunk.
+ */
+#define ARENA_ALIGN     16
+#define ARENA_CHUNK_MIN (64 * 1024)
+
+/*
+ * Size of the chunk header, rounded up so the usable memory is aligned.
+ */
+#define CHUNK_HDR_SZ                                                           \
+    ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/*
+ * Arena used by the cJSON hooks in the current thread. If NULL, cJSON uses
+ * 'malloc' and 'free'.
+ */
+static THREAD_LOCAL Arena* cjson_arena = NULL;
+
+/*
+ * Statistics of the current thread, so they can be updated without locking, and
+ * the ones of the threads that already called 'arena_flush_stats'.
+ */
+static THREAD_LOCAL ArenaStats stats = { 0 };
+static ArenaStats flushed_stats      = { 0 };
+static pthread_mutex_t flushed_lock  = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Allocate a new chunk with room for at least 'sz' bytes, and make it the
+ * current one.
+ */
+static ArenaChunk* add_chunk(Arena* arena, size_t sz) {
+    /* Grow geometrically, so big workloads need few chunks */
+    size_t chunk_sz = (arena->capacity < ARENA_CHUNK_MIN) ? ARENA_CHUNK_MIN
+                                                          : arena->capacity;
+    while (chunk_sz < sz)
+        chunk_sz *= 2;
+
+    ArenaChunk* chunk = malloc(CHUNK_HDR_SZ + chunk_sz);
+    if (chunk == NULL) {
+        ERR("Couldn't allocate arena chunk of %zu bytes.", chunk_sz);
+        return NULL;
+    }
+
+    chunk->next   = arena->chunks;
+    chunk->sz     = chunk_sz;
+    chunk->used   = 0;
+    arena->chunks = chunk;
+    arena->capacity += chunk_sz;
+
+    stats.chunk_allocs++;
+    return chunk;
+}
+
+void* arena_alloc(Arena* arena, size_t sz) {
+    sz = (sz + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk == NULL || chunk->sz - chunk->used < sz) {
+        chunk = add_chunk(arena, sz);
+        if (chunk == NULL)
+            return NULL;
+    }
+
+    void* result = (char*)chunk + CHUNK_HDR_SZ + chunk->used;
+    chunk->used += sz;
+    arena->used += sz;
+
+    stats.allocs++;
+    if (arena->used > stats.peak)
+        stats.peak = arena->used;
+
+    return result;
+}
+
+void arena_reset(Arena* arena) {
+    /*
+     * If the last use needed more than one chunk, replace them with a single
+     * one that can hold everything.
+     */
+    if (arena->chunks != NULL && arena->chunks->next != NULL) {
+        const size_t total = arena->capacity;
+        arena_free(arena);
+        if (add_chunk(arena, total) == NULL)
+            return;
+    }
+
+    if (arena->chunks != NULL)
+        arena->chunks->used = 0;
+    arena->used = 0;
+}
+
+void arena_free(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks   = NULL;
+    arena->used     = 0;
+    arena->capacity = 0;
+}
+
+/*
+ * Allocation hooks for cJSON. While an arena is selected, memory comes from it,
+ * and freeing is a no-op.
+ */
+static void* cjson_malloc_hook(size_t sz) {
+    if (cjson_arena != NULL)
+        return arena_alloc(cjson_arena, sz);
+
+    stats.cjson_allocs++;
+    return malloc(sz);
+}
+
+static void cjson_free_hook(void* ptr) {
+    if (cjson_arena == NULL)
+        free(ptr);
+}
+
+void arena_init_cjson_hooks(void) {
+    static cJSON_Hooks hooks = {
+        .malloc_fn = cjson_malloc_hook,
+        .free_fn   = cjson_free_hook,
+    };
+    cJSON_InitHooks(&hooks);
+}
+
+cJSON* arena_parse_json(Arena* arena, const char* str, size_t str_sz) {
+    Arena* old_arena = cjson_arena;
+    cjson_arena      = arena;
+
+    cJSON* result = cJSON_ParseWithLength(str, str_sz);
+
+    cjson_arena = old_arena;
+    return result;
+}
+
+/*
+ * Add the statistics of 'src' to 'dst'.
+ */
+static void add_stats(ArenaStats* dst, const ArenaStats* src) {
+    dst->allocs += src->allocs;
+    dst->chunk_allocs += src->chunk_allocs;
+    dst->cjson_allocs += src->cjson_allocs;
+    if (src->peak > dst->peak)
+        dst->peak = src->peak;
+}
+
+void arena_flush_stats(void) {
+    pthread_mutex_lock(&flushed_lock);
+    add_stats(&flushed_stats, &stats);
+    pthread_mutex_unlock(&flushed_lock);
+
+    stats = (ArenaStats){ 0 };
+}
+
+void arena_get_stats(ArenaStats* dst) {
+    pthread_mutex_lock(&flushed_lock);
+    *dst = flushed_stats;
+    pthread_mutex_unlock(&flushed_lock);
+
+    add_stats(dst, &stats);
+}
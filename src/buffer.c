@@ -0,0 +1,137 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h> /* vsnprintf */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "include/buffer.h"
+#include "include/util.h"
+
+/*
+ * Initial capacity of a buffer, in bytes.
+ */
+#define BUFFER_MIN_CAP 4096
+
+/*
+ * Allocations of the current thread, and of the threads that already called
+ * 'buffer_flush_stats'.
+ */
+static THREAD_LOCAL size_t alloc_count = 0;
+static size_t flushed_count            = 0;
+static pthread_mutex_t flushed_lock    = PTHREAD_MUTEX_INITIALIZER;
+
+bool buffer_reserve(Buffer* buffer, size_t extra) {
+    const size_t needed = buffer->sz + extra + 1;
+    if (needed <= buffer->cap)
+        return true;
+
+    size_t new_cap = (buffer->cap == 0) ? BUFFER_MIN_CAP : buffer->cap;
+    while (new_cap < needed)
+        new_cap *= 2;
+
+    char* ptr = realloc(buffer->data, new_cap);
+    if (ptr == NULL) {
+        ERR("Couldn't realloc from %zu to %zu bytes.", buffer->cap, new_cap);
+        return false;
+    }
+
+    buffer->data = ptr;
+    buffer->cap  = new_cap;
+    alloc_count++;
+    return true;
+}
+
+bool buffer_append(Buffer* buffer, const char* data, size_t data_sz) {
+    if (!buffer_reserve(buffer, data_sz))
+        return false;
+
+    memcpy(&buffer->data[buffer->sz], data, data_sz);
+    buffer->sz += data_sz;
+    buffer->data[buffer->sz] = '\0';
+    return true;
+}
+
+bool buffer_append_str(Buffer* buffer, const char* str) {
+    return buffer_append(buffer, str, strlen(str));
+}
+
+bool buffer_printf(Buffer* buffer, const char* fmt, ...) {
+    va_list va;
+
+    /* Try to format into the free space first, and only grow if needed */
+    const size_t available = (buffer->cap > buffer->sz)
+                               ? buffer->cap - buffer->sz
+                               : 0;
+
+    va_start(va, fmt);
+    const int len = vsnprintf((available > 0) ? &buffer->data[buffer->sz]
+                                              : NULL,
+                              available,
+                              fmt,
+                              va);
+    va_end(va);
+
+    if (len < 0)
+        return false;
+
+    if ((size_t)len >= available) {
+        if (!buffer_reserve(buffer, (size_t)len))
+            return false;
+
+        va_start(va, fmt);
+        vsnprintf(&buffer->data[buffer->sz], (size_t)len + 1, fmt, va);
+        va_end(va);
+    }
+
+    buffer->sz += (size_t)len;
+    return true;
+}
+
+void buffer_clear(Buffer* buffer) {
+    buffer->sz = 0;
+    if (buffer->data != NULL)
+        buffer->data[0] = '\0';
+}
+
+void buffer_free(Buffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->sz   = 0;
+    buffer->cap  = 0;
+}
+
+void buffer_flush_stats(void) {
+    pthread_mutex_lock(&flushed_lock);
+    flushed_count += alloc_count;
+    pthread_mutex_unlock(&flushed_lock);
+
+    alloc_count = 0;
+}
+
+size_t buffer_alloc_count(void) {
+    pthread_mutex_lock(&flushed_lock);
+    const size_t result = flushed_count + alloc_count;
+    pthread_mutex_unlock(&flushed_lock);
+
+    return result;
+}
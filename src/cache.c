@@ -0,0 +1,236 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/cache.h"
+#include "include/buffer.h"
+#include "include/util.h"
+
+/*
+ * First line of every cache file. Files with a different first line are
+ * ignored, so the format can be changed in the future.
+ */
+#define CACHE_MAGIC "4cli-cache 1"
+
+/*
+ * Each cache entry is a file inside the cache directory, named after the hash
+ * of the URL. The file contains the following lines, followed by the raw body
+ * of the response:
+ *
+ *   4cli-cache 1
+ *   <URL>
+ *   <ETag>
+ *   <Last-Modified>
+ *
+ * The URL is stored for detecting hash collisions.
+ */
+static char cache_dir[1024] = { '\0' };
+
+/*
+ * Compute the 64-bit FNV-1a hash of a string.
+ */
+static uint64_t hash_str(const char* str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *str != '\0'; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/*
+ * Write the path of the cache file for the specified URL into 'dst'.
+ */
+static bool entry_path(char* dst, size_t dst_sz, const char* url) {
+    const int written = snprintf(dst,
+                                 dst_sz,
+                                 "%s/%016llx",
+                                 cache_dir,
+                                 (unsigned long long)hash_str(url));
+    return written > 0 && (size_t)written < dst_sz;
+}
+
+/*
+ * Read a line from 'fp' into 'dst', without the trailing newline. Returns false
+ * if the line could not be read, or if it didn't fit.
+ */
+static bool read_line(FILE* fp, char* dst, size_t dst_sz) {
+    if (fgets(dst, dst_sz, fp) == NULL)
+        return false;
+
+    const size_t len = strlen(dst);
+    if (len == 0 || dst[len - 1] != '\n')
+        return false;
+
+    dst[len - 1] = '\0';
+    return true;
+}
+
+/*
+ * Open the cache file for the specified URL, and read its header. On success,
+ * the returned file is positioned at the start of the body.
+ */
+static FILE* open_entry(const char* url, CacheValidators* validators) {
+    if (!cache_enabled())
+        return NULL;
+
+    char path[sizeof(cache_dir) + 32];
+    if (!entry_path(path, sizeof(path), url))
+        return NULL;
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    char line[2048];
+    if (!read_line(fp, line, sizeof(line)) || strcmp(line, CACHE_MAGIC) != 0 ||
+        !read_line(fp, line, sizeof(line)) || strcmp(line, url) != 0 ||
+        !read_line(fp, validators->etag, sizeof(validators->etag)) ||
+        !read_line(fp,
+                   validators->last_modified,
+                   sizeof(validators->last_modified))) {
+        fclose(fp);
+        return NULL;
+    }
+
+    return fp;
+}
+
+bool cache_init(const char* dir) {
+    int written;
+    if (dir != NULL) {
+        written = snprintf(cache_dir, sizeof(cache_dir), "%s", dir);
+    } else {
+        const char* xdg_cache = getenv("XDG_CACHE_HOME");
+        const char* home      = getenv("HOME");
+        if (xdg_cache != NULL && *xdg_cache != '\0')
+            written =
+              snprintf(cache_dir, sizeof(cache_dir), "%s/4cli", xdg_cache);
+        else if (home != NULL && *home != '\0')
+            written =
+              snprintf(cache_dir, sizeof(cache_dir), "%s/.cache/4cli", home);
+        else
+            written = -1;
+    }
+
+    if (written <= 0 || (size_t)written >= sizeof(cache_dir) ||
+        !make_dirs(cache_dir)) {
+        cache_dir[0] = '\0';
+        return false;
+    }
+
+    return true;
+}
+
+bool cache_enabled(void) {
+    return cache_dir[0] != '\0';
+}
+
+bool cache_load_validators(const char* url, CacheValidators* dst) {
+    FILE* fp = open_entry(url, dst);
+    if (fp == NULL)
+        return false;
+
+    fclose(fp);
+    return true;
+}
+
+bool cache_load_body(const char* url, Buffer* dst) {
+    CacheValidators validators;
+    FILE* fp = open_entry(url, &validators);
+    if (fp == NULL)
+        return false;
+
+    /* Get the size of the body from the current position */
+    const long body_start = ftell(fp);
+    if (body_start < 0 || fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return false;
+    }
+    const long body_end = ftell(fp);
+    if (body_end < body_start || fseek(fp, body_start, SEEK_SET) != 0) {
+        fclose(fp);
+        return false;
+    }
+
+    const size_t body_sz = (size_t)(body_end - body_start);
+    if (!buffer_reserve(dst, body_sz) ||
+        fread(&dst->data[dst->sz], 1, body_sz, fp) != body_sz) {
+        fclose(fp);
+        return false;
+    }
+    dst->sz += body_sz;
+    dst->data[dst->sz] = '\0';
+
+    fclose(fp);
+    return true;
+}
+
+bool cache_store_begin(const char* url, const CacheValidators* validators,
+                       FileWriter* dst) {
+    dst->fp = NULL;
+    if (!cache_enabled())
+        return false;
+
+    /* Responses without validators can't be revalidated, don't store them */
+    if (validators->etag[0] == '\0' && validators->last_modified[0] == '\0')
+        return false;
+
+    /* The URL and validators are stored in single lines */
+    if (strchr(url, '\n') != NULL || strchr(validators->etag, '\n') != NULL ||
+        strchr(validators->last_modified, '\n') != NULL)
+        return false;
+
+    /*
+     * Write to a temporary file and rename it, so concurrent processes never
+     * read partial entries.
+     */
+    char path[sizeof(cache_dir) + 32];
+    if (!entry_path(path, sizeof(path), url) || !file_writer_open(dst, path))
+        return false;
+
+    if (fprintf(dst->fp,
+                CACHE_MAGIC "\n%s\n%s\n%s\n",
+                url,
+                validators->etag,
+                validators->last_modified) <= 0) {
+        file_writer_discard(dst);
+        return false;
+    }
+
+    return true;
+}
+
+bool cache_store(const char* url, const CacheValidators* validators,
+                 const char* body, size_t body_sz) {
+    FileWriter writer;
+    if (!cache_store_begin(url, validators, &writer))
+        return false;
+
+    if (!file_writer_write(&writer, body, body_sz)) {
+        file_writer_discard(&writer);
+        return false;
+    }
+
+    return file_writer_commit(&writer);
+}
@@ -0,0 +1,343 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+#include <cjson/cJSON.h>
+
+#include "include/fetch.h"
+#include "include/request.h"
+#include "include/arena.h"
+#include "include/replay.h"
+#include "include/ratelimit.h"
+#include "include/util.h"
+
+/*
+ * Maximum time in milliseconds that we will wait for activity in a single call
+ * to 'curl_multi_poll'.
+ */
+#define POLL_TIMEOUT_MS 1000
+
+/*
+ * Slot used for a single request in the engine. The slot used by the request
+ * with index 'i' is always 'i % max_in_flight', since there can't be more than
+ * 'max_in_flight' requests between the first undelivered one and the last
+ * started one.
+ */
+typedef struct {
+    CURL* curl;
+    Request req;
+    Arena arena; /* Used for the parsed response, reset for each request */
+    bool busy; /* Request in progress or waiting to be delivered */
+    bool done; /* Transfer finished, 'result' or 'ok' is valid */
+    cJSON* result;
+    bool ok; /* Raw response received, only used in raw engines */
+} FetchSlot;
+
+struct FetchEngine {
+    CURLM* multi;
+
+    FetchSlot* slots;
+    size_t max_in_flight;
+
+    /* Queue of URLs, in the order they were added */
+    char** urls;
+    size_t urls_num, urls_cap;
+
+    /* Index of the next URL to start, and of the next result to deliver */
+    size_t next_start, next_deliver;
+
+    /* Only one of the callbacks is set, depending on the type of engine */
+    FetchCallback callback;
+    FetchRawCallback raw_callback;
+    void* user_data;
+};
+
+/*
+ * Allocate and initialize a new fetching engine, without callbacks.
+ */
+static FetchEngine* engine_new(size_t max_in_flight, void* user_data) {
+    if (max_in_flight <= 0)
+        max_in_flight = 1;
+
+    FetchEngine* engine = calloc(1, sizeof(FetchEngine));
+    if (engine == NULL)
+        return NULL;
+
+    engine->max_in_flight = max_in_flight;
+    engine->user_data     = user_data;
+
+    engine->multi = curl_multi_init();
+    engine->slots = calloc(max_in_flight, sizeof(FetchSlot));
+    if (engine->multi == NULL || engine->slots == NULL) {
+        ERR("Failed to initialize fetching engine.");
+        fetch_engine_free(engine);
+        return NULL;
+    }
+
+    /* Send concurrent requests over the same HTTP/2 connection */
+    curl_multi_setopt(engine->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    /*
+     * The easy handles are kept for the whole life of the engine. Their
+     * connections are also kept in the shared pool, so they are reused by the
+     * next engine.
+     */
+    for (size_t i = 0; i < max_in_flight; i++) {
+        FetchSlot* slot = &engine->slots[i];
+
+        slot->arena = (Arena)ARENA_EMPTY;
+        request_init(&slot->req, &slot->arena);
+
+        slot->curl = request_handle_new();
+        if (slot->curl == NULL) {
+            ERR("Failed to initialize 'CURL' object.");
+            fetch_engine_free(engine);
+            return NULL;
+        }
+    }
+
+    return engine;
+}
+
+FetchEngine* fetch_engine_new(size_t max_in_flight, FetchCallback callback,
+                              void* user_data) {
+    FetchEngine* engine = engine_new(max_in_flight, user_data);
+    if (engine != NULL)
+        engine->callback = callback;
+
+    return engine;
+}
+
+FetchEngine* fetch_engine_new_raw(size_t max_in_flight,
+                                  FetchRawCallback callback, void* user_data) {
+    FetchEngine* engine = engine_new(max_in_flight, user_data);
+    if (engine != NULL)
+        engine->raw_callback = callback;
+
+    return engine;
+}
+
+void fetch_engine_free(FetchEngine* engine) {
+    if (engine == NULL)
+        return;
+
+    if (engine->slots != NULL) {
+        for (size_t i = 0; i < engine->max_in_flight; i++) {
+            FetchSlot* slot = &engine->slots[i];
+            if (slot->curl != NULL) {
+                if (slot->busy && !slot->done) {
+                    curl_multi_remove_handle(engine->multi, slot->curl);
+                    request_finish(slot->curl,
+                                   &slot->req,
+                                   CURLE_ABORTED_BY_CALLBACK);
+                }
+                curl_easy_cleanup(slot->curl);
+            }
+
+            request_free(&slot->req);
+            arena_free(&slot->arena);
+        }
+        free(engine->slots);
+    }
+
+    for (size_t i = 0; i < engine->urls_num; i++)
+        free(engine->urls[i]);
+    free(engine->urls);
+
+    if (engine->multi != NULL)
+        curl_multi_cleanup(engine->multi);
+
+    free(engine);
+}
+
+long fetch_engine_add(FetchEngine* engine, const char* url) {
+    if (engine->urls_num >= engine->urls_cap) {
+        const size_t new_cap =
+          (engine->urls_cap == 0) ? 64 : engine->urls_cap * 2;
+        char** ptr = realloc(engine->urls, new_cap * sizeof(char*));
+        if (ptr == NULL) {
+            ERR("Couldn't grow the URL queue to %zu elements.", new_cap);
+            return -1;
+        }
+        engine->urls     = ptr;
+        engine->urls_cap = new_cap;
+    }
+
+    char* copy = malloc(strlen(url) + 1);
+    if (copy == NULL)
+        return -1;
+    strcpy(copy, url);
+
+    engine->urls[engine->urls_num] = copy;
+    return (long)engine->urls_num++;
+}
+
+/*
+ * Start as many queued requests as the free slots and the rate limits allow. If
+ * the next request has to wait for the rate limit, the number of milliseconds
+ * until it can be started is written to 'wait_ms'; otherwise, it's set to zero.
+ */
+static bool start_requests(FetchEngine* engine, long* wait_ms) {
+    *wait_ms = 0;
+
+    while (engine->next_start < engine->urls_num &&
+           engine->next_start < engine->next_deliver + engine->max_in_flight) {
+        const size_t idx = engine->next_start;
+        FetchSlot* slot  = &engine->slots[idx % engine->max_in_flight];
+
+        /* Captured responses are available immediately */
+        if (replay_enabled()) {
+            if (engine->raw_callback != NULL)
+                slot->ok = request_replay_raw(&slot->req, engine->urls[idx]);
+            else
+                slot->result = request_replay(&slot->req, engine->urls[idx]);
+            slot->busy = true;
+            slot->done   = true;
+            engine->next_start++;
+            continue;
+        }
+
+        /* Requests are started in order, so a single host can block others */
+        *wait_ms = ratelimit_acquire(engine->urls[idx]);
+        if (*wait_ms > 0)
+            break;
+
+        request_setup(slot->curl, &slot->req, engine->urls[idx]);
+        curl_easy_setopt(slot->curl, CURLOPT_PRIVATE, slot);
+
+        const CURLMcode code = curl_multi_add_handle(engine->multi, slot->curl);
+        if (code != CURLM_OK) {
+            ERR("Failed to add request to '%s': %s",
+                engine->urls[idx],
+                curl_multi_strerror(code));
+            return false;
+        }
+
+        slot->busy   = true;
+        slot->done   = false;
+        slot->result = NULL;
+        slot->ok     = false;
+        engine->next_start++;
+    }
+
+    return true;
+}
+
+/*
+ * Deliver all finished results, in order, until we find one that is still in
+ * progress.
+ */
+static void deliver_results(FetchEngine* engine) {
+    while (engine->next_deliver < engine->next_start) {
+        const size_t idx = engine->next_deliver;
+        FetchSlot* slot  = &engine->slots[idx % engine->max_in_flight];
+        if (!slot->done)
+            break;
+
+        cJSON* result = slot->result;
+        const bool ok = slot->ok;
+        slot->result  = NULL;
+        slot->busy    = false;
+        slot->done    = false;
+
+        /* The callback might add more URLs */
+        engine->next_deliver++;
+
+        if (engine->raw_callback != NULL) {
+            engine->raw_callback(engine->user_data,
+                                 idx,
+                                 ok ? &slot->req : NULL);
+            buffer_clear(&slot->req.buffer);
+        } else {
+            engine->callback(engine->user_data, idx, result);
+        }
+
+        /* The request points to the URL, so it's only freed now */
+        free(engine->urls[idx]);
+        engine->urls[idx] = NULL;
+    }
+}
+
+/*
+ * Read the messages of the multi handle, finishing the completed transfers.
+ * Returns the number of transfers that finished.
+ */
+static size_t collect_finished(FetchEngine* engine) {
+    size_t finished = 0;
+    CURLMsg* msg;
+    int msgs_left;
+    while ((msg = curl_multi_info_read(engine->multi, &msgs_left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        CURL* curl          = msg->easy_handle;
+        const CURLcode code = msg->data.result;
+
+        char* private_ptr = NULL;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, &private_ptr);
+        curl_multi_remove_handle(engine->multi, curl);
+
+        FetchSlot* slot = (FetchSlot*)private_ptr;
+
+        if (engine->raw_callback != NULL)
+            slot->ok = request_finish_raw(curl, &slot->req, code);
+        else
+            slot->result = request_finish(curl, &slot->req, code);
+        slot->done = true;
+        finished++;
+    }
+
+    return finished;
+}
+
+bool fetch_engine_run(FetchEngine* engine) {
+    while (engine->next_deliver < engine->urls_num) {
+        long wait_ms;
+        if (!start_requests(engine, &wait_ms))
+            return false;
+
+        /* Wake up when the rate limit allows starting the next request */
+        const int timeout_ms = (wait_ms > 0 && wait_ms < POLL_TIMEOUT_MS)
+                                 ? (int)wait_ms
+                                 : POLL_TIMEOUT_MS;
+
+        int running = 0;
+        CURLMcode code = curl_multi_perform(engine->multi, &running);
+
+        /*
+         * Only wait if nothing finished in this call, otherwise the results
+         * would be held back until the poll times out.
+         */
+        if (code == CURLM_OK && collect_finished(engine) == 0 &&
+            (running > 0 || wait_ms > 0))
+            code = curl_multi_poll(engine->multi, NULL, 0, timeout_ms, NULL);
+        if (code != CURLM_OK) {
+            ERR("Failed to perform requests: %s", curl_multi_strerror(code));
+            return false;
+        }
+
+        deliver_results(engine);
+    }
+
+    return true;
+}
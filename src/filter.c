@@ -0,0 +1,574 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+
+#include "include/filter.h"
+#include "include/buffer.h"
+#include "include/html.h"
+#include "include/post.h"
+#include "include/util.h"
+
+/*
+ * Maximum length of a line of a filter file.
+ */
+#define MAX_RULE_LEN 1024
+
+/*
+ * Actions of the rules, and fields of the posts that are matched.
+ */
+enum {
+    ACTION_HIDE,
+    ACTION_ONLY,
+};
+
+enum {
+    FIELD_SUB,
+    FIELD_COM,
+    FIELD_FILENAME,
+    FIELDS_NUM,
+};
+
+/*
+ * Each pattern applies to a set of actions and fields, stored as a mask with a
+ * bit for each pair.
+ */
+#define MATCH_BIT(ACTION, FIELD) (1u << ((ACTION) * FIELDS_NUM + (FIELD)))
+
+typedef struct {
+    char* text; /* Lowercase */
+    unsigned mask;
+} FilterKeyword;
+
+typedef struct {
+    regex_t regex;
+    unsigned mask;
+} FilterRegex;
+
+static FilterKeyword* keywords = NULL;
+static size_t keywords_num = 0, keywords_cap = 0;
+
+static FilterRegex* regexes = NULL;
+static size_t regexes_num = 0, regexes_cap = 0;
+
+/* Union of the masks of all the rules */
+static unsigned rules_mask = 0;
+static bool compiled       = false;
+
+/*
+ * Aho-Corasick automaton of the keywords, as a full transition table. The
+ * bytes that are used by the same keywords share a class, so each state only
+ * has a column for each class; the bytes that are not used by any keyword are
+ * in class zero. The state zero is the root, and 'out_masks' contains the
+ * union of the masks of the keywords that end at each state, including
+ * through its failure links.
+ */
+static uint8_t byte_classes[256];
+static size_t classes_num = 0;
+static uint32_t* transitions = NULL;
+static uint8_t* out_masks    = NULL;
+static size_t states_num = 0, states_cap = 0;
+
+/*
+ * Fields converted to plain text, for matching the regular expressions.
+ */
+static THREAD_LOCAL Buffer converted = BUFFER_EMPTY;
+
+/*
+ * Lowercase version of an ASCII character. Other bytes are not changed.
+ */
+static inline unsigned char to_lower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/*
+ * Parse the field of a rule into a mask of fields, for the specified action.
+ * Returns zero if it's not valid.
+ */
+static unsigned parse_field(const char* field, size_t len, unsigned action) {
+    if (len == 3 && memcmp(field, "sub", 3) == 0)
+        return MATCH_BIT(action, FIELD_SUB);
+    if (len == 3 && memcmp(field, "com", 3) == 0)
+        return MATCH_BIT(action, FIELD_COM);
+    if (len == 8 && memcmp(field, "filename", 8) == 0)
+        return MATCH_BIT(action, FIELD_FILENAME);
+    if (len == 3 && memcmp(field, "any", 3) == 0)
+        return MATCH_BIT(action, FIELD_SUB) | MATCH_BIT(action, FIELD_COM) |
+               MATCH_BIT(action, FIELD_FILENAME);
+
+    return 0;
+}
+
+/*
+ * Add a keyword with the specified mask. It's converted to lowercase.
+ */
+static bool add_keyword(const char* str, size_t len, unsigned mask) {
+    Buffer text = BUFFER_EMPTY;
+    for (size_t i = 0; i < len; i++) {
+        const char c = (char)to_lower((unsigned char)str[i]);
+        buffer_append(&text, &c, 1);
+    }
+
+    if (text.data == NULL)
+        return false;
+
+    if (keywords_num >= keywords_cap) {
+        const size_t new_cap = (keywords_cap == 0) ? 64 : keywords_cap * 2;
+        FilterKeyword* new_keywords =
+          realloc(keywords, new_cap * sizeof(FilterKeyword));
+        if (new_keywords == NULL) {
+            buffer_free(&text);
+            return false;
+        }
+        keywords     = new_keywords;
+        keywords_cap = new_cap;
+    }
+
+    /* The buffer is null-terminated, so its data is used as the string */
+    keywords[keywords_num].text = text.data;
+    keywords[keywords_num].mask = mask;
+    keywords_num++;
+    return true;
+}
+
+/*
+ * Add a regular expression with the specified mask. Returns false if it's not
+ * valid.
+ */
+static bool add_regex(const char* str, size_t len, bool ignore_case,
+                      unsigned mask) {
+    if (regexes_num >= regexes_cap) {
+        const size_t new_cap = (regexes_cap == 0) ? 16 : regexes_cap * 2;
+        FilterRegex* new_regexes =
+          realloc(regexes, new_cap * sizeof(FilterRegex));
+        if (new_regexes == NULL)
+            return false;
+        regexes     = new_regexes;
+        regexes_cap = new_cap;
+    }
+
+    char* pattern = malloc(len + 1);
+    if (pattern == NULL)
+        return false;
+    memcpy(pattern, str, len);
+    pattern[len] = '\0';
+
+    const int flags = REG_EXTENDED | REG_NOSUB | (ignore_case ? REG_ICASE : 0);
+    const int code  = regcomp(&regexes[regexes_num].regex, pattern, flags);
+    free(pattern);
+    if (code != 0) {
+        char message[256];
+        regerror(code, &regexes[regexes_num].regex, message, sizeof(message));
+        ERR("Invalid regular expression: %s", message);
+        return false;
+    }
+
+    regexes[regexes_num].mask = mask;
+    regexes_num++;
+    return true;
+}
+
+bool filter_add_rule(const char* rule) {
+    const char* start = rule + strspn(rule, " \t");
+
+    /* Ignore the trailing whitespace, including line breaks */
+    size_t len = strlen(start);
+    while (len > 0 && strchr(" \t\r\n", start[len - 1]) != NULL)
+        len--;
+
+    if (len == 0 || *start == '#')
+        return true;
+
+    const char* p   = start;
+    const char* end = start + len;
+
+    /* The action and the field are separated by whitespace */
+    const size_t action_len = strcspn(p, " \t");
+    unsigned action;
+    if (action_len == 4 && memcmp(p, "hide", 4) == 0)
+        action = ACTION_HIDE;
+    else if (action_len == 4 && memcmp(p, "only", 4) == 0)
+        action = ACTION_ONLY;
+    else
+        goto invalid;
+    p += action_len;
+    p += strspn(p, " \t");
+
+    const size_t field_len = strcspn(p, " \t");
+    const unsigned mask    = parse_field(p, field_len, action);
+    if (mask == 0)
+        goto invalid;
+    p += field_len;
+    p += strspn(p, " \t");
+
+    if (p >= end)
+        goto invalid;
+
+    /* Regular expressions are enclosed in slashes, followed by the flags */
+    if (*p == '/') {
+        const char* last_slash = end - 1;
+        bool ignore_case       = false;
+        if (*last_slash == 'i') {
+            ignore_case = true;
+            last_slash--;
+        }
+
+        if (last_slash <= p || *last_slash != '/')
+            goto invalid;
+
+        const bool added =
+          add_regex(p + 1, last_slash - p - 1, ignore_case, mask);
+        if (added)
+            rules_mask |= mask;
+        return added;
+    }
+
+    if (!add_keyword(p, end - p, mask))
+        return false;
+
+    rules_mask |= mask;
+    return true;
+
+invalid:
+    ERR("Invalid filter rule: '%.*s'.", (int)len, start);
+    return false;
+}
+
+/*
+ * Add a new state to the automaton, without transitions. Returns its index, or
+ * zero on failure, since the root is never added.
+ */
+static uint32_t add_state(void) {
+    if (states_num >= states_cap) {
+        const size_t new_cap = (states_cap == 0) ? 256 : states_cap * 2;
+        uint32_t* new_transitions =
+          realloc(transitions, new_cap * classes_num * sizeof(uint32_t));
+        if (new_transitions == NULL)
+            return 0;
+        transitions = new_transitions;
+
+        uint8_t* new_out_masks = realloc(out_masks, new_cap);
+        if (new_out_masks == NULL)
+            return 0;
+        out_masks  = new_out_masks;
+        states_cap = new_cap;
+    }
+
+    memset(&transitions[states_num * classes_num],
+           0,
+           classes_num * sizeof(uint32_t));
+    out_masks[states_num] = 0;
+    return (uint32_t)states_num++;
+}
+
+/*
+ * Build the automaton of the keywords: a trie, whose missing transitions are
+ * then filled by following the failure links, in breadth-first order.
+ */
+static bool build_automaton(void) {
+    /* The class of each byte, with the uppercase letters like lowercase ones */
+    memset(byte_classes, 0, sizeof(byte_classes));
+    classes_num = 1;
+    for (size_t i = 0; i < keywords_num; i++) {
+        for (const char* p = keywords[i].text; *p != '\0'; p++) {
+            const unsigned char c = (unsigned char)*p;
+            if (byte_classes[c] != 0)
+                continue;
+
+            if (classes_num > UINT8_MAX) {
+                ERR("Too many different characters in the filter keywords.");
+                return false;
+            }
+
+            byte_classes[c] = (uint8_t)classes_num;
+            if (c >= 'a' && c <= 'z')
+                byte_classes[c - 'a' + 'A'] = (uint8_t)classes_num;
+            classes_num++;
+        }
+    }
+
+    /* The root */
+    states_num = 0;
+    add_state();
+    if (states_num != 1)
+        return false;
+
+    /* While building the trie, a zero transition is a missing child */
+    for (size_t i = 0; i < keywords_num; i++) {
+        uint32_t state = 0;
+        for (const char* p = keywords[i].text; *p != '\0'; p++) {
+            const size_t pos =
+              state * classes_num + byte_classes[(unsigned char)*p];
+            if (transitions[pos] == 0) {
+                const uint32_t child = add_state();
+                if (child == 0)
+                    return false;
+                transitions[pos] = child;
+            }
+            state = transitions[pos];
+        }
+        out_masks[state] |= (uint8_t)keywords[i].mask;
+    }
+
+    uint32_t* fail  = malloc(states_num * sizeof(uint32_t));
+    uint32_t* queue = malloc(states_num * sizeof(uint32_t));
+    if (fail == NULL || queue == NULL) {
+        free(fail);
+        free(queue);
+        return false;
+    }
+
+    /* The children of the root fail to the root */
+    size_t head = 0, tail = 0;
+    for (size_t c = 0; c < classes_num; c++) {
+        const uint32_t child = transitions[c];
+        if (child != 0) {
+            fail[child]   = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    /*
+     * The failure link of each state has a lower depth, so its row and its
+     * mask are complete when the state is visited.
+     */
+    while (head < tail) {
+        const uint32_t state = queue[head++];
+        out_masks[state] |= out_masks[fail[state]];
+
+        uint32_t* row            = &transitions[state * classes_num];
+        const uint32_t* fail_row = &transitions[fail[state] * classes_num];
+        for (size_t c = 0; c < classes_num; c++) {
+            if (row[c] != 0) {
+                fail[row[c]]  = fail_row[c];
+                queue[tail++] = row[c];
+            } else {
+                row[c] = fail_row[c];
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return true;
+}
+
+bool filter_compile(void) {
+    if (keywords_num > 0 && !build_automaton()) {
+        ERR("Could not compile the filters.");
+        return false;
+    }
+
+    compiled = true;
+    return true;
+}
+
+bool filter_load(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        ERR("Could not open filter file '%s'.", path);
+        return false;
+    }
+
+    bool result     = true;
+    size_t line_num = 0;
+    char line[MAX_RULE_LEN];
+    while (result && fgets(line, sizeof(line), fp) != NULL) {
+        line_num++;
+
+        /* Don't split a line that doesn't fit into multiple rules */
+        if (strchr(line, '\n') == NULL) {
+            const int next = getc(fp);
+            if (next != '\n' && next != EOF) {
+                ERR("Line %zu of filter file '%s' is too long.",
+                    line_num,
+                    path);
+                result = false;
+                break;
+            }
+        }
+
+        result = filter_add_rule(line);
+        if (!result)
+            ERR("Invalid rule in line %zu of filter file '%s'.",
+                line_num,
+                path);
+    }
+
+    fclose(fp);
+    return result && filter_compile();
+}
+
+bool filter_enabled(void) {
+    return compiled;
+}
+
+/*
+ * Run the automaton over the visible text of an HTML field, with the specified
+ * bit in its mask. Like 'html2txt', tags are skipped, line breaks are newlines
+ * and entities are decoded, but in the same pass as the matching, without
+ * writing the text anywhere.
+ */
+static bool keywords_match(const char* html, unsigned bit) {
+    uint32_t state = 0;
+    const char* p  = html;
+    while (*p != '\0') {
+        char decoded[HTML_ENTITY_MAX_UTF8];
+        const char* chars = p;
+        size_t chars_num  = 1;
+
+        if (*p == '&') {
+            size_t entity_len;
+            const size_t decoded_len =
+              html_decode_entity(p, &entity_len, decoded);
+            if (decoded_len > 0) {
+                chars     = decoded;
+                chars_num = decoded_len;
+                p += entity_len;
+            } else {
+                p++;
+            }
+        } else if (*p == '<') {
+            /* Find the end of the tag, ignoring '>' inside quoted values */
+            const char* tag_end = p + 1;
+            bool in_quotes      = false;
+            while (*tag_end != '\0' && (in_quotes || *tag_end != '>')) {
+                if (*tag_end == '"')
+                    in_quotes = !in_quotes;
+                tag_end++;
+            }
+
+            /* An unterminated tag hides the rest of the input */
+            if (*tag_end == '\0')
+                break;
+
+            /* Line breaks are the only tags that are part of the text */
+            const char* name = (p[1] == '/') ? p + 2 : p + 1;
+            const bool is_br = (name[0] == 'b' && name[1] == 'r' &&
+                                !isalnum((unsigned char)name[2]));
+            chars     = "\n";
+            chars_num = is_br ? 1 : 0;
+            p         = tag_end + 1;
+        } else {
+            p++;
+        }
+
+        for (size_t i = 0; i < chars_num; i++) {
+            const unsigned char c = (unsigned char)chars[i];
+            state = transitions[state * classes_num + byte_classes[c]];
+            if ((out_masks[state] & bit) != 0)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Check if a field matches any pattern with the specified bit in its mask.
+ * Only the visible text of the HTML is matched, not its markup.
+ */
+static bool field_matches(const char* html, unsigned bit) {
+    if (html == NULL || (rules_mask & bit) == 0)
+        return false;
+
+    if (states_num > 0 && keywords_match(html, bit))
+        return true;
+
+    /* The text is only converted if a regular expression needs it */
+    bool is_converted = false;
+    for (size_t i = 0; i < regexes_num; i++) {
+        if ((regexes[i].mask & bit) == 0)
+            continue;
+
+        if (!is_converted) {
+            /* The plain text is never longer than the HTML */
+            buffer_clear(&converted);
+            if (!buffer_reserve(&converted, strlen(html)))
+                return false;
+            converted.sz = html2txt(converted.data, html, NULL);
+            is_converted = true;
+        }
+
+        if (regexec(&regexes[i].regex, converted.data, 0, NULL, 0) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Check if any field of a post matches a pattern of the specified action.
+ */
+static bool post_matches(const Post* post, unsigned action) {
+    return field_matches(post->sub, MATCH_BIT(action, FIELD_SUB)) ||
+           field_matches(post->com, MATCH_BIT(action, FIELD_COM)) ||
+           field_matches(post->filename, MATCH_BIT(action, FIELD_FILENAME));
+}
+
+bool filter_post_hidden(const Post* post) {
+    return compiled && post_matches(post, ACTION_HIDE);
+}
+
+bool filter_thread_shown(const Post* op) {
+    if (!compiled)
+        return true;
+
+    /* Without 'only' rules, all the threads that are not hidden are shown */
+    const unsigned only_mask = MATCH_BIT(ACTION_ONLY, FIELD_SUB) |
+                               MATCH_BIT(ACTION_ONLY, FIELD_COM) |
+                               MATCH_BIT(ACTION_ONLY, FIELD_FILENAME);
+    return !post_matches(op, ACTION_HIDE) &&
+           ((rules_mask & only_mask) == 0 || post_matches(op, ACTION_ONLY));
+}
+
+void filter_free(void) {
+    for (size_t i = 0; i < keywords_num; i++)
+        free(keywords[i].text);
+    free(keywords);
+    keywords     = NULL;
+    keywords_num = 0;
+    keywords_cap = 0;
+
+    for (size_t i = 0; i < regexes_num; i++)
+        regfree(&regexes[i].regex);
+    free(regexes);
+    regexes     = NULL;
+    regexes_num = 0;
+    regexes_cap = 0;
+
+    free(transitions);
+    free(out_masks);
+    transitions = NULL;
+    out_masks   = NULL;
+    states_num  = 0;
+    states_cap  = 0;
+    classes_num = 0;
+
+    buffer_free(&converted);
+
+    rules_mask = 0;
+    compiled   = false;
+}
@@ -0,0 +1,651 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/html.h"
+#include "include/util.h"
+
+/*
+ * Maximum length of the name of a named entity, and of the digits of a numeric
+ * entity.
+ */
+#define MAX_NAME_LEN   32
+#define MAX_DEC_DIGITS 7
+#define MAX_HEX_DIGITS 6
+
+/*
+ * Character used for invalid code points.
+ */
+#define REPLACEMENT_CHAR 0xFFFD
+
+/*
+ * Structure representing a named HTML entity, along with its Unicode code
+ * point.
+ */
+typedef struct {
+    const char* name;
+    uint32_t codepoint;
+} HtmlEntity;
+
+/*
+ * All the named entities of HTML 4.01, plus "&apos;". Sorted by name, so they
+ * can be searched with a binary search.
+ */
+static const HtmlEntity named_entities[] = {
+    { "AElig", 0x00C6 }, { "Aacute", 0x00C1 }, { "Acirc", 0x00C2 },
+    { "Agrave", 0x00C0 }, { "Alpha", 0x0391 }, { "Aring", 0x00C5 },
+    { "Atilde", 0x00C3 }, { "Auml", 0x00C4 }, { "Beta", 0x0392 },
+    { "Ccedil", 0x00C7 }, { "Chi", 0x03A7 }, { "Dagger", 0x2021 },
+    { "Delta", 0x0394 }, { "ETH", 0x00D0 }, { "Eacute", 0x00C9 },
+    { "Ecirc", 0x00CA }, { "Egrave", 0x00C8 }, { "Epsilon", 0x0395 },
+    { "Eta", 0x0397 }, { "Euml", 0x00CB }, { "Gamma", 0x0393 },
+    { "Iacute", 0x00CD }, { "Icirc", 0x00CE }, { "Igrave", 0x00CC },
+    { "Iota", 0x0399 }, { "Iuml", 0x00CF }, { "Kappa", 0x039A },
+    { "Lambda", 0x039B }, { "Mu", 0x039C }, { "Ntilde", 0x00D1 },
+    { "Nu", 0x039D }, { "OElig", 0x0152 }, { "Oacute", 0x00D3 },
+    { "Ocirc", 0x00D4 }, { "Ograve", 0x00D2 }, { "Omega", 0x03A9 },
+    { "Omicron", 0x039F }, { "Oslash", 0x00D8 }, { "Otilde", 0x00D5 },
+    { "Ouml", 0x00D6 }, { "Phi", 0x03A6 }, { "Pi", 0x03A0 },
+    { "Prime", 0x2033 }, { "Psi", 0x03A8 }, { "Rho", 0x03A1 },
+    { "Scaron", 0x0160 }, { "Sigma", 0x03A3 }, { "THORN", 0x00DE },
+    { "Tau", 0x03A4 }, { "Theta", 0x0398 }, { "Uacute", 0x00DA },
+    { "Ucirc", 0x00DB }, { "Ugrave", 0x00D9 }, { "Upsilon", 0x03A5 },
+    { "Uuml", 0x00DC }, { "Xi", 0x039E }, { "Yacute", 0x00DD },
+    { "Yuml", 0x0178 }, { "Zeta", 0x0396 }, { "aacute", 0x00E1 },
+    { "acirc", 0x00E2 }, { "acute", 0x00B4 }, { "aelig", 0x00E6 },
+    { "agrave", 0x00E0 }, { "alefsym", 0x2135 }, { "alpha", 0x03B1 },
+    { "amp", 0x0026 }, { "and", 0x2227 }, { "ang", 0x2220 },
+    { "apos", 0x0027 }, { "aring", 0x00E5 }, { "asymp", 0x2248 },
+    { "atilde", 0x00E3 }, { "auml", 0x00E4 }, { "bdquo", 0x201E },
+    { "beta", 0x03B2 }, { "brvbar", 0x00A6 }, { "bull", 0x2022 },
+    { "cap", 0x2229 }, { "ccedil", 0x00E7 }, { "cedil", 0x00B8 },
+    { "cent", 0x00A2 }, { "chi", 0x03C7 }, { "circ", 0x02C6 },
+    { "clubs", 0x2663 }, { "cong", 0x2245 }, { "copy", 0x00A9 },
+    { "crarr", 0x21B5 }, { "cup", 0x222A }, { "curren", 0x00A4 },
+    { "dArr", 0x21D3 }, { "dagger", 0x2020 }, { "darr", 0x2193 },
+    { "deg", 0x00B0 }, { "delta", 0x03B4 }, { "diams", 0x2666 },
+    { "divide", 0x00F7 }, { "eacute", 0x00E9 }, { "ecirc", 0x00EA },
+    { "egrave", 0x00E8 }, { "empty", 0x2205 }, { "emsp", 0x2003 },
+    { "ensp", 0x2002 }, { "epsilon", 0x03B5 }, { "equiv", 0x2261 },
+    { "eta", 0x03B7 }, { "eth", 0x00F0 }, { "euml", 0x00EB },
+    { "euro", 0x20AC }, { "exist", 0x2203 }, { "fnof", 0x0192 },
+    { "forall", 0x2200 }, { "frac12", 0x00BD }, { "frac14", 0x00BC },
+    { "frac34", 0x00BE }, { "frasl", 0x2044 }, { "gamma", 0x03B3 },
+    { "ge", 0x2265 }, { "gt", 0x003E }, { "hArr", 0x21D4 }, { "harr", 0x2194 },
+    { "hearts", 0x2665 }, { "hellip", 0x2026 }, { "iacute", 0x00ED },
+    { "icirc", 0x00EE }, { "iexcl", 0x00A1 }, { "igrave", 0x00EC },
+    { "image", 0x2111 }, { "infin", 0x221E }, { "int", 0x222B },
+    { "iota", 0x03B9 }, { "iquest", 0x00BF }, { "isin", 0x2208 },
+    { "iuml", 0x00EF }, { "kappa", 0x03BA }, { "lArr", 0x21D0 },
+    { "lambda", 0x03BB }, { "lang", 0x2329 }, { "laquo", 0x00AB },
+    { "larr", 0x2190 }, { "lceil", 0x2308 }, { "ldquo", 0x201C },
+    { "le", 0x2264 }, { "lfloor", 0x230A }, { "lowast", 0x2217 },
+    { "loz", 0x25CA }, { "lrm", 0x200E }, { "lsaquo", 0x2039 },
+    { "lsquo", 0x2018 }, { "lt", 0x003C }, { "macr", 0x00AF },
+    { "mdash", 0x2014 }, { "micro", 0x00B5 }, { "middot", 0x00B7 },
+    { "minus", 0x2212 }, { "mu", 0x03BC }, { "nabla", 0x2207 },
+    { "nbsp", 0x00A0 }, { "ndash", 0x2013 }, { "ne", 0x2260 },
+    { "ni", 0x220B }, { "not", 0x00AC }, { "notin", 0x2209 },
+    { "nsub", 0x2284 }, { "ntilde", 0x00F1 }, { "nu", 0x03BD },
+    { "oacute", 0x00F3 }, { "ocirc", 0x00F4 }, { "oelig", 0x0153 },
+    { "ograve", 0x00F2 }, { "oline", 0x203E }, { "omega", 0x03C9 },
+    { "omicron", 0x03BF }, { "oplus", 0x2295 }, { "or", 0x2228 },
+    { "ordf", 0x00AA }, { "ordm", 0x00BA }, { "oslash", 0x00F8 },
+    { "otilde", 0x00F5 }, { "otimes", 0x2297 }, { "ouml", 0x00F6 },
+    { "para", 0x00B6 }, { "part", 0x2202 }, { "permil", 0x2030 },
+    { "perp", 0x22A5 }, { "phi", 0x03C6 }, { "pi", 0x03C0 }, { "piv", 0x03D6 },
+    { "plusmn", 0x00B1 }, { "pound", 0x00A3 }, { "prime", 0x2032 },
+    { "prod", 0x220F }, { "prop", 0x221D }, { "psi", 0x03C8 },
+    { "quot", 0x0022 }, { "rArr", 0x21D2 }, { "radic", 0x221A },
+    { "rang", 0x232A }, { "raquo", 0x00BB }, { "rarr", 0x2192 },
+    { "rceil", 0x2309 }, { "rdquo", 0x201D }, { "real", 0x211C },
+    { "reg", 0x00AE }, { "rfloor", 0x230B }, { "rho", 0x03C1 },
+    { "rlm", 0x200F }, { "rsaquo", 0x203A }, { "rsquo", 0x2019 },
+    { "sbquo", 0x201A }, { "scaron", 0x0161 }, { "sdot", 0x22C5 },
+    { "sect", 0x00A7 }, { "shy", 0x00AD }, { "sigma", 0x03C3 },
+    { "sigmaf", 0x03C2 }, { "sim", 0x223C }, { "spades", 0x2660 },
+    { "sub", 0x2282 }, { "sube", 0x2286 }, { "sum", 0x2211 },
+    { "sup", 0x2283 }, { "sup1", 0x00B9 }, { "sup2", 0x00B2 },
+    { "sup3", 0x00B3 }, { "supe", 0x2287 }, { "szlig", 0x00DF },
+    { "tau", 0x03C4 }, { "there4", 0x2234 }, { "theta", 0x03B8 },
+    { "thetasym", 0x03D1 }, { "thinsp", 0x2009 }, { "thorn", 0x00FE },
+    { "tilde", 0x02DC }, { "times", 0x00D7 }, { "trade", 0x2122 },
+    { "uArr", 0x21D1 }, { "uacute", 0x00FA }, { "uarr", 0x2191 },
+    { "ucirc", 0x00FB }, { "ugrave", 0x00F9 }, { "uml", 0x00A8 },
+    { "upsih", 0x03D2 }, { "upsilon", 0x03C5 }, { "uuml", 0x00FC },
+    { "weierp", 0x2118 }, { "xi", 0x03BE }, { "yacute", 0x00FD },
+    { "yen", 0x00A5 }, { "yuml", 0x00FF }, { "zeta", 0x03B6 },
+    { "zwj", 0x200D }, { "zwnj", 0x200C },
+};
+
+/*
+ * Write the specified code point to 'dst' as UTF-8, returning the number of
+ * written bytes.
+ */
+static size_t encode_utf8(uint32_t cp, char* dst) {
+    unsigned char* out = (unsigned char*)dst;
+
+    if (cp < 0x80) {
+        out[0] = cp;
+        return 1;
+    } else if (cp < 0x800) {
+        out[0] = 0xC0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    } else if (cp < 0x10000) {
+        out[0] = 0xE0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3F);
+        out[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    } else {
+        out[0] = 0xF0 | (cp >> 18);
+        out[1] = 0x80 | ((cp >> 12) & 0x3F);
+        out[2] = 0x80 | ((cp >> 6) & 0x3F);
+        out[3] = 0x80 | (cp & 0x3F);
+        return 4;
+    }
+}
+
+/*
+ * Search the code point of the named entity with the specified name, which is
+ * not null-terminated.
+ */
+static bool lookup_named_entity(const char* name, size_t len, uint32_t* dst) {
+    size_t lo = 0, hi = ARRLEN(named_entities);
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const char* cur  = named_entities[mid].name;
+        int cmp          = strncmp(name, cur, len);
+        if (cmp == 0 && cur[len] != '\0')
+            cmp = -1; /* The name is a prefix of the current entry */
+
+        if (cmp == 0) {
+            *dst = named_entities[mid].codepoint;
+            return true;
+        }
+
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return false;
+}
+
+/*
+ * Parse the digits of a numeric entity, starting at 'src', in the specified
+ * base. Returns the number of digits, or zero if there were none or too many.
+ */
+static size_t parse_entity_digits(const char* src, int base, uint32_t* dst) {
+    const size_t max_digits = (base == 16) ? MAX_HEX_DIGITS : MAX_DEC_DIGITS;
+
+    uint32_t value = 0;
+    size_t i;
+    for (i = 0; i <= max_digits; i++) {
+        const char c = src[i];
+
+        uint32_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (base == 16 && c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            break;
+
+        value = value * base + digit;
+    }
+
+    if (i == 0 || i > max_digits)
+        return 0;
+
+    *dst = value;
+    return i;
+}
+
+/*
+ * Try to decode the entities that appear in almost every post, without
+ * searching the entity table.
+ */
+static inline size_t decode_common_entity(const char* src, size_t* src_len,
+                                          char* dst) {
+    switch (src[1]) {
+        case 'l':
+        case 'g':
+            if (src[2] == 't' && src[3] == ';') {
+                *dst     = (src[1] == 'l') ? '<' : '>';
+                *src_len = 4;
+                return 1;
+            }
+            break;
+
+        case 'a':
+            if (src[2] == 'm' && src[3] == 'p' && src[4] == ';') {
+                *dst     = '&';
+                *src_len = 5;
+                return 1;
+            }
+            break;
+
+        case 'q':
+            if (strncmp(&src[2], "uot;", 4) == 0) {
+                *dst     = '\"';
+                *src_len = 6;
+                return 1;
+            }
+            break;
+
+        case '#':
+            if (strncmp(&src[2], "039;", 4) == 0) {
+                *dst     = '\'';
+                *src_len = 6;
+                return 1;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+size_t html_decode_entity(const char* src, size_t* src_len, char* dst) {
+    const size_t common_written = decode_common_entity(src, src_len, dst);
+    if (common_written > 0)
+        return common_written;
+
+    uint32_t cp;
+    size_t i = 1; /* Skip the '&' */
+
+    if (src[i] == '#') {
+        i++;
+
+        int base = 10;
+        if (src[i] == 'x' || src[i] == 'X') {
+            base = 16;
+            i++;
+        }
+
+        const size_t digits = parse_entity_digits(&src[i], base, &cp);
+        if (digits == 0)
+            return 0;
+        i += digits;
+
+        /* Replace code points that can't be represented */
+        if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            cp = REPLACEMENT_CHAR;
+    } else {
+        const char* name = &src[i];
+        while (i <= MAX_NAME_LEN &&
+               ((src[i] >= 'a' && src[i] <= 'z') ||
+                (src[i] >= 'A' && src[i] <= 'Z') ||
+                (src[i] >= '0' && src[i] <= '9')))
+            i++;
+
+        const size_t name_len = (size_t)(&src[i] - name);
+        if (name_len == 0 || !lookup_named_entity(name, name_len, &cp))
+            return 0;
+    }
+
+    if (src[i] != ';')
+        return 0;
+
+    *src_len = i + 1;
+    return encode_utf8(cp, dst);
+}
+
+char* html_decode_entities(char* str) {
+    /*
+     * Since a decoded entity is never longer than the entity itself, the write
+     * cursor never overtakes the read cursor.
+     */
+    const char* read = str;
+    char* write      = str;
+
+    for (;;) {
+        /* Copy everything up to the next entity in a single call */
+        const char* amp = strchr(read, '&');
+        const size_t run_len =
+          (amp == NULL) ? strlen(read) : (size_t)(amp - read);
+
+        if (write != read)
+            memmove(write, read, run_len);
+        write += run_len;
+        read += run_len;
+
+        if (amp == NULL)
+            break;
+
+        size_t entity_len;
+        const size_t written = html_decode_entity(read, &entity_len, write);
+        if (written == 0) {
+            /* Not an entity, keep the '&' */
+            *write++ = *read++;
+            continue;
+        }
+
+        write += written;
+        read += entity_len;
+    }
+
+    *write = '\0';
+    return str;
+}
+
+/*
+ * Maximum number of nested tags whose closing tag is tracked. Deeper tags are
+ * still removed, but they don't produce spans.
+ */
+#define MAX_TAG_DEPTH 16
+
+/*
+ * Maximum number of stored characters in the name of an open tag.
+ */
+#define MAX_TAG_NAME 8
+
+/*
+ * Tag that was opened, and that is waiting for its closing tag.
+ */
+typedef struct {
+    char name[MAX_TAG_NAME + 1];
+    long span_idx; /* Span opened by this tag, or -1 */
+} OpenTag;
+
+void html_spans_free(HtmlSpans* spans) {
+    free(spans->data);
+    spans->data = NULL;
+    spans->num  = 0;
+    spans->cap  = 0;
+}
+
+/*
+ * Add a new span to the list, starting at the specified position. Returns its
+ * index, or -1 on failure.
+ */
+static long add_span(HtmlSpans* spans, HtmlSpanKind kind, size_t start) {
+    if (spans->num >= spans->cap) {
+        const size_t new_cap = (spans->cap == 0) ? 32 : spans->cap * 2;
+        HtmlSpan* ptr = realloc(spans->data, new_cap * sizeof(HtmlSpan));
+        if (ptr == NULL)
+            return -1;
+        spans->data = ptr;
+        spans->cap  = new_cap;
+    }
+
+    HtmlSpan* span = &spans->data[spans->num];
+    span->kind     = kind;
+    span->start    = start;
+    span->end      = start;
+    span->target   = 0;
+    return (long)spans->num++;
+}
+
+/*
+ * Search the value of an attribute in the attributes of a tag, which are in the
+ * range [attrs, attrs_end). Only quoted values are supported. Returns a pointer
+ * to the start of the value, and writes its length to 'value_len'.
+ */
+static const char* find_attribute(const char* attrs, const char* attrs_end,
+                                  const char* name, size_t* value_len) {
+    const size_t name_len = strlen(name);
+
+    for (const char* p = attrs; p + name_len + 2 < attrs_end; p++) {
+        if ((p != attrs && p[-1] != ' ') || strncmp(p, name, name_len) != 0 ||
+            p[name_len] != '=' || p[name_len + 1] != '"')
+            continue;
+
+        const char* value = p + name_len + 2;
+        const char* end   = value;
+        while (end < attrs_end && *end != '"')
+            end++;
+
+        *value_len = (size_t)(end - value);
+        return value;
+    }
+
+    return NULL;
+}
+
+/*
+ * Does the attribute value, which is not null-terminated, contain the specified
+ * word?
+ */
+static bool has_word(const char* value, size_t value_len, const char* word) {
+    if (value == NULL)
+        return false;
+
+    const size_t word_len = strlen(word);
+    for (size_t i = 0; i + word_len <= value_len; i++) {
+        if (strncmp(&value[i], word, word_len) == 0 &&
+            (i == 0 || value[i - 1] == ' ') &&
+            (i + word_len == value_len || value[i + word_len] == ' '))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Parse the number of the post that a quotelink points to, from its 'href'
+ * attribute (e.g. "#p123" or "/g/thread/100#p123"). Returns zero if the link
+ * doesn't point to a post.
+ */
+static unsigned long parse_link_target(const char* href, size_t href_len) {
+    if (href == NULL)
+        return 0;
+
+    /* Search the last "#p" in the value */
+    const char* target = NULL;
+    for (size_t i = 0; i + 1 < href_len; i++)
+        if (href[i] == '#' && href[i + 1] == 'p')
+            target = &href[i + 2];
+
+    if (target == NULL)
+        return 0;
+
+    unsigned long result = 0;
+    for (; target < href + href_len && *target >= '0' && *target <= '9';
+         target++)
+        result = result * 10 + (unsigned long)(*target - '0');
+
+    return result;
+}
+
+/*
+ * Handle an opening tag with the specified name and attributes, at position
+ * 'pos' of the output. If the tag needs a closing tag, it's pushed to the
+ * stack of open tags.
+ */
+static void open_tag(const char* name, size_t name_len, const char* attrs,
+                     const char* attrs_end, size_t pos, HtmlSpans* spans,
+                     OpenTag* stack, size_t* depth) {
+#define NAME_IS(STR)                                                           \
+    (name_len == STRLEN(STR) && strncmp(name, STR, name_len) == 0)
+
+    /* Void elements never have a closing tag */
+    if (NAME_IS("img") || NAME_IS("hr"))
+        return;
+
+    if (NAME_IS("wbr")) {
+        if (spans != NULL)
+            add_span(spans, HTML_SPAN_WBR, pos);
+        return;
+    }
+
+    long span_idx = -1;
+    if (spans != NULL) {
+        size_t class_len = 0;
+        const char* class_value =
+          find_attribute(attrs, attrs_end, "class", &class_len);
+
+        if (NAME_IS("span") && has_word(class_value, class_len, "quote")) {
+            span_idx = add_span(spans, HTML_SPAN_QUOTE, pos);
+        } else if (NAME_IS("span") &&
+                   has_word(class_value, class_len, "deadlink")) {
+            span_idx = add_span(spans, HTML_SPAN_DEADLINK, pos);
+        } else if (NAME_IS("a") &&
+                   has_word(class_value, class_len, "quotelink")) {
+            span_idx = add_span(spans, HTML_SPAN_QUOTELINK, pos);
+
+            size_t href_len = 0;
+            const char* href =
+              find_attribute(attrs, attrs_end, "href", &href_len);
+            if (span_idx >= 0)
+                spans->data[span_idx].target =
+                  parse_link_target(href, href_len);
+        } else if (NAME_IS("s")) {
+            span_idx = add_span(spans, HTML_SPAN_SPOILER, pos);
+        } else if (NAME_IS("pre")) {
+            span_idx = add_span(spans, HTML_SPAN_CODE, pos);
+        }
+    }
+#undef NAME_IS
+
+    if (*depth >= MAX_TAG_DEPTH)
+        return;
+
+    OpenTag* tag = &stack[(*depth)++];
+    if (name_len > MAX_TAG_NAME)
+        name_len = MAX_TAG_NAME;
+    memcpy(tag->name, name, name_len);
+    tag->name[name_len] = '\0';
+    tag->span_idx       = span_idx;
+}
+
+/*
+ * Handle a closing tag with the specified name, at position 'pos' of the
+ * output. The innermost open tag with the same name is closed, along with any
+ * unclosed tags inside it.
+ */
+static void close_tag(const char* name, size_t name_len, size_t pos,
+                      HtmlSpans* spans, OpenTag* stack, size_t* depth) {
+    if (name_len > MAX_TAG_NAME)
+        name_len = MAX_TAG_NAME;
+
+    size_t i = *depth;
+    while (i > 0 && (strncmp(stack[i - 1].name, name, name_len) != 0 ||
+                     stack[i - 1].name[name_len] != '\0'))
+        i--;
+
+    /* Ignore closing tags that were never opened */
+    if (i == 0)
+        return;
+
+    const size_t match = i - 1;
+    while (*depth > match) {
+        const OpenTag* tag = &stack[--(*depth)];
+        if (spans != NULL && tag->span_idx >= 0)
+            spans->data[tag->span_idx].end = pos;
+    }
+}
+
+size_t html2txt(char* dst, const char* src, HtmlSpans* spans) {
+    OpenTag stack[MAX_TAG_DEPTH];
+    size_t depth = 0;
+
+    if (spans != NULL)
+        spans->num = 0;
+
+    /*
+     * Position of the write cursor in 'dst'. The read cursor never falls
+     * behind it, since the output is never longer than the input.
+     */
+    size_t written = 0;
+
+    while (*src != '\0') {
+        /* Copy everything up to the next tag or entity in a single call */
+        const size_t run_len = strcspn(src, "<&");
+        if (run_len > 0) {
+            if (&dst[written] != src)
+                memmove(&dst[written], src, run_len);
+            written += run_len;
+            src += run_len;
+            continue;
+        }
+
+        if (*src == '&') {
+            size_t entity_len;
+            const size_t decoded =
+              html_decode_entity(src, &entity_len, &dst[written]);
+            if (decoded == 0) {
+                dst[written++] = *src++;
+            } else {
+                written += decoded;
+                src += entity_len;
+            }
+            continue;
+        }
+
+        /* Find the end of the tag, ignoring '>' inside quoted values */
+        const char* tag_end = src + 1;
+        bool in_quotes      = false;
+        while (*tag_end != '\0' && (in_quotes || *tag_end != '>')) {
+            if (*tag_end == '"')
+                in_quotes = !in_quotes;
+            tag_end++;
+        }
+
+        /* An unterminated tag is removed, along with the rest of the input */
+        if (*tag_end == '\0')
+            break;
+
+        const bool is_closing = (src[1] == '/');
+        const char* name      = src + (is_closing ? 2 : 1);
+        const char* name_end  = name;
+        while ((*name_end >= 'a' && *name_end <= 'z') ||
+               (*name_end >= 'A' && *name_end <= 'Z') ||
+               (*name_end >= '0' && *name_end <= '9'))
+            name_end++;
+        const size_t name_len = (size_t)(name_end - name);
+
+        if (name_len == 2 && strncmp(name, "br", 2) == 0) {
+            dst[written++] = '\n';
+        } else if (is_closing) {
+            close_tag(name, name_len, written, spans, stack, &depth);
+        } else if (name_len > 0) {
+            open_tag(name,
+                     name_len,
+                     name_end,
+                     tag_end,
+                     written,
+                     spans,
+                     stack,
+                     &depth);
+        }
+
+        src = tag_end + 1;
+    }
+
+    /* Close the spans that were left open */
+    while (depth > 0) {
+        const OpenTag* tag = &stack[--depth];
+        if (spans != NULL && tag->span_idx >= 0)
+            spans->data[tag->span_idx].end = written;
+    }
+
+    dst[written] = '\0';
+    return written;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cjson/cJSON.h>
+
+#include "buffer.h"
+#include "post.h"
+#include "thread.h"
+
+/*
+ * Archives store the posts of some threads in a compact binary format, which
+ * can be mapped into memory and read without parsing or copying it. The file
+ * contains an 'ArchiveHeader', followed by the thread table, the post table and
+ * the string heap. All integers use the byte order of the machine that wrote
+ * the archive, and archives with a different byte order are rejected.
+ *
+ * Strings are stored in the heap, and they are null-terminated, so they can be
+ * used directly. Posts refer to them with an offset into the heap, or with
+ * ARCHIVE_NO_STR if the post doesn't have that field.
+ */
+#define ARCHIVE_MAGIC      "4cliarc"
+#define ARCHIVE_VERSION    1
+#define ARCHIVE_BYTE_ORDER 0x01020304
+#define ARCHIVE_NO_STR     UINT32_MAX
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t threads_num;
+    uint64_t posts_num;
+    uint64_t heap_sz;
+} ArchiveHeader;
+
+typedef struct {
+    uint64_t id;
+    uint64_t first_post; /* Index in the post table */
+    uint64_t posts_num;
+} ArchiveThread;
+
+/*
+ * Fixed-width header of a post. See the 'Post' structure.
+ */
+typedef struct {
+    uint64_t no;
+    int64_t time;
+    int64_t tim;
+    int32_t replies;
+    int32_t images;
+    uint32_t sub;
+    uint32_t name;
+    uint32_t filename;
+    uint32_t ext;
+    uint32_t com;
+    uint32_t reserved;
+} ArchivePost;
+
+/*
+ * Archive opened for reading. The tables point to the mapped file.
+ */
+typedef struct {
+    void* map;
+    size_t map_sz;
+    const ArchiveThread* threads;
+    size_t threads_num;
+    const ArchivePost* posts;
+    size_t posts_num;
+    const char* heap;
+    size_t heap_sz;
+} Archive;
+
+/*
+ * Archive being built in memory, before writing it to a file.
+ */
+typedef struct {
+    Buffer threads;
+    Buffer posts;
+    Buffer heap;
+    size_t threads_num, posts_num;
+} ArchiveWriter;
+
+/*
+ * Initialize an empty archive writer.
+ */
+void archive_writer_init(ArchiveWriter* writer);
+
+/*
+ * Free the data of an archive writer.
+ */
+void archive_writer_free(ArchiveWriter* writer);
+
+/*
+ * Add the posts of a thread JSON to the archive. The strings are copied, so the
+ * JSON tree is not needed afterwards.
+ */
+bool archive_writer_add_thread(ArchiveWriter* writer, ThreadId id,
+                               cJSON* thread_json);
+
+/*
+ * Write the archive to the specified path, replacing the previous file.
+ */
+bool archive_writer_save(const ArchiveWriter* writer, const char* path);
+
+/*
+ * Open and map the archive at the specified path, checking that its tables are
+ * valid.
+ */
+bool archive_open(Archive* archive, const char* path);
+
+/*
+ * Unmap an archive opened with 'archive_open'.
+ */
+void archive_close(Archive* archive);
+
+/*
+ * Fill a 'Post' structure from a post of an opened archive. The strings point
+ * to the mapped file, so they are valid until the archive is closed.
+ */
+void archive_get_post(const Archive* archive, const ArchivePost* src,
+                      Post* dst);
+
+#endif /* ARCHIVE_H_ */
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_ 1
+
+#include <stddef.h>
+
+#include <cjson/cJSON.h>
+
+/*
+ * Chunk of memory used by an arena. The usable memory follows the header.
+ */
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t sz, used;
+} ArenaChunk;
+
+/*
+ * Bump allocator. Allocations are never freed individually; instead, the whole
+ * arena is reset at once, keeping its memory for the next use. After a reset,
+ * the arena is merged into a single chunk big enough for the previous use, so
+ * reusing the arena for similar workloads doesn't allocate at all.
+ */
+typedef struct {
+    ArenaChunk* chunks; /* Current chunk first */
+    size_t used;        /* Bytes allocated since the last reset */
+    size_t capacity;    /* Sum of the sizes of all chunks */
+} Arena;
+
+/*
+ * Global statistics of all arenas, and of the cJSON allocations.
+ */
+typedef struct {
+    size_t allocs;       /* Calls to 'arena_alloc' */
+    size_t chunk_allocs; /* Calls to 'malloc' for new chunks */
+    size_t peak;         /* Maximum value of 'used' in any arena */
+    size_t cjson_allocs; /* cJSON allocations that didn't use an arena */
+} ArenaStats;
+
+/*
+ * Initializer for an empty 'Arena'.
+ */
+#define ARENA_EMPTY { .chunks = NULL, .used = 0, .capacity = 0 }
+
+/*
+ * Allocate the specified number of bytes from the arena. The returned memory is
+ * suitably aligned for any type.
+ */
+void* arena_alloc(Arena* arena, size_t sz);
+
+/*
+ * Invalidate all allocations of the arena, keeping its memory.
+ */
+void arena_reset(Arena* arena);
+
+/*
+ * Free all the memory used by the arena.
+ */
+void arena_free(Arena* arena);
+
+/*
+ * Install the cJSON allocation hooks. Must be called once, before using cJSON.
+ * Each thread selects its own arena, so they can parse JSON concurrently.
+ */
+void arena_init_cjson_hooks(void);
+
+/*
+ * Parse the specified JSON string, allocating the resulting tree from the
+ * specified arena. The tree must not be freed with 'cJSON_Delete'; it's valid
+ * until the arena is reset.
+ */
+cJSON* arena_parse_json(Arena* arena, const char* str, size_t str_sz);
+
+/*
+ * Add the allocation statistics of the calling thread to the global ones. Must
+ * be called by every thread that used arenas or cJSON, before exiting.
+ */
+void arena_flush_stats(void);
+
+/*
+ * Obtain the global allocation statistics, including the ones of the calling
+ * thread.
+ */
+void arena_get_stats(ArenaStats* dst);
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUFFER_H_
+#define BUFFER_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Structure representing a growable buffer of arbitrary size. The data is
+ * always null-terminated after the first append. Clearing the buffer keeps its
+ * capacity, so the same buffer can be reused without reallocating it.
+ */
+typedef struct {
+    char* data;
+    size_t sz, cap;
+} Buffer;
+
+/*
+ * Initializer for an empty 'Buffer'.
+ */
+#define BUFFER_EMPTY { .data = NULL, .sz = 0, .cap = 0 }
+
+/*
+ * Make sure that the buffer has room for at least 'extra' more bytes, plus the
+ * null terminator. The capacity grows geometrically.
+ */
+bool buffer_reserve(Buffer* buffer, size_t extra);
+
+/*
+ * Append some data to the buffer, keeping it null-terminated.
+ */
+bool buffer_append(Buffer* buffer, const char* data, size_t data_sz);
+
+/*
+ * Append a null-terminated string to the buffer.
+ */
+bool buffer_append_str(Buffer* buffer, const char* str);
+
+/*
+ * Append the string resulting from the specified 'printf'-like format.
+ */
+bool buffer_printf(Buffer* buffer, const char* fmt, ...);
+
+/*
+ * Remove the contents of the buffer, keeping its capacity.
+ */
+void buffer_clear(Buffer* buffer);
+
+/*
+ * Free the data of the buffer, and reset it to an empty state.
+ */
+void buffer_free(Buffer* buffer);
+
+/*
+ * Add the allocations of the calling thread to the global count. Must be called
+ * by every thread that used buffers, before exiting.
+ */
+void buffer_flush_stats(void);
+
+/*
+ * Total number of times that the data of any buffer was (re)allocated, by the
+ * calling thread or by the threads that called 'buffer_flush_stats'.
+ */
+size_t buffer_alloc_count(void);
+
+#endif /* BUFFER_H_ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACHE_H_
+#define CACHE_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "buffer.h"
+#include "util.h"
+
+/*
+ * Maximum size of the stored validators, including the null terminator. Longer
+ * values are not cached.
+ */
+#define CACHE_ETAG_SZ          128
+#define CACHE_LAST_MODIFIED_SZ 64
+
+/*
+ * Values returned by the server that can be used for making conditional
+ * requests. Empty strings mean that the server didn't send that header.
+ */
+typedef struct {
+    char etag[CACHE_ETAG_SZ];
+    char last_modified[CACHE_LAST_MODIFIED_SZ];
+} CacheValidators;
+
+/*
+ * Initialize the on-disk response cache, creating the specified directory if
+ * needed. If 'dir' is NULL, the default directory is used. Returns false if the
+ * cache could not be enabled.
+ */
+bool cache_init(const char* dir);
+
+/*
+ * Is the cache initialized and usable?
+ */
+bool cache_enabled(void);
+
+/*
+ * Read the validators of the cached response for the specified URL. Returns
+ * false if the URL is not cached.
+ */
+bool cache_load_validators(const char* url, CacheValidators* dst);
+
+/*
+ * Read the cached response body for the specified URL, appending it to the
+ * specified buffer. Returns false if the URL is not cached.
+ */
+bool cache_load_body(const char* url, Buffer* dst);
+
+/*
+ * Store the response for the specified URL, along with its validators,
+ * replacing any previous entry.
+ */
+bool cache_store(const char* url, const CacheValidators* validators,
+                 const char* body, size_t body_sz);
+
+/*
+ * Start storing the response for the specified URL, like 'cache_store', but
+ * without its body: it should be written to the specified writer as it's
+ * received, and the entry replaces the previous one once the writer is
+ * committed. Returns false if the response can't be stored.
+ */
+bool cache_store_begin(const char* url, const CacheValidators* validators,
+                       FileWriter* dst);
+
+#endif /* CACHE_H_ */
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FETCH_H_
+#define FETCH_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <cjson/cJSON.h>
+
+#include "request.h"
+
+/*
+ * Concurrent fetching engine, built on top of the curl multi interface. URLs
+ * are added to a queue, and they are requested concurrently. Results are
+ * delivered in the same order they were added, regardless of the order in which
+ * the transfers finish.
+ */
+typedef struct FetchEngine FetchEngine;
+
+/*
+ * Function called for each added URL, in order. The 'idx' argument is the
+ * position of the URL in the queue, and 'json' is the parsed response, or NULL
+ * if the request failed. The 'json' tree is allocated from an arena owned by
+ * the engine, so it's only valid until the callback returns, and it must not be
+ * freed. The callback is allowed to add more URLs to the engine.
+ */
+typedef void (*FetchCallback)(void* user_data, size_t idx, cJSON* json);
+
+/*
+ * Function called for each added URL, in order, by an engine created with
+ * 'fetch_engine_new_raw'. The 'req' argument is the finished request, with the
+ * unparsed response in its buffer, or NULL if the request failed. The contents
+ * of 'req' are only valid until the callback returns, but it's allowed to swap
+ * the response buffer with another one, taking ownership of it. The response is
+ * not stored in the cache; see 'request_store'.
+ */
+typedef void (*FetchRawCallback)(void* user_data, size_t idx, Request* req);
+
+/*
+ * Allocate and initialize a new fetching engine. At most 'max_in_flight'
+ * requests will be pending at any given time; this includes finished requests
+ * that are waiting for an earlier one to be delivered.
+ */
+FetchEngine* fetch_engine_new(size_t max_in_flight, FetchCallback callback,
+                              void* user_data);
+
+/*
+ * Allocate and initialize a new fetching engine, like 'fetch_engine_new', whose
+ * responses are delivered without parsing them, so they can be parsed by other
+ * threads.
+ */
+FetchEngine* fetch_engine_new_raw(size_t max_in_flight,
+                                  FetchRawCallback callback, void* user_data);
+
+/*
+ * Free all the resources used by a fetching engine.
+ */
+void fetch_engine_free(FetchEngine* engine);
+
+/*
+ * Add a URL to the queue of the engine. The URL is copied. Returns the index of
+ * the URL in the queue, which will be passed to the callback, or a negative
+ * value on failure.
+ */
+long fetch_engine_add(FetchEngine* engine, const char* url);
+
+/*
+ * Perform all queued requests, calling the callback in order for each of them.
+ * Returns when there are no more queued requests, or on fatal errors.
+ */
+bool fetch_engine_run(FetchEngine* engine);
+
+#endif /* FETCH_H_ */
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_ 1
+
+#include <stdbool.h>
+
+#include "post.h"
+
+/*
+ * Filters of threads and posts, matched against the title, the contents and
+ * the file name of each post. Each rule has an action, a field and a pattern:
+ *
+ *   hide FIELD PATTERN    Hide the posts that match; an OP hides its thread
+ *   only FIELD PATTERN    Only show the threads whose OP matches
+ *
+ * The field is 'sub', 'com', 'filename' or 'any'. The pattern is the rest of
+ * the line: either a keyword, which matches anywhere in the field regardless
+ * of case, or an extended regular expression between slashes, optionally
+ * followed by 'i' for ignoring case. All keywords are compiled into a single
+ * Aho-Corasick automaton, so the cost of matching a post doesn't depend on the
+ * number of keywords. Only the visible text of the fields is matched: the
+ * automaton skips the HTML tags and decodes the entities as it scans, and
+ * regular expressions match the text converted by 'html2txt'.
+ */
+
+/*
+ * Add a rule to the filters, which must then be compiled with 'filter_compile'.
+ * Empty rules and comments, starting with '#', are ignored. Returns false if
+ * the rule is not valid.
+ */
+bool filter_add_rule(const char* rule);
+
+/*
+ * Compile the added rules, enabling the filters. Returns false on failure.
+ */
+bool filter_compile(void);
+
+/*
+ * Add the rules of a file, one per line, and compile them. Returns false if the
+ * file could not be read, or if a rule is not valid or too long.
+ */
+bool filter_load(const char* path);
+
+/*
+ * Are the filters compiled and enabled?
+ */
+bool filter_enabled(void);
+
+/*
+ * Is the specified post hidden by the filters?
+ */
+bool filter_post_hidden(const Post* post);
+
+/*
+ * Should the thread with the specified OP be shown, according to the filters?
+ */
+bool filter_thread_shown(const Post* op);
+
+/*
+ * Free all the rules, disabling the filters.
+ */
+void filter_free(void);
+
+#endif /* FILTER_H_ */
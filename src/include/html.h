@@ -0,0 +1,117 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HTML_H_
+#define HTML_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Maximum number of bytes written by 'html_decode_entity'. It's never bigger
+ * than the length of the decoded entity, so decoding can be done in place.
+ */
+#define HTML_ENTITY_MAX_UTF8 4
+
+/*
+ * Decode the HTML entity at the start of 'src', which must point to an '&'
+ * character. Named entities (e.g. "&gt;"), decimal entities (e.g. "&#62;") and
+ * hexadecimal entities (e.g. "&#x3E;") are supported, and they must end with a
+ * semicolon. The decoded character is written to 'dst' as UTF-8, and the
+ * number of bytes written is returned. The length of the entity in 'src' is
+ * written to 'src_len'. If 'src' doesn't start with a valid entity, zero is
+ * returned.
+ */
+size_t html_decode_entity(const char* src, size_t* src_len, char* dst);
+
+/*
+ * Replace each HTML entity in the input string with its corresponding UTF-8
+ * character, in a single pass. The conversion is done in place, and the input
+ * buffer is returned.
+ */
+char* html_decode_entities(char* str);
+
+/*
+ * Kind of a region of text with special meaning, as marked by the HTML of a
+ * post.
+ */
+typedef enum {
+    HTML_SPAN_QUOTE,     /* <span class="quote">, e.g. ">foo" */
+    HTML_SPAN_QUOTELINK, /* <a class="quotelink">, e.g. ">>123" or ">>>/g/" */
+    HTML_SPAN_DEADLINK,  /* <span class="deadlink">, link to a deleted post */
+    HTML_SPAN_SPOILER,   /* <s> */
+    HTML_SPAN_CODE,      /* <pre class="prettyprint"> */
+    HTML_SPAN_WBR,       /* <wbr>, an empty span where a word can be broken */
+} HtmlSpanKind;
+
+/*
+ * Region of the converted text, in the range [start, end).
+ */
+typedef struct {
+    HtmlSpanKind kind;
+    size_t start, end;
+
+    /*
+     * For quotelinks to a post, the number of the target post. Zero for links
+     * to boards or catalogs, and for other kinds of spans.
+     */
+    unsigned long target;
+} HtmlSpan;
+
+/*
+ * Growable list of spans, sorted by their start position. Spans can be nested,
+ * but they never overlap partially. The list can be reused for multiple
+ * conversions without reallocating it.
+ */
+typedef struct {
+    HtmlSpan* data;
+    size_t num, cap;
+} HtmlSpans;
+
+/*
+ * Initializer for an empty 'HtmlSpans'.
+ */
+#define HTML_SPANS_EMPTY { .data = NULL, .num = 0, .cap = 0 }
+
+/*
+ * Free the memory used by a list of spans.
+ */
+void html_spans_free(HtmlSpans* spans);
+
+/*
+ * Convert the HTML of a post to plain text in a single pass, writing the
+ * result to 'dst', and returning its length. Line breaks are converted to
+ * newlines, other tags are removed, and entities are decoded. The output is
+ * never longer than the input, so 'dst' can be the same as 'src'.
+ *
+ * If 'spans' is not NULL, it's filled with the regions of the output that had
+ * a special meaning (quotes, quotelinks, spoilers, etc.).
+ */
+size_t html2txt(char* dst, const char* src, HtmlSpans* spans);
+
+/*
+ * Text converted by 'html2txt', along with its spans, kept so it can be used
+ * again without converting the HTML. The spans are never grown.
+ */
+typedef struct {
+    const char* text; /* Null-terminated */
+    size_t len;
+    HtmlSpans spans;
+} HtmlText;
+
+#endif /* HTML_H_ */
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDEX_H_
+#define INDEX_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+#include "post.h"
+#include "thread.h"
+
+/*
+ * The full-text index maps each term to the list of posts that contain it,
+ * along with the positions of the term in each post, used for phrase queries.
+ * The file contains an 'IndexHeader', followed by the document table, the term
+ * table (sorted by term), the term heap and the postings. All integers use the
+ * byte order of the machine that wrote the index.
+ *
+ * Each document (post) has a sequential ID, its position in the document
+ * table. The postings of a term are a sequence of unsigned LEB128 integers,
+ * with the following values for each document that contains it:
+ *
+ *   <document ID, minus the previous one>
+ *   <number of positions>
+ *   <position, minus the previous one>...
+ *
+ * Terms are sequences of ASCII letters, digits and non-ASCII bytes, converted
+ * to lowercase, and truncated to INDEX_MAX_TERM bytes.
+ */
+#define INDEX_MAGIC      "4cliidx"
+#define INDEX_VERSION    1
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_MAX_TERM   32
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t docs_num;
+    uint64_t terms_num;
+    uint64_t heap_sz;
+    uint64_t postings_sz;
+} IndexHeader;
+
+typedef struct {
+    uint64_t thread;
+    uint64_t post;
+    int64_t time;
+} IndexDoc;
+
+typedef struct {
+    uint32_t str;      /* Offset in the term heap */
+    uint32_t str_len;  /* Not null-terminated */
+    uint64_t postings; /* Offset in the postings */
+    uint64_t postings_sz;
+    uint32_t docs_num;
+    uint32_t last_doc;
+} IndexTerm;
+
+/*
+ * Index opened for reading. The tables point to the mapped file.
+ */
+typedef struct {
+    void* map;
+    size_t map_sz;
+    const IndexDoc* docs;
+    size_t docs_num;
+    const IndexTerm* terms;
+    size_t terms_num;
+    const char* heap;
+    size_t heap_sz;
+    const unsigned char* postings;
+    size_t postings_sz;
+} Index;
+
+/*
+ * Occurrence of a term in a new document, before sorting them by term.
+ */
+typedef struct {
+    uint32_t term;
+    uint32_t doc;
+    uint32_t pos;
+} IndexHit;
+
+/*
+ * New term, not yet written to the index.
+ */
+typedef struct {
+    uint32_t str, str_len; /* Offset and length in 'IndexBuilder.heap' */
+    uint32_t hits_num;
+} IndexBuilderTerm;
+
+/*
+ * Index being updated with new documents. The previous contents of the index
+ * are kept mapped, and they are merged with the new ones when saving it.
+ */
+typedef struct {
+    const char* path;
+    Index old;
+    bool has_old;
+    PostId* old_posts; /* Sorted, for skipping the posts already indexed */
+
+    Buffer docs;  /* Array of 'IndexDoc' */
+    Buffer hits;  /* Array of 'IndexHit' */
+    Buffer terms; /* Array of 'IndexBuilderTerm' */
+    Buffer heap;
+    uint32_t* table; /* Hash table of term indexes, plus one */
+    size_t table_cap;
+    size_t docs_num, hits_num, terms_num;
+} IndexBuilder;
+
+/*
+ * Post that matched a query.
+ */
+typedef struct {
+    ThreadId thread;
+    PostId post;
+    long long time;
+} IndexMatch;
+
+/*
+ * Growable list of query results.
+ */
+typedef struct {
+    IndexMatch* data;
+    size_t num, cap;
+} IndexMatches;
+
+/*
+ * Initializer for an empty 'IndexMatches'.
+ */
+#define INDEX_MATCHES_EMPTY { .data = NULL, .num = 0, .cap = 0 }
+
+/*
+ * Start updating the index at the specified path. If the file doesn't exist, a
+ * new index is created when saving it.
+ */
+bool index_builder_init(IndexBuilder* builder, const char* path);
+
+/*
+ * Add the title and contents of a post to the index. Posts that are already in
+ * the index are skipped.
+ */
+bool index_builder_add_post(IndexBuilder* builder, ThreadId thread,
+                            const Post* post);
+
+/*
+ * Write the previous and the new contents of the index to its file, replacing
+ * it.
+ */
+bool index_builder_save(IndexBuilder* builder);
+
+/*
+ * Free the data of the builder, without saving it.
+ */
+void index_builder_free(IndexBuilder* builder);
+
+/*
+ * Open and map the index at the specified path, checking that its tables are
+ * valid.
+ */
+bool index_open(Index* index, const char* path);
+
+/*
+ * Unmap an index opened with 'index_open'.
+ */
+void index_close(Index* index);
+
+/*
+ * Search the posts that contain all the terms of the query. Double-quoted parts
+ * of the query are phrases, whose terms must appear consecutively. The matches
+ * are written to 'dst' (replacing its contents), in the order they were
+ * indexed.
+ */
+bool index_search(const Index* index, const char* query, IndexMatches* dst);
+
+/*
+ * Free a list of query results.
+ */
+void index_matches_free(IndexMatches* matches);
+
+#endif /* INDEX_H_ */
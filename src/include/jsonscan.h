@@ -0,0 +1,144 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef JSONSCAN_H_
+#define JSONSCAN_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "post.h"
+
+/*
+ * On-demand extraction of the fields of posts from the raw JSON of a thread.
+ * Instead of building a tree of the whole document, the scanner only locates
+ * the members used by the program (see 'Post'), and skips everything else. The
+ * strings are only decoded when requested.
+ *
+ * Most of the bytes of a thread are inside strings, so the search for the end
+ * of each string is vectorized, with a scalar fallback.
+ */
+
+/*
+ * Implementations of the scanner. The vectorized ones are only available on
+ * some processors.
+ */
+typedef enum {
+    JSON_SCAN_NONE, /* The scanner is disabled, cJSON is used instead */
+    JSON_SCAN_SCALAR,
+    JSON_SCAN_SSE2,
+    JSON_SCAN_AVX2,
+} JsonScanImpl;
+
+/*
+ * Raw text of a member of a JSON object. For strings, it's the text between the
+ * quotes, without decoding the escape sequences; for other values, it's the
+ * text of the value. The 'str' member is NULL if the member was not found.
+ */
+typedef struct {
+    const char* str;
+    size_t sz;
+    bool is_str;
+    bool has_escapes;
+} JsonRaw;
+
+/*
+ * Raw members of a post object. See 'Post'. The 'md5' member, the Base64 MD5
+ * of the attachment, is only used for downloading it; see 'media.h'.
+ */
+typedef struct {
+    JsonRaw no, time, tim, replies, images;
+    JsonRaw sub, name, filename, ext, com;
+    JsonRaw md5;
+} JsonPostRaw;
+
+/*
+ * Position of a scanner in the "posts" array of a thread JSON.
+ */
+typedef struct {
+    const char* cur;
+    const char* end;
+    bool failed; /* The JSON was malformed */
+} JsonScanner;
+
+/*
+ * Select the implementation used by the scanner, for all threads. Must be
+ * called before scanning anything. Returns false if the implementation is not
+ * supported by this processor.
+ */
+bool json_scan_select(JsonScanImpl impl);
+
+/*
+ * Get the implementation used by default on this processor, which is the
+ * fastest one on real threads.
+ */
+JsonScanImpl json_scan_best(void);
+
+/*
+ * Get the name of an implementation, for reporting it.
+ */
+const char* json_scan_name(JsonScanImpl impl);
+
+/*
+ * Is the scanner used instead of cJSON? It's enabled by selecting any
+ * implementation other than 'JSON_SCAN_NONE'.
+ */
+bool json_scan_enabled(void);
+
+/*
+ * Prepare a scanner for the posts of the specified thread JSON, which doesn't
+ * need to be null-terminated. Returns false if the JSON is not an object with a
+ * "posts" array.
+ */
+bool json_scan_thread(JsonScanner* scanner, const char* json, size_t json_sz);
+
+/*
+ * Locate the members of the next post of the scanner. Returns false if there
+ * are no more posts, or if the JSON is malformed, in which case the 'failed'
+ * member of the scanner is set.
+ */
+bool json_scan_next_post(JsonScanner* scanner, JsonPostRaw* dst);
+
+/*
+ * Locate the members of the specified post object, which doesn't need to be
+ * null-terminated. Returns false if the JSON is malformed.
+ */
+bool json_scan_post(JsonPostRaw* dst, const char* json, size_t json_sz);
+
+/*
+ * Get the value of a raw number, or 'fallback' if the member was not found or
+ * if it's not a number.
+ */
+double json_raw_number(const JsonRaw* raw, double fallback);
+
+/*
+ * Decode a raw string into the arena, converting its escape sequences. The
+ * decoded string is never longer than the raw one. If the member was not found
+ * or if it's not a string, 'dst' is set to NULL. Returns false if the string
+ * has invalid escape sequences.
+ */
+bool json_raw_string(const char** dst, const JsonRaw* raw, Arena* arena);
+
+/*
+ * Fill a 'Post' structure from its raw members, decoding the strings into the
+ * specified arena. Returns false if a string has invalid escape sequences.
+ */
+bool json_post_decode(Post* dst, const JsonPostRaw* src, Arena* arena);
+
+#endif /* JSONSCAN_H_ */
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef JSONSTREAM_H_
+#define JSONSTREAM_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "buffer.h"
+
+/*
+ * Function called for each complete element found by the stream. The 'elem'
+ * string is the null-terminated JSON text of the element, and it's only valid
+ * until the callback returns. If the callback returns false, the stream is
+ * aborted.
+ */
+typedef bool (*JsonStreamCallback)(void* user_data, const char* elem,
+                                   size_t elem_sz);
+
+/*
+ * Incremental splitter for JSON documents. It receives the document in chunks
+ * of arbitrary size, and extracts the text of every object whose opening brace
+ * appears at a specific nesting level, as soon as its closing brace is
+ * received. For example, with a level of 2, the posts of a thread
+ * ('{"posts":[{...},{...}]}') are extracted one by one.
+ *
+ * Only the text of the current element is kept in memory, so the whole
+ * document is never stored.
+ */
+typedef struct {
+    int elem_depth;
+    JsonStreamCallback callback;
+    void* user_data;
+
+    /* Current nesting level, and string state */
+    int depth;
+    bool in_str, escaped;
+
+    /* Is the text being received part of an element? */
+    bool in_elem;
+
+    /* Text of the current element, reused for all elements */
+    Buffer elem;
+
+    /* Number of elements extracted so far */
+    size_t elem_count;
+
+    /* Was the stream aborted because of malformed input or by the callback? */
+    bool failed;
+} JsonStream;
+
+/*
+ * Initialize a JSON stream that will extract the objects at the specified
+ * nesting level, calling the specified callback for each one.
+ */
+void json_stream_init(JsonStream* stream, int elem_depth,
+                      JsonStreamCallback callback, void* user_data);
+
+/*
+ * Prepare a JSON stream for a new document, keeping the memory used for the
+ * elements of the previous one.
+ */
+void json_stream_reset(JsonStream* stream);
+
+/*
+ * Free the resources used by a JSON stream.
+ */
+void json_stream_free(JsonStream* stream);
+
+/*
+ * Feed the next chunk of the document to the stream. Returns false if the
+ * stream failed.
+ */
+bool json_stream_feed(JsonStream* stream, const char* data, size_t data_sz);
+
+/*
+ * Check that the whole document was received. Returns false if the document was
+ * incomplete, or if the stream failed.
+ */
+bool json_stream_finish(const JsonStream* stream);
+
+#endif /* JSONSTREAM_H_ */
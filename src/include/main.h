@@ -20,10 +20,29 @@
 #define MAIN_H_ 1
 
 /*
- * Compile-time configuration.
+ * Compile-time configuration. The boards can be changed at runtime with '-b'.
  */
-#define BOARD       "g"
-#define THREADS_URL "https://a.4cdn.org/" BOARD "/threads.json"
+#define DEFAULT_BOARD "g"
+#define API_URL       "https://a.4cdn.org"
+#define MEDIA_URL     "https://i.4cdn.org"
+
+/*
+ * Maximum number of boards requested at once, and maximum length of the name of
+ * a board.
+ */
+#define MAX_BOARDS    80
+#define MAX_BOARD_LEN 15
+
+/*
+ * Default number of concurrent requests. Can be changed at runtime with '-j'.
+ */
+#define DEFAULT_JOBS 4
+
+/*
+ * Default number of concurrent media downloads. Can be changed at runtime with
+ * '-J'.
+ */
+#define DEFAULT_MEDIA_JOBS 4
 
 /*
  * Maximum number of threads (not posts) to parse and print.
@@ -33,6 +52,6 @@
 /*
  * Entry point of the program.
  */
-int main(void);
+int main(int argc, char** argv);
 
 #endif /* MAIN_H_ */
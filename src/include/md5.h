@@ -0,0 +1,56 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MD5_H_
+#define MD5_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Size of an MD5 digest, in bytes.
+ */
+#define MD5_SZ 16
+
+/*
+ * State of an incremental MD5 computation (RFC 1321), so data can be hashed as
+ * it's received, without keeping it in memory.
+ */
+typedef struct {
+    uint32_t state[4];
+    uint64_t len;       /* Total number of bytes hashed */
+    uint8_t block[64];  /* Input that doesn't fill a block yet */
+} Md5;
+
+/*
+ * Start a new MD5 computation.
+ */
+void md5_init(Md5* md5);
+
+/*
+ * Hash the specified data, after the data of the previous calls.
+ */
+void md5_update(Md5* md5, const void* data, size_t data_sz);
+
+/*
+ * Finish the computation, writing the digest of all the hashed data to 'dst'.
+ * The state must be initialized again before it's used for other data.
+ */
+void md5_final(Md5* md5, uint8_t dst[MD5_SZ]);
+
+#endif /* MD5_H_ */
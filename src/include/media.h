@@ -0,0 +1,85 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEDIA_H_
+#define MEDIA_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Attachments of each post that are downloaded, as a combination of flags.
+ */
+typedef enum {
+    MEDIA_FILES  = 1 << 0, /* The full files */
+    MEDIA_THUMBS = 1 << 1, /* Their thumbnails */
+} MediaKind;
+
+/*
+ * Number of attachments handled since the downloader was initialized.
+ */
+typedef struct {
+    size_t downloaded;
+    size_t stored;     /* Already in the store, not downloaded again */
+    size_t duplicates; /* Found more than once, only handled the first time */
+    size_t failed;
+    uint64_t bytes; /* Written to the store */
+} MediaCounts;
+
+/*
+ * Initialize the media downloader. The attachments are requested from 'url',
+ * and they are stored in 'dir', which is created if needed, named after the MD5
+ * of the file reported by the API, so each file is only downloaded once, even
+ * if it was posted several times. Full files are only stored if their MD5
+ * matches. At most 'max_connections' attachments are downloaded at once.
+ * Returns false if the downloader could not be enabled.
+ */
+bool media_init(const char* dir, const char* url, int kinds,
+                size_t max_connections);
+
+/*
+ * Is the downloader initialized?
+ */
+bool media_enabled(void);
+
+/*
+ * Queue the attachments of the posts of a thread JSON of the specified board,
+ * which doesn't need to be null-terminated, skipping the ones that are already
+ * stored or queued. Returns false if the JSON is malformed.
+ */
+bool media_add_thread(const char* board, const char* json, size_t json_sz);
+
+/*
+ * Download the queued attachments concurrently, writing each one to the store
+ * as it's received. Returns false if any of them failed.
+ */
+bool media_run(void);
+
+/*
+ * Get the number of attachments handled so far.
+ */
+void media_get_counts(MediaCounts* dst);
+
+/*
+ * Free all the resources used by the downloader. The queued attachments that
+ * were not downloaded are discarded.
+ */
+void media_free(void);
+
+#endif /* MEDIA_H_ */
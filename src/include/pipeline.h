@@ -0,0 +1,109 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "buffer.h"
+#include "cache.h"
+#include "thread.h"
+
+/*
+ * Number of jobs that can be in the pipeline for each worker, including the
+ * ones waiting to be parsed and the ones waiting to be written.
+ */
+#define PIPELINE_JOBS_PER_WORKER 4
+
+/*
+ * Pipeline that parses and renders threads on a pool of worker threads, while
+ * the main thread keeps fetching them. Jobs are submitted in order to a
+ * bounded ring, and each worker takes the oldest one that was not taken yet.
+ * The finished jobs are passed to the output callback on the main thread, in
+ * the order they were submitted, regardless of the order in which they finish.
+ */
+typedef struct Pipeline Pipeline;
+
+/*
+ * Thread processed by the pipeline. The caller fills the input fields of the
+ * job returned by 'pipeline_next_job', and the workers fill the results.
+ */
+typedef struct {
+    /* Input */
+    const char* board; /* Must remain valid until the job is done */
+    ThreadId id;
+    PostId last_seen; /* Only the newer posts are rendered */
+    Buffer body;      /* JSON of the thread, empty if it could not be fetched */
+
+    /* Metadata of the response, not used by the pipeline */
+    long status;
+    CacheValidators validators;
+
+    /* Results */
+    bool ok;              /* The thread was parsed and rendered */
+    Buffer out;           /* Rendered posts */
+    PostId last_rendered; /* See 'pretty_render_thread_since' */
+} PipelineJob;
+
+/*
+ * Function called on the main thread for each finished job, in order. The job
+ * is reused after the callback returns, but the callback is allowed to swap its
+ * buffers with other ones, taking ownership of them.
+ */
+typedef void (*PipelineOutput)(void* user_data, PipelineJob* job);
+
+/*
+ * Allocate a new pipeline, and start the specified number of workers. With zero
+ * workers, each job is processed by the calling thread when it's submitted.
+ * Returns NULL on failure.
+ */
+Pipeline* pipeline_new(size_t workers_num, PipelineOutput output,
+                       void* user_data);
+
+/*
+ * Stop the workers of the pipeline, and free it. The jobs that were not passed
+ * to the output callback are discarded; see 'pipeline_finish'.
+ */
+void pipeline_free(Pipeline* pipeline);
+
+/*
+ * Get the next job, whose input should be filled before passing it to
+ * 'pipeline_submit'. If the pipeline is full, the oldest jobs are waited for
+ * and passed to the output callback first.
+ */
+PipelineJob* pipeline_next_job(Pipeline* pipeline);
+
+/*
+ * Pass the job returned by the last call to 'pipeline_next_job' to the workers.
+ */
+void pipeline_submit(Pipeline* pipeline);
+
+/*
+ * Pass the jobs that already finished to the output callback, in order, without
+ * waiting for the rest.
+ */
+void pipeline_flush(Pipeline* pipeline);
+
+/*
+ * Wait for all submitted jobs, and pass them to the output callback, in order.
+ */
+void pipeline_finish(Pipeline* pipeline);
+
+#endif /* PIPELINE_H_ */
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef POST_H_
+#define POST_H_ 1
+
+#include <stdbool.h>
+
+#include <cjson/cJSON.h>
+
+#include "thread.h"
+
+/*
+ * Fields of a post used by the program. The strings are not owned by the
+ * structure, they point to the source of the post (e.g. a JSON tree or an
+ * archive), and they are NULL if the post doesn't have that field.
+ */
+typedef struct {
+    PostId no;          /* Zero if unknown */
+    long long time;     /* UNIX timestamp, zero if unknown */
+    long long tim;      /* Timestamp of the attachment, zero if none */
+    int replies;        /* Only in the OP, negative if unknown */
+    int images;         /* Only in the OP, negative if unknown */
+    const char* sub;    /* Title, as HTML */
+    const char* name;   /* Name of the author */
+    const char* filename;
+    const char* ext;
+    const char* com;    /* Contents, as HTML */
+} Post;
+
+/*
+ * Fill a 'Post' structure from a post object of a thread JSON. The strings
+ * point to the JSON tree, so they are only valid while it exists.
+ */
+bool post_from_json(Post* dst, cJSON* src);
+
+#endif /* POST_H_ */
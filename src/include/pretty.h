@@ -24,9 +24,143 @@
 
 #include <cjson/cJSON.h>
 
+#include "buffer.h"
+#include "html.h"
+#include "post.h"
+#include "replies.h"
+#include "thread.h"
+
+/*
+ * The functions that render whole threads below walk their posts, and render
+ * each of them, along with the headers between them, with the selected
+ * renderer (see 'render.h'). The pretty printer, which is the default renderer,
+ * is implemented by the rest of the functions.
+ */
+
+/*
+ * Render a single post of the specified board, appending the text to the
+ * specified buffer. The board is used for the URL of the attachment. The
+ * 'is_reply' argument indicates whether the post is a reply, or the first post
+ * of the thread. If 'com' is not NULL, it's the contents of the post, already
+ * converted from HTML. The strings of the post are not modified.
+ */
+bool pretty_render_post(Buffer* out, const Post* post, const HtmlText* com,
+                        const char* board, bool is_reply);
+
+/*
+ * Render the header shown before the threads of a board, when more than one
+ * board is printed.
+ */
+void pretty_render_board_header(Buffer* out, const char* board);
+
+/*
+ * Render the numbers of the posts that quote the post at position 'pos' of the
+ * graph, wrapping them like the contents of a post. Nothing is rendered if the
+ * post has no replies.
+ */
+void pretty_render_replies(Buffer* out, const ReplyGraph* graph, size_t pos,
+                           bool is_reply);
+
+/*
+ * Render all the posts of a specific thread JSON of the specified board,
+ * appending the text to the specified buffer.
+ */
+bool pretty_render_thread(Buffer* out, cJSON* thread_json, const char* board);
+
+/*
+ * Render the posts of a thread JSON whose number is greater than 'last_seen'.
+ * The posts are found by walking backwards from the last one, so the older
+ * posts are not visited. If the OP is not rendered, a header with its number is
+ * rendered first. If 'last_rendered' is not NULL and some post was rendered, it
+ * is set to the number of the last post.
+ */
+bool pretty_render_thread_since(Buffer* out, cJSON* thread_json,
+                                const char* board, PostId last_seen,
+                                PostId* last_rendered);
+
+/*
+ * Render the posts of a thread like 'pretty_render_thread_since', locating them
+ * in the raw JSON of the thread with the on-demand scanner (see 'jsonscan.h')
+ * instead of parsing it with cJSON. The JSON doesn't need to be
+ * null-terminated.
+ */
+bool pretty_render_thread_scan(Buffer* out, const char* json, size_t json_sz,
+                               const char* board, PostId last_seen,
+                               PostId* last_rendered);
+
+/*
+ * Render a list of posts of a thread, in order, all of them except the first
+ * one as replies. If backlinks are enabled (see 'pretty_enable_backlinks'),
+ * each post is followed by the numbers of its replies.
+ */
+bool pretty_render_posts(Buffer* out, const Post* posts, size_t posts_num,
+                         const char* board);
+
+/*
+ * Render a post of a thread JSON, followed by the posts that reply to it,
+ * directly or through other replies, in the order of the thread. Each post is
+ * followed by the numbers of its replies, even if backlinks are not enabled, as
+ * long as the renderer shows them. Returns false if the post is not in the
+ * thread.
+ */
+bool pretty_render_subtree(Buffer* out, cJSON* thread_json, const char* board,
+                           PostId root_no);
+
+/*
+ * Render a thread of a board catalog ('catalog.json'): its OP, followed by the
+ * last replies included in the catalog. The thread is formatted like the ones
+ * rendered by 'pretty_render_thread'.
+ */
+bool pretty_render_catalog_thread(Buffer* out, cJSON* thread_json,
+                                  const char* board);
+
+/*
+ * Render the line shown in place of the replies of a thread that are not
+ * included in the catalog.
+ */
+void pretty_render_omitted_header(Buffer* out, int omitted);
+
+/*
+ * Render the header shown before the new replies of a thread, when its OP is
+ * not rendered.
+ */
+void pretty_render_new_replies_header(Buffer* out, PostId op_no);
+
+/*
+ * Render the numbers of the posts that quote each post below it, in the
+ * rendering functions of whole threads. Building the reply graph needs all the
+ * posts of the thread, even if only some of them are rendered. Must be called
+ * before rendering, since it affects all threads.
+ */
+void pretty_enable_backlinks(bool enable);
+
+/*
+ * The rendering functions above can be called from several threads at once,
+ * since each thread uses its own temporary buffers. Free the buffers of the
+ * calling thread; it must be called by every thread other than the main one
+ * before exiting.
+ */
+void pretty_free(void);
+
+/*
+ * Print a single post. The post is rendered into an internal buffer, which is
+ * written to the file with a single call.
+ */
+bool pretty_print_post(FILE* fp, const Post* post, const char* board,
+                       bool is_reply);
+
+/*
+ * Print the contents of a specific thread JSON. The whole thread is rendered
+ * into an internal buffer, which is written to the file with a single call.
+ */
+bool pretty_print_thread(FILE* fp, cJSON* thread_json, const char* board);
+
 /*
- * Print the contents of a specific thread JSON to the standard output.
+ * Print the posts of a thread JSON whose number is greater than 'last_seen'.
+ * See 'pretty_render_thread_since'.
  */
-bool pretty_print_thread(FILE* fp, cJSON* thread_json);
+bool pretty_print_thread_since(FILE* fp, cJSON* thread_json,
+                               const char* board, PostId last_seen,
+                               PostId* last_rendered);
 
 #endif /* PRETTY_H_ */
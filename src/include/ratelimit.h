@@ -0,0 +1,64 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RATELIMIT_H_
+#define RATELIMIT_H_ 1
+
+#include <stdbool.h>
+
+/*
+ * Default number of requests per second allowed for each host, as required by
+ * the rules of the 4chan API.
+ */
+#define RATELIMIT_DEFAULT_RATE 1.0
+
+/*
+ * The requests to each host are paced with a token bucket: every request takes
+ * a token, and tokens are added at a fixed rate, up to a maximum (the burst),
+ * so a host never receives more than 'burst' requests at once, and never more
+ * than 'rate' requests per second on average. The limits apply to the whole
+ * program, and they are shared by all handles.
+ */
+
+/*
+ * Set the limit of the specified host, or of all the hosts without a specific
+ * limit if 'host' is NULL. A rate of zero disables the limit. Returns false if
+ * there is no space for more hosts.
+ */
+bool ratelimit_set(const char* host, double rate, double burst);
+
+/*
+ * Set a limit from a string of the form "[HOST=]RATE[:BURST]", as specified in
+ * the command line. The burst defaults to one request. Returns false if the
+ * string is not valid.
+ */
+bool ratelimit_parse(const char* spec);
+
+/*
+ * Try to take a token for a request to the specified URL. Returns zero if the
+ * request can be made now, or the number of milliseconds until a token will be
+ * available; in that case, no token is taken.
+ */
+long ratelimit_acquire(const char* url);
+
+/*
+ * Wait until a request to the specified URL can be made, and take a token.
+ */
+void ratelimit_wait(const char* url);
+
+#endif /* RATELIMIT_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDER_H_
+#define RENDER_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "buffer.h"
+#include "html.h"
+#include "post.h"
+#include "replies.h"
+#include "thread.h"
+
+/*
+ * Output formats, each of them implemented by a different renderer.
+ */
+typedef enum {
+    RENDER_PRETTY, /* Colored and wrapped posts, for terminals */
+    RENDER_NDJSON, /* A JSON object for each post, one per line */
+    RENDER_TSV,    /* Tab-separated fields of each post, one per line */
+} RenderFormat;
+
+/*
+ * Backend used for rendering posts. The threads are walked by the functions in
+ * 'pretty.h', which call the selected renderer for each post. Every function
+ * appends the text to a buffer, and can be called by several threads at once.
+ * The headers and the replies are meant for people reading the output, so
+ * formats that don't have them leave those functions NULL.
+ */
+typedef struct {
+    const char* name;
+
+    /*
+     * Render a post of the thread whose OP has the number 'thread'. If 'com'
+     * is not NULL, it's the contents of the post, already converted.
+     */
+    bool (*post)(Buffer* out, const Post* post, const HtmlText* com,
+                 const char* board, ThreadId thread, bool is_reply);
+
+    /* Render the numbers of the posts that quote the post at 'pos' */
+    void (*replies)(Buffer* out, const ReplyGraph* graph, size_t pos,
+                    bool is_reply);
+
+    /* See 'pretty_render_new_replies_header' and similar */
+    void (*new_replies_header)(Buffer* out, PostId op_no);
+    void (*omitted_header)(Buffer* out, int omitted);
+    void (*board_header)(Buffer* out, const char* board);
+} Renderer;
+
+/*
+ * Select the renderer used for all posts. Must be called before rendering
+ * anything.
+ */
+void render_select(RenderFormat format);
+
+/*
+ * Get the selected renderer, which is the pretty printer by default.
+ */
+const Renderer* render_current(void);
+
+/*
+ * Get the format with the specified name, as used in the command-line. Returns
+ * false if there is no format with that name.
+ */
+bool render_format_from_name(const char* name, RenderFormat* dst);
+
+/*
+ * Free the temporary buffers of the calling thread, like 'pretty_free'.
+ */
+void render_free(void);
+
+#endif /* RENDER_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "buffer.h"
+#include "util.h"
+
+/*
+ * Captured responses are identified by the path of their URL, without the
+ * scheme and the host. For example, the response of:
+ *
+ *   https://a.4cdn.org/g/thread/123.json
+ *
+ * is stored in 'g/thread/123.json', inside the capture directory or tarball.
+ */
+
+/*
+ * Open the replay source at the specified path, which can be a directory or an
+ * uncompressed tarball of captured responses. While it's open, requests are
+ * answered from it instead of the network. Returns false if the source could
+ * not be opened.
+ */
+bool replay_open(const char* path);
+
+/*
+ * Is a replay source open?
+ */
+bool replay_enabled(void);
+
+/*
+ * Read the captured response for the specified URL, appending it to the
+ * specified buffer. Returns false if the URL was not captured.
+ */
+bool replay_load(const char* url, Buffer* dst);
+
+/*
+ * Close the replay source.
+ */
+void replay_close(void);
+
+/*
+ * Store every successful response in the specified directory, which is created
+ * if needed, so it can be used as a replay source later. Returns false if the
+ * directory could not be created.
+ */
+bool replay_capture_init(const char* dir);
+
+/*
+ * Are responses being captured?
+ */
+bool replay_capture_enabled(void);
+
+/*
+ * Store the response for the specified URL in the capture directory, replacing
+ * any previous one.
+ */
+bool replay_capture_store(const char* url, const char* body, size_t body_sz);
+
+/*
+ * Start storing the response for the specified URL in the capture directory,
+ * like 'replay_capture_store', but without its body: it should be written to
+ * the specified writer as it's received, and the capture replaces the previous
+ * one once the writer is committed. Returns false on failure.
+ */
+bool replay_capture_begin(const char* url, FileWriter* dst);
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLIES_H_
+#define REPLIES_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h> /* SIZE_MAX */
+
+#include "arena.h"
+#include "html.h"
+#include "thread.h"
+
+/*
+ * Position returned by 'reply_graph_find' for posts that are not in the graph.
+ */
+#define REPLY_NONE SIZE_MAX
+
+/*
+ * Reply to a post, as a node of the list of replies of that post.
+ */
+typedef struct ReplyEdge {
+    size_t from; /* Position of the replying post */
+    struct ReplyEdge* next;
+} ReplyEdge;
+
+/*
+ * Post of the graph, with the posts that quote it, in the order of the thread.
+ */
+typedef struct {
+    PostId no;
+    ReplyEdge* first_reply;
+    ReplyEdge* last_reply;
+} ReplyNode;
+
+/*
+ * Graph of the replies between the posts of a thread. Posts are added in the
+ * order of the thread, and their quotelinks are resolved with a hash index from
+ * post numbers to positions, so the graph is built in a single pass. Since a
+ * post can only quote older posts, links to posts that were not added yet (e.g.
+ * posts of other threads) are ignored, and replies always come after the post
+ * they quote. All the memory of the graph is allocated from an arena.
+ */
+typedef struct {
+    Arena* arena;
+
+    /* Added posts, by position in the thread */
+    ReplyNode* nodes;
+    size_t nodes_num, nodes_cap;
+
+    /* Open addressing, each slot is a position plus one, or zero if empty */
+    size_t* slots;
+    size_t slots_mask;
+} ReplyGraph;
+
+/*
+ * Initialize an empty graph for at most 'posts_max' posts, allocated from the
+ * specified arena. The graph is valid until the arena is reset.
+ */
+bool reply_graph_init(ReplyGraph* graph, Arena* arena, size_t posts_max);
+
+/*
+ * Add the next post of the thread to the graph, along with the quotelinks of
+ * its contents, as returned by 'html2txt'. The spans can be NULL if the post
+ * has no contents. Repeated links to the same post are only added once.
+ */
+bool reply_graph_add(ReplyGraph* graph, PostId no, const HtmlSpans* spans);
+
+/*
+ * Get the position of the post with the specified number, or 'REPLY_NONE' if
+ * it's not in the graph.
+ */
+size_t reply_graph_find(const ReplyGraph* graph, PostId no);
+
+/*
+ * Mark the post at position 'root' and all of its replies, recursively. The
+ * 'marked' array must have an element for each post of the graph. Returns the
+ * number of marked posts.
+ */
+size_t reply_graph_subtree(const ReplyGraph* graph, size_t root, bool* marked);
+
+#endif /* REPLIES_H_ */
@@ -19,13 +19,176 @@
 #ifndef REQUEST_H_
 #define REQUEST_H_ 1
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
 
+#include "arena.h"
+#include "buffer.h"
+#include "cache.h"
+#include "jsonstream.h"
+#include "util.h"
+
+/*
+ * State of a single request, shared by the blocking and concurrent paths. It
+ * should be initialized once with 'request_init', and it can then be reused for
+ * multiple requests, each one prepared with 'request_setup' and finished with
+ * 'request_finish' (or prepared with 'request_setup_stream' and finished with
+ * 'request_finish_stream').
+ */
+typedef struct {
+    CURL* curl;
+    const char* url;
+
+    /* Response buffer, reused across requests */
+    Buffer buffer;
+
+    /*
+     * If not NULL, the parsed JSON is allocated from this arena, which is reset
+     * at the start of each request.
+     */
+    Arena* arena;
+
+    /* If not NULL, the response is passed to this stream as it's received */
+    JsonStream* stream;
+
+    /*
+     * Files where a streamed response is written as it's received, if it's
+     * stored in the cache or in the capture directory. They are opened when
+     * the first data is received.
+     */
+    FileWriter cache_file;
+    FileWriter capture_file;
+    bool files_opened;
+
+    /* Extra request headers, used for conditional requests */
+    struct curl_slist* headers;
+
+    /* Was a cached response found when the request was prepared? */
+    bool is_cached;
+
+    /* Validators returned by the server, filled while receiving headers */
+    CacheValidators validators;
+
+    /* HTTP status of the finished request, 304 if the cached one was used */
+    long status;
+} Request;
+
+/*
+ * Initialize the pool of connections, DNS entries and TLS sessions shared by
+ * all the handles created with 'request_handle_new', so they are reused across
+ * handles and fetching engines. Returns false if the pool could not be
+ * created, in which case the handles are still usable without it.
+ */
+bool request_pool_init(void);
+
+/*
+ * Free the shared pool. All the handles that use it must have been freed.
+ */
+void request_pool_free(void);
+
+/*
+ * Create a new 'CURL' handle that uses the shared pool, if it was initialized,
+ * and that prefers HTTP/2 for HTTPS. Returns NULL on failure.
+ */
+CURL* request_handle_new(void);
+
+/*
+ * Set the URL of the next request of a handle created with
+ * 'request_handle_new'. HTTPS requests wait for an existing connection that
+ * can multiplex them, when possible, instead of opening a new one.
+ */
+void request_handle_set_url(CURL* curl, const char* url);
+
+/*
+ * Initialize a request structure. If 'arena' is not NULL, the trees returned by
+ * 'request_finish' are allocated from it, and they are only valid until the
+ * next request is prepared; otherwise, they must be freed with 'cJSON_Delete'.
+ */
+void request_init(Request* req, Arena* arena);
+
+/*
+ * Free the resources used by a request structure.
+ */
+void request_free(Request* req);
+
+/*
+ * Prepare the specified 'curl' handle for requesting the specified URL, storing
+ * the response in the buffer of 'req'. The URL is not copied, so it must remain
+ * valid until 'request_finish' is called. The 'req' structure must have been
+ * initialized with 'request_init'.
+ */
+void request_setup(CURL* curl, Request* req, const char* url);
+
+/*
+ * Prepare the specified 'curl' handle for requesting the specified URL, like
+ * 'request_setup', but passing the response to the specified stream as it's
+ * received, instead of storing it.
+ */
+void request_setup_stream(CURL* curl, Request* req, const char* url,
+                          JsonStream* stream);
+
+/*
+ * Finish a request that was prepared with 'request_setup', and whose transfer
+ * returned the specified 'code'. The received response is parsed as JSON, and
+ * the internal buffer is cleared. If the server reported that the cached
+ * response is still valid, the cached one is parsed instead. Returns NULL on
+ * failure.
+ */
+cJSON* request_finish(CURL* curl, Request* req, CURLcode code);
+
+/*
+ * Finish a request that was prepared with 'request_setup', like
+ * 'request_finish', but without parsing the response: it's left in the buffer
+ * of 'req' until the next request, and it's not stored in the cache, since it
+ * might not be valid. See 'request_store'. Returns false on failure.
+ */
+bool request_finish_raw(CURL* curl, Request* req, CURLcode code);
+
+/*
+ * Store a valid response of a request, with the specified HTTP status, in the
+ * cache and in the capture directory, if they are enabled. Only new responses
+ * (with status 200) are stored in the cache.
+ */
+void request_store(const char* url, long status,
+                   const CacheValidators* validators, const char* body,
+                   size_t body_sz);
+
+/*
+ * Finish a request that was prepared with 'request_setup_stream', and whose
+ * transfer returned the specified 'code'. If the server reported that the
+ * cached response is still valid, it's passed to the stream now. Returns true
+ * if the whole response was received and passed to the stream.
+ */
+bool request_finish_stream(CURL* curl, Request* req, CURLcode code);
+
+/*
+ * Load the captured response for the specified URL from the replay source
+ * (see 'replay_open'), and parse it as JSON, without using the network. The
+ * tree is allocated like in 'request_finish'. Returns NULL on failure.
+ */
+cJSON* request_replay(Request* req, const char* url);
+
+/*
+ * Load the captured response for the specified URL into the buffer of 'req',
+ * like 'request_finish_raw'. Returns false if there is no captured response.
+ */
+bool request_replay_raw(Request* req, const char* url);
+
 /*
  * Request the contents of the specified URL, and parse them as JSON. The 'curl'
- * argument should have been initialized through 'curl_easy_init'.
+ * argument should have been initialized through 'curl_easy_init'. If a replay
+ * source is open, the captured response is used instead.
  */
 cJSON* request_json_from_url(CURL* curl, const char* url);
 
+/*
+ * Request the contents of the specified URL, passing them to the specified JSON
+ * stream as they are received. If a replay source is open, the captured
+ * response is used instead. Returns true on success.
+ */
+bool request_stream_from_url(CURL* curl, const char* url, JsonStream* stream);
+
 #endif /* REQUEST_H_ */
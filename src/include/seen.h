@@ -0,0 +1,69 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEEN_H_
+#define SEEN_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "thread.h"
+
+/*
+ * Initialize the list of the last post printed in each thread, loading it from
+ * the state file in the specified directory, which is created if needed. If
+ * 'dir' is NULL, the default directory is used. Returns false if the list could
+ * not be enabled.
+ */
+bool seen_init(const char* dir);
+
+/*
+ * Is the list initialized and usable?
+ */
+bool seen_enabled(void);
+
+/*
+ * Get the number of the last printed post of the specified thread of a board,
+ * or zero if none was printed.
+ */
+PostId seen_get(const char* board, ThreadId thread);
+
+/*
+ * Set the number of the last printed post of the specified thread of a board.
+ */
+bool seen_set(const char* board, ThreadId thread, PostId last_post);
+
+/*
+ * Remove the threads of a board that are not in the specified list of thread
+ * metadata, which must be sorted by ID. Used for forgetting threads that were
+ * pruned or archived. The threads of other boards are not affected.
+ */
+void seen_prune(const char* board, const ThreadInfo* threads,
+                size_t threads_num);
+
+/*
+ * Write the list to the state file, replacing the previous one.
+ */
+bool seen_save(void);
+
+/*
+ * Free the list, without saving it.
+ */
+void seen_free(void);
+
+#endif /* SEEN_H_ */
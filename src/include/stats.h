@@ -0,0 +1,102 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H_
+#define STATS_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <curl/curl.h>
+
+/*
+ * Stages of the program whose latency is measured. The network stages are
+ * obtained from curl after each transfer; the others are timed directly.
+ */
+typedef enum {
+    STATS_DNS,      /* Name resolution, only for new connections */
+    STATS_CONNECT,  /* TCP connection, only for new connections */
+    STATS_TLS,      /* TLS handshake, only for new connections */
+    STATS_TTFB,     /* From sending the request to the first response byte */
+    STATS_TRANSFER, /* From the first to the last response byte */
+    STATS_REQUEST,  /* Whole request, including all of the above */
+    STATS_PARSE,    /* Parsing a response as JSON */
+    STATS_RENDER,   /* Rendering a thread */
+
+    STATS_STAGES_NUM,
+} StatsStage;
+
+/*
+ * Format of the report printed by 'stats_print'.
+ */
+typedef enum {
+    STATS_FORMAT_TEXT,
+    STATS_FORMAT_JSON,
+} StatsFormat;
+
+/*
+ * Start measuring the latency of each stage. If 'trace_path' is not NULL, a
+ * line with the timings of each request is also written to that file, in JSON.
+ * Returns false if the trace file could not be opened.
+ */
+bool stats_init(const char* trace_path);
+
+/*
+ * Is the latency being measured?
+ */
+bool stats_enabled(void);
+
+/*
+ * Return the value of a monotonic clock, in nanoseconds.
+ */
+uint64_t stats_now_ns(void);
+
+/*
+ * Add a measurement of the specified stage, in nanoseconds. It can be called
+ * from any thread.
+ */
+void stats_record(StatsStage stage, uint64_t ns);
+
+/*
+ * Add the timings of the finished transfer of the specified handle, which
+ * returned the specified code, and write them to the trace file.
+ */
+void stats_record_transfer(CURL* curl, const char* url, CURLcode code);
+
+/*
+ * Account for the specified text, written to the standard output. The time of
+ * the first written text, and the time when the written lines fill the screen
+ * of the terminal, are measured from 'stats_init'. It must be called from the
+ * main thread.
+ */
+void stats_record_output(const char* data, size_t sz);
+
+/*
+ * Print the number of requests and the latency percentiles of each stage to
+ * the specified file.
+ */
+void stats_print(FILE* fp, StatsFormat format);
+
+/*
+ * Close the trace file, and stop measuring.
+ */
+void stats_free(void);
+
+#endif /* STATS_H_ */
@@ -19,16 +19,56 @@
 #ifndef THREAD_H_
 #define THREAD_H_ 1
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include <cjson/cJSON.h>
 
 typedef unsigned long ThreadId;
+typedef unsigned long PostId;
 
 /*
- * Fill a list of thread IDs (of the specified maximum size) by parsing the
- * contents of the 'src' JSON.
+ * Metadata of a thread, as listed in the 'threads.json' file of a board.
  */
-size_t thread_ids_from_json(ThreadId* dst, size_t dst_sz, cJSON* src);
+typedef struct {
+    ThreadId id;
+    long last_modified; /* UNIX timestamp */
+    int replies;
+    size_t position; /* Position in the thread list, in bump order */
+} ThreadInfo;
+
+/*
+ * Fill a list of thread metadata (of the specified maximum size) by parsing the
+ * contents of the 'src' JSON. Returns the number of written elements.
+ */
+size_t threads_from_json(ThreadInfo* dst, size_t dst_sz, cJSON* src);
+
+/*
+ * Sort a list of thread metadata by thread ID, so it can be used with
+ * 'thread_is_updated'.
+ */
+void threads_sort_by_id(ThreadInfo* threads, size_t threads_num);
+
+/*
+ * Sort a list of thread metadata by priority, so the threads that are more
+ * likely to be read are requested first: the most recently modified threads go
+ * first, and the threads that were modified at the same time keep the order of
+ * the thread list.
+ */
+void threads_sort_by_priority(ThreadInfo* threads, size_t threads_num);
+
+/*
+ * Check if the specified thread is new or was modified, compared to a previous
+ * list of thread metadata, which must be sorted by ID.
+ */
+bool thread_is_updated(const ThreadInfo* prev, size_t prev_num,
+                       const ThreadInfo* thread);
+
+/*
+ * Mark the thread with the specified ID as outdated in a list of thread
+ * metadata sorted by ID, so 'thread_is_updated' considers it updated again.
+ */
+void thread_mark_outdated(ThreadInfo* threads, size_t threads_num,
+                          ThreadId id);
 
 #endif /* THREAD_H_ */
@@ -19,6 +19,7 @@
 #ifndef UTIL_H_
 #define UTIL_H_ 1
 
+#include <stdbool.h>
 #include <stdio.h>  /* fprintf, stderr, etc. */
 #include <string.h> /* memmove */
 
@@ -34,6 +35,12 @@
  */
 #define STRLEN(STR) (ARRLEN(STR) - 1)
 
+/*
+ * Give each thread its own instance of a static variable. C99 has no keyword
+ * for this, but GCC and Clang support this extension.
+ */
+#define THREAD_LOCAL __thread
+
 /*
  * Move a string to a destination address, allowing buffer overlapping.
  */
@@ -49,4 +56,49 @@
         fprintf(stderr, COL_NORM "\n");                                        \
     } while (0)
 
+/*
+ * Create the specified directory, along with all its missing parents. Returns
+ * true if the directory exists after the call.
+ */
+bool make_dirs(const char* path);
+
+/*
+ * Maximum size of the paths of the files written with 'file_writer_open',
+ * including the null terminator.
+ */
+#define FILE_WRITER_PATH_SZ 1536
+
+/*
+ * File that is written to a temporary path next to its final one, and renamed
+ * when it's complete, so other processes never read partial files.
+ */
+typedef struct {
+    FILE* fp; /* NULL if the file is not open */
+    char path[FILE_WRITER_PATH_SZ];
+    char tmp_path[FILE_WRITER_PATH_SZ + 32];
+} FileWriter;
+
+/*
+ * Create the temporary file of a writer, which will be renamed to the specified
+ * path. Returns false if it could not be created.
+ */
+bool file_writer_open(FileWriter* writer, const char* path);
+
+/*
+ * Append data to the temporary file of a writer. Returns false on failure, in
+ * which case the writer should be discarded.
+ */
+bool file_writer_write(FileWriter* writer, const void* data, size_t data_sz);
+
+/*
+ * Close the temporary file of a writer, and rename it to its final path.
+ * Returns false on failure, in which case the temporary file is removed.
+ */
+bool file_writer_commit(FileWriter* writer);
+
+/*
+ * Close and remove the temporary file of a writer, if it's open.
+ */
+void file_writer_discard(FileWriter* writer);
+
 #endif /* UTIL_H_ */
@@ -0,0 +1,974 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>    /* open */
+#include <sys/mman.h> /* mmap */
+#include <sys/stat.h> /* fstat */
+#include <unistd.h>   /* access, close, getpid */
+
+#include "include/index.h"
+#include "include/buffer.h"
+#include "include/html.h"
+#include "include/post.h"
+#include "include/util.h"
+
+/*
+ * Maximum number of terms in a query, including the ones inside phrases.
+ */
+#define MAX_QUERY_TERMS 32
+
+/*
+ * Minimum capacity of the hash table of new terms. Must be a power of two.
+ */
+#define MIN_TABLE_CAP 4096
+
+/*----------------------------------------------------------------------------*/
+/* Encoding */
+
+/*
+ * Append an unsigned LEB128 integer to the buffer.
+ */
+static bool put_varint(Buffer* dst, uint64_t value) {
+    char bytes[10];
+    size_t len = 0;
+
+    do {
+        bytes[len] = (char)(value & 0x7F);
+        value >>= 7;
+        if (value != 0)
+            bytes[len] |= (char)0x80;
+        len++;
+    } while (value != 0);
+
+    return buffer_append(dst, bytes, len);
+}
+
+/*
+ * Read an unsigned LEB128 integer. Returns the position after it, or NULL if it
+ * was not terminated before 'end'.
+ */
+static const unsigned char* get_varint(const unsigned char* src,
+                                       const unsigned char* end,
+                                       uint64_t* dst) {
+    uint64_t value = 0;
+    for (int shift = 0; src < end && shift < 64; shift += 7) {
+        const unsigned char byte = *src++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *dst = value;
+            return src;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Compute the 32-bit FNV-1a hash of a string of the specified length.
+ */
+static uint32_t hash_term(const char* str, size_t len) {
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+/*
+ * Compare two terms, which are not null-terminated.
+ */
+static int compare_terms(const char* a, size_t a_len, const char* b,
+                         size_t b_len) {
+    const int result = memcmp(a, b, (a_len < b_len) ? a_len : b_len);
+    if (result != 0)
+        return result;
+
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Tokenizer */
+
+/*
+ * Is the specified byte part of a term? Non-ASCII bytes are included, so UTF-8
+ * words are not split.
+ */
+static inline bool is_term_char(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+/*
+ * Read the next term of the string into 'dst', which must have room for
+ * INDEX_MAX_TERM bytes. The term is not null-terminated. Returns its length,
+ * or zero if there are no more terms. The 'str' pointer is moved after the
+ * term.
+ */
+static size_t next_term(const char** str, char* dst) {
+    const char* cur = *str;
+    while (*cur != '\0' && !is_term_char((unsigned char)*cur))
+        cur++;
+
+    size_t len = 0;
+    for (; is_term_char((unsigned char)*cur); cur++) {
+        if (len >= INDEX_MAX_TERM)
+            continue;
+
+        const char c = *cur;
+        dst[len++]   = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+
+    *str = cur;
+    return len;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Reading */
+
+/*
+ * Check that the tables of a mapped index only refer to valid positions.
+ */
+static bool validate_index(const Index* index) {
+    for (size_t i = 0; i < index->terms_num; i++) {
+        const IndexTerm* term = &index->terms[i];
+        if (term->str > index->heap_sz ||
+            term->str_len > index->heap_sz - term->str ||
+            term->postings > index->postings_sz ||
+            term->postings_sz > index->postings_sz - term->postings ||
+            term->last_doc >= index->docs_num)
+            return false;
+    }
+
+    return true;
+}
+
+bool index_open(Index* index, const char* path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERR("Could not open index '%s'.", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexHeader)) {
+        ERR("Invalid index '%s'.", path);
+        close(fd);
+        return false;
+    }
+
+    index->map_sz = (size_t)st.st_size;
+    index->map    = mmap(NULL, index->map_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (index->map == MAP_FAILED) {
+        ERR("Could not map index '%s'.", path);
+        return false;
+    }
+
+    /* The tables are placed right after the header, and they are aligned */
+    const IndexHeader* header = index->map;
+    const size_t available    = index->map_sz - sizeof(IndexHeader);
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != INDEX_VERSION ||
+        header->byte_order != INDEX_BYTE_ORDER ||
+        header->docs_num > UINT32_MAX ||
+        header->docs_num > available / sizeof(IndexDoc) ||
+        header->terms_num > available / sizeof(IndexTerm) ||
+        header->heap_sz > available || header->postings_sz > available ||
+        header->docs_num * sizeof(IndexDoc) +
+            header->terms_num * sizeof(IndexTerm) + header->heap_sz +
+            header->postings_sz !=
+          available) {
+        ERR("Invalid index '%s'.", path);
+        index_close(index);
+        return false;
+    }
+
+    const char* tables = (const char*)index->map + sizeof(IndexHeader);
+
+    index->docs_num    = header->docs_num;
+    index->terms_num   = header->terms_num;
+    index->heap_sz     = header->heap_sz;
+    index->postings_sz = header->postings_sz;
+    index->docs        = (const IndexDoc*)tables;
+    index->terms       = (const IndexTerm*)(index->docs + index->docs_num);
+    index->heap        = (const char*)(index->terms + index->terms_num);
+    index->postings =
+      (const unsigned char*)(index->heap + index->heap_sz);
+
+    if (!validate_index(index)) {
+        ERR("Invalid index '%s'.", path);
+        index_close(index);
+        return false;
+    }
+
+    return true;
+}
+
+void index_close(Index* index) {
+    munmap(index->map, index->map_sz);
+    index->map    = NULL;
+    index->map_sz = 0;
+}
+
+/*
+ * Find a term in the sorted term table of an index.
+ */
+static const IndexTerm* find_term(const Index* index, const char* str,
+                                  size_t len) {
+    size_t lo = 0, hi = index->terms_num;
+    while (lo < hi) {
+        const size_t mid      = lo + (hi - lo) / 2;
+        const IndexTerm* term = &index->terms[mid];
+
+        const int cmp =
+          compare_terms(&index->heap[term->str], term->str_len, str, len);
+        if (cmp == 0)
+            return term;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Building */
+
+/*
+ * Compare two post numbers. Used for 'qsort' and 'bsearch'.
+ */
+static int compare_post_ids(const void* a, const void* b) {
+    const PostId id_a = *(const PostId*)a;
+    const PostId id_b = *(const PostId*)b;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+bool index_builder_init(IndexBuilder* builder, const char* path) {
+    const Buffer empty = BUFFER_EMPTY;
+
+    builder->path      = path;
+    builder->has_old   = false;
+    builder->old_posts = NULL;
+    builder->docs      = empty;
+    builder->hits      = empty;
+    builder->terms     = empty;
+    builder->heap      = empty;
+    builder->table     = NULL;
+    builder->table_cap = 0;
+    builder->docs_num  = 0;
+    builder->hits_num  = 0;
+    builder->terms_num = 0;
+
+    /* A missing index is not an error, it will be created */
+    if (access(path, F_OK) != 0)
+        return true;
+
+    if (!index_open(&builder->old, path))
+        return false;
+    builder->has_old = true;
+
+    /* Sort the indexed posts, for skipping them quickly */
+    const size_t old_num = builder->old.docs_num;
+    builder->old_posts   = malloc(old_num * sizeof(PostId) + 1);
+    if (builder->old_posts == NULL) {
+        index_builder_free(builder);
+        return false;
+    }
+
+    for (size_t i = 0; i < old_num; i++)
+        builder->old_posts[i] = builder->old.docs[i].post;
+    qsort(builder->old_posts, old_num, sizeof(PostId), compare_post_ids);
+
+    return true;
+}
+
+void index_builder_free(IndexBuilder* builder) {
+    if (builder->has_old)
+        index_close(&builder->old);
+    builder->has_old = false;
+
+    free(builder->old_posts);
+    free(builder->table);
+    builder->old_posts = NULL;
+    builder->table     = NULL;
+
+    buffer_free(&builder->docs);
+    buffer_free(&builder->hits);
+    buffer_free(&builder->terms);
+    buffer_free(&builder->heap);
+}
+
+/*
+ * Get the new terms of the builder, as an array.
+ */
+static inline IndexBuilderTerm* builder_terms(const IndexBuilder* builder) {
+    return (IndexBuilderTerm*)builder->terms.data;
+}
+
+/*
+ * Grow the hash table of new terms, inserting the existing ones again.
+ */
+static bool grow_table(IndexBuilder* builder) {
+    const size_t new_cap =
+      (builder->table_cap == 0) ? MIN_TABLE_CAP : builder->table_cap * 2;
+    uint32_t* new_table = calloc(new_cap, sizeof(uint32_t));
+    if (new_table == NULL) {
+        ERR("Couldn't allocate the term table of the index.");
+        return false;
+    }
+
+    const IndexBuilderTerm* terms = builder_terms(builder);
+    for (size_t i = 0; i < builder->terms_num; i++) {
+        const char* str = &builder->heap.data[terms[i].str];
+        size_t slot = hash_term(str, terms[i].str_len) & (new_cap - 1);
+        while (new_table[slot] != 0)
+            slot = (slot + 1) & (new_cap - 1);
+        new_table[slot] = (uint32_t)i + 1;
+    }
+
+    free(builder->table);
+    builder->table     = new_table;
+    builder->table_cap = new_cap;
+    return true;
+}
+
+/*
+ * Get the index of a new term, adding it if needed. Returns false on failure.
+ */
+static bool intern_term(IndexBuilder* builder, const char* str, size_t len,
+                        uint32_t* dst) {
+    /* Keep the load factor of the table under 50% */
+    if (builder->terms_num * 2 >= builder->table_cap && !grow_table(builder))
+        return false;
+
+    const size_t mask = builder->table_cap - 1;
+    size_t slot       = hash_term(str, len) & mask;
+    for (; builder->table[slot] != 0; slot = (slot + 1) & mask) {
+        const uint32_t idx           = builder->table[slot] - 1;
+        const IndexBuilderTerm* term = &builder_terms(builder)[idx];
+        if (term->str_len == len &&
+            memcmp(&builder->heap.data[term->str], str, len) == 0) {
+            *dst = idx;
+            return true;
+        }
+    }
+
+    if (builder->terms_num >= UINT32_MAX - 1 ||
+        builder->heap.sz + len >= UINT32_MAX)
+        return false;
+
+    const IndexBuilderTerm term = {
+        .str      = (uint32_t)builder->heap.sz,
+        .str_len  = (uint32_t)len,
+        .hits_num = 0,
+    };
+    if (!buffer_append(&builder->heap, str, len) ||
+        !buffer_append(&builder->terms, (const char*)&term, sizeof(term)))
+        return false;
+
+    *dst                 = (uint32_t)builder->terms_num++;
+    builder->table[slot] = *dst + 1;
+    return true;
+}
+
+/*
+ * Add the terms of some plain text to the current document, starting at the
+ * specified position. Returns the position after the last term.
+ */
+static uint32_t add_text(IndexBuilder* builder, const char* text,
+                         uint32_t doc, uint32_t pos) {
+    char term[INDEX_MAX_TERM];
+    size_t len;
+    while ((len = next_term(&text, term)) > 0) {
+        IndexHit hit = {
+            .doc = doc,
+            .pos = pos++,
+        };
+        if (!intern_term(builder, term, len, &hit.term) ||
+            !buffer_append(&builder->hits, (const char*)&hit, sizeof(hit)))
+            break;
+
+        builder_terms(builder)[hit.term].hits_num++;
+        builder->hits_num++;
+    }
+
+    return pos;
+}
+
+bool index_builder_add_post(IndexBuilder* builder, ThreadId thread,
+                            const Post* post) {
+    /* Reused for converting the HTML of each post */
+    static Buffer text = BUFFER_EMPTY;
+
+    if (builder->old_posts != NULL &&
+        bsearch(&post->no,
+                builder->old_posts,
+                builder->old.docs_num,
+                sizeof(PostId),
+                compare_post_ids) != NULL)
+        return true;
+
+    const size_t old_num = builder->has_old ? builder->old.docs_num : 0;
+    if (old_num + builder->docs_num >= UINT32_MAX)
+        return false;
+
+    const IndexDoc doc = {
+        .thread = thread,
+        .post   = post->no,
+        .time   = post->time,
+    };
+    if (!buffer_append(&builder->docs, (const char*)&doc, sizeof(doc)))
+        return false;
+
+    /* The document IDs of the hits are relative to the new documents */
+    const uint32_t doc_id = (uint32_t)builder->docs_num++;
+
+    /* The title and the contents are separated, so phrases don't span both */
+    const char* fields[] = { post->sub, post->com };
+    uint32_t pos = 0;
+    for (size_t i = 0; i < ARRLEN(fields); i++) {
+        if (fields[i] == NULL)
+            continue;
+
+        buffer_clear(&text);
+        if (!buffer_reserve(&text, strlen(fields[i])))
+            return false;
+        text.sz = html2txt(text.data, fields[i], NULL);
+
+        pos = add_text(builder, text.data, doc_id, pos) + 1;
+    }
+
+    return true;
+}
+
+/*
+ * New term of the builder, with its position in the sorted hit list. Used for
+ * sorting the new terms.
+ */
+typedef struct {
+    const char* str;
+    uint32_t len;
+    uint32_t first_hit, hits_num;
+} SortedTerm;
+
+static int compare_sorted_terms(const void* a, const void* b) {
+    const SortedTerm* term_a = a;
+    const SortedTerm* term_b = b;
+    return compare_terms(term_a->str, term_a->len, term_b->str, term_b->len);
+}
+
+/*
+ * Append the postings of the new hits of a term, whose documents IDs are
+ * relative to 'doc_base'. The 'prev_doc' argument is the last document of the
+ * existing postings of the term, if any. Returns the number of documents.
+ */
+static uint32_t encode_hits(Buffer* dst, const IndexHit* hits, size_t hits_num,
+                            uint32_t doc_base, uint32_t prev_doc,
+                            uint32_t* last_doc) {
+    uint32_t docs_num = 0;
+
+    for (size_t i = 0; i < hits_num;) {
+        const uint32_t doc = doc_base + hits[i].doc;
+
+        size_t positions_num = 1;
+        while (i + positions_num < hits_num &&
+               hits[i + positions_num].doc == hits[i].doc)
+            positions_num++;
+
+        put_varint(dst, doc - prev_doc);
+        put_varint(dst, positions_num);
+
+        uint32_t prev_pos = 0;
+        for (size_t j = 0; j < positions_num; j++) {
+            put_varint(dst, hits[i + j].pos - prev_pos);
+            prev_pos = hits[i + j].pos;
+        }
+
+        prev_doc = doc;
+        docs_num++;
+        i += positions_num;
+    }
+
+    *last_doc = prev_doc;
+    return docs_num;
+}
+
+/*
+ * Write the header and the tables of the index to a file.
+ */
+static bool write_index(FILE* fp, const IndexHeader* header,
+                        const IndexBuilder* builder, const Buffer* terms,
+                        const Buffer* heap, const Buffer* postings) {
+    const Index* old       = &builder->old;
+    const size_t old_docs  = builder->has_old ? old->docs_num : 0;
+    const size_t docs_size = old_docs * sizeof(IndexDoc);
+
+    return fwrite(header, sizeof(*header), 1, fp) == 1 &&
+           (docs_size == 0 ||
+            fwrite(old->docs, 1, docs_size, fp) == docs_size) &&
+           fwrite(builder->docs.data, 1, builder->docs.sz, fp) ==
+             builder->docs.sz &&
+           fwrite(terms->data, 1, terms->sz, fp) == terms->sz &&
+           fwrite(heap->data, 1, heap->sz, fp) == heap->sz &&
+           fwrite(postings->data, 1, postings->sz, fp) == postings->sz;
+}
+
+bool index_builder_save(IndexBuilder* builder) {
+    bool result = false;
+
+    const Index* old        = &builder->old;
+    const size_t old_terms  = builder->has_old ? old->terms_num : 0;
+    const uint32_t doc_base = builder->has_old ? (uint32_t)old->docs_num : 0;
+
+    Buffer terms    = BUFFER_EMPTY;
+    Buffer heap     = BUFFER_EMPTY;
+    Buffer postings = BUFFER_EMPTY;
+
+    /* Sort the hits by term, keeping the order of documents and positions */
+    IndexHit* hits = malloc(builder->hits_num * sizeof(IndexHit) + 1);
+    SortedTerm* sorted =
+      malloc(builder->terms_num * sizeof(SortedTerm) + 1);
+    if (hits == NULL || sorted == NULL)
+        goto done;
+
+    const IndexBuilderTerm* new_terms = builder_terms(builder);
+    uint32_t first_hit                = 0;
+    for (size_t i = 0; i < builder->terms_num; i++) {
+        sorted[i].str       = &builder->heap.data[new_terms[i].str];
+        sorted[i].len       = new_terms[i].str_len;
+        sorted[i].first_hit = first_hit;
+        sorted[i].hits_num  = 0;
+        first_hit += new_terms[i].hits_num;
+    }
+
+    const IndexHit* unsorted = (const IndexHit*)builder->hits.data;
+    for (size_t i = 0; i < builder->hits_num; i++) {
+        SortedTerm* term = &sorted[unsorted[i].term];
+        hits[term->first_hit + term->hits_num++] = unsorted[i];
+    }
+
+    qsort(sorted, builder->terms_num, sizeof(SortedTerm), compare_sorted_terms);
+
+    /* Merge the old and the new terms, which are both sorted */
+    size_t i = 0, j = 0;
+    while (i < old_terms || j < builder->terms_num) {
+        const IndexTerm* old_term = (i < old_terms) ? &old->terms[i] : NULL;
+        const SortedTerm* new_term =
+          (j < builder->terms_num) ? &sorted[j] : NULL;
+
+        int cmp;
+        if (old_term == NULL)
+            cmp = 1;
+        else if (new_term == NULL)
+            cmp = -1;
+        else
+            cmp = compare_terms(&old->heap[old_term->str],
+                                old_term->str_len,
+                                new_term->str,
+                                new_term->len);
+
+        IndexTerm term = {
+            .str         = (uint32_t)heap.sz,
+            .postings    = postings.sz,
+            .postings_sz = 0,
+            .docs_num    = 0,
+            .last_doc    = 0,
+        };
+
+        if (cmp <= 0) {
+            term.str_len  = old_term->str_len;
+            term.docs_num = old_term->docs_num;
+            term.last_doc = old_term->last_doc;
+            if (!buffer_append(&heap,
+                               &old->heap[old_term->str],
+                               old_term->str_len) ||
+                !buffer_append(&postings,
+                               (const char*)&old->postings[old_term->postings],
+                               old_term->postings_sz))
+                goto done;
+            i++;
+        }
+
+        if (cmp >= 0) {
+            if (cmp > 0) {
+                term.str_len = new_term->len;
+                if (!buffer_append(&heap, new_term->str, new_term->len))
+                    goto done;
+            }
+
+            term.docs_num += encode_hits(&postings,
+                                         &hits[new_term->first_hit],
+                                         new_term->hits_num,
+                                         doc_base,
+                                         (cmp == 0) ? term.last_doc : 0,
+                                         &term.last_doc);
+            j++;
+        }
+
+        term.postings_sz = postings.sz - term.postings;
+        if (heap.sz >= UINT32_MAX ||
+            !buffer_append(&terms, (const char*)&term, sizeof(term)))
+            goto done;
+    }
+
+    IndexHeader header = {
+        .version     = INDEX_VERSION,
+        .byte_order  = INDEX_BYTE_ORDER,
+        .docs_num    = doc_base + builder->docs_num,
+        .terms_num   = terms.sz / sizeof(IndexTerm),
+        .heap_sz     = heap.sz,
+        .postings_sz = postings.sz,
+    };
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+
+    char tmp_path[1024];
+    const int written = snprintf(tmp_path,
+                                 sizeof(tmp_path),
+                                 "%s.%ld",
+                                 builder->path,
+                                 (long)getpid());
+    if (written <= 0 || (size_t)written >= sizeof(tmp_path))
+        goto done;
+
+    /*
+     * Write to a temporary file and rename it, so an index that is being read
+     * is never left incomplete. The old index stays mapped until the builder
+     * is freed.
+     */
+    FILE* fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        ERR("Could not create index '%s'.", tmp_path);
+        goto done;
+    }
+
+    const bool success =
+      write_index(fp, &header, builder, &terms, &heap, &postings);
+    if (fclose(fp) != 0 || !success || rename(tmp_path, builder->path) != 0) {
+        ERR("Could not write index '%s'.", builder->path);
+        remove(tmp_path);
+        goto done;
+    }
+
+    result = true;
+
+done:
+    free(hits);
+    free(sorted);
+    buffer_free(&terms);
+    buffer_free(&heap);
+    buffer_free(&postings);
+    return result;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Searching */
+
+/*
+ * Iterator over the postings of a term.
+ */
+typedef struct {
+    const unsigned char* cur;
+    const unsigned char* end;
+    uint64_t doc;                   /* Current document */
+    uint64_t positions_num;         /* Positions in the current document */
+    const unsigned char* positions; /* Encoded positions */
+    bool done;
+} PostingIter;
+
+/*
+ * Term of a query, with the phrase that contains it.
+ */
+typedef struct {
+    const IndexTerm* term;
+    size_t phrase;      /* Index of the phrase in the query */
+    size_t phrase_pos;  /* Position of the term in the phrase */
+    PostingIter iter;
+    uint32_t* positions; /* Decoded positions of the current document */
+    size_t positions_cap;
+} QueryTerm;
+
+/*
+ * Move the iterator to the next document. Returns false if there are no more
+ * documents, or if the postings are corrupt.
+ */
+static bool iter_next(PostingIter* iter) {
+    uint64_t delta, value;
+    if (iter->cur >= iter->end ||
+        (iter->cur = get_varint(iter->cur, iter->end, &delta)) == NULL ||
+        (iter->cur = get_varint(iter->cur, iter->end, &iter->positions_num)) ==
+          NULL) {
+        iter->done = true;
+        return false;
+    }
+
+    iter->doc += delta;
+    iter->positions = iter->cur;
+
+    /* Skip the positions, they are only decoded when needed */
+    for (uint64_t i = 0; i < iter->positions_num; i++) {
+        iter->cur = get_varint(iter->cur, iter->end, &value);
+        if (iter->cur == NULL) {
+            iter->done = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Move the iterator to the first document that is not lower than 'doc'.
+ */
+static bool iter_seek(PostingIter* iter, uint64_t doc) {
+    while (!iter->done && iter->doc < doc)
+        iter_next(iter);
+    return !iter->done;
+}
+
+/*
+ * Decode the positions of the current document of a query term.
+ */
+static bool decode_positions(QueryTerm* term) {
+    const PostingIter* iter = &term->iter;
+
+    if (iter->positions_num > term->positions_cap) {
+        uint32_t* ptr =
+          realloc(term->positions, iter->positions_num * sizeof(uint32_t));
+        if (ptr == NULL)
+            return false;
+        term->positions     = ptr;
+        term->positions_cap = iter->positions_num;
+    }
+
+    const unsigned char* cur = iter->positions;
+    uint64_t pos = 0, delta;
+    for (uint64_t i = 0; i < iter->positions_num; i++) {
+        cur = get_varint(cur, iter->cur, &delta);
+        if (cur == NULL)
+            return false;
+        pos += delta;
+        term->positions[i] = (uint32_t)pos;
+    }
+
+    return true;
+}
+
+/*
+ * Check if a sorted list of positions contains the specified one.
+ */
+static bool has_position(const uint32_t* positions, size_t positions_num,
+                         uint64_t pos) {
+    size_t lo = 0, hi = positions_num;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (positions[mid] == pos)
+            return true;
+        if (positions[mid] < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return false;
+}
+
+/*
+ * Check if the terms of each phrase appear consecutively in the current
+ * document, which must be the same for all the iterators.
+ */
+static bool phrases_match(QueryTerm* terms, size_t terms_num) {
+    for (size_t i = 0; i < terms_num; i++) {
+        /* Only check each phrase once, from its first term */
+        if (terms[i].phrase_pos != 0 || i + 1 >= terms_num ||
+            terms[i + 1].phrase != terms[i].phrase)
+            continue;
+
+        size_t phrase_len = 1;
+        while (i + phrase_len < terms_num &&
+               terms[i + phrase_len].phrase == terms[i].phrase)
+            phrase_len++;
+
+        for (size_t j = 0; j < phrase_len; j++)
+            if (!decode_positions(&terms[i + j]))
+                return false;
+
+        bool found = false;
+        for (uint64_t k = 0; !found && k < terms[i].iter.positions_num; k++) {
+            const uint64_t start = terms[i].positions[k];
+
+            found = true;
+            for (size_t j = 1; found && j < phrase_len; j++)
+                found = has_position(terms[i + j].positions,
+                                     terms[i + j].iter.positions_num,
+                                     start + j);
+        }
+
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Split a query into terms, looking them up in the index. Returns the number of
+ * terms, or zero if the query has no terms. If some term is not in the index,
+ * 'missing' is set.
+ */
+static size_t parse_query(const Index* index, const char* query,
+                          QueryTerm* dst, size_t dst_sz, bool* missing) {
+    size_t terms_num = 0, phrase = 0;
+    bool in_quotes   = false;
+
+    *missing = false;
+    while (*query != '\0' && terms_num < dst_sz) {
+        if (*query == '"') {
+            in_quotes = !in_quotes;
+            phrase++;
+            query++;
+            continue;
+        }
+
+        if (!is_term_char((unsigned char)*query)) {
+            query++;
+            continue;
+        }
+
+        /* Terms outside of quotes are separate phrases of a single term */
+        char str[INDEX_MAX_TERM];
+        const size_t len = next_term(&query, str);
+
+        QueryTerm* term = &dst[terms_num++];
+        term->term      = find_term(index, str, len);
+        term->phrase    = phrase;
+        term->phrase_pos =
+          (terms_num > 1 && dst[terms_num - 2].phrase == phrase)
+            ? dst[terms_num - 2].phrase_pos + 1
+            : 0;
+        term->positions     = NULL;
+        term->positions_cap = 0;
+
+        if (term->term == NULL)
+            *missing = true;
+
+        if (!in_quotes)
+            phrase++;
+    }
+
+    return terms_num;
+}
+
+/*
+ * Append a match to the list.
+ */
+static bool add_match(IndexMatches* dst, const IndexDoc* doc) {
+    if (dst->num >= dst->cap) {
+        const size_t new_cap = (dst->cap == 0) ? 64 : dst->cap * 2;
+        IndexMatch* ptr = realloc(dst->data, new_cap * sizeof(IndexMatch));
+        if (ptr == NULL) {
+            ERR("Couldn't realloc the list of matches.");
+            return false;
+        }
+        dst->data = ptr;
+        dst->cap  = new_cap;
+    }
+
+    IndexMatch* match = &dst->data[dst->num++];
+    match->thread     = doc->thread;
+    match->post       = doc->post;
+    match->time       = doc->time;
+    return true;
+}
+
+bool index_search(const Index* index, const char* query, IndexMatches* dst) {
+    QueryTerm terms[MAX_QUERY_TERMS];
+    bool missing;
+
+    dst->num = 0;
+
+    const size_t terms_num =
+      parse_query(index, query, terms, ARRLEN(terms), &missing);
+    if (terms_num == 0 || missing)
+        return true;
+
+    for (size_t i = 0; i < terms_num; i++) {
+        const IndexTerm* term = terms[i].term;
+        PostingIter* iter     = &terms[i].iter;
+
+        iter->cur  = &index->postings[term->postings];
+        iter->end  = iter->cur + term->postings_sz;
+        iter->doc  = 0;
+        iter->done = false;
+        iter_next(iter);
+    }
+
+    /*
+     * Find the documents that contain all the terms, by moving every iterator
+     * to the highest current document, until they are all in the same one.
+     */
+    bool result = true;
+    while (result) {
+        uint64_t target = 0;
+        bool done       = false;
+        for (size_t i = 0; i < terms_num; i++) {
+            done |= terms[i].iter.done;
+            if (terms[i].iter.doc > target)
+                target = terms[i].iter.doc;
+        }
+        if (done)
+            break;
+
+        bool all_equal = true;
+        for (size_t i = 0; i < terms_num; i++) {
+            if (!iter_seek(&terms[i].iter, target)) {
+                all_equal = false;
+                break;
+            }
+            if (terms[i].iter.doc != target)
+                all_equal = false;
+        }
+        if (!all_equal)
+            continue;
+
+        if (target < index->docs_num && phrases_match(terms, terms_num))
+            result = add_match(dst, &index->docs[target]);
+
+        /* Move to the next document */
+        iter_next(&terms[0].iter);
+    }
+
+    for (size_t i = 0; i < terms_num; i++)
+        free(terms[i].positions);
+
+    return result;
+}
+
+void index_matches_free(IndexMatches* matches) {
+    free(matches->data);
+    matches->data = NULL;
+    matches->num  = 0;
+    matches->cap  = 0;
+}
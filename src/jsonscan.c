@@ -0,0 +1,645 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h> /* strtod */
+#include <string.h>
+
+#include "include/jsonscan.h"
+#include "include/arena.h"
+#include "include/post.h"
+
+/*
+ * The vectorized implementations need the x86 intrinsics, and the 'target'
+ * attribute and CPU detection built-ins of GCC and Clang. SSE2 is always
+ * available when '__SSE2__' is defined, but AVX2 is detected at runtime.
+ */
+#if defined(__GNUC__) && defined(__SSE2__) && \
+  (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define HAVE_X86_SIMD 0
+#endif
+
+/*
+ * Find the first quote or backslash in the 'sz' bytes at 'str'. Returns its
+ * position, or 'sz' if there is none.
+ */
+typedef size_t (*FindSpecialFunc)(const char* str, size_t sz);
+
+static size_t find_special_scalar(const char* str, size_t sz) {
+    for (size_t i = 0; i < sz; i++)
+        if (str[i] == '"' || str[i] == '\\')
+            return i;
+
+    return sz;
+}
+
+#if HAVE_X86_SIMD
+static size_t find_special_sse2(const char* str, size_t sz) {
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 16 <= sz; i += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)&str[i]);
+        const __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                           _mm_cmpeq_epi8(chunk, backslash));
+
+        const unsigned mask = (unsigned)_mm_movemask_epi8(found);
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+
+    return i + find_special_scalar(&str[i], sz - i);
+}
+
+__attribute__((target("avx2"))) static size_t
+find_special_avx2(const char* str, size_t sz) {
+    const __m256i quote     = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 32 <= sz; i += 32) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)&str[i]);
+        const __m256i found =
+          _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                          _mm256_cmpeq_epi8(chunk, backslash));
+
+        const unsigned mask = (unsigned)_mm256_movemask_epi8(found);
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+
+    return i + find_special_sse2(&str[i], sz - i);
+}
+
+/*
+ * Is AVX2 supported by this processor?
+ */
+static bool has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif /* HAVE_X86_SIMD */
+
+/*
+ * Implementation selected with 'json_scan_select'. The function is shared by
+ * all threads, so it's only changed before scanning anything.
+ */
+static JsonScanImpl selected_impl    = JSON_SCAN_NONE;
+static FindSpecialFunc find_special = find_special_scalar;
+
+bool json_scan_select(JsonScanImpl impl) {
+    FindSpecialFunc func = find_special_scalar;
+
+    switch (impl) {
+        case JSON_SCAN_NONE:
+        case JSON_SCAN_SCALAR:
+            break;
+
+        case JSON_SCAN_SSE2:
+#if HAVE_X86_SIMD
+            func = find_special_sse2;
+            break;
+#else
+            return false;
+#endif
+
+        case JSON_SCAN_AVX2:
+#if HAVE_X86_SIMD
+            if (!has_avx2())
+                return false;
+            func = find_special_avx2;
+            break;
+#else
+            return false;
+#endif
+    }
+
+    selected_impl = impl;
+    find_special  = func;
+    return true;
+}
+
+JsonScanImpl json_scan_best(void) {
+    /*
+     * Most strings of a thread are short runs of HTML between escaped quotes,
+     * so the wider loads of AVX2 don't pay off, and SSE2 is faster on real
+     * threads. AVX2 is only used when it's selected explicitly.
+     */
+#if HAVE_X86_SIMD
+    return JSON_SCAN_SSE2;
+#else
+    return JSON_SCAN_SCALAR;
+#endif
+}
+
+const char* json_scan_name(JsonScanImpl impl) {
+    switch (impl) {
+        case JSON_SCAN_NONE:
+            return "cjson";
+        case JSON_SCAN_SCALAR:
+            return "scalar";
+        case JSON_SCAN_SSE2:
+            return "sse2";
+        case JSON_SCAN_AVX2:
+            return "avx2";
+    }
+
+    return "unknown";
+}
+
+bool json_scan_enabled(void) {
+    return selected_impl != JSON_SCAN_NONE;
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline bool is_ws(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline const char* skip_ws(const char* p, const char* end) {
+    while (p < end && is_ws(*p))
+        p++;
+    return p;
+}
+
+/*
+ * Find the closing quote of the string whose contents start at 'p'. Returns
+ * NULL if the string is not terminated. If the string has escape sequences,
+ * 'has_escapes' is set to true.
+ */
+static const char* find_string_end(const char* p, const char* end,
+                                   bool* has_escapes) {
+    while (p < end) {
+        p += find_special(p, (size_t)(end - p));
+        if (p >= end)
+            break;
+
+        if (*p == '"')
+            return p;
+
+        /* Skip the backslash and the escaped character, which can be a quote */
+        *has_escapes = true;
+        p += 2;
+    }
+
+    return NULL;
+}
+
+/*
+ * Locate the value starting at 'p', and store its raw text in 'dst'. Nested
+ * objects and arrays are skipped as a whole. Returns the position after the
+ * value, or NULL if it's malformed.
+ */
+static const char* scan_value(const char* p, const char* end, JsonRaw* dst) {
+    if (p >= end)
+        return NULL;
+
+    const char* start = p;
+
+    if (*p == '"') {
+        bool has_escapes = false;
+        p = find_string_end(p + 1, end, &has_escapes);
+        if (p == NULL)
+            return NULL;
+
+        dst->str         = start + 1;
+        dst->sz          = (size_t)(p - dst->str);
+        dst->is_str      = true;
+        dst->has_escapes = has_escapes;
+        return p + 1;
+    }
+
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        for (; p < end; p++) {
+            if (*p == '"') {
+                bool has_escapes = false;
+                p = find_string_end(p + 1, end, &has_escapes);
+                if (p == NULL)
+                    return NULL;
+            } else if (*p == '{' || *p == '[') {
+                depth++;
+            } else if ((*p == '}' || *p == ']') && --depth == 0) {
+                p++;
+                break;
+            }
+        }
+
+        if (depth != 0)
+            return NULL;
+    } else {
+        /* Numbers and literals end at the next delimiter */
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && !is_ws(*p))
+            p++;
+
+        if (p == start)
+            return NULL;
+    }
+
+    dst->str         = start;
+    dst->sz          = (size_t)(p - start);
+    dst->is_str      = false;
+    dst->has_escapes = false;
+    return p;
+}
+
+/*
+ * Get the member of a post where the value of the specified key is stored, or
+ * NULL if the key is not used.
+ */
+static JsonRaw* post_member(JsonPostRaw* post, const char* key, size_t key_sz) {
+    switch (key_sz) {
+        case 2:
+            if (memcmp(key, "no", 2) == 0)
+                return &post->no;
+            break;
+
+        case 3:
+            if (memcmp(key, "tim", 3) == 0)
+                return &post->tim;
+            if (memcmp(key, "sub", 3) == 0)
+                return &post->sub;
+            if (memcmp(key, "ext", 3) == 0)
+                return &post->ext;
+            if (memcmp(key, "com", 3) == 0)
+                return &post->com;
+            if (memcmp(key, "md5", 3) == 0)
+                return &post->md5;
+            break;
+
+        case 4:
+            if (memcmp(key, "time", 4) == 0)
+                return &post->time;
+            if (memcmp(key, "name", 4) == 0)
+                return &post->name;
+            break;
+
+        case 6:
+            if (memcmp(key, "images", 6) == 0)
+                return &post->images;
+            break;
+
+        case 7:
+            if (memcmp(key, "replies", 7) == 0)
+                return &post->replies;
+            break;
+
+        case 8:
+            if (memcmp(key, "filename", 8) == 0)
+                return &post->filename;
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+ * Locate the members of the post object starting at 'p'. Returns the position
+ * after the object, or NULL if it's malformed.
+ */
+static const char* scan_post(const char* p, const char* end,
+                             JsonPostRaw* dst) {
+    memset(dst, 0, sizeof(JsonPostRaw));
+
+    if (p >= end || *p != '{')
+        return NULL;
+
+    p = skip_ws(p + 1, end);
+    if (p < end && *p == '}')
+        return p + 1;
+
+    while (p < end && *p == '"') {
+        bool has_escapes = false;
+        const char* key  = p + 1;
+        p                = find_string_end(key, end, &has_escapes);
+        if (p == NULL)
+            return NULL;
+
+        const size_t key_sz = (size_t)(p - key);
+        p                   = skip_ws(p + 1, end);
+        if (p >= end || *p != ':')
+            return NULL;
+        p = skip_ws(p + 1, end);
+
+        /* Like cJSON, only the first member with the same key is used */
+        JsonRaw ignored;
+        JsonRaw* member = post_member(dst, key, key_sz);
+        if (member == NULL || member->str != NULL)
+            member = &ignored;
+
+        p = scan_value(p, end, member);
+        if (p == NULL)
+            return NULL;
+
+        p = skip_ws(p, end);
+        if (p < end && *p == '}')
+            return p + 1;
+        if (p >= end || *p != ',')
+            return NULL;
+        p = skip_ws(p + 1, end);
+    }
+
+    return NULL;
+}
+
+bool json_scan_thread(JsonScanner* scanner, const char* json, size_t json_sz) {
+    const char* end = json + json_sz;
+
+    scanner->cur    = end;
+    scanner->end    = end;
+    scanner->failed = false;
+
+    const char* p = skip_ws(json, end);
+    if (p >= end || *p != '{')
+        return false;
+    p = skip_ws(p + 1, end);
+
+    /* Skip the members of the thread until the array of posts */
+    while (p < end && *p == '"') {
+        bool has_escapes = false;
+        const char* key  = p + 1;
+        p                = find_string_end(key, end, &has_escapes);
+        if (p == NULL)
+            return false;
+
+        const bool is_posts =
+          ((size_t)(p - key) == 5 && memcmp(key, "posts", 5) == 0);
+        p = skip_ws(p + 1, end);
+        if (p >= end || *p != ':')
+            return false;
+        p = skip_ws(p + 1, end);
+
+        if (is_posts) {
+            if (p >= end || *p != '[')
+                return false;
+
+            scanner->cur = p + 1;
+            return true;
+        }
+
+        JsonRaw ignored;
+        p = scan_value(p, end, &ignored);
+        if (p == NULL)
+            return false;
+
+        p = skip_ws(p, end);
+        if (p >= end || *p != ',')
+            return false;
+        p = skip_ws(p + 1, end);
+    }
+
+    return false;
+}
+
+bool json_scan_next_post(JsonScanner* scanner, JsonPostRaw* dst) {
+    if (scanner->failed)
+        return false;
+
+    const char* p = skip_ws(scanner->cur, scanner->end);
+    if (p < scanner->end && *p == ']') {
+        scanner->cur = p;
+        return false;
+    }
+
+    p = scan_post(p, scanner->end, dst);
+    if (p == NULL) {
+        scanner->failed = true;
+        return false;
+    }
+
+    p = skip_ws(p, scanner->end);
+    if (p < scanner->end && *p == ',') {
+        p++;
+    } else if (p >= scanner->end || *p != ']') {
+        scanner->failed = true;
+        return false;
+    }
+
+    scanner->cur = p;
+    return true;
+}
+
+bool json_scan_post(JsonPostRaw* dst, const char* json, size_t json_sz) {
+    const char* end = json + json_sz;
+    return scan_post(skip_ws(json, end), end, dst) != NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+
+double json_raw_number(const JsonRaw* raw, double fallback) {
+    if (raw->str == NULL || raw->is_str)
+        return fallback;
+
+    const char* p   = raw->str;
+    const char* end = raw->str + raw->sz;
+
+    const bool negative = (*p == '-');
+    if (negative)
+        p++;
+    if (p >= end || *p < '0' || *p > '9')
+        return fallback;
+
+    /* Integers that a double can represent exactly are the most common case */
+    if (end - p <= 15) {
+        unsigned long long value = 0;
+        const char* digit        = p;
+        while (digit < end && *digit >= '0' && *digit <= '9')
+            value = value * 10 + (unsigned long long)(*digit++ - '0');
+
+        if (digit == end)
+            return negative ? -(double)value : (double)value;
+    }
+
+    /* Other numbers are converted like cJSON does */
+    char tmp[64];
+    if (raw->sz >= sizeof(tmp))
+        return fallback;
+    memcpy(tmp, raw->str, raw->sz);
+    tmp[raw->sz] = '\0';
+
+    char* endptr;
+    const double value = strtod(tmp, &endptr);
+    return (endptr == tmp) ? fallback : value;
+}
+
+/*
+ * Parse the four hexadecimal digits of a '\u' escape sequence. Returns false if
+ * they are not valid.
+ */
+static bool parse_hex4(const char* str, unsigned* dst) {
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++) {
+        const char c = str[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            value |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            value |= (unsigned)(c - 'A' + 10);
+        else
+            return false;
+    }
+
+    *dst = value;
+    return true;
+}
+
+/*
+ * Write the UTF-8 encoding of a code point, returning the position after it.
+ */
+static char* encode_utf8(char* dst, unsigned code) {
+    if (code < 0x80) {
+        *dst++ = (char)code;
+    } else if (code < 0x800) {
+        *dst++ = (char)(0xC0 | (code >> 6));
+        *dst++ = (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        *dst++ = (char)(0xE0 | (code >> 12));
+        *dst++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (code & 0x3F));
+    } else {
+        *dst++ = (char)(0xF0 | (code >> 18));
+        *dst++ = (char)(0x80 | ((code >> 12) & 0x3F));
+        *dst++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (code & 0x3F));
+    }
+
+    return dst;
+}
+
+/*
+ * Decode the '\u' escape sequence at 'p', which might be followed by a second
+ * one for a UTF-16 surrogate pair. Unpaired surrogates can't be encoded as
+ * UTF-8, so they are replaced with U+FFFD instead of failing, and the sequence
+ * after a high surrogate is decoded separately if it's not a low one. Returns
+ * the position after the sequences, or NULL if they are not valid.
+ */
+static const char* decode_utf16(const char* p, const char* end, char** out) {
+    unsigned code;
+    if (end - p < 6 || !parse_hex4(p + 2, &code))
+        return NULL;
+    p += 6;
+
+    if (code >= 0xDC00 && code <= 0xDFFF) {
+        code = 0xFFFD;
+    } else if (code >= 0xD800 && code <= 0xDBFF) {
+        unsigned low;
+        if (end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+            parse_hex4(p + 2, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+            p += 6;
+            code = 0x10000 + (((code & 0x3FF) << 10) | (low & 0x3FF));
+        } else {
+            code = 0xFFFD;
+        }
+    }
+
+    *out = encode_utf8(*out, code);
+    return p;
+}
+
+bool json_raw_string(const char** dst, const JsonRaw* raw, Arena* arena) {
+    *dst = NULL;
+    if (raw->str == NULL || !raw->is_str)
+        return true;
+
+    char* decoded = arena_alloc(arena, raw->sz + 1);
+    if (decoded == NULL)
+        return false;
+
+    if (!raw->has_escapes) {
+        memcpy(decoded, raw->str, raw->sz);
+        decoded[raw->sz] = '\0';
+        *dst             = decoded;
+        return true;
+    }
+
+    const char* p   = raw->str;
+    const char* end = raw->str + raw->sz;
+    char* out       = decoded;
+    while (p < end) {
+        /* The quotes of the raw string are escaped, so only backslashes stop */
+        const size_t plain = find_special(p, (size_t)(end - p));
+        memcpy(out, p, plain);
+        out += plain;
+        p += plain;
+
+        if (p >= end)
+            break;
+        if (end - p < 2)
+            return false;
+
+        switch (p[1]) {
+            case '"':
+            case '\\':
+            case '/':
+                *out++ = p[1];
+                break;
+            case 'b':
+                *out++ = '\b';
+                break;
+            case 'f':
+                *out++ = '\f';
+                break;
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+
+            case 'u':
+                p = decode_utf16(p, end, &out);
+                if (p == NULL)
+                    return false;
+                continue;
+
+            default:
+                return false;
+        }
+
+        p += 2;
+    }
+
+    *out = '\0';
+    *dst = decoded;
+    return true;
+}
+
+bool json_post_decode(Post* dst, const JsonPostRaw* src, Arena* arena) {
+    dst->no      = (PostId)json_raw_number(&src->no, 0);
+    dst->time    = (long long)json_raw_number(&src->time, 0);
+    dst->tim     = (long long)json_raw_number(&src->tim, 0);
+    dst->replies = (int)json_raw_number(&src->replies, -1);
+    dst->images  = (int)json_raw_number(&src->images, -1);
+
+    return json_raw_string(&dst->sub, &src->sub, arena) &&
+           json_raw_string(&dst->name, &src->name, arena) &&
+           json_raw_string(&dst->filename, &src->filename, arena) &&
+           json_raw_string(&dst->ext, &src->ext, arena) &&
+           json_raw_string(&dst->com, &src->com, arena);
+}
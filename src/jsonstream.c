@@ -0,0 +1,137 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "include/jsonstream.h"
+#include "include/buffer.h"
+
+void json_stream_init(JsonStream* stream, int elem_depth,
+                      JsonStreamCallback callback, void* user_data) {
+    stream->elem_depth = elem_depth;
+    stream->callback   = callback;
+    stream->user_data  = user_data;
+    stream->depth      = 0;
+    stream->in_str     = false;
+    stream->escaped    = false;
+    stream->in_elem    = false;
+    stream->elem       = (Buffer)BUFFER_EMPTY;
+    stream->elem_count = 0;
+    stream->failed     = false;
+}
+
+void json_stream_reset(JsonStream* stream) {
+    stream->depth      = 0;
+    stream->in_str     = false;
+    stream->escaped    = false;
+    stream->in_elem    = false;
+    stream->elem_count = 0;
+    stream->failed     = false;
+    buffer_clear(&stream->elem);
+}
+
+void json_stream_free(JsonStream* stream) {
+    buffer_free(&stream->elem);
+}
+
+bool json_stream_feed(JsonStream* stream, const char* data, size_t data_sz) {
+    if (stream->failed)
+        return false;
+
+    /*
+     * Position in 'data' where the text of the current element starts. The
+     * text is copied in a single call when the element ends, or when the chunk
+     * ends.
+     */
+    size_t elem_start = 0;
+
+    for (size_t i = 0; i < data_sz; i++) {
+        const char c = data[i];
+
+        if (stream->in_str) {
+            if (stream->escaped)
+                stream->escaped = false;
+            else if (c == '\\')
+                stream->escaped = true;
+            else if (c == '"')
+                stream->in_str = false;
+            continue;
+        }
+
+        switch (c) {
+            case '"':
+                stream->in_str = true;
+                break;
+
+            case '{':
+            case '[':
+                if (c == '{' && !stream->in_elem &&
+                    stream->depth == stream->elem_depth) {
+                    stream->in_elem = true;
+                    buffer_clear(&stream->elem);
+                    elem_start      = i;
+                }
+                stream->depth++;
+                break;
+
+            case '}':
+            case ']':
+                if (stream->depth <= 0) {
+                    stream->failed = true;
+                    return false;
+                }
+                stream->depth--;
+
+                if (stream->in_elem && stream->depth == stream->elem_depth) {
+                    stream->in_elem = false;
+
+                    const size_t elem_end = i + 1;
+                    if (!buffer_append(&stream->elem,
+                                       &data[elem_start],
+                                       elem_end - elem_start) ||
+                        !stream->callback(stream->user_data,
+                                          stream->elem.data,
+                                          stream->elem.sz)) {
+                        stream->failed = true;
+                        return false;
+                    }
+                    stream->elem_count++;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    /* Store the part of the current element that was received in this chunk */
+    if (stream->in_elem && !buffer_append(&stream->elem,
+                                          &data[elem_start],
+                                          data_sz - elem_start)) {
+        stream->failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool json_stream_finish(const JsonStream* stream) {
+    return !stream->failed && stream->depth == 0 && !stream->in_elem &&
+           !stream->in_str;
+}
@@ -16,10 +16,14 @@
  * this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <ctype.h> /* isalnum */
 #include <stdbool.h>
+#include <stdint.h> /* SIZE_MAX */
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>   /* clock_gettime */
+#include <unistd.h> /* getopt */
 
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
@@ -27,65 +31,2116 @@
 #include "include/main.h"
 #include "include/util.h"
 #include "include/request.h"
+#include "include/cache.h"
+#include "include/fetch.h"
+#include "include/jsonstream.h"
+#include "include/jsonscan.h"
+#include "include/arena.h"
+#include "include/buffer.h"
 #include "include/thread.h"
+#include "include/post.h"
+#include "include/seen.h"
+#include "include/archive.h"
+#include "include/index.h"
+#include "include/replay.h"
+#include "include/ratelimit.h"
+#include "include/stats.h"
 #include "include/pretty.h"
+#include "include/render.h"
+#include "include/pipeline.h"
+#include "include/media.h"
+#include "include/filter.h"
 
-int main(void) {
+/*
+ * Options that can be changed from the command-line.
+ */
+typedef struct {
+    const char* api_url;
+    const char* boards[MAX_BOARDS]; /* Requested in this order */
+    size_t boards_num;
+    size_t jobs;
+    bool use_cache;
+    const char* cache_dir;
+    bool stream;
+    bool latency; /* Print the first posts as soon as possible */
+    unsigned watch_interval; /* Seconds, zero if not watching */
+    bool only_new;
+    bool catalog;                   /* Print the catalog of each board */
+    ThreadId expanded[MAX_THREADS]; /* Printed in full in catalog mode */
+    size_t expanded_num;
+    const char* crawl_path; /* Archive written instead of printing */
+    const char* read_path;  /* Archive printed instead of the board */
+    const char* index_path; /* Full-text index of the archived posts */
+    const char* query;
+    const char* replay_path; /* Responses read instead of the network */
+    const char* capture_dir; /* Responses stored for replaying them */
+    const char* stats_format; /* Latency report printed at exit, or NULL */
+    const char* trace_path;   /* Timings of each request, or NULL */
+    size_t workers; /* Threads for parsing and rendering, or zero */
+    JsonScanImpl parser; /* 'JSON_SCAN_NONE' if cJSON is used */
+    RenderFormat format;
+    bool backlinks;        /* Print the replies of each post */
+    ThreadId subtree_thread; /* Zero if not printing a reply subtree */
+    PostId subtree_post;
+    const char* media_dir; /* Store of the downloaded attachments, or NULL */
+    const char* media_url; /* NULL if not specified */
+    int media_kinds;       /* Zero if not specified */
+    size_t media_jobs;     /* Zero if not specified */
+    const char* filter_path; /* Rules for hiding threads and posts, or NULL */
+    bool verbose;
+} Options;
+
+/*
+ * List of threads that could not be printed, so they can be requested again in
+ * the next poll.
+ */
+typedef struct {
+    ThreadId ids[MAX_THREADS];
+    size_t num;
+} FailedThreads;
+
+/*
+ * Metadata of the threads in the last poll of 'threads.json', sorted by ID.
+ * Used for only requesting the threads that changed since then.
+ */
+typedef struct {
+    ThreadInfo threads[MAX_THREADS];
+    size_t threads_num;
+} WatchState;
+
+/*
+ * State of a single board. All boards share the same connections and output,
+ * but each of them has its own thread list.
+ */
+typedef struct {
+    const char* name;
+    char threads_url[255];
+    WatchState state;
+    FailedThreads failed;
+
+    /* Thread list of the current poll, most recently modified first */
+    ThreadInfo threads[MAX_THREADS];
+    size_t threads_num;
+
+    /* The list was received, even if all of its threads were filtered */
+    bool listed;
+} Board;
+
+/*
+ * Thread of a specific board, requested in the current poll.
+ */
+typedef struct {
+    Board* board;
+    ThreadId id;
+
+    /*
+     * Position of the thread in the output of the poll. Threads might be
+     * requested in a different order, see 'add_updated_threads'.
+     */
+    size_t print_idx;
+} ThreadRef;
+
+/*
+ * Thread that was rendered before some of the threads that are printed before
+ * it, waiting for them.
+ */
+typedef struct {
+    bool done; /* Rendered, or failed and not printed */
+    Board* board;
+    ThreadId id;
+    Buffer out;
+    PostId last_seen, last_rendered;
+} HeldThread;
+
+/*
+ * Context passed to 'on_thread_received' and 'on_thread_rendered' through the
+ * fetching engine and the pipeline, or to 'on_thread_fetched' if the threads
+ * are archived.
+ */
+typedef struct {
+    const Options* opts;
+    const ThreadRef* refs;
+    size_t rendered_num;    /* Number of threads delivered by the pipeline */
+    ArchiveWriter* archive; /* If not NULL, add threads instead of printing */
+    Pipeline* pipeline;     /* If NULL, the threads are archived */
+
+    /* Rendered threads, indexed by 'ThreadRef.print_idx' */
+    HeldThread* held;
+    size_t print_num;  /* Threads that will be printed, including the skipped */
+    size_t next_print; /* Position of the next thread that is printed */
+} ThreadPrintCtx;
+
+/*
+ * Threads of 'ThreadPrintCtx.held', shared by all polls, since only one is in
+ * progress at a time.
+ */
+static HeldThread held_threads[MAX_BOARDS * MAX_THREADS];
+
+/*
+ * Context passed to 'on_catalog_fetched' through the fetching engine.
+ */
+typedef struct {
+    const Options* opts;
+    Board** boards; /* Boards whose catalogs were requested, in order */
+    Buffer out;     /* Used for rendering each thread */
+    bool failed;
+
+    /* Expanded threads found in the catalogs, in order */
+    ThreadRef expanded[MAX_THREADS];
+    size_t expanded_num;
+    bool found[MAX_THREADS]; /* Indexed like 'Options.expanded' */
+} CatalogCtx;
+
+/*
+ * Context passed to 'on_post_received' through the JSON stream.
+ */
+typedef struct {
+    const Options* opts;
+    const Board* board;
+    JsonStream stream;
+    Arena arena; /* Used for each parsed post */
+    Buffer out;  /* Used for rendering each post */
+    PostId op_no;
+    PostId last_seen, last_printed;
+    uint64_t parse_ns, render_ns; /* Time spent in the current thread */
+} PostStreamCtx;
+
+static void print_usage(FILE* fp, const char* self) {
+    fprintf(fp,
+            "Usage: %s [-hCgLsv] [-b BOARDS] [-j JOBS] [-u API_URL] "
+            "[-c CACHE_DIR]\n"
+            "          [-l LIMIT] [-p WORKERS] [-P PARSER] [-w SECONDS] [-d]\n"
+            "          [-o [-x THREADS]] [-R SOURCE | -K CAPTURE_DIR]\n"
+            "          [-f FORMAT] [-F FILTERS] [-S FORMAT] [-T TRACE]\n"
+            "          [-m MEDIA_DIR [-M KIND] [-U MEDIA_URL] [-J JOBS]]\n"
+            "       %s [-b BOARD] [-a ARCHIVE | -r ARCHIVE] [-i INDEX]\n"
+            "       %s [-b BOARD] -i INDEX -q QUERY [-r ARCHIVE]\n"
+            "       %s [-b BOARD] [-R SOURCE] -t THREAD:POST\n"
+            "  -h            Show this help and exit.\n"
+            "  -b BOARDS     Comma-separated list of boards, which are\n"
+            "                requested concurrently and printed in order\n"
+            "                (default: " DEFAULT_BOARD "). Archives only hold\n"
+            "                a single board.\n"
+            "  -j JOBS       Number of concurrent requests (default: %d).\n"
+            "  -u API_URL    Base URL of the API (default: " API_URL ").\n"
+            "  -c CACHE_DIR  Directory of the response cache.\n"
+            "  -C            Disable the response cache.\n"
+            "  -s            Print posts as they are received, one thread at\n"
+            "                a time.\n"
+            "  -L            Print the first posts as soon as possible:\n"
+            "                request the threads of each board as soon as\n"
+            "                its thread list is received, and print each\n"
+            "                thread as soon as the previous one is printed,\n"
+            "                receiving at most JOBS threads ahead.\n"
+            "  -l [HOST=]RATE[:BURST]\n"
+            "                Make at most RATE requests per second to HOST,\n"
+            "                or to any host, with at most BURST requests at\n"
+            "                once. Zero disables the limit (default: %g).\n"
+            "  -p WORKERS    Number of threads used for parsing and rendering\n"
+            "                the received threads (default: one for each\n"
+            "                processor). With 0, the main thread is used.\n"
+            "  -P PARSER     Parser used for the threads: 'scan' locates the\n"
+            "                fields of each post without building a tree, and\n"
+            "                'cjson' parses the whole thread (default: scan).\n"
+            "                The implementation of 'scan' can be forced with\n"
+            "                'scalar', 'sse2' or 'avx2'.\n"
+            "  -w SECONDS    Keep polling the thread list every SECONDS, and\n"
+            "                print the threads that changed since the last\n"
+            "                poll.\n"
+            "  -d            Only print the posts that are newer than the\n"
+            "                last printed post of each thread, even across\n"
+            "                runs.\n"
+            "  -o            Print an overview of each board from its\n"
+            "                catalog, with a single request: the first post\n"
+            "                and the last replies of each thread.\n"
+            "  -x THREADS    Comma-separated list of threads that are printed\n"
+            "                in full after the overview, instead of in it.\n"
+            "  -f FORMAT     Format of the printed posts: 'pretty', or one\n"
+            "                line per post, as 'ndjson' or 'tsv' (default:\n"
+            "                pretty).\n"
+            "  -g            Print the numbers of the replies to each post\n"
+            "                below it.\n"
+            "  -t THREAD:POST\n"
+            "                Print POST of THREAD, followed by the posts that\n"
+            "                reply to it, directly or through other replies.\n"
+            "  -m MEDIA_DIR  Download the attachments of the printed threads\n"
+            "                into a store named after their MD5, so each\n"
+            "                file is only downloaded once.\n"
+            "  -M KIND       Attachments that are downloaded: 'files',\n"
+            "                'thumbs' or 'both' (default: files).\n"
+            "  -U MEDIA_URL  Base URL of the attachments (default:\n"
+            "                " MEDIA_URL ").\n"
+            "  -J JOBS       Number of concurrent downloads (default: %d).\n",
+            self,
+            self,
+            self,
+            self,
+            DEFAULT_JOBS,
+            RATELIMIT_DEFAULT_RATE,
+            DEFAULT_MEDIA_JOBS);
+
+    /* Split, since C99 compilers don't need to support longer strings */
+    fputs("  -F FILTERS    Hide the threads and posts that match the rules\n"
+          "                of a file, one per line: 'hide' or 'only', a\n"
+          "                field ('sub', 'com', 'filename' or 'any') and a\n"
+          "                keyword or a /regex/. Filtered threads are not\n"
+          "                requested.\n"
+          "  -a ARCHIVE    Store all threads in an archive file, instead of\n"
+          "                printing them.\n"
+          "  -r ARCHIVE    Print the threads of an archive file, instead of\n"
+          "                requesting them.\n"
+          "  -i INDEX      Add the posts of the archive to a full-text\n"
+          "                index, instead of printing them.\n"
+          "  -q QUERY      Search the posts that contain all the words of\n"
+          "                QUERY in the index. Double-quoted words must\n"
+          "                appear consecutively. The matching posts are\n"
+          "                printed from the archive, if specified.\n"
+          "  -R SOURCE     Read the responses from a directory or tarball\n"
+          "                of captured responses, instead of the network.\n"
+          "  -K CAPTURE_DIR\n"
+          "                Store the received responses in a directory, so\n"
+          "                they can be replayed with '-R'.\n"
+          "  -S FORMAT     Print the number of requests and the latency\n"
+          "                of each stage when done, as 'text' or 'json'.\n"
+          "  -T TRACE      Write the timings of each request to a file,\n"
+          "                one JSON object per line.\n"
+          "  -v            Print memory statistics when done, and the\n"
+          "                number of downloaded attachments after each\n"
+          "                poll.\n",
+          fp);
+}
+
+/*
+ * Add the boards of a comma-separated list to the options. The list is
+ * modified. Returns false if a name is not valid, or if there are too many
+ * boards.
+ */
+static bool parse_boards(Options* opts, char* list) {
+    for (char* name = strtok(list, ","); name != NULL;
+         name = strtok(NULL, ",")) {
+        const size_t len = strlen(name);
+        bool valid       = (len <= MAX_BOARD_LEN);
+        for (size_t i = 0; valid && i < len; i++)
+            valid = isalnum((unsigned char)name[i]);
+
+        if (!valid) {
+            ERR("Invalid board name: '%s'.", name);
+            return false;
+        }
+
+        /* Each board is only requested once, ignore repeated names */
+        bool repeated = false;
+        for (size_t i = 0; !repeated && i < opts->boards_num; i++)
+            repeated = (strcmp(opts->boards[i], name) == 0);
+        if (repeated)
+            continue;
+
+        if (opts->boards_num >= MAX_BOARDS) {
+            ERR("Too many boards, the maximum is %d.", MAX_BOARDS);
+            return false;
+        }
+        opts->boards[opts->boards_num++] = name;
+    }
+
+    return true;
+}
+
+/*
+ * Add the threads of a comma-separated list of IDs to the ones expanded in
+ * catalog mode. The list is modified. Returns false if an ID is not valid, or
+ * if there are too many threads.
+ */
+static bool parse_expanded(Options* opts, char* list) {
+    for (char* str = strtok(list, ","); str != NULL; str = strtok(NULL, ",")) {
+        char* endptr;
+        const unsigned long id = strtoul(str, &endptr, 10);
+        if (*endptr != '\0' || id == 0) {
+            ERR("Invalid thread ID: '%s'.", str);
+            return false;
+        }
+
+        /* Each thread is only requested once, ignore repeated IDs */
+        bool repeated = false;
+        for (size_t i = 0; !repeated && i < opts->expanded_num; i++)
+            repeated = (opts->expanded[i] == id);
+        if (repeated)
+            continue;
+
+        if (opts->expanded_num >= MAX_THREADS) {
+            ERR("Too many expanded threads, the maximum is %d.", MAX_THREADS);
+            return false;
+        }
+        opts->expanded[opts->expanded_num++] = (ThreadId)id;
+    }
+
+    return true;
+}
+
+/*
+ * Parse the thread and post of the reply subtree, in the "THREAD:POST" format.
+ * Returns false if it's not valid.
+ */
+static bool parse_subtree(Options* opts, const char* str) {
+    char* endptr;
+    const unsigned long thread = strtoul(str, &endptr, 10);
+    if (thread == 0 || *endptr != ':') {
+        ERR("Invalid reply subtree, expected THREAD:POST: '%s'.", str);
+        return false;
+    }
+
+    const unsigned long post = strtoul(endptr + 1, &endptr, 10);
+    if (post == 0 || *endptr != '\0') {
+        ERR("Invalid reply subtree, expected THREAD:POST: '%s'.", str);
+        return false;
+    }
+
+    opts->subtree_thread = (ThreadId)thread;
+    opts->subtree_post   = (PostId)post;
+    return true;
+}
+
+/*
+ * Parse the kinds of attachments that are downloaded: "files", "thumbs" or
+ * "both". Returns false if it's not valid.
+ */
+static bool parse_media_kinds(Options* opts, const char* str) {
+    if (strcmp(str, "files") == 0)
+        opts->media_kinds = MEDIA_FILES;
+    else if (strcmp(str, "thumbs") == 0)
+        opts->media_kinds = MEDIA_THUMBS;
+    else if (strcmp(str, "both") == 0)
+        opts->media_kinds = MEDIA_FILES | MEDIA_THUMBS;
+    else
+        return false;
+
+    return true;
+}
+
+/*
+ * Get the default number of pipeline workers: one for each processor.
+ */
+static size_t default_workers(void) {
+    const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return (processors > 0) ? (size_t)processors : 1;
+}
+
+static bool parse_options(Options* opts, int argc, char** argv) {
+    opts->api_url    = API_URL;
+    opts->boards_num = 0;
+    opts->jobs       = DEFAULT_JOBS;
+    opts->use_cache  = true;
+    opts->cache_dir  = NULL;
+    opts->stream         = false;
+    opts->latency        = false;
+    opts->watch_interval = 0;
+    opts->only_new       = false;
+    opts->catalog        = false;
+    opts->expanded_num   = 0;
+    opts->crawl_path     = NULL;
+    opts->read_path      = NULL;
+    opts->index_path     = NULL;
+    opts->query          = NULL;
+    opts->replay_path    = NULL;
+    opts->capture_dir    = NULL;
+    opts->stats_format   = NULL;
+    opts->trace_path     = NULL;
+    opts->workers        = default_workers();
+    opts->parser         = json_scan_best();
+    opts->format         = RENDER_PRETTY;
+    opts->backlinks      = false;
+    opts->subtree_thread = 0;
+    opts->subtree_post   = 0;
+    opts->media_dir      = NULL;
+    opts->media_url      = NULL;
+    opts->media_kinds    = 0;
+    opts->media_jobs     = 0;
+    opts->filter_path    = NULL;
+    opts->verbose        = false;
+
+    int opt;
+    while ((opt = getopt(argc,
+                         argv,
+                         "hb:j:u:c:CsLl:p:P:w:dox:f:gt:m:M:U:J:F:a:r:i:q:R:K:S:"
+                         "T:v")) != -1) {
+        switch (opt) {
+            case 'h':
+                print_usage(stdout, argv[0]);
+                exit(EXIT_SUCCESS);
+
+            case 'b':
+                if (!parse_boards(opts, optarg))
+                    return false;
+                break;
+
+            case 'j': {
+                char* endptr;
+                const long jobs = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || jobs <= 0) {
+                    ERR("Invalid number of jobs: '%s'.", optarg);
+                    return false;
+                }
+                opts->jobs = (size_t)jobs;
+            } break;
+
+            case 'u':
+                opts->api_url = optarg;
+                break;
+
+            case 'c':
+                opts->cache_dir = optarg;
+                break;
+
+            case 'C':
+                opts->use_cache = false;
+                break;
+
+            case 's':
+                opts->stream = true;
+                break;
+
+            case 'L':
+                opts->latency = true;
+                break;
+
+            case 'l':
+                if (!ratelimit_parse(optarg)) {
+                    ERR("Invalid rate limit: '%s'.", optarg);
+                    return false;
+                }
+                break;
+
+            case 'p': {
+                char* endptr;
+                const long workers = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || workers < 0 || workers > 256) {
+                    ERR("Invalid number of workers: '%s'.", optarg);
+                    return false;
+                }
+                opts->workers = (size_t)workers;
+            } break;
+
+            case 'P':
+                if (strcmp(optarg, "scan") == 0) {
+                    opts->parser = json_scan_best();
+                } else if (strcmp(optarg, "cjson") == 0) {
+                    opts->parser = JSON_SCAN_NONE;
+                } else if (strcmp(optarg, "scalar") == 0) {
+                    opts->parser = JSON_SCAN_SCALAR;
+                } else if (strcmp(optarg, "sse2") == 0) {
+                    opts->parser = JSON_SCAN_SSE2;
+                } else if (strcmp(optarg, "avx2") == 0) {
+                    opts->parser = JSON_SCAN_AVX2;
+                } else {
+                    ERR("Invalid parser: '%s'.", optarg);
+                    return false;
+                }
+                break;
+
+            case 'w': {
+                char* endptr;
+                const long interval = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || interval <= 0 || interval > 86400) {
+                    ERR("Invalid watch interval: '%s'.", optarg);
+                    return false;
+                }
+                opts->watch_interval = (unsigned)interval;
+            } break;
+
+            case 'd':
+                opts->only_new = true;
+                break;
+
+            case 'o':
+                opts->catalog = true;
+                break;
+
+            case 'x':
+                if (!parse_expanded(opts, optarg))
+                    return false;
+                break;
+
+            case 'f':
+                if (!render_format_from_name(optarg, &opts->format)) {
+                    ERR("Invalid output format: '%s'.", optarg);
+                    return false;
+                }
+                break;
+
+            case 'g':
+                opts->backlinks = true;
+                break;
+
+            case 't':
+                if (!parse_subtree(opts, optarg))
+                    return false;
+                break;
+
+            case 'm':
+                opts->media_dir = optarg;
+                break;
+
+            case 'M':
+                if (!parse_media_kinds(opts, optarg)) {
+                    ERR("Invalid kind of attachments: '%s'.", optarg);
+                    return false;
+                }
+                break;
+
+            case 'U':
+                opts->media_url = optarg;
+                break;
+
+            case 'J': {
+                char* endptr;
+                const long jobs = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || jobs <= 0) {
+                    ERR("Invalid number of downloads: '%s'.", optarg);
+                    return false;
+                }
+                opts->media_jobs = (size_t)jobs;
+            } break;
+
+            case 'F':
+                opts->filter_path = optarg;
+                break;
+
+            case 'a':
+                opts->crawl_path = optarg;
+                break;
+
+            case 'r':
+                opts->read_path = optarg;
+                break;
+
+            case 'i':
+                opts->index_path = optarg;
+                break;
+
+            case 'q':
+                opts->query = optarg;
+                break;
+
+            case 'R':
+                opts->replay_path = optarg;
+                break;
+
+            case 'K':
+                opts->capture_dir = optarg;
+                break;
+
+            case 'S':
+                if (strcmp(optarg, "text") != 0 &&
+                    strcmp(optarg, "json") != 0) {
+                    ERR("Invalid statistics format: '%s'.", optarg);
+                    return false;
+                }
+                opts->stats_format = optarg;
+                break;
+
+            case 'T':
+                opts->trace_path = optarg;
+                break;
+
+            case 'v':
+                opts->verbose = true;
+                break;
+
+            default:
+                print_usage(stderr, argv[0]);
+                return false;
+        }
+    }
+
+    if (opts->boards_num == 0)
+        opts->boards[opts->boards_num++] = DEFAULT_BOARD;
+
+    if (opts->crawl_path != NULL &&
+        (opts->stream || opts->watch_interval != 0 || opts->only_new)) {
+        ERR("Option '-a' can't be combined with '-s', '-w' or '-d'.");
+        return false;
+    }
+
+    if (opts->catalog && (opts->crawl_path != NULL || opts->only_new)) {
+        ERR("Option '-o' can't be combined with '-a' or '-d'.");
+        return false;
+    }
+
+    if (opts->expanded_num > 0 && !opts->catalog) {
+        ERR("Option '-x' can only be used with '-o'.");
+        return false;
+    }
+
+    if (opts->latency &&
+        (opts->stream || opts->catalog || opts->crawl_path != NULL)) {
+        ERR("Option '-L' can't be combined with '-s', '-o' or '-a'.");
+        return false;
+    }
+
+    /* Posts are printed before their replies are received */
+    if (opts->backlinks && opts->stream) {
+        ERR("Option '-g' can't be combined with '-s'.");
+        return false;
+    }
+
+    if (opts->backlinks && opts->format != RENDER_PRETTY) {
+        ERR("Option '-g' can only be used with the 'pretty' format.");
+        return false;
+    }
+
+    if (opts->subtree_thread != 0 &&
+        (opts->stream || opts->watch_interval != 0 || opts->only_new ||
+         opts->catalog || opts->crawl_path != NULL ||
+         opts->read_path != NULL || opts->query != NULL)) {
+        ERR("Option '-t' can't be combined with '-s', '-w', '-d', '-o', '-a', "
+            "'-r' or '-q'.");
+        return false;
+    }
+
+    if (opts->subtree_thread != 0 && opts->boards_num > 1) {
+        ERR("Option '-t' can only be used with a single board.");
+        return false;
+    }
+
+    if (opts->media_dir == NULL &&
+        (opts->media_url != NULL || opts->media_kinds != 0 ||
+         opts->media_jobs != 0)) {
+        ERR("Options '-M', '-U' and '-J' can only be used with '-m'.");
+        return false;
+    }
+
+    /* Attachments are found in the threads that are printed in full */
+    if (opts->media_dir != NULL &&
+        (opts->stream || opts->catalog || opts->crawl_path != NULL ||
+         opts->subtree_thread != 0 || opts->read_path != NULL ||
+         opts->query != NULL || opts->replay_path != NULL)) {
+        ERR("Option '-m' can't be combined with '-s', '-o', '-a', '-t', '-r', "
+            "'-q' or '-R'.");
+        return false;
+    }
+
+    /* Archives don't store the board of each thread */
+    if (opts->crawl_path != NULL && opts->boards_num > 1) {
+        ERR("Option '-a' can only be used with a single board.");
+        return false;
+    }
+
+    if (opts->replay_path != NULL && opts->capture_dir != NULL) {
+        ERR("Options '-R' and '-K' can't be combined.");
+        return false;
+    }
+
+    if (opts->query != NULL && opts->index_path == NULL) {
+        ERR("Option '-q' needs an index, specified with '-i'.");
+        return false;
+    }
+
+    if (opts->index_path != NULL && opts->query == NULL &&
+        opts->crawl_path == NULL && opts->read_path == NULL) {
+        ERR("Option '-i' needs an archive ('-a' or '-r') or a query ('-q').");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Write the URL of the JSON of the specified thread of a board. Returns false
+ * if it didn't fit.
+ */
+static bool thread_url(char* dst, size_t dst_sz, const Options* opts,
+                       const char* board, ThreadId id) {
+    const int written =
+      snprintf(dst, dst_sz, "%s/%s/thread/%lu.json", opts->api_url, board, id);
+    return written > 0 && (size_t)written < dst_sz;
+}
+
+/*
+ * Write rendered text to the standard output, accounting for it in the latency
+ * statistics. In latency mode, the output is flushed right away, so it's shown
+ * even if the standard output is not line-buffered.
+ */
+static void write_output(const Options* opts, const char* data, size_t sz) {
+    fwrite(data, 1, sz, stdout);
+    if (opts->latency)
+        fflush(stdout);
+
+    stats_record_output(data, sz);
+}
+
+/*
+ * Board of the last printed header, reset in each poll. See
+ * 'print_board_header'.
+ */
+static const Board* header_board = NULL;
+
+/*
+ * Print the name of a board before its first printed thread, if more than one
+ * board was requested, so the output of each board is grouped under its name.
+ * Must be called right before printing the contents of a thread.
+ */
+static void print_board_header(const Options* opts, const Board* board) {
+    const Renderer* renderer = render_current();
+    if (opts->boards_num <= 1 || board == header_board ||
+        renderer->board_header == NULL)
+        return;
+
+    static Buffer out = BUFFER_EMPTY;
+    buffer_clear(&out);
+    renderer->board_header(&out, board->name);
+    write_output(opts, out.data, out.sz);
+    header_board = board;
+}
+
+/*
+ * Remember that a thread could not be printed, so it's requested again in the
+ * next poll of its board.
+ */
+static void mark_failed(const ThreadRef* ref) {
+    FailedThreads* failed = &ref->board->failed;
+    failed->ids[failed->num++] = ref->id;
+}
+
+/*
+ * Called by the fetching engine, in order, whenever a thread is received, if
+ * the threads are archived instead of printing them.
+ */
+static void on_thread_fetched(void* user_data, size_t idx, cJSON* thread) {
+    ThreadPrintCtx* ctx  = user_data;
+    const ThreadRef* ref = &ctx->refs[idx];
+
+    if (thread != NULL &&
+        archive_writer_add_thread(ctx->archive, ref->id, thread))
+        return;
+
+    ERR("Could not archive thread with ID %lu.", ref->id);
+    mark_failed(ref);
+}
+
+/*
+ * Called by the JSON stream for each post of a thread, as soon as it's
+ * received.
+ */
+static bool on_post_received(void* user_data, const char* post_str,
+                             size_t post_sz) {
+    PostStreamCtx* ctx = user_data;
+
+    /* The previous post is no longer needed */
+    arena_reset(&ctx->arena);
+
+    const uint64_t parse_start = stats_enabled() ? stats_now_ns() : 0;
+    Post post;
+    bool parsed;
+    if (json_scan_enabled()) {
+        JsonPostRaw raw;
+        parsed = json_scan_post(&raw, post_str, post_sz) &&
+                 json_post_decode(&post, &raw, &ctx->arena);
+    } else {
+        cJSON* post_json = arena_parse_json(&ctx->arena, post_str, post_sz);
+        parsed = post_json != NULL && post_from_json(&post, post_json);
+    }
+
+    if (!parsed) {
+        ERR("Could not parse post as JSON.");
+        return false;
+    }
+
+    const uint64_t render_start = stats_enabled() ? stats_now_ns() : 0;
+    ctx->parse_ns += render_start - parse_start;
+
+    const PostId no = post.no;
+
+    const bool is_op = (ctx->stream.elem_count == 0);
+    if (is_op)
+        ctx->op_no = no;
+
+    /* Skip the posts that were already printed in a previous run */
+    if (ctx->last_seen != 0 && no <= ctx->last_seen)
+        return true;
+
+    if (filter_post_hidden(&post))
+        return true;
+
+    const Renderer* renderer = render_current();
+    buffer_clear(&ctx->out);
+    if (!is_op && ctx->last_printed == 0 && ctx->last_seen != 0 &&
+        renderer->new_replies_header != NULL)
+        renderer->new_replies_header(&ctx->out, ctx->op_no);
+    renderer->post(&ctx->out,
+                   &post,
+                   NULL,
+                   ctx->board->name,
+                   ctx->op_no,
+                   !is_op);
+    ctx->last_printed = no;
+
+    /* Make the post visible even if the output is not line-buffered */
+    print_board_header(ctx->opts, ctx->board);
+    write_output(ctx->opts, ctx->out.data, ctx->out.sz);
+    fflush(stdout);
+
+    if (stats_enabled())
+        ctx->render_ns += stats_now_ns() - render_start;
+    return true;
+}
+
+/*
+ * Request and print each thread, one at a time. Each post is printed as soon as
+ * it's received, instead of waiting for the whole thread.
+ */
+static bool stream_threads(CURL* curl, const Options* opts,
+                           const ThreadRef* refs, size_t refs_num) {
+    PostStreamCtx ctx = {
+        .opts  = opts,
+        .arena = ARENA_EMPTY,
+        .out   = BUFFER_EMPTY,
+    };
+
+    /* The posts are the objects inside the "posts" array */
+    json_stream_init(&ctx.stream, 2, on_post_received, &ctx);
+
+    for (size_t i = 0; i < refs_num; i++) {
+        const ThreadRef* ref = &refs[i];
+        const char* board    = ref->board->name;
+
+        static char cur_thread_url[255] = { '\0' };
+        if (!thread_url(cur_thread_url,
+                        sizeof(cur_thread_url),
+                        opts,
+                        board,
+                        ref->id))
+            continue;
+
+        ctx.board        = ref->board;
+        ctx.op_no        = 0;
+        ctx.last_seen    = seen_enabled() ? seen_get(board, ref->id) : 0;
+        ctx.last_printed = 0;
+        ctx.parse_ns     = 0;
+        ctx.render_ns    = 0;
+
+        json_stream_reset(&ctx.stream);
+        if (!request_stream_from_url(curl, cur_thread_url, &ctx.stream)) {
+            ERR("Could not print contents of thread with ID %lu.", ref->id);
+            mark_failed(ref);
+        }
+
+        /* Even if the request failed, some posts might have been printed */
+        if (ctx.last_printed > ctx.last_seen && seen_enabled())
+            seen_set(board, ref->id, ctx.last_printed);
+
+        /* Posts are parsed and rendered separately, measure whole threads */
+        stats_record(STATS_PARSE, ctx.parse_ns);
+        stats_record(STATS_RENDER, ctx.render_ns);
+    }
+
+    json_stream_free(&ctx.stream);
+    buffer_free(&ctx.out);
+    arena_free(&ctx.arena);
+    return true;
+}
+
+/*
+ * Called by the fetching engine, in order, whenever a thread is received, if a
+ * pipeline is used. The response is moved to a job of the pipeline, without
+ * parsing it.
+ */
+static void on_thread_received(void* user_data, size_t idx, Request* req) {
+    ThreadPrintCtx* ctx  = user_data;
+    const ThreadRef* ref = &ctx->refs[idx];
+
+    PipelineJob* job = pipeline_next_job(ctx->pipeline);
+    job->board       = ref->board->name;
+    job->id          = ref->id;
+    job->last_seen   = seen_enabled() ? seen_get(job->board, job->id) : 0;
+
+    /* Swap the buffers, the request reuses the previous one of the job */
+    if (req != NULL) {
+        const Buffer body = job->body;
+        job->body         = req->buffer;
+        req->buffer       = body;
+        job->status       = req->status;
+        job->validators   = req->validators;
+    }
+
+    pipeline_submit(ctx->pipeline);
+
+    /* Print the threads that are ready while the rest are received */
+    pipeline_flush(ctx->pipeline);
+}
+
+/*
+ * Print the rendered posts of a thread, and remember the last one.
+ */
+static void print_rendered(const Options* opts, Board* board, ThreadId id,
+                           const Buffer* out, PostId last_seen,
+                           PostId last_rendered) {
+    if (out->sz > 0) {
+        print_board_header(opts, board);
+        write_output(opts, out->data, out->sz);
+    }
+
+    if (last_rendered > last_seen && seen_enabled())
+        seen_set(board->name, id, last_rendered);
+}
+
+/*
+ * Print the held threads that are next in the output, in order. If 'skip_gaps'
+ * is true, the threads that were not rendered are skipped instead of waiting
+ * for them, which is used once no more threads will be rendered.
+ */
+static void print_held_threads(ThreadPrintCtx* ctx, bool skip_gaps) {
+    for (; ctx->next_print < ctx->print_num; ctx->next_print++) {
+        HeldThread* held = &ctx->held[ctx->next_print];
+        if (!held->done && !skip_gaps)
+            break;
+
+        if (held->done)
+            print_rendered(ctx->opts,
+                           held->board,
+                           held->id,
+                           &held->out,
+                           held->last_seen,
+                           held->last_rendered);
+
+        /* Most threads are printed without being held, free the rest */
+        buffer_free(&held->out);
+        held->done = false;
+    }
+}
+
+/*
+ * Remember that the thread with the specified position in the output was
+ * skipped, so the threads after it don't wait for it.
+ */
+static void skip_held_thread(ThreadPrintCtx* ctx, size_t print_idx) {
+    if (ctx->held == NULL)
+        return;
+
+    ctx->held[print_idx].done  = true;
+    ctx->held[print_idx].board = NULL;
+    print_held_threads(ctx, false);
+}
+
+/*
+ * Called by the pipeline, in order, whenever a thread is rendered.
+ */
+static void on_thread_rendered(void* user_data, PipelineJob* job) {
+    ThreadPrintCtx* ctx = user_data;
+
+    /* Jobs are delivered in the same order as the received threads */
+    const ThreadRef* ref = &ctx->refs[ctx->rendered_num++];
+
+    if (!job->ok) {
+        ERR("Could not print contents of thread with ID %lu.", job->id);
+        mark_failed(ref);
+        skip_held_thread(ctx, ref->print_idx);
+        return;
+    }
+
+    /* The response could be parsed, so it can be cached */
+    static char url[255] = { '\0' };
+    if (thread_url(url, sizeof(url), ctx->opts, job->board, job->id))
+        request_store(url,
+                      job->status,
+                      &job->validators,
+                      job->body.data,
+                      job->body.sz);
+
+    /*
+     * Threads are printed in the order of their thread list, even if they were
+     * requested in a different one, so a thread rendered before the ones that
+     * go before it is held until they are printed.
+     */
+    if (ref->print_idx == ctx->next_print) {
+        print_rendered(ctx->opts,
+                       ref->board,
+                       job->id,
+                       &job->out,
+                       job->last_seen,
+                       job->last_rendered);
+        ctx->next_print++;
+        print_held_threads(ctx, false);
+    } else {
+        HeldThread* held    = &ctx->held[ref->print_idx];
+        const Buffer out    = held->out;
+        held->out           = job->out;
+        job->out            = out;
+        held->done          = true;
+        held->board         = ref->board;
+        held->id            = job->id;
+        held->last_seen     = job->last_seen;
+        held->last_rendered = job->last_rendered;
+    }
+
+    /* The attachments are downloaded after the threads of the poll */
+    if (media_enabled() &&
+        !media_add_thread(job->board, job->body.data, job->body.sz))
+        ERR("Could not get the attachments of thread with ID %lu.", job->id);
+}
+
+/*
+ * Request the specified threads concurrently, and print their contents in the
+ * original order. Unless they are archived, they are parsed and rendered by a
+ * pipeline, on worker threads if enabled, while the rest are received.
+ */
+static bool fetch_threads(const Options* opts, ThreadRef* refs,
+                          size_t refs_num, ArchiveWriter* archive) {
+    bool result = true;
+
+    ThreadPrintCtx ctx = {
+        .opts         = opts,
+        .refs         = refs,
+        .rendered_num = 0,
+        .archive      = archive,
+        .pipeline     = NULL,
+        .held         = (archive == NULL) ? held_threads : NULL,
+        .print_num    = refs_num,
+        .next_print   = 0,
+    };
+
+    FetchEngine* engine;
+    if (archive == NULL) {
+        ctx.pipeline = pipeline_new(opts->workers, on_thread_rendered, &ctx);
+        if (ctx.pipeline == NULL)
+            return false;
+
+        engine = fetch_engine_new_raw(opts->jobs, on_thread_received, &ctx);
+    } else {
+        engine = fetch_engine_new(opts->jobs, on_thread_fetched, &ctx);
+    }
+
+    if (engine == NULL) {
+        pipeline_free(ctx.pipeline);
+        return false;
+    }
+
+    for (size_t i = 0; i < refs_num; i++) {
+        const ThreadRef cur_ref = refs[i];
+
+        static char cur_thread_url[255] = { '\0' };
+        if (!thread_url(cur_thread_url,
+                        sizeof(cur_thread_url),
+                        opts,
+                        cur_ref.board->name,
+                        cur_ref.id)) {
+            skip_held_thread(&ctx, cur_ref.print_idx);
+            continue;
+        }
+
+        const long idx = fetch_engine_add(engine, cur_thread_url);
+        if (idx < 0) {
+            result = false;
+            goto done;
+        }
+
+        /*
+         * Skipped threads are never added, so move the current one to the
+         * index that the engine will pass to the callback. This never
+         * overwrites a thread that hasn't been read yet.
+         */
+        refs[idx] = cur_ref;
+    }
+
+    if (!fetch_engine_run(engine))
+        result = false;
+
+    if (ctx.pipeline != NULL)
+        pipeline_finish(ctx.pipeline);
+
+done:
+    fetch_engine_free(engine);
+    pipeline_free(ctx.pipeline);
+
+    /* After a failure, some threads might never be rendered */
+    if (ctx.held != NULL)
+        print_held_threads(&ctx, true);
+    return result;
+}
+
+/*
+ * Remove the threads whose OP is filtered from the thread list of a board,
+ * parsed from its catalog, so they are never requested. The threads that are
+ * kept don't change their order.
+ */
+static void remove_filtered_threads(Board* board, cJSON* catalog) {
+    if (!filter_enabled() || board->threads_num <= 0)
+        return;
+
+    /* The thread list has the threads of the catalog, in the same order */
+    size_t pos = 0, kept = 0;
+    cJSON* page;
+    cJSON_ArrayForEach(page, catalog) {
+        cJSON* threads = cJSON_GetObjectItemCaseSensitive(page, "threads");
+        cJSON* thread;
+        cJSON_ArrayForEach(thread, threads) {
+            if (pos >= board->threads_num)
+                break;
+
+            Post op;
+            if (!post_from_json(&op, thread) || filter_thread_shown(&op))
+                board->threads[kept++] = board->threads[pos];
+            pos++;
+        }
+    }
+
+    board->threads_num = kept;
+}
+
+/*
+ * Called by the fetching engine, in order, whenever the thread list of a board
+ * is received. The user data is the list of boards whose thread lists were
+ * requested, in the same order.
+ */
+static void on_thread_list_fetched(void* user_data, size_t idx, cJSON* json) {
+    Board** boards = user_data;
+    Board* board   = boards[idx];
+
+    board->threads_num =
+      (json == NULL)
+        ? 0
+        : threads_from_json(board->threads, ARRLEN(board->threads), json);
+
+    board->listed = (board->threads_num > 0);
+    if (!board->listed) {
+        ERR("Could not get the thread list of board '%s'.", board->name);
+        return;
+    }
+
+    remove_filtered_threads(board, json);
+}
+
+/*
+ * Add the threads of a board that are new or were modified since the previous
+ * poll to the specified list, in the order they should be requested. Their
+ * positions in the output follow the thread list, starting at 'print_base'. If
+ * 'by_priority' is true, they are requested most recently modified first, so
+ * the most active threads are received first when the requests are paced. The
+ * board must have a thread list. Returns the number of added threads.
+ */
+static size_t add_updated_threads(const Options* opts, Board* board,
+                                  ThreadRef* refs, size_t print_base,
+                                  bool by_priority) {
+    /*
+     * The updated threads are printed in the order of the thread list, which
+     * is the order of 'board->threads' until it's sorted. A thread that is not
+     * updated has no position in the output.
+     */
+    size_t print_order[MAX_THREADS];
+    size_t updated_num = 0;
+    for (size_t j = 0; j < board->threads_num; j++) {
+        const bool updated = thread_is_updated(board->state.threads,
+                                               board->state.threads_num,
+                                               &board->threads[j]);
+        print_order[board->threads[j].position] =
+          updated ? updated_num++ : SIZE_MAX;
+    }
+
+    if (by_priority)
+        threads_sort_by_priority(board->threads, board->threads_num);
+
+    ThreadRef* ref = refs;
+    for (size_t j = 0; j < board->threads_num; j++) {
+        const size_t order = print_order[board->threads[j].position];
+        if (order == SIZE_MAX)
+            continue;
+
+        ref->board     = board;
+        ref->id        = board->threads[j].id;
+        ref->print_idx = print_base + order;
+        ref++;
+    }
+
+    if (opts->verbose)
+        fprintf(stderr,
+                COL_INFO "Poll:" COL_NORM " /%s/: %zu threads, %zu updated.\n",
+                board->name,
+                board->threads_num,
+                updated_num);
+
+    board->failed.num = 0;
+    return updated_num;
+}
+
+/*
+ * Context passed to 'on_early_response' through the fetching engine.
+ */
+typedef struct {
+    FetchEngine* engine;
+    Board** boards;
+    size_t boards_num;
+    size_t lists_num; /* Thread lists received so far */
+    size_t list_idx;  /* Engine index of the pending thread list */
+    bool failed;
+    Arena arena; /* Used for parsing each thread list */
+
+    /* Threads requested after each thread list, in order */
+    ThreadRef* refs;
+    size_t refs_num;
+
+    ThreadPrintCtx print; /* Used for the threads, see 'on_thread_received' */
+} EarlyFetchCtx;
+
+/*
+ * Request the thread list of the next board, if any.
+ */
+static void request_next_list(EarlyFetchCtx* ctx) {
+    if (ctx->lists_num >= ctx->boards_num)
+        return;
+
+    const long added_idx =
+      fetch_engine_add(ctx->engine, ctx->boards[ctx->lists_num]->threads_url);
+    if (added_idx < 0) {
+        ctx->failed = true;
+        return;
+    }
+
+    ctx->list_idx = (size_t)added_idx;
+}
+
+/*
+ * Called by the fetching engine, in order, for each response of
+ * 'fetch_boards_early'. When the thread list of a board is received, its
+ * updated threads are requested, followed by the thread list of the next board.
+ */
+static void on_early_response(void* user_data, size_t idx, Request* req) {
+    EarlyFetchCtx* ctx = user_data;
+    if (ctx->lists_num >= ctx->boards_num || idx != ctx->list_idx) {
+        /* The lists before this thread have been received */
+        on_thread_received(&ctx->print, idx - ctx->lists_num, req);
+        return;
+    }
+
+    Board* board       = ctx->boards[ctx->lists_num++];
+    board->threads_num = 0;
+    board->listed      = false;
+
+    if (req != NULL) {
+        const uint64_t start = stats_enabled() ? stats_now_ns() : 0;
+        cJSON* json =
+          arena_parse_json(&ctx->arena, req->buffer.data, req->buffer.sz);
+        if (stats_enabled())
+            stats_record(STATS_PARSE, stats_now_ns() - start);
+
+        if (json != NULL) {
+            board->threads_num =
+              threads_from_json(board->threads, ARRLEN(board->threads), json);
+            board->listed = (board->threads_num > 0);
+            remove_filtered_threads(board, json);
+            request_store(req->url,
+                          req->status,
+                          &req->validators,
+                          req->buffer.data,
+                          req->buffer.sz);
+        }
+        arena_reset(&ctx->arena);
+    }
+
+    if (!board->listed) {
+        ERR("Could not get the thread list of board '%s'.", board->name);
+        ctx->failed = true;
+        request_next_list(ctx);
+        return;
+    }
+
+    /*
+     * The threads are requested in the order they are printed, so each one can
+     * be printed as soon as it's received, and the engine bounds the number of
+     * threads that are received ahead of it.
+     */
+    const size_t added_num = add_updated_threads(ctx->print.opts,
+                                                 board,
+                                                 &ctx->refs[ctx->refs_num],
+                                                 ctx->print.print_num,
+                                                 false);
+    ctx->print.print_num += added_num;
+
+    size_t queued_num = ctx->refs_num;
+    for (size_t i = 0; i < added_num; i++) {
+        const ThreadRef cur_ref = ctx->refs[ctx->refs_num + i];
+
+        static char cur_thread_url[255] = { '\0' };
+        if (!thread_url(cur_thread_url,
+                        sizeof(cur_thread_url),
+                        ctx->print.opts,
+                        board->name,
+                        cur_ref.id)) {
+            skip_held_thread(&ctx->print, cur_ref.print_idx);
+            continue;
+        }
+
+        const long added_idx = fetch_engine_add(ctx->engine, cur_thread_url);
+        if (added_idx < 0) {
+            ctx->failed = true;
+            break;
+        }
+
+        /* Like in 'fetch_threads', skipped threads are overwritten */
+        ctx->refs[added_idx - ctx->lists_num] = cur_ref;
+        queued_num = (size_t)added_idx - ctx->lists_num + 1;
+    }
+
+    ctx->refs_num = queued_num;
+    request_next_list(ctx);
+}
+
+/*
+ * Request the thread lists of all boards, and print their updated threads,
+ * minimizing the time until the first post is printed. Unlike the rest of the
+ * modes, the threads of each board are requested by the same engine as soon as
+ * its thread list is received, before the thread list of the next board, and
+ * each thread is rendered and printed as soon as it and the threads before it
+ * are received. The number of threads received ahead of the printed ones is
+ * bounded by the number of concurrent requests.
+ */
+static bool fetch_boards_early(const Options* opts, Board** boards,
+                               size_t boards_num) {
+    static ThreadRef refs[MAX_BOARDS * MAX_THREADS];
+
+    EarlyFetchCtx ctx = {
+        .boards     = boards,
+        .boards_num = boards_num,
+        .lists_num  = 0,
+        .list_idx   = 0,
+        .failed     = false,
+        .arena      = ARENA_EMPTY,
+        .refs       = refs,
+        .refs_num   = 0,
+        .print = {
+            .opts         = opts,
+            .refs         = refs,
+            .rendered_num = 0,
+            .archive      = NULL,
+            .held         = held_threads,
+            .print_num    = 0,
+            .next_print   = 0,
+        },
+    };
+
+    /*
+     * Threads are rendered by the main thread when they are received, so they
+     * are printed right away instead of after the next response.
+     */
+    ctx.print.pipeline = pipeline_new(0, on_thread_rendered, &ctx.print);
+    ctx.engine = fetch_engine_new_raw(opts->jobs, on_early_response, &ctx);
+    if (ctx.print.pipeline == NULL || ctx.engine == NULL) {
+        ctx.failed = true;
+        goto done;
+    }
+
+    request_next_list(&ctx);
+    if (ctx.failed)
+        goto done;
+
+    if (!fetch_engine_run(ctx.engine))
+        ctx.failed = true;
+
+    pipeline_finish(ctx.print.pipeline);
+
+done:
+    fetch_engine_free(ctx.engine);
+    pipeline_free(ctx.print.pipeline);
+    print_held_threads(&ctx.print, true);
+    arena_free(&ctx.arena);
+    return !ctx.failed;
+}
+
+/*
+ * Print the number of attachments handled by the media downloader so far.
+ */
+static void print_media_counts(void) {
+    MediaCounts counts;
+    media_get_counts(&counts);
+
+    fprintf(stderr,
+            COL_INFO "Media:" COL_NORM " %zu downloaded (%llu bytes), %zu "
+            "already stored, %zu duplicates, %zu failed.\n",
+            counts.downloaded,
+            (unsigned long long)counts.bytes,
+            counts.stored,
+            counts.duplicates,
+            counts.failed);
+}
+
+/*
+ * Request the thread lists of all boards concurrently, and print the threads
+ * that are new or were modified since the previous poll, according to the
+ * state of each board. The output is grouped by board, in the specified order.
+ * The state of each board is then updated with its current thread list. If
+ * 'archive' is not NULL, the threads are added to it instead of printing them.
+ */
+static bool poll_boards(CURL* curl, const Options* opts, Board* boards,
+                        size_t boards_num, ArchiveWriter* archive) {
+    bool result = true;
+
+    /* Each poll starts a new group of boards */
+    header_board = NULL;
+
+    static Board* requested[MAX_BOARDS];
+    for (size_t i = 0; i < boards_num; i++)
+        requested[i] = &boards[i];
+
+    if (opts->latency) {
+        result = fetch_boards_early(opts, requested, boards_num);
+        goto update_state;
+    }
+
+    FetchEngine* engine =
+      fetch_engine_new(opts->jobs, on_thread_list_fetched, requested);
+    if (engine == NULL)
+        return false;
+
+    for (size_t i = 0; i < boards_num; i++) {
+        boards[i].threads_num = 0;
+        boards[i].listed      = false;
+        if (fetch_engine_add(engine, boards[i].threads_url) < 0) {
+            fetch_engine_free(engine);
+            return false;
+        }
+    }
+
+    if (!fetch_engine_run(engine))
+        result = false;
+    fetch_engine_free(engine);
+
+    /* Only request the updated threads of each board */
+    static ThreadRef refs[MAX_BOARDS * MAX_THREADS];
+    size_t refs_num = 0;
+    for (size_t i = 0; i < boards_num; i++) {
+        if (!boards[i].listed) {
+            result = false;
+            continue;
+        }
+
+        /*
+         * Threads are only requested by priority if they are printed after
+         * being received, otherwise the output would follow that order.
+         */
+        refs_num += add_updated_threads(opts,
+                                        &boards[i],
+                                        &refs[refs_num],
+                                        refs_num,
+                                        !opts->stream && archive == NULL);
+    }
+
+    if (refs_num > 0) {
+        if (opts->stream) {
+            if (!stream_threads(curl, opts, refs, refs_num))
+                result = false;
+        } else if (!fetch_threads(opts, refs, refs_num, archive)) {
+            result = false;
+        }
+    }
+
+update_state:
+    if (media_enabled()) {
+        /* Show the printed threads while the attachments are downloaded */
+        fflush(stdout);
+        if (!media_run())
+            result = false;
+
+        if (opts->verbose)
+            print_media_counts();
+    }
+
+    for (size_t i = 0; i < boards_num; i++) {
+        Board* board = &boards[i];
+        if (!board->listed)
+            continue;
+
+        /* Remember the current thread list for the next poll */
+        WatchState* state = &board->state;
+        memcpy(state->threads,
+               board->threads,
+               board->threads_num * sizeof(ThreadInfo));
+        state->threads_num = board->threads_num;
+        threads_sort_by_id(state->threads, state->threads_num);
+
+        /* Make sure that the threads that failed are requested again */
+        for (size_t j = 0; j < board->failed.num; j++)
+            thread_mark_outdated(state->threads,
+                                 state->threads_num,
+                                 board->failed.ids[j]);
+
+        /* Forget the threads that are gone */
+        if (seen_enabled())
+            seen_prune(board->name, state->threads, state->threads_num);
+    }
+
+    /* Store the last printed posts of all boards */
+    if (seen_enabled())
+        seen_save();
+
+    return result;
+}
+
+/*
+ * Get the position of a thread in the list of expanded threads, or a negative
+ * value if it's not expanded.
+ */
+static long find_expanded(const Options* opts, ThreadId id) {
+    for (size_t i = 0; i < opts->expanded_num; i++)
+        if (opts->expanded[i] == id)
+            return (long)i;
+
+    return -1;
+}
+
+/*
+ * Called by the fetching engine, in order, whenever the catalog of a board is
+ * received. The threads are printed right away, except the expanded ones.
+ */
+static void on_catalog_fetched(void* user_data, size_t idx, cJSON* catalog) {
+    CatalogCtx* ctx = user_data;
+    Board* board    = ctx->boards[idx];
+
+    if (!cJSON_IsArray(catalog)) {
+        ERR("Could not get the catalog of board '%s'.", board->name);
+        ctx->failed = true;
+        return;
+    }
+
+    /* The catalog is a list of pages, each one with a list of threads */
+    cJSON* page;
+    cJSON_ArrayForEach(page, catalog) {
+        cJSON* threads = cJSON_GetObjectItemCaseSensitive(page, "threads");
+        cJSON* thread;
+        cJSON_ArrayForEach(thread, threads) {
+            cJSON* no = cJSON_GetObjectItemCaseSensitive(thread, "no");
+            const ThreadId id =
+              cJSON_IsNumber(no) ? (ThreadId)no->valuedouble : 0;
+
+            /* Expanded threads are requested in full later */
+            const long expanded = find_expanded(ctx->opts, id);
+            if (expanded >= 0) {
+                if (!ctx->found[expanded]) {
+                    ctx->found[expanded] = true;
+
+                    ThreadRef* ref = &ctx->expanded[ctx->expanded_num];
+                    ref->board     = board;
+                    ref->id        = id;
+                    ref->print_idx = ctx->expanded_num++;
+                }
+                continue;
+            }
+
+            const uint64_t start = stats_enabled() ? stats_now_ns() : 0;
+            buffer_clear(&ctx->out);
+            if (!pretty_render_catalog_thread(&ctx->out, thread, board->name)) {
+                ERR("Could not print contents of thread with ID %lu.", id);
+                ctx->failed = true;
+                continue;
+            }
+
+            print_board_header(ctx->opts, board);
+            write_output(ctx->opts, ctx->out.data, ctx->out.sz);
+
+            if (stats_enabled())
+                stats_record(STATS_RENDER, stats_now_ns() - start);
+        }
+    }
+}
+
+/*
+ * Request the catalogs of all boards concurrently, and print an overview of
+ * each board, in order. Then, the expanded threads are requested and printed
+ * in full, in the order of the catalogs. The expanded threads that are not in
+ * any catalog are requested from the first board.
+ */
+static bool poll_catalogs(CURL* curl, const Options* opts, Board* boards,
+                          size_t boards_num) {
+    bool result = true;
+
+    static Board* requested[MAX_BOARDS];
+    static CatalogCtx ctx;
+    ctx.opts         = opts;
+    ctx.boards       = requested;
+    ctx.out          = (Buffer)BUFFER_EMPTY;
+    ctx.failed       = false;
+    ctx.expanded_num = 0;
+    memset(ctx.found, 0, sizeof(ctx.found));
+
+    FetchEngine* engine =
+      fetch_engine_new(opts->jobs, on_catalog_fetched, &ctx);
+    if (engine == NULL)
+        return false;
+
+    for (size_t i = 0; i < boards_num; i++) {
+        requested[i]         = &boards[i];
+        boards[i].failed.num = 0;
+
+        static char url[255] = { '\0' };
+        const int written    = snprintf(url,
+                                        sizeof(url),
+                                        "%s/%s/catalog.json",
+                                        opts->api_url,
+                                        boards[i].name);
+        if (written <= 0 || (size_t)written >= sizeof(url) ||
+            fetch_engine_add(engine, url) < 0) {
+            result = false;
+            goto done;
+        }
+    }
+
+    /* Each poll starts a new group of boards */
+    header_board = NULL;
+
+    if (!fetch_engine_run(engine) || ctx.failed)
+        result = false;
+
+    for (size_t i = 0; i < opts->expanded_num; i++) {
+        if (ctx.found[i])
+            continue;
+
+        ThreadRef* ref = &ctx.expanded[ctx.expanded_num];
+        ref->board     = &boards[0];
+        ref->id        = opts->expanded[i];
+        ref->print_idx = ctx.expanded_num++;
+    }
+
+    if (ctx.expanded_num > 0) {
+        if (opts->stream) {
+            if (!stream_threads(curl, opts, ctx.expanded, ctx.expanded_num))
+                result = false;
+        } else if (!fetch_threads(opts,
+                                  ctx.expanded,
+                                  ctx.expanded_num,
+                                  NULL)) {
+            result = false;
+        }
+    }
+
+done:
+    fetch_engine_free(engine);
+    buffer_free(&ctx.out);
+    return result;
+}
+
+/*
+ * Print all the threads of an archive file of the specified board, without
+ * parsing any JSON.
+ */
+static bool print_archive(const char* path, const char* board) {
+    Archive archive;
+    if (!archive_open(&archive, path))
+        return false;
+
+    bool result = true;
+
+    /* Posts of the current thread, as an array of 'Post' */
+    Buffer posts = BUFFER_EMPTY;
+    Buffer out   = BUFFER_EMPTY;
+    for (size_t i = 0; i < archive.threads_num; i++) {
+        const ArchiveThread* thread = &archive.threads[i];
+
+        buffer_clear(&posts);
+        for (size_t j = 0; j < thread->posts_num; j++) {
+            Post post;
+            archive_get_post(&archive,
+                             &archive.posts[thread->first_post + j],
+                             &post);
+            if (!buffer_append(&posts, (const char*)&post, sizeof(post))) {
+                result = false;
+                goto done;
+            }
+        }
+
+        buffer_clear(&out);
+        if (!pretty_render_posts(&out,
+                                 (const Post*)posts.data,
+                                 thread->posts_num,
+                                 board)) {
+            ERR("Could not render thread %lu of the archive.",
+                (unsigned long)thread->id);
+            result = false;
+            goto done;
+        }
+
+        /* Write each thread with a single call, like 'pretty_print_thread' */
+        if (out.sz > 0)
+            fwrite(out.data, 1, out.sz, stdout);
+    }
+
+done:
+    buffer_free(&posts);
+    buffer_free(&out);
+    archive_close(&archive);
+    return result;
+}
+
+/*
+ * Print a post of a thread and all of its replies, recursively. See
+ * 'pretty_render_subtree'.
+ */
+static bool print_subtree(CURL* curl, const Options* opts) {
+    char url[255];
+    if (!thread_url(url,
+                    sizeof(url),
+                    opts,
+                    opts->boards[0],
+                    opts->subtree_thread)) {
+        ERR("The URL of thread %lu is too long.", opts->subtree_thread);
+        return false;
+    }
+
+    cJSON* thread = request_json_from_url(curl, url);
+    if (thread == NULL) {
+        ERR("Could not get thread %lu.", opts->subtree_thread);
+        return false;
+    }
+
+    Buffer out        = BUFFER_EMPTY;
+    const bool result = pretty_render_subtree(&out,
+                                              thread,
+                                              opts->boards[0],
+                                              opts->subtree_post);
+    if (result)
+        write_output(opts, out.data, out.sz);
+    else
+        ERR("Post %lu is not in thread %lu.",
+            opts->subtree_post,
+            opts->subtree_thread);
+
+    buffer_free(&out);
+    cJSON_Delete(thread);
+    return result;
+}
+
+/*
+ * Add the posts of an archive file to a full-text index. The posts that are
+ * already indexed are skipped.
+ */
+static bool index_archive(const char* index_path, const char* archive_path) {
+    bool result = false;
+
+    Archive archive;
+    if (!archive_open(&archive, archive_path))
+        return false;
+
+    IndexBuilder builder;
+    if (!index_builder_init(&builder, index_path))
+        goto cleanup_archive;
+
+    for (size_t i = 0; i < archive.threads_num; i++) {
+        const ArchiveThread* thread = &archive.threads[i];
+        for (size_t j = 0; j < thread->posts_num; j++) {
+            Post post;
+            archive_get_post(&archive,
+                             &archive.posts[thread->first_post + j],
+                             &post);
+            if (!index_builder_add_post(&builder, thread->id, &post))
+                goto cleanup_builder;
+        }
+    }
+
+    result = index_builder_save(&builder);
+
+cleanup_builder:
+    index_builder_free(&builder);
+
+cleanup_archive:
+    archive_close(&archive);
+    return result;
+}
+
+/*
+ * Compare two index matches by post number. Used for 'qsort' and 'bsearch'.
+ */
+static int compare_matches(const void* a, const void* b) {
+    const PostId post_a = ((const IndexMatch*)a)->post;
+    const PostId post_b = ((const IndexMatch*)b)->post;
+    return (post_a > post_b) - (post_a < post_b);
+}
+
+/*
+ * Print the posts of an archive of the specified board that are in the list of
+ * matches, which is sorted in the process.
+ */
+static bool print_archived_matches(const char* archive_path,
+                                   const char* board, IndexMatches* matches) {
+    Archive archive;
+    if (!archive_open(&archive, archive_path))
+        return false;
+
+    qsort(matches->data, matches->num, sizeof(IndexMatch), compare_matches);
+
+    Buffer out = BUFFER_EMPTY;
+    for (size_t i = 0; i < archive.threads_num; i++) {
+        const ArchiveThread* thread = &archive.threads[i];
+
+        /* Like when printing threads, the thread rules apply to the OP */
+        if (filter_enabled() && thread->posts_num > 0) {
+            Post op;
+            archive_get_post(&archive, &archive.posts[thread->first_post], &op);
+            if (!filter_thread_shown(&op))
+                continue;
+        }
+
+        buffer_clear(&out);
+        for (size_t j = 0; j < thread->posts_num; j++) {
+            const ArchivePost* archived =
+              &archive.posts[thread->first_post + j];
+
+            const IndexMatch key = { .post = archived->no };
+            if (bsearch(&key,
+                        matches->data,
+                        matches->num,
+                        sizeof(IndexMatch),
+                        compare_matches) == NULL)
+                continue;
+
+            Post post;
+            archive_get_post(&archive, archived, &post);
+            if (!filter_post_hidden(&post))
+                render_current()->post(&out,
+                                       &post,
+                                       NULL,
+                                       board,
+                                       thread->id,
+                                       j > 0);
+        }
+
+        if (out.sz > 0)
+            fwrite(out.data, 1, out.sz, stdout);
+    }
+
+    buffer_free(&out);
+    archive_close(&archive);
+    return true;
+}
+
+/*
+ * Search the posts that match the query in the index. If an archive was
+ * specified, the matching posts are printed from it; otherwise, their thread
+ * number, post number and time are printed, one per line.
+ */
+static bool search_index(const Options* opts) {
+    Index index;
+    if (!index_open(&index, opts->index_path))
+        return false;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    IndexMatches matches = INDEX_MATCHES_EMPTY;
+    bool result          = index_search(&index, opts->query, &matches);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (opts->verbose)
+        fprintf(stderr,
+                COL_INFO "Search:" COL_NORM " %zu matches in %.3f ms.\n",
+                matches.num,
+                (end.tv_sec - start.tv_sec) * 1e3 +
+                  (end.tv_nsec - start.tv_nsec) / 1e6);
+
+    if (result && opts->read_path != NULL) {
+        result = print_archived_matches(opts->read_path,
+                                        opts->boards[0],
+                                        &matches);
+    } else if (result) {
+        for (size_t i = 0; i < matches.num; i++)
+            printf("%lu %lu %lld\n",
+                   matches.data[i].thread,
+                   matches.data[i].post,
+                   matches.data[i].time);
+    }
+
+    index_matches_free(&matches);
+    index_close(&index);
+    return result;
+}
+
+/*
+ * Print the allocation statistics of the arenas and buffers.
+ */
+static void print_memory_stats(void) {
+    ArenaStats stats;
+    arena_get_stats(&stats);
+
+    fprintf(stderr,
+            COL_INFO "Memory:" COL_NORM "\n"
+            "  Arena allocations:        %zu\n"
+            "  Arena chunk allocations:  %zu\n"
+            "  Peak arena size:          %zu bytes\n"
+            "  Other cJSON allocations:  %zu\n"
+            "  Buffer allocations:       %zu\n",
+            stats.allocs,
+            stats.chunk_allocs,
+            stats.peak,
+            stats.cjson_allocs,
+            buffer_alloc_count());
+}
+
+int main(int argc, char** argv) {
     int exit_code = EXIT_SUCCESS;
 
+    Options opts;
+    if (!parse_options(&opts, argc, argv))
+        return EXIT_FAILURE;
+
+    /* Set before any thread is rendered, by any thread */
+    render_select(opts.format);
+    pretty_enable_backlinks(opts.backlinks);
+    if (opts.filter_path != NULL && !filter_load(opts.filter_path))
+        return EXIT_FAILURE;
+
+    /* Archives and indexes don't need any network or cache access */
+    if (opts.query != NULL)
+        return search_index(&opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (opts.read_path != NULL && opts.index_path != NULL)
+        return index_archive(opts.index_path, opts.read_path) ? EXIT_SUCCESS
+                                                              : EXIT_FAILURE;
+
+    if (opts.read_path != NULL)
+        return print_archive(opts.read_path, opts.boards[0]) ? EXIT_SUCCESS
+                                                             : EXIT_FAILURE;
+
+    /* Allocate parsed JSON trees from arenas, when possible */
+    arena_init_cjson_hooks();
+
+    if (!json_scan_select(opts.parser)) {
+        ERR("The '%s' parser is not supported by this processor.",
+            json_scan_name(opts.parser));
+        return EXIT_FAILURE;
+    }
+
+    /* Replayed responses never reach the network, so the cache is not used */
+    if (opts.replay_path != NULL && !replay_open(opts.replay_path))
+        return EXIT_FAILURE;
+
+    if (opts.capture_dir != NULL && !replay_capture_init(opts.capture_dir)) {
+        ERR("Could not create the capture directory.");
+        return EXIT_FAILURE;
+    }
+
+    if ((opts.stats_format != NULL || opts.trace_path != NULL) &&
+        !stats_init(opts.trace_path))
+        return EXIT_FAILURE;
+
+    const StatsFormat stats_format = (opts.stats_format != NULL &&
+                                      strcmp(opts.stats_format, "json") == 0)
+                                       ? STATS_FORMAT_JSON
+                                       : STATS_FORMAT_TEXT;
+
+    /*
+     * Initialize the response cache. The program can still be used without
+     * it, so failing is not fatal.
+     */
+    if (opts.use_cache && !replay_enabled() && !cache_init(opts.cache_dir))
+        ERR("Could not initialize the response cache, continuing without it.");
+
+    /* Unlike the cache, delta output can't work without its state */
+    if (opts.only_new && !seen_init(NULL)) {
+        ERR("Could not load the list of printed posts.");
+        return EXIT_FAILURE;
+    }
+
+    /* Connections are reused across polls and fetching engines */
+    if (!request_pool_init())
+        ERR("Could not create the connection pool, continuing without it.");
+
+    if (opts.media_dir != NULL &&
+        !media_init(opts.media_dir,
+                    (opts.media_url != NULL) ? opts.media_url : MEDIA_URL,
+                    (opts.media_kinds != 0) ? opts.media_kinds : MEDIA_FILES,
+                    (opts.media_jobs != 0) ? opts.media_jobs
+                                           : DEFAULT_MEDIA_JOBS)) {
+        ERR("Could not initialize the media store.");
+        return EXIT_FAILURE;
+    }
+
     /* Initialize curl */
-    CURL* curl = curl_easy_init();
+    CURL* curl = request_handle_new();
     if (curl == NULL) {
         ERR("Failed to initialize 'CURL' object.");
         exit_code = EXIT_FAILURE;
         goto cleanup_curl;
     }
 
-    /* Obtain the JSON with the thread list */
-    cJSON* root_json = request_json_from_url(curl, THREADS_URL);
-    if (root_json == NULL) {
-        exit_code = EXIT_FAILURE;
-        goto cleanup_curl;
+    /* Initially empty, so all threads are considered new */
+    static Board boards[MAX_BOARDS];
+    for (size_t i = 0; i < opts.boards_num; i++) {
+        Board* board = &boards[i];
+        board->name  = opts.boards[i];
+
+        /*
+         * URL of the JSON with the thread list. The catalog also contains the
+         * OP of each thread, so the filtered threads are never requested.
+         */
+        const int written = snprintf(board->threads_url,
+                                     sizeof(board->threads_url),
+                                     "%s/%s/%s",
+                                     opts.api_url,
+                                     board->name,
+                                     filter_enabled() ? "catalog.json"
+                                                      : "threads.json");
+        if (written <= 0 || (size_t)written >= sizeof(board->threads_url)) {
+            ERR("The URL of board '%s' is too long.", board->name);
+            exit_code = EXIT_FAILURE;
+            goto cleanup_curl;
+        }
     }
 
-    /* Extract the IDs of all available threads */
-    static ThreadId thread_ids[MAX_THREADS] = { 0 };
-    const size_t retreived_ids =
-      thread_ids_from_json(thread_ids, ARRLEN(thread_ids), root_json);
-    if (retreived_ids <= 0) {
-        exit_code = EXIT_FAILURE;
-        goto cleanup_json;
+    if (opts.crawl_path != NULL) {
+        /* Store all threads in an archive */
+        ArchiveWriter archive;
+        archive_writer_init(&archive);
+        if (!poll_boards(curl, &opts, boards, opts.boards_num, &archive) ||
+            !archive_writer_save(&archive, opts.crawl_path))
+            exit_code = EXIT_FAILURE;
+        archive_writer_free(&archive);
+
+        /* Add the new posts to the index */
+        if (exit_code == EXIT_SUCCESS && opts.index_path != NULL &&
+            !index_archive(opts.index_path, opts.crawl_path))
+            exit_code = EXIT_FAILURE;
+        goto cleanup_curl;
     }
 
-    /* Request information about each thread, and print its contents */
-    for (size_t i = 0; i < retreived_ids; i++) {
-        const ThreadId cur_thread_id = thread_ids[i];
-        if (cur_thread_id == 0)
-            continue;
+    if (opts.subtree_thread != 0) {
+        if (!print_subtree(curl, &opts))
+            exit_code = EXIT_FAILURE;
+        goto cleanup_curl;
+    }
 
-        static char cur_thread_url[255] = { '\0' };
-        if (snprintf(cur_thread_url,
-                     sizeof(cur_thread_url),
-                     "https://a.4cdn.org/" BOARD "/thread/%lu.json",
-                     cur_thread_id) < 0)
-            continue;
+    if (opts.watch_interval == 0) {
+        /* Print all threads once */
+        const bool polled =
+          opts.catalog
+            ? poll_catalogs(curl, &opts, boards, opts.boards_num)
+            : poll_boards(curl, &opts, boards, opts.boards_num, NULL);
+        if (!polled)
+            exit_code = EXIT_FAILURE;
+        goto cleanup_curl;
+    }
 
-        cJSON* cur_thread = request_json_from_url(curl, cur_thread_url);
-        if (cur_thread == NULL)
-            continue;
+    for (;;) {
+        /* Errors are not fatal in watch mode, try again in the next poll */
+        if (opts.catalog)
+            poll_catalogs(curl, &opts, boards, opts.boards_num);
+        else
+            poll_boards(curl, &opts, boards, opts.boards_num, NULL);
 
-        if (!pretty_print_thread(stdout, cur_thread))
-            ERR("Could not print contents of thread with ID %lu.",
-                cur_thread_id);
+        /* The program never exits, so the statistics so far are printed */
+        if (opts.stats_format != NULL)
+            stats_print(stderr, stats_format);
 
-        cJSON_Delete(cur_thread);
+        sleep(opts.watch_interval);
     }
 
-cleanup_json:
-    cJSON_Delete(root_json);
-
 cleanup_curl:
     curl_easy_cleanup(curl);
+    media_free();
+    request_pool_free();
+    seen_free();
+    filter_free();
+    replay_close();
+
+    if (opts.stats_format != NULL)
+        stats_print(stderr, stats_format);
+    stats_free();
+
+    if (opts.verbose)
+        print_memory_stats();
 
     return exit_code;
 }
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "include/md5.h"
+
+/*
+ * Shift amounts of each round, and the constants of each step, which are the
+ * integer part of abs(sin(i + 1)) * 2^32.
+ */
+static const uint8_t shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static const uint32_t constants[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+    0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+    0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+    0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+    0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+    0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static inline uint32_t rotate_left(uint32_t x, unsigned n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+/*
+ * Hash a single 64-byte block into the state.
+ */
+static void process_block(uint32_t state[4], const uint8_t* block) {
+    /* The words of the block are little-endian, on any processor */
+    uint32_t words[16];
+    for (size_t i = 0; i < 16; i++)
+        words[i] = (uint32_t)block[i * 4] |
+                   ((uint32_t)block[i * 4 + 1] << 8) |
+                   ((uint32_t)block[i * 4 + 2] << 16) |
+                   ((uint32_t)block[i * 4 + 3] << 24);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (size_t i = 0; i < 64; i++) {
+        uint32_t f;
+        size_t word;
+        if (i < 16) {
+            f    = (b & c) | (~b & d);
+            word = i;
+        } else if (i < 32) {
+            f    = (d & b) | (~d & c);
+            word = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f    = b ^ c ^ d;
+            word = (3 * i + 5) % 16;
+        } else {
+            f    = c ^ (b | ~d);
+            word = (7 * i) % 16;
+        }
+
+        const uint32_t rotated =
+          rotate_left(a + f + constants[i] + words[word], shifts[i]);
+        a = d;
+        d = c;
+        c = b;
+        b = b + rotated;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+void md5_init(Md5* md5) {
+    md5->state[0] = 0x67452301;
+    md5->state[1] = 0xefcdab89;
+    md5->state[2] = 0x98badcfe;
+    md5->state[3] = 0x10325476;
+    md5->len      = 0;
+}
+
+void md5_update(Md5* md5, const void* data, size_t data_sz) {
+    const uint8_t* p = data;
+    size_t used      = (size_t)(md5->len % sizeof(md5->block));
+    md5->len += data_sz;
+
+    /* Complete the pending block first */
+    if (used > 0) {
+        const size_t missing = sizeof(md5->block) - used;
+        if (data_sz < missing) {
+            memcpy(&md5->block[used], p, data_sz);
+            return;
+        }
+
+        memcpy(&md5->block[used], p, missing);
+        process_block(md5->state, md5->block);
+        p += missing;
+        data_sz -= missing;
+    }
+
+    /* Whole blocks are hashed without copying them */
+    for (; data_sz >= sizeof(md5->block); data_sz -= sizeof(md5->block)) {
+        process_block(md5->state, p);
+        p += sizeof(md5->block);
+    }
+
+    memcpy(md5->block, p, data_sz);
+}
+
+void md5_final(Md5* md5, uint8_t dst[MD5_SZ]) {
+    const uint64_t bits = md5->len * 8;
+
+    /* A one bit, zeros until 8 bytes before the end of a block, and the size */
+    static const uint8_t padding[64] = { 0x80 };
+    const size_t used                = (size_t)(md5->len % 64);
+    md5_update(md5, padding, (used < 56) ? 56 - used : 120 - used);
+
+    uint8_t len_bytes[8];
+    for (size_t i = 0; i < 8; i++)
+        len_bytes[i] = (uint8_t)(bits >> (i * 8));
+    md5_update(md5, len_bytes, sizeof(len_bytes));
+
+    for (size_t i = 0; i < 4; i++)
+        for (size_t j = 0; j < 4; j++)
+            dst[i * 4 + j] = (uint8_t)(md5->state[i] >> (j * 8));
+}
@@ -0,0 +1,702 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> /* access, getpid */
+
+#include <curl/curl.h>
+
+#include "include/media.h"
+#include "include/arena.h"
+#include "include/jsonscan.h"
+#include "include/md5.h"
+#include "include/request.h"
+#include "include/ratelimit.h"
+#include "include/util.h"
+
+/*
+ * Maximum time in milliseconds that we will wait for activity in a single call
+ * to 'curl_multi_poll'.
+ */
+#define POLL_TIMEOUT_MS 1000
+
+/*
+ * Size of the hexadecimal representation of an MD5, which is used for naming
+ * the stored files.
+ */
+#define MD5_HEX_SZ (MD5_SZ * 2)
+
+/*
+ * Maximum length of the extension of an attachment, including the dot. Longer
+ * extensions are not downloaded, since they are used in file names.
+ */
+#define MAX_EXT_LEN 8
+
+/*
+ * Suffix of the thumbnail of an attachment, appended to its timestamp. All
+ * thumbnails are JPEG images.
+ */
+#define THUMB_SUFFIX "s.jpg"
+
+/*
+ * Each file is stored inside the store directory, in a subdirectory named after
+ * the first two hexadecimal digits of its MD5, so the directories don't grow
+ * too large:
+ *
+ *   <dir>/<xx>/<md5><ext>    Full file
+ *   <dir>/<xx>/<md5>s.jpg    Thumbnail
+ *
+ * Files are written to a temporary file next to their final path, and renamed
+ * when they are complete, so the store never contains partial files.
+ */
+static char store_dir[1024] = { '\0' };
+static char base_url[256]   = { '\0' };
+static int enabled_kinds    = 0;
+
+/*
+ * Attachment waiting to be downloaded.
+ */
+typedef struct {
+    char* url;
+    char* path; /* Final path in the store */
+    uint8_t md5[MD5_SZ];
+    MediaKind kind;
+} MediaItem;
+
+/*
+ * Download in progress. The received data is written straight to 'fp', and
+ * hashed as it's written, so full files can be checked against their MD5.
+ */
+typedef struct {
+    CURL* curl;
+    FILE* fp;
+    Md5 hash;
+    MediaItem item;
+    char tmp_path[sizeof(store_dir) + 64];
+    uint64_t bytes;
+    bool busy;
+} MediaSlot;
+
+static CURLM* multi      = NULL;
+static MediaSlot* slots  = NULL;
+static size_t slots_num  = 0;
+static size_t active_num = 0;
+
+static MediaItem* queue = NULL;
+static size_t queue_num = 0, queue_cap = 0, queue_next = 0;
+
+/*
+ * Attachment that was found in a post, identified by the MD5 of its file and
+ * its kind. The kind is zero in unused entries of the set.
+ */
+typedef struct {
+    uint8_t md5[MD5_SZ];
+    uint8_t kind;
+} MediaKey;
+
+/*
+ * Open-addressing set of the attachments found since the downloader was
+ * initialized, so each one is only handled once. The capacity is a power of
+ * two. Attachments whose download fails are removed, so they are retried when
+ * they are found again.
+ */
+static MediaKey* keys   = NULL;
+static size_t keys_num  = 0;
+static size_t keys_mask = 0;
+
+static MediaCounts counts = { 0 };
+
+/*
+ * Used for decoding the strings of each thread.
+ */
+static Arena arena = ARENA_EMPTY;
+
+/*
+ * Decode a Base64 MD5, as reported by the API. Returns false if it's not a
+ * valid digest.
+ */
+static bool decode_md5(uint8_t* dst, const char* str) {
+    /* 16 bytes are encoded as 22 characters and two padding characters */
+    if (strlen(str) != 24 || strcmp(&str[22], "==") != 0)
+        return false;
+
+    uint32_t bits = 0;
+    int bits_num  = 0;
+    size_t dst_sz = 0;
+    for (size_t i = 0; i < 22; i++) {
+        const char c = str[i];
+
+        uint32_t value;
+        if (c >= 'A' && c <= 'Z')
+            value = c - 'A';
+        else if (c >= 'a' && c <= 'z')
+            value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9')
+            value = c - '0' + 52;
+        else if (c == '+')
+            value = 62;
+        else if (c == '/')
+            value = 63;
+        else
+            return false;
+
+        bits = (bits << 6) | value;
+        bits_num += 6;
+        if (bits_num >= 8) {
+            bits_num -= 8;
+            dst[dst_sz++] = (uint8_t)(bits >> bits_num);
+        }
+    }
+
+    return dst_sz == MD5_SZ;
+}
+
+/*
+ * Is the specified extension safe to use in a file name? It must be a dot,
+ * followed by alphanumeric characters.
+ */
+static bool valid_ext(const char* ext) {
+    const size_t len = strlen(ext);
+    if (len < 2 || len > MAX_EXT_LEN || ext[0] != '.')
+        return false;
+
+    for (size_t i = 1; i < len; i++)
+        if (!((ext[i] >= 'a' && ext[i] <= 'z') ||
+              (ext[i] >= 'A' && ext[i] <= 'Z') ||
+              (ext[i] >= '0' && ext[i] <= '9')))
+            return false;
+
+    return true;
+}
+
+/*
+ * Get the position of the set where the probing for the specified key starts.
+ */
+static size_t key_home(const uint8_t* md5, uint8_t kind) {
+    /* The digest is already uniformly distributed */
+    uint64_t hash;
+    memcpy(&hash, md5, sizeof(hash));
+
+    return (size_t)(hash + kind) & keys_mask;
+}
+
+/*
+ * Get the position of the specified key in the set: either the entry that
+ * contains it, or the empty entry where it would be inserted.
+ */
+static size_t find_key(const uint8_t* md5, uint8_t kind) {
+    size_t pos = key_home(md5, kind);
+    while (keys[pos].kind != 0 &&
+           (keys[pos].kind != kind || memcmp(keys[pos].md5, md5, MD5_SZ) != 0))
+        pos = (pos + 1) & keys_mask;
+
+    return pos;
+}
+
+/*
+ * Double the capacity of the set, or allocate it if it's empty.
+ */
+static bool grow_keys(void) {
+    const size_t old_cap = (keys == NULL) ? 0 : keys_mask + 1;
+    const size_t new_cap = (old_cap == 0) ? 1024 : old_cap * 2;
+
+    MediaKey* old_keys = keys;
+    keys               = calloc(new_cap, sizeof(MediaKey));
+    if (keys == NULL) {
+        keys = old_keys;
+        ERR("Could not allocate the set of attachments.");
+        return false;
+    }
+    keys_mask = new_cap - 1;
+
+    for (size_t i = 0; i < old_cap; i++)
+        if (old_keys[i].kind != 0)
+            keys[find_key(old_keys[i].md5, old_keys[i].kind)] = old_keys[i];
+
+    free(old_keys);
+    return true;
+}
+
+/*
+ * Add an attachment to the set. The 'is_new' argument is set to whether it was
+ * not in the set already. Returns false on failure.
+ */
+static bool add_key(const uint8_t* md5, MediaKind kind, bool* is_new) {
+    /* Keep the load factor below one half */
+    if ((keys_num + 1) * 2 > ((keys == NULL) ? 0 : keys_mask + 1) &&
+        !grow_keys())
+        return false;
+
+    const size_t pos = find_key(md5, (uint8_t)kind);
+    *is_new          = (keys[pos].kind == 0);
+    if (*is_new) {
+        memcpy(keys[pos].md5, md5, MD5_SZ);
+        keys[pos].kind = (uint8_t)kind;
+        keys_num++;
+    }
+
+    return true;
+}
+
+/*
+ * Remove an attachment from the set, if it's there. The entries that follow it
+ * in its probe sequence are moved back, so no tombstones are needed.
+ */
+static void remove_key(const uint8_t* md5, MediaKind kind) {
+    if (keys == NULL)
+        return;
+
+    size_t hole = find_key(md5, (uint8_t)kind);
+    if (keys[hole].kind == 0)
+        return;
+
+    for (size_t pos = (hole + 1) & keys_mask; keys[pos].kind != 0;
+         pos = (pos + 1) & keys_mask) {
+        /* Entries whose probing starts after the hole can't be moved to it */
+        const size_t home = key_home(keys[pos].md5, keys[pos].kind);
+        if (((pos - home) & keys_mask) < ((pos - hole) & keys_mask))
+            continue;
+
+        keys[hole] = keys[pos];
+        hole       = pos;
+    }
+
+    keys[hole].kind = 0;
+    keys_num--;
+}
+
+/*
+ * Queue an attachment of a post for downloading, unless it was already found
+ * or it's already in the store. The 'suffix' is appended to the timestamp in
+ * its URL, and to its MD5 in its path. Returns false on failure.
+ */
+static bool add_attachment(const char* board, long long tim,
+                           const uint8_t* md5, MediaKind kind,
+                           const char* suffix) {
+    bool is_new;
+    if (!add_key(md5, kind, &is_new))
+        return false;
+    if (!is_new) {
+        counts.duplicates++;
+        return true;
+    }
+
+    char hex[MD5_HEX_SZ + 1];
+    for (size_t i = 0; i < MD5_SZ; i++)
+        sprintf(&hex[i * 2], "%02x", md5[i]);
+
+    char path[sizeof(store_dir) + 64];
+    snprintf(path,
+             sizeof(path),
+             "%s/%.2s/%s%s",
+             store_dir,
+             hex,
+             hex,
+             suffix);
+    if (access(path, F_OK) == 0) {
+        counts.stored++;
+        return true;
+    }
+
+    char url[sizeof(base_url) + 128];
+    snprintf(url, sizeof(url), "%s/%s/%lld%s", base_url, board, tim, suffix);
+
+    if (queue_num >= queue_cap) {
+        const size_t new_cap = (queue_cap == 0) ? 64 : queue_cap * 2;
+        MediaItem* new_queue = realloc(queue, new_cap * sizeof(MediaItem));
+        if (new_queue == NULL) {
+            ERR("Could not grow the queue of attachments.");
+            remove_key(md5, kind);
+            return false;
+        }
+        queue     = new_queue;
+        queue_cap = new_cap;
+    }
+
+    MediaItem* item = &queue[queue_num];
+    item->url       = strdup(url);
+    item->path      = strdup(path);
+    item->kind      = kind;
+    memcpy(item->md5, md5, MD5_SZ);
+    if (item->url == NULL || item->path == NULL) {
+        free(item->url);
+        free(item->path);
+        remove_key(md5, kind);
+        return false;
+    }
+
+    queue_num++;
+    return true;
+}
+
+bool media_init(const char* dir, const char* url, int kinds,
+                size_t max_connections) {
+    if (strlen(dir) >= sizeof(store_dir) || strlen(url) >= sizeof(base_url)) {
+        ERR("The media directory or URL is too long.");
+        return false;
+    }
+
+    if (!make_dirs(dir))
+        return false;
+
+    if (max_connections <= 0)
+        max_connections = 1;
+
+    multi = curl_multi_init();
+    slots = calloc(max_connections, sizeof(MediaSlot));
+    if (multi == NULL || slots == NULL) {
+        ERR("Failed to initialize the media downloader.");
+        media_free();
+        return false;
+    }
+    slots_num = max_connections;
+
+    /* Besides the number of transfers, bound the number of connections */
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi,
+                      CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                      (long)max_connections);
+
+    for (size_t i = 0; i < slots_num; i++) {
+        slots[i].curl = request_handle_new();
+        if (slots[i].curl == NULL) {
+            ERR("Failed to initialize 'CURL' object.");
+            media_free();
+            return false;
+        }
+    }
+
+    strcpy(store_dir, dir);
+    strcpy(base_url, url);
+    enabled_kinds = kinds;
+    return true;
+}
+
+bool media_enabled(void) {
+    return store_dir[0] != '\0';
+}
+
+bool media_add_thread(const char* board, const char* json, size_t json_sz) {
+    JsonScanner scanner;
+    if (!json_scan_thread(&scanner, json, json_sz))
+        return false;
+
+    bool result = true;
+    JsonPostRaw raw;
+    while (result && json_scan_next_post(&scanner, &raw)) {
+        const long long tim = (long long)json_raw_number(&raw.tim, 0);
+        if (tim <= 0)
+            continue;
+
+        /* Slashes in the MD5 are usually escaped */
+        const char* ext;
+        const char* md5_str;
+        uint8_t md5[MD5_SZ];
+        if (!json_raw_string(&ext, &raw.ext, &arena) ||
+            !json_raw_string(&md5_str, &raw.md5, &arena) || ext == NULL ||
+            md5_str == NULL || !valid_ext(ext) || !decode_md5(md5, md5_str))
+            continue;
+
+        if ((enabled_kinds & MEDIA_FILES) != 0)
+            result = add_attachment(board, tim, md5, MEDIA_FILES, ext);
+        if (result && (enabled_kinds & MEDIA_THUMBS) != 0)
+            result =
+              add_attachment(board, tim, md5, MEDIA_THUMBS, THUMB_SUFFIX);
+    }
+
+    arena_reset(&arena);
+    return result && !scanner.failed;
+}
+
+/*
+ * Write the received data of a download to its temporary file. Returning less
+ * than the received size aborts the transfer.
+ */
+static size_t data_received_callback(char* data, size_t item_sz,
+                                     size_t items_num, void* user_data) {
+    MediaSlot* slot = user_data;
+
+    const size_t written = fwrite(data, item_sz, items_num, slot->fp);
+    md5_update(&slot->hash, data, written * item_sz);
+    slot->bytes += written * item_sz;
+    return written * item_sz;
+}
+
+/*
+ * Start downloading the next queued attachment in the specified slot. Returns
+ * false if its temporary file could not be created.
+ */
+static bool start_download(MediaSlot* slot) {
+    slot->item = queue[queue_next++];
+    snprintf(slot->tmp_path,
+             sizeof(slot->tmp_path),
+             "%s.%ld",
+             slot->item.path,
+             (long)getpid());
+
+    /* The subdirectory is only created when it's first needed */
+    slot->fp = fopen(slot->tmp_path, "wb");
+    if (slot->fp == NULL && errno == ENOENT) {
+        char dir[sizeof(store_dir) + 4];
+        snprintf(dir,
+                 sizeof(dir),
+                 "%.*s",
+                 (int)(strrchr(slot->item.path, '/') - slot->item.path),
+                 slot->item.path);
+        if (make_dirs(dir))
+            slot->fp = fopen(slot->tmp_path, "wb");
+    }
+
+    if (slot->fp == NULL) {
+        ERR("Could not create file '%s': %s",
+            slot->tmp_path,
+            strerror(errno));
+        remove_key(slot->item.md5, slot->item.kind);
+        free(slot->item.url);
+        free(slot->item.path);
+        return false;
+    }
+
+    /* Error pages are not written to the file */
+    CURL* curl = slot->curl;
+    request_handle_set_url(curl, slot->item.url);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_received_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, slot);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, slot);
+
+    const CURLMcode code = curl_multi_add_handle(multi, curl);
+    if (code != CURLM_OK) {
+        ERR("Failed to add request to '%s': %s",
+            slot->item.url,
+            curl_multi_strerror(code));
+        fclose(slot->fp);
+        remove(slot->tmp_path);
+        remove_key(slot->item.md5, slot->item.kind);
+        free(slot->item.url);
+        free(slot->item.path);
+        return false;
+    }
+
+    md5_init(&slot->hash);
+    slot->bytes = 0;
+    slot->busy  = true;
+    active_num++;
+    return true;
+}
+
+/*
+ * Finish the download of a slot, whose transfer returned the specified 'code',
+ * moving the file to the store if it's complete. Returns false if it failed.
+ */
+static bool finish_download(MediaSlot* slot, CURLcode code) {
+    curl_multi_remove_handle(multi, slot->curl);
+    slot->busy = false;
+    active_num--;
+
+    long status = 0;
+    curl_easy_getinfo(slot->curl, CURLINFO_RESPONSE_CODE, &status);
+
+    /* Error statuses also fail the transfer, see 'start_download' */
+    bool ok = true;
+    if (status >= 300) {
+        ERR("Download of '%s' failed with HTTP status %ld.",
+            slot->item.url,
+            status);
+        ok = false;
+    } else if (code != CURLE_OK) {
+        ERR("Failed to download '%s': %s",
+            slot->item.url,
+            curl_easy_strerror(code));
+        ok = false;
+    }
+
+    if (fclose(slot->fp) != 0 && ok) {
+        ERR("Could not write file '%s'.", slot->tmp_path);
+        ok = false;
+    }
+    slot->fp = NULL;
+
+    /*
+     * The MD5 reported by the API is the one of the full file, so a wrong or
+     * truncated body is not stored under it. Thumbnails can't be checked.
+     */
+    if (ok && slot->item.kind == MEDIA_FILES) {
+        uint8_t digest[MD5_SZ];
+        md5_final(&slot->hash, digest);
+        if (memcmp(digest, slot->item.md5, MD5_SZ) != 0) {
+            ERR("Download of '%s' doesn't match its MD5.", slot->item.url);
+            ok = false;
+        }
+    }
+
+    if (ok && rename(slot->tmp_path, slot->item.path) != 0) {
+        ERR("Could not write file '%s'.", slot->item.path);
+        ok = false;
+    }
+
+    if (ok) {
+        counts.downloaded++;
+        counts.bytes += slot->bytes;
+    } else {
+        /* Retried when it's found again, e.g. by the next poll */
+        remove(slot->tmp_path);
+        remove_key(slot->item.md5, slot->item.kind);
+        counts.failed++;
+    }
+
+    free(slot->item.url);
+    free(slot->item.path);
+    return ok;
+}
+
+/*
+ * Start as many queued downloads as the free slots and the rate limits allow.
+ * If the next one has to wait for the rate limit, the number of milliseconds
+ * until it can be started is written to 'wait_ms'; otherwise, it's set to zero.
+ * Returns false if any of them could not be started.
+ */
+static bool start_downloads(long* wait_ms) {
+    bool result = true;
+    *wait_ms    = 0;
+
+    for (size_t i = 0; i < slots_num && queue_next < queue_num; i++) {
+        if (slots[i].busy)
+            continue;
+
+        *wait_ms = ratelimit_acquire(queue[queue_next].url);
+        if (*wait_ms > 0)
+            break;
+
+        if (!start_download(&slots[i])) {
+            counts.failed++;
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Read the messages of the multi handle, finishing the completed downloads.
+ * Returns the number of downloads that finished, and sets 'failed' if any of
+ * them failed.
+ */
+static size_t collect_finished(bool* failed) {
+    size_t finished = 0;
+    CURLMsg* msg;
+    int msgs_left;
+    while ((msg = curl_multi_info_read(multi, &msgs_left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        char* private_ptr = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &private_ptr);
+
+        /* The message is invalidated when the handle is removed */
+        const CURLcode code = msg->data.result;
+        if (!finish_download((MediaSlot*)private_ptr, code))
+            *failed = true;
+        finished++;
+    }
+
+    return finished;
+}
+
+bool media_run(void) {
+    bool failed = false;
+
+    while (queue_next < queue_num || active_num > 0) {
+        long wait_ms;
+        if (!start_downloads(&wait_ms))
+            failed = true;
+
+        /* Wake up when the rate limit allows starting the next download */
+        const int timeout_ms = (wait_ms > 0 && wait_ms < POLL_TIMEOUT_MS)
+                                 ? (int)wait_ms
+                                 : POLL_TIMEOUT_MS;
+
+        int running = 0;
+        CURLMcode code = curl_multi_perform(multi, &running);
+
+        /* Like in the fetching engine, only wait if nothing finished */
+        if (code == CURLM_OK && collect_finished(&failed) == 0 &&
+            (running > 0 || wait_ms > 0))
+            code = curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+        if (code != CURLM_OK) {
+            ERR("Failed to perform downloads: %s", curl_multi_strerror(code));
+            return false;
+        }
+    }
+
+    /* All items were moved to the slots, and freed when they finished */
+    queue_num  = 0;
+    queue_next = 0;
+    return !failed;
+}
+
+void media_get_counts(MediaCounts* dst) {
+    *dst = counts;
+}
+
+void media_free(void) {
+    for (size_t i = 0; i < slots_num; i++) {
+        MediaSlot* slot = &slots[i];
+        if (slot->busy) {
+            curl_multi_remove_handle(multi, slot->curl);
+            fclose(slot->fp);
+            remove(slot->tmp_path);
+            free(slot->item.url);
+            free(slot->item.path);
+        }
+        if (slot->curl != NULL)
+            curl_easy_cleanup(slot->curl);
+    }
+    free(slots);
+    slots      = NULL;
+    slots_num  = 0;
+    active_num = 0;
+
+    for (size_t i = queue_next; i < queue_num; i++) {
+        free(queue[i].url);
+        free(queue[i].path);
+    }
+    free(queue);
+    queue      = NULL;
+    queue_num  = 0;
+    queue_cap  = 0;
+    queue_next = 0;
+
+    free(keys);
+    keys      = NULL;
+    keys_num  = 0;
+    keys_mask = 0;
+
+    if (multi != NULL)
+        curl_multi_cleanup(multi);
+    multi = NULL;
+
+    arena_free(&arena);
+    store_dir[0] = '\0';
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <cjson/cJSON.h>
+
+#include "include/pipeline.h"
+#include "include/arena.h"
+#include "include/buffer.h"
+#include "include/jsonscan.h"
+#include "include/pretty.h"
+#include "include/render.h"
+#include "include/stats.h"
+#include "include/util.h"
+#include "include/main.h"
+
+/*
+ * Position of the ring used for a job. The job with index 'i' always uses the
+ * slot 'i % capacity', like in the fetching engine.
+ */
+typedef struct {
+    PipelineJob job;
+    bool done; /* Processed by a worker, protected by the lock */
+} PipelineSlot;
+
+struct Pipeline {
+    pthread_t* workers;
+    size_t workers_num;
+
+    PipelineSlot* slots;
+    size_t capacity;
+
+    /*
+     * Index of the next job to output, of the next one to be taken by a worker,
+     * and of the next one to be submitted. The last one is only modified by the
+     * main thread, but it's read by the workers.
+     */
+    size_t next_output, next_take, next_submit;
+
+    /* Set when the workers should exit, once there are no more jobs */
+    bool closing;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_submitted; /* Signaled for the workers */
+    pthread_cond_t job_done;      /* Signaled for the main thread */
+
+    PipelineOutput output;
+    void* user_data;
+
+    /* Used for the jobs processed on the main thread, without workers */
+    Arena arena;
+};
+
+/*
+ * Parse and render the thread of a job, using the specified arena for the
+ * parsed JSON.
+ */
+static void process_job(PipelineJob* job, Arena* arena) {
+    job->ok            = false;
+    job->last_rendered = 0;
+
+    /* The thread could not be fetched, the error was already reported */
+    if (job->body.sz == 0)
+        return;
+
+    /* The scanner parses the posts while they are rendered */
+    if (json_scan_enabled()) {
+        const uint64_t start = stats_enabled() ? stats_now_ns() : 0;
+
+        job->ok = pretty_render_thread_scan(&job->out,
+                                            job->body.data,
+                                            job->body.sz,
+                                            job->board,
+                                            job->last_seen,
+                                            &job->last_rendered);
+        if (!job->ok)
+            ERR("Could not parse thread with ID %lu as JSON.", job->id);
+
+        if (stats_enabled())
+            stats_record(STATS_RENDER, stats_now_ns() - start);
+        return;
+    }
+
+    arena_reset(arena);
+
+    const uint64_t parse_start = stats_enabled() ? stats_now_ns() : 0;
+    cJSON* json = arena_parse_json(arena, job->body.data, job->body.sz);
+    if (json == NULL) {
+        ERR("Could not parse thread with ID %lu as JSON.", job->id);
+        return;
+    }
+
+    const uint64_t render_start = stats_enabled() ? stats_now_ns() : 0;
+    stats_record(STATS_PARSE, render_start - parse_start);
+
+    job->ok = pretty_render_thread_since(&job->out,
+                                         json,
+                                         job->board,
+                                         job->last_seen,
+                                         &job->last_rendered);
+
+    if (stats_enabled())
+        stats_record(STATS_RENDER, stats_now_ns() - render_start);
+}
+
+/*
+ * Function run by each worker, until the pipeline is closed.
+ */
+static void* worker_main(void* arg) {
+    Pipeline* pipeline = arg;
+    Arena arena        = ARENA_EMPTY;
+
+    pthread_mutex_lock(&pipeline->lock);
+    for (;;) {
+        while (pipeline->next_take == pipeline->next_submit &&
+               !pipeline->closing)
+            pthread_cond_wait(&pipeline->job_submitted, &pipeline->lock);
+
+        if (pipeline->next_take == pipeline->next_submit)
+            break;
+
+        const size_t idx   = pipeline->next_take++;
+        PipelineSlot* slot = &pipeline->slots[idx % pipeline->capacity];
+
+        pthread_mutex_unlock(&pipeline->lock);
+        process_job(&slot->job, &arena);
+        pthread_mutex_lock(&pipeline->lock);
+
+        slot->done = true;
+        pthread_cond_signal(&pipeline->job_done);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+
+    /* Free the memory of this thread, and keep its statistics */
+    arena_free(&arena);
+    pretty_free();
+    render_free();
+    arena_flush_stats();
+    buffer_flush_stats();
+    return NULL;
+}
+
+Pipeline* pipeline_new(size_t workers_num, PipelineOutput output,
+                       void* user_data) {
+    Pipeline* pipeline = calloc(1, sizeof(Pipeline));
+    if (pipeline == NULL)
+        return NULL;
+
+    /* Without workers, the ring is as big as with a single one */
+    const size_t capacity_workers = (workers_num > 0) ? workers_num : 1;
+
+    pipeline->capacity  = capacity_workers * PIPELINE_JOBS_PER_WORKER;
+    pipeline->arena     = (Arena)ARENA_EMPTY;
+    pipeline->output    = output;
+    pipeline->user_data = user_data;
+
+    pipeline->slots   = calloc(pipeline->capacity, sizeof(PipelineSlot));
+    pipeline->workers = calloc(capacity_workers, sizeof(pthread_t));
+    if (pipeline->slots == NULL || pipeline->workers == NULL) {
+        free(pipeline->slots);
+        free(pipeline->workers);
+        free(pipeline);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->job_submitted, NULL);
+    pthread_cond_init(&pipeline->job_done, NULL);
+
+    for (size_t i = 0; i < workers_num; i++) {
+        if (pthread_create(&pipeline->workers[i],
+                           NULL,
+                           worker_main,
+                           pipeline) != 0) {
+            ERR("Could not start pipeline worker %zu.", i);
+            pipeline_free(pipeline);
+            return NULL;
+        }
+        pipeline->workers_num++;
+    }
+
+    return pipeline;
+}
+
+void pipeline_free(Pipeline* pipeline) {
+    if (pipeline == NULL)
+        return;
+
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->closing = true;
+    pthread_cond_broadcast(&pipeline->job_submitted);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    for (size_t i = 0; i < pipeline->workers_num; i++)
+        pthread_join(pipeline->workers[i], NULL);
+
+    for (size_t i = 0; i < pipeline->capacity; i++) {
+        buffer_free(&pipeline->slots[i].job.body);
+        buffer_free(&pipeline->slots[i].job.out);
+    }
+
+    arena_free(&pipeline->arena);
+
+    pthread_cond_destroy(&pipeline->job_done);
+    pthread_cond_destroy(&pipeline->job_submitted);
+    pthread_mutex_destroy(&pipeline->lock);
+
+    free(pipeline->slots);
+    free(pipeline->workers);
+    free(pipeline);
+}
+
+/*
+ * Pass the oldest submitted job to the output callback. If 'wait' is true, wait
+ * until it's done; otherwise, return false if it's not done yet.
+ */
+static bool output_next(Pipeline* pipeline, bool wait) {
+    PipelineSlot* slot =
+      &pipeline->slots[pipeline->next_output % pipeline->capacity];
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (wait && !slot->done)
+        pthread_cond_wait(&pipeline->job_done, &pipeline->lock);
+    const bool done = slot->done;
+    pthread_mutex_unlock(&pipeline->lock);
+
+    if (!done)
+        return false;
+
+    /* The workers don't touch the job until it's submitted again */
+    pipeline->output(pipeline->user_data, &slot->job);
+    pipeline->next_output++;
+    return true;
+}
+
+PipelineJob* pipeline_next_job(Pipeline* pipeline) {
+    while (pipeline->next_submit - pipeline->next_output >= pipeline->capacity)
+        output_next(pipeline, true);
+
+    PipelineSlot* slot =
+      &pipeline->slots[pipeline->next_submit % pipeline->capacity];
+    slot->done = false;
+
+    PipelineJob* job   = &slot->job;
+    job->board         = DEFAULT_BOARD;
+    job->id            = 0;
+    job->last_seen     = 0;
+    job->status        = 0;
+    job->ok            = false;
+    job->last_rendered = 0;
+    buffer_clear(&job->body);
+    buffer_clear(&job->out);
+    job->validators.etag[0]          = '\0';
+    job->validators.last_modified[0] = '\0';
+
+    return job;
+}
+
+void pipeline_submit(Pipeline* pipeline) {
+    /* Without workers, the job is processed right away */
+    if (pipeline->workers_num == 0) {
+        PipelineSlot* slot =
+          &pipeline->slots[pipeline->next_submit % pipeline->capacity];
+        process_job(&slot->job, &pipeline->arena);
+        slot->done = true;
+
+        pipeline->next_take++;
+        pipeline->next_submit++;
+        return;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->next_submit++;
+    pthread_cond_signal(&pipeline->job_submitted);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+void pipeline_flush(Pipeline* pipeline) {
+    while (pipeline->next_output < pipeline->next_submit &&
+           output_next(pipeline, false))
+        continue;
+}
+
+void pipeline_finish(Pipeline* pipeline) {
+    while (pipeline->next_output < pipeline->next_submit)
+        output_next(pipeline, true);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <cjson/cJSON.h>
+
+#include "include/post.h"
+
+/*
+ * Get the value of a string member of a JSON object, or NULL if it doesn't
+ * exist or if it's not a string.
+ */
+static const char* get_str(cJSON* obj, const char* name) {
+    cJSON* item = cJSON_GetObjectItemCaseSensitive(obj, name);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+/*
+ * Get the value of a number member of a JSON object, or 'fallback' if it
+ * doesn't exist or if it's not a number.
+ */
+static double get_num(cJSON* obj, const char* name, double fallback) {
+    cJSON* item = cJSON_GetObjectItemCaseSensitive(obj, name);
+    return cJSON_IsNumber(item) ? item->valuedouble : fallback;
+}
+
+bool post_from_json(Post* dst, cJSON* src) {
+    if (!cJSON_IsObject(src))
+        return false;
+
+    dst->no       = (PostId)get_num(src, "no", 0);
+    dst->time     = (long long)get_num(src, "time", 0);
+    dst->tim      = (long long)get_num(src, "tim", 0);
+    dst->replies  = (int)get_num(src, "replies", -1);
+    dst->images   = (int)get_num(src, "images", -1);
+    dst->sub      = get_str(src, "sub");
+    dst->name     = get_str(src, "name");
+    dst->filename = get_str(src, "filename");
+    dst->ext      = get_str(src, "ext");
+    dst->com      = get_str(src, "com");
+    return true;
+}
@@ -17,12 +17,22 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h> /* SIZE_MAX */
+#include <stdio.h>  /* snprintf */
 #include <string.h>
-#include <ctype.h> /* isdigit */
+#include <ctype.h> /* isspace */
 
 #include <cjson/cJSON.h>
 
 #include "include/pretty.h"
+#include "include/html.h"
+#include "include/post.h"
+#include "include/buffer.h"
+#include "include/arena.h"
+#include "include/jsonscan.h"
+#include "include/filter.h"
+#include "include/replies.h"
+#include "include/render.h"
 #include "include/request.h"
 #include "include/util.h"
 #include "include/main.h"
@@ -38,128 +48,178 @@
 #define POST_PAD 6
 
 /*
- * Structure representing an HTML entity string, along with its corresponding
- * ASCII character.
+ * Reused for all posts rendered by the current thread. The converted text is
+ * written to a separate buffer, so the source of the post is not modified and
+ * it can be rendered again.
  */
-typedef struct {
-    const char* html_str;
-    size_t html_str_len;
-    char character;
-} HtmlEntityPair;
+static THREAD_LOCAL Buffer converted        = BUFFER_EMPTY;
+static THREAD_LOCAL HtmlSpans converted_spans = HTML_SPANS_EMPTY;
 
 /*
- * Helper macro to create an 'HtmlEntityPair' structure from a string literal
- * and an ASCII character at compile-time.
+ * Reused for all threads scanned by the current thread: the raw members of
+ * each post, as an array of 'JsonPostRaw', and the decoded strings.
  */
-#define HTML_ENTITY_PAIR(HTML, CH)                                             \
-    { .html_str = HTML, .html_str_len = STRLEN(HTML), .character = CH }
+static THREAD_LOCAL Buffer scanned_posts  = BUFFER_EMPTY;
+static THREAD_LOCAL Arena scanned_strings = ARENA_EMPTY;
 
 /*
- * Replace each HTML entity in the input string with its corresponding ASCII
- * character.
+ * Reused for all reply graphs built by the current thread: the posts of the
+ * thread, as an array of 'Post', the memory of the graph, the posts marked by
+ * 'reply_graph_subtree' and the posts hidden by the filters, as arrays of
+ * 'bool'.
  */
-static char* replace_html_entities(char* str) {
-    static const HtmlEntityPair entity_map[] = {
-        HTML_ENTITY_PAIR("&quot;", '\"'), HTML_ENTITY_PAIR("&apos;", '\''),
-        HTML_ENTITY_PAIR("&amp;", '&'),   HTML_ENTITY_PAIR("&lt;", '<'),
-        HTML_ENTITY_PAIR("&gt;", '>'),    HTML_ENTITY_PAIR("&#034;", '\"'),
-        HTML_ENTITY_PAIR("&#039;", '\''), HTML_ENTITY_PAIR("&#038;", '&'),
-        HTML_ENTITY_PAIR("&#060;", '<'),  HTML_ENTITY_PAIR("&#062;", '>'),
-    };
+static THREAD_LOCAL Buffer graph_posts  = BUFFER_EMPTY;
+static THREAD_LOCAL Arena graph_arena   = ARENA_EMPTY;
+static THREAD_LOCAL Buffer graph_marked = BUFFER_EMPTY;
+static THREAD_LOCAL Buffer graph_hidden = BUFFER_EMPTY;
 
-    /*
-     * For each entity in the map, iterate all occurrences of that entity in the
-     * target string. For each occurrence, insert the replacement character and
-     * shift the rest of the input.
-     */
-    for (size_t i = 0; i < ARRLEN(entity_map); i++) {
-        char* cur_ent;
-        while ((cur_ent = strstr(str, entity_map[i].html_str)) != NULL) {
-            *cur_ent = entity_map[i].character;
-            STRMOVE(cur_ent + 1, cur_ent + entity_map[i].html_str_len);
-        }
-    }
+/*
+ * Are the replies of each post rendered below it? Set once, before rendering.
+ */
+static bool backlinks_enabled = false;
+
+/*
+ * Append the padding used for indenting post replies.
+ */
+static inline void append_pad(Buffer* out) {
+    if (!buffer_reserve(out, POST_PAD))
+        return;
 
-    return str;
+    memset(&out->data[out->sz], ' ', POST_PAD);
+    out->sz += POST_PAD;
+    out->data[out->sz] = '\0';
 }
 
 /*
- * Perform a basic conversion between HTML and plain text. The conversion is
- * done in place, and the input buffer is returned.
+ * Append a single character to the output buffer.
  */
-static char* html2txt(char* str) {
-    char* const start = str;
-
-    char* label_start = str;
-    bool in_br        = false;
-
-    while (*str != '\0') {
-        switch (*str) {
-            case '<': {
-                label_start = str;
-                str++;
-
-                /* If label is <br>, store */
-                if (*str++ == 'b' && *str++ == 'r')
-                    in_br = true;
-            } break;
-
-            case '>': {
-                /* If we are closing a <br> string, insert '\n' */
-                if (in_br) {
-                    *label_start++ = '\n';
-                    in_br          = false;
-                }
-
-                /* Shift rest of string */
-                STRMOVE(label_start, str + 1);
-                str = label_start;
-            } break;
-
-            default: {
-                str++;
-            } break;
-        }
-    }
-
-    return start;
+static inline void append_char(Buffer* out, char c) {
+    buffer_append(out, &c, 1);
 }
 
 /*
- * Check if the specified cJSON pointer is non-null number.
+ * Style used for printing a character of a post, depending on the spans that
+ * contain it.
  */
-static inline bool is_cjson_num(cJSON* p) {
-    return p != NULL && cJSON_IsNumber(p);
+typedef enum {
+    STYLE_UNKNOWN, /* The color needs to be printed again */
+    STYLE_POST,
+    STYLE_QUOTE,
+    STYLE_XPOST,
+} TextStyle;
+
+/*
+ * Iterator over the spans of a post, used for obtaining the style of each
+ * character, in increasing order.
+ */
+typedef struct {
+    const HtmlSpans* spans;
+    size_t first; /* First span that might contain the current position */
+} SpanCursor;
+
+/*
+ * Get the style of the character at the specified position, which must not be
+ * lower than the position of the previous call. If 'in_quote' is not NULL, it
+ * is set to whether the character is inside a quote. If 'next_change' is not
+ * NULL, it is set to the first position after 'pos' where the style might be
+ * different.
+ */
+static TextStyle style_at(SpanCursor* cursor, size_t pos, bool* in_quote,
+                          size_t* next_change) {
+    const HtmlSpans* spans = cursor->spans;
+
+    /* Spans are sorted by their start, and they never overlap partially */
+    while (cursor->first < spans->num && spans->data[cursor->first].end <= pos)
+        cursor->first++;
+
+    TextStyle result = STYLE_POST;
+    bool quote       = false;
+    size_t change    = SIZE_MAX;
+
+    size_t i;
+    for (i = cursor->first; i < spans->num && spans->data[i].start <= pos;
+         i++) {
+        const HtmlSpan* span = &spans->data[i];
+        if (pos >= span->end)
+            continue;
+
+        if (span->end < change)
+            change = span->end;
+
+        switch (span->kind) {
+            case HTML_SPAN_QUOTELINK:
+            case HTML_SPAN_DEADLINK:
+                result = STYLE_XPOST;
+                break;
+
+            case HTML_SPAN_QUOTE:
+                quote = true;
+                if (result != STYLE_XPOST)
+                    result = STYLE_QUOTE;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    /* The next span that starts after this position */
+    if (i < spans->num && spans->data[i].start < change)
+        change = spans->data[i].start;
+
+    if (in_quote != NULL)
+        *in_quote = quote;
+    if (next_change != NULL)
+        *next_change = change;
+    return result;
 }
 
 /*
- * Check if the specified cJSON pointer is non-null string.
+ * Get the color sequence for the specified style.
  */
-static inline bool is_cjson_str(cJSON* p) {
-    return p != NULL && cJSON_IsString(p);
+static const char* style_color(TextStyle style) {
+    switch (style) {
+        case STYLE_QUOTE:
+            return COL_QUOTE;
+        case STYLE_XPOST:
+            return COL_XPOST;
+        default:
+            return COL_POST;
+    }
 }
 
 /*
- * Print a constant amount of padding.
+ * Convert the HTML of a post into plain text, writing it to the specified
+ * buffer. See 'html2txt'.
  */
-static inline void print_pad(FILE* fp, int amount) {
-    for (int i = 0; i < amount; i++)
-        fputc(' ', fp);
+static bool convert_html(Buffer* dst, const char* html, HtmlSpans* spans) {
+    buffer_clear(dst);
+
+    /* The plain text is never longer than the HTML */
+    const size_t html_len = strlen(html);
+    if (!buffer_reserve(dst, html_len))
+        return false;
+
+    dst->sz = html2txt(dst->data, html, spans);
+    return true;
 }
 
 /*
- * Print the specified string as if they were the contents of a 4chan post,
- * wrapping lines at word boundaries if they exceed MAX_COLUMN.
+ * Append the specified string as if they were the contents of a 4chan post,
+ * wrapping lines at word boundaries if they exceed MAX_COLUMN. The spans
+ * returned by 'html2txt' are used for coloring quotes and quotelinks.
  */
-static void print_post_contents(FILE* fp, const char* str, bool use_pad) {
-    bool in_quote = false; /* >foo */
-    enum {
-        XPOST_NONE,
-        XPOST_DIGITS, /* >>123456789 */
-        XPOST_TEXT,   /* >>>/foo/ */
-    } xpost_state = XPOST_NONE;
-
-    /* Position in the string of the last printed newline or space */
+static void render_post_contents(Buffer* out, const char* str,
+                                 const HtmlSpans* spans, bool use_pad) {
+    SpanCursor cursor = {
+        .spans = spans,
+        .first = 0,
+    };
+
+    /* Style of the last appended character */
+    TextStyle cur_style = STYLE_POST;
+
+    /* Position in the string of the last appended newline or space */
     size_t last_newline_idx = 0, last_space_idx = 0;
 
     size_t max_column = MAX_COLUMN;
@@ -172,155 +232,665 @@ static void print_post_contents(FILE* fp, const char* str, bool use_pad) {
          * Store that we found a space (and optionally a newline) in the current
          * iteration.
          */
-        if (isspace(str[i])) {
+        if (isspace((unsigned char)str[i])) {
             last_space_idx = i;
             if (str[i] == '\n')
                 last_newline_idx = i;
             continue;
         }
 
-        if (!isspace(str[i + 1]) && str[i + 1] != '\0')
+        if (!isspace((unsigned char)str[i + 1]) && str[i + 1] != '\0')
             continue;
 
         const bool is_first_word_of_input_line =
           (last_space_idx == 0 || str[last_space_idx] == '\n');
 
+        const size_t word_start =
+          (last_space_idx == 0) ? 0 : last_space_idx + 1;
+
+        bool in_quote;
+        style_at(&cursor, word_start, &in_quote, NULL);
+
         if (i - last_newline_idx >= max_column) {
-            fputc('\n', fp);
+            append_char(out, '\n');
             last_newline_idx = last_space_idx;
             if (use_pad)
-                print_pad(fp, POST_PAD);
+                append_pad(out);
+
             /*
              * It shouldn't be necessary to specify the color again, but some
              * terminals reset on newline (e.g. when piping to 'less -R').
              */
-            if (in_quote)
-                fprintf(fp, COL_QUOTE ">");
+            if (in_quote) {
+                buffer_append_str(out, COL_QUOTE ">");
+                cur_style = STYLE_QUOTE;
+            } else if (cur_style != STYLE_POST) {
+                cur_style = STYLE_UNKNOWN;
+            }
         } else if (last_space_idx != 0) {
-            fputc(str[last_space_idx], fp);
+            append_char(out, str[last_space_idx]);
+            if (str[last_space_idx] == '\n' && cur_style != STYLE_POST)
+                cur_style = STYLE_UNKNOWN;
         }
 
-        /* Whenever we change an input line, reset color and quote state */
-        if (is_first_word_of_input_line) {
-            if (in_quote || xpost_state != XPOST_NONE)
-                fprintf(fp, COL_POST);
-            if (use_pad)
-                print_pad(fp, POST_PAD);
-            in_quote    = false;
-            xpost_state = XPOST_NONE;
-        }
+        if (is_first_word_of_input_line && use_pad)
+            append_pad(out);
 
-        /* Print the last word of the input */
-        const size_t word_start =
-          (last_space_idx == 0) ? 0 : last_space_idx + 1;
-        for (size_t j = word_start; j <= i; j++) {
-            /* Check if this character starts a quote, and what kind */
-            if (xpost_state == XPOST_NONE && str[j] == '>') {
-                if (str[j + 1] == '>') {
-                    if (isdigit(str[j + 2])) {
-                        xpost_state = XPOST_DIGITS; /* >>123456789 */
-                        fprintf(fp, COL_XPOST);
-                    } else if (str[j + 2] == '>') {
-                        xpost_state = XPOST_TEXT; /* >>>/foo/ */
-                        fprintf(fp, COL_XPOST);
-                    }
-
-                    while (str[j + 1] == '>')
-                        fputc(str[j++], fp);
-                } else if (is_first_word_of_input_line && !in_quote) {
-                    in_quote = true; /* >foo */
-                    fprintf(fp, COL_QUOTE);
-                }
-            } else if ((xpost_state == XPOST_DIGITS && !isdigit(str[j])) ||
-                       (xpost_state == XPOST_TEXT && isspace(str[j]))) {
-                const char* old_color = (in_quote) ? COL_QUOTE : COL_POST;
-                fprintf(fp, "%s", old_color);
-                xpost_state = XPOST_NONE;
+        /*
+         * Append the last word of the input, changing colors as needed. The
+         * characters between span boundaries are appended at once.
+         */
+        size_t run_start = word_start;
+        while (run_start <= i) {
+            size_t run_end;
+            const TextStyle style =
+              style_at(&cursor, run_start, NULL, &run_end);
+            if (style != cur_style) {
+                buffer_append_str(out, style_color(style));
+                cur_style = style;
             }
 
-            fputc(str[j], fp);
+            if (run_end > i + 1)
+                run_end = i + 1;
+
+            buffer_append(out, &str[run_start], run_end - run_start);
+            run_start = run_end;
         }
     }
 
     /* Reset terminal color */
-    fprintf(fp, "%s", COL_NORM);
+    buffer_append_str(out, COL_NORM);
 }
 
-bool pretty_print_thread(FILE* fp, cJSON* thread_json) {
-    cJSON* posts = cJSON_GetObjectItemCaseSensitive(thread_json, "posts");
-    if (!posts || !cJSON_IsArray(posts))
-        return false;
+bool pretty_render_post(Buffer* out, const Post* post, const HtmlText* com,
+                        const char* board, bool is_reply) {
+    append_char(out, '\n');
+    if (is_reply)
+        append_pad(out);
+
+    /* Post ID */
+    if (post->no != 0)
+        buffer_printf(out, COL_INFO "[%lu] " COL_NORM, post->no);
+    else
+        buffer_append_str(out, COL_INFO "[???] " COL_NORM);
+
+    /* Title */
+    buffer_append_str(out, COL_TITLE);
+    if (post->sub != NULL && convert_html(&converted, post->sub, NULL))
+        buffer_append(out, converted.data, converted.sz);
+    else
+        buffer_append_str(out, "Anonymous");
+    buffer_append_str(out, COL_NORM);
+
+    /* Reply and image count */
+    if (post->replies >= 0) {
+        buffer_printf(out, COL_REPLIES " (%d replies", post->replies);
+        if (post->images >= 0)
+            buffer_printf(out, ", %d images", post->images);
+        buffer_append_str(out, ")" COL_NORM);
+    }
+
+    /* Image URL and filename */
+    if (post->tim != 0 && post->ext != NULL) {
+        append_char(out, '\n');
+        if (is_reply)
+            append_pad(out);
+
+        buffer_printf(out,
+                      COL_URL "https://i.4cdn.org/%s/%lld%s" COL_NORM,
+                      board,
+                      post->tim,
+                      post->ext);
+
+        if (post->filename != NULL)
+            buffer_printf(out,
+                          " (" COL_FILENAME "%s%s" COL_NORM ")",
+                          post->filename,
+                          post->ext);
+    }
+
+    /* Post contents, converted unless they already were */
+    if (com != NULL) {
+        append_char(out, '\n');
+        render_post_contents(out, com->text, &com->spans, is_reply);
+    } else if (post->com != NULL &&
+               convert_html(&converted, post->com, &converted_spans)) {
+        append_char(out, '\n');
+        render_post_contents(out, converted.data, &converted_spans, is_reply);
+    }
+
+    append_char(out, '\n');
+    return true;
+}
+
+bool pretty_render_thread(Buffer* out, cJSON* thread_json, const char* board) {
+    return pretty_render_thread_since(out, thread_json, board, 0, NULL);
+}
+
+/*
+ * Get the number of the specified post, or zero if it doesn't have one.
+ */
+static PostId get_post_no(cJSON* post) {
+    cJSON* post_no = cJSON_GetObjectItemCaseSensitive(post, "no");
+    return cJSON_IsNumber(post_no) ? (PostId)post_no->valuedouble : 0;
+}
 
-    /* Is this the first post? */
-    int post_count = 0;
+void pretty_render_new_replies_header(Buffer* out, PostId op_no) {
+    buffer_printf(out, "\n" COL_INFO ">>%lu" COL_NORM " new replies:\n", op_no);
+}
+
+/*
+ * Fill 'graph_posts' with the posts of the 'posts' array of a thread JSON.
+ */
+static bool collect_posts(cJSON* posts) {
+    buffer_clear(&graph_posts);
 
     cJSON* p;
     cJSON_ArrayForEach(p, posts) {
-        cJSON* post_no       = cJSON_GetObjectItemCaseSensitive(p, "no");
-        cJSON* post_replies  = cJSON_GetObjectItemCaseSensitive(p, "replies");
-        cJSON* post_images   = cJSON_GetObjectItemCaseSensitive(p, "images");
-        cJSON* post_title    = cJSON_GetObjectItemCaseSensitive(p, "sub");
-        cJSON* post_filename = cJSON_GetObjectItemCaseSensitive(p, "filename");
-        cJSON* post_ext      = cJSON_GetObjectItemCaseSensitive(p, "ext");
-        cJSON* post_img_url  = cJSON_GetObjectItemCaseSensitive(p, "tim");
-        cJSON* post_content  = cJSON_GetObjectItemCaseSensitive(p, "com");
-
-        fputc('\n', fp);
-        if (post_count > 0)
-            print_pad(fp, POST_PAD);
-
-        /* Post ID */
-        if (is_cjson_num(post_no))
-            fprintf(fp, COL_INFO "[%d] " COL_NORM, post_no->valueint);
-        else
-            fprintf(fp, COL_INFO "[???] " COL_NORM);
-
-        /* Title */
-        if (is_cjson_str(post_title))
-            fprintf(fp,
-                    COL_TITLE "%s" COL_NORM,
-                    replace_html_entities(post_title->valuestring));
-        else
-            fprintf(fp, COL_TITLE "Anonymous" COL_NORM);
-
-        /* Reply and image count */
-        if (is_cjson_num(post_replies)) {
-            fprintf(fp, COL_REPLIES " (%d replies", post_replies->valueint);
-            if (is_cjson_num(post_images))
-                fprintf(fp, ", %d images", post_images->valueint);
-            fprintf(fp, ")" COL_NORM);
+        Post post;
+        if (post_from_json(&post, p) &&
+            !buffer_append(&graph_posts, (const char*)&post, sizeof(post)))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Fill 'graph_hidden' with whether each of the specified posts is hidden by the
+ * filters. Returns NULL on failure.
+ */
+static const bool* find_hidden(const Post* posts, size_t posts_num) {
+    buffer_clear(&graph_hidden);
+    if (!buffer_reserve(&graph_hidden, posts_num * sizeof(bool)))
+        return NULL;
+
+    bool* hidden = (bool*)graph_hidden.data;
+    for (size_t i = 0; i < posts_num; i++)
+        hidden[i] = filter_post_hidden(&posts[i]);
+
+    return hidden;
+}
+
+/*
+ * Convert the HTML of a post into plain text, like 'convert_html', but keeping
+ * the text and its spans in 'graph_arena'. Returns false on failure.
+ */
+static bool convert_html_kept(HtmlText* dst, const char* html) {
+    /* The plain text is never longer than the HTML */
+    char* text = arena_alloc(&graph_arena, strlen(html) + 1);
+    if (text == NULL)
+        return false;
+
+    const size_t len = html2txt(text, html, &converted_spans);
+
+    HtmlSpan* spans = NULL;
+    if (converted_spans.num > 0) {
+        const size_t spans_sz = converted_spans.num * sizeof(HtmlSpan);
+        spans                 = arena_alloc(&graph_arena, spans_sz);
+        if (spans == NULL)
+            return false;
+        memcpy(spans, converted_spans.data, spans_sz);
+    }
+
+    dst->text       = text;
+    dst->len        = len;
+    dst->spans.data = spans;
+    dst->spans.num  = converted_spans.num;
+    dst->spans.cap  = converted_spans.num;
+    return true;
+}
+
+/*
+ * Build the reply graph of the specified posts of a thread. The contents of
+ * each post are converted to find their quotelinks, except for the hidden
+ * posts, whose quotelinks are ignored. The converted contents of the posts from
+ * 'keep_from' on are returned, so they are rendered without converting them
+ * again; the ones that were not kept have a NULL text. Returns NULL on failure.
+ */
+static const HtmlText* build_graph(ReplyGraph* graph, const Post* posts,
+                                   size_t posts_num, const bool* hidden,
+                                   size_t keep_from) {
+    arena_reset(&graph_arena);
+
+    HtmlText* texts = arena_alloc(&graph_arena, posts_num * sizeof(HtmlText));
+    if (texts == NULL || !reply_graph_init(graph, &graph_arena, posts_num))
+        return NULL;
+
+    for (size_t i = 0; i < posts_num; i++) {
+        HtmlText* text = &texts[i];
+        text->text     = NULL;
+        text->len      = 0;
+        text->spans    = (HtmlSpans)HTML_SPANS_EMPTY;
+
+        const HtmlSpans* spans = NULL;
+        if (hidden[i] || posts[i].com == NULL) {
+            spans = NULL;
+        } else if (i >= keep_from) {
+            if (!convert_html_kept(text, posts[i].com))
+                return NULL;
+            spans = &text->spans;
+        } else if (convert_html(&converted, posts[i].com, &converted_spans)) {
+            spans = &converted_spans;
         }
 
-        /* Image URL and filename */
-        if (is_cjson_num(post_img_url) && is_cjson_str(post_ext)) {
-            fputc('\n', fp);
-            if (post_count > 0)
-                print_pad(fp, POST_PAD);
-
-            fprintf(fp,
-                    COL_URL "https://i.4cdn.org/" BOARD "/%.0f%s" COL_NORM,
-                    post_img_url->valuedouble,
-                    post_ext->valuestring);
-
-            if (is_cjson_str(post_filename))
-                fprintf(fp,
-                        " (" COL_FILENAME "%s%s" COL_NORM ")",
-                        post_filename->valuestring,
-                        post_ext->valuestring);
+        if (!reply_graph_add(graph, posts[i].no, spans))
+            return NULL;
+    }
+
+    return texts;
+}
+
+void pretty_render_replies(Buffer* out, const ReplyGraph* graph, size_t pos,
+                           bool is_reply) {
+    const ReplyEdge* edge = graph->nodes[pos].first_reply;
+    if (edge == NULL)
+        return;
+
+    size_t max_column = MAX_COLUMN;
+    if (is_reply) {
+        max_column -= POST_PAD;
+        append_pad(out);
+    }
+
+    buffer_append_str(out, COL_INFO "replies:" COL_XPOST);
+    size_t column = strlen("replies:");
+
+    for (; edge != NULL; edge = edge->next) {
+        char link[32];
+        const int len = snprintf(link,
+                                 sizeof(link),
+                                 ">>%lu",
+                                 graph->nodes[edge->from].no);
+        if (len <= 0 || (size_t)len >= sizeof(link))
+            continue;
+
+        if (column + 1 + len > max_column) {
+            buffer_append_str(out, COL_NORM "\n");
+            if (is_reply)
+                append_pad(out);
+            buffer_append_str(out, COL_XPOST);
+            column = 0;
+        } else {
+            append_char(out, ' ');
+            column++;
         }
 
-        /* Post contents */
-        if (is_cjson_str(post_content)) {
-            const char* converted =
-              replace_html_entities(html2txt(post_content->valuestring));
+        buffer_append(out, link, len);
+        column += len;
+    }
+
+    buffer_append_str(out, COL_NORM "\n");
+}
+
+/*
+ * Render the posts of a thread whose number is greater than 'last_seen', like
+ * 'pretty_render_thread_since', each of them followed by its replies.
+ */
+static bool render_posts_since(Buffer* out, const Post* posts,
+                               size_t posts_num, const char* board,
+                               PostId last_seen, PostId* last_rendered) {
+    if (posts_num == 0 || !filter_thread_shown(&posts[0]))
+        return true;
+
+    size_t start = posts_num;
+    while (start > 0 && (last_seen == 0 || posts[start - 1].no > last_seen))
+        start--;
+
+    if (start >= posts_num)
+        return true;
+
+    const bool* hidden = find_hidden(posts, posts_num);
+    if (hidden == NULL)
+        return false;
+
+    /*
+     * The replies need the quotelinks of every post, so the contents of the
+     * rendered posts are kept from building the graph, instead of converting
+     * them again. Renderers without replies don't need the graph.
+     */
+    const Renderer* renderer = render_current();
+    ReplyGraph graph;
+    const HtmlText* texts = NULL;
+    if (renderer->replies != NULL) {
+        texts = build_graph(&graph, posts, posts_num, hidden, start);
+        if (texts == NULL)
+            return false;
+    }
+
+    if (start != 0 && renderer->new_replies_header != NULL)
+        renderer->new_replies_header(out, posts[0].no);
+
+    for (size_t i = start; i < posts_num; i++) {
+        if (hidden[i])
+            continue;
+
+        const HtmlText* com =
+          (texts != NULL && texts[i].text != NULL) ? &texts[i] : NULL;
+        renderer->post(out, &posts[i], com, board, posts[0].no, i != 0);
+        if (texts != NULL)
+            renderer->replies(out, &graph, i, i != 0);
+    }
+
+    if (last_rendered != NULL)
+        *last_rendered = posts[posts_num - 1].no;
+
+    return true;
+}
+
+bool pretty_render_thread_since(Buffer* out, cJSON* thread_json,
+                                const char* board, PostId last_seen,
+                                PostId* last_rendered) {
+    cJSON* posts = cJSON_GetObjectItemCaseSensitive(thread_json, "posts");
+    if (!posts || !cJSON_IsArray(posts))
+        return false;
 
-            fputc('\n', fp);
-            print_post_contents(fp, converted, post_count > 0);
+    /* The replies of the rendered posts can be anywhere in the thread */
+    if (backlinks_enabled) {
+        if (!collect_posts(posts))
+            return false;
+
+        return render_posts_since(out,
+                                  (const Post*)graph_posts.data,
+                                  graph_posts.sz / sizeof(Post),
+                                  board,
+                                  last_seen,
+                                  last_rendered);
+    }
+
+    cJSON* first = posts->child;
+    if (first == NULL)
+        return true;
+
+    /* The OP decides if the thread is shown, even if it's not rendered */
+    Post op;
+    if (filter_enabled() && post_from_json(&op, first) &&
+        !filter_thread_shown(&op))
+        return true;
+
+    /*
+     * Walk backwards from the last post (the 'prev' member of the first
+     * element), until a post that was already seen. The older posts of the
+     * thread are never visited.
+     */
+    cJSON* start = NULL;
+    for (cJSON* p = first->prev; p != NULL; p = p->prev) {
+        if (last_seen != 0 && get_post_no(p) <= last_seen)
+            break;
+
+        start = p;
+        if (p == first)
+            break;
+    }
+
+    if (start == NULL)
+        return true;
+
+    const Renderer* renderer = render_current();
+    const PostId op_no       = get_post_no(first);
+
+    /* Show which thread the replies belong to, if the OP is not rendered */
+    if (start != first && renderer->new_replies_header != NULL)
+        renderer->new_replies_header(out, op_no);
+
+    for (cJSON* p = start; p != NULL; p = p->next) {
+        Post post;
+        if (post_from_json(&post, p) && !filter_post_hidden(&post))
+            renderer->post(out, &post, NULL, board, op_no, p != first);
+    }
+
+    if (last_rendered != NULL)
+        *last_rendered = get_post_no(first->prev);
+
+    return true;
+}
+
+void pretty_render_omitted_header(Buffer* out, int omitted) {
+    append_char(out, '\n');
+    append_pad(out);
+    buffer_printf(out, COL_INFO "%d replies omitted." COL_NORM "\n", omitted);
+}
+
+void pretty_render_board_header(Buffer* out, const char* board) {
+    buffer_printf(out, "\n" COL_INFO "/%s/" COL_NORM "\n", board);
+}
+
+bool pretty_render_catalog_thread(Buffer* out, cJSON* thread_json,
+                                  const char* board) {
+    Post op;
+    if (!post_from_json(&op, thread_json))
+        return false;
+
+    if (!filter_thread_shown(&op))
+        return true;
+
+    const Renderer* renderer = render_current();
+    renderer->post(out, &op, NULL, board, op.no, false);
+
+    cJSON* omitted = cJSON_GetObjectItemCaseSensitive(thread_json,
+                                                      "omitted_posts");
+    if (cJSON_IsNumber(omitted) && omitted->valueint > 0 &&
+        renderer->omitted_header != NULL)
+        renderer->omitted_header(out, omitted->valueint);
+
+    cJSON* last_replies =
+      cJSON_GetObjectItemCaseSensitive(thread_json, "last_replies");
+    cJSON* reply;
+    cJSON_ArrayForEach(reply, last_replies) {
+        /* The OP was already rendered, in case it's also listed */
+        Post post;
+        if (post_from_json(&post, reply) && post.no != op.no &&
+            !filter_post_hidden(&post))
+            renderer->post(out, &post, NULL, board, op.no, true);
+    }
+
+    return true;
+}
+
+/*
+ * Get the number of a scanned post, or zero if it doesn't have one.
+ */
+static PostId get_raw_post_no(const JsonPostRaw* post) {
+    return (PostId)json_raw_number(&post->no, 0);
+}
+
+bool pretty_render_thread_scan(Buffer* out, const char* json, size_t json_sz,
+                               const char* board, PostId last_seen,
+                               PostId* last_rendered) {
+    JsonScanner scanner;
+    if (!json_scan_thread(&scanner, json, json_sz))
+        return false;
+
+    /* Locate all posts first, since they are visited backwards */
+    buffer_clear(&scanned_posts);
+    JsonPostRaw raw;
+    while (json_scan_next_post(&scanner, &raw))
+        if (!buffer_append(&scanned_posts, (const char*)&raw, sizeof(raw)))
+            return false;
+
+    if (scanner.failed)
+        return false;
+
+    const JsonPostRaw* posts = (const JsonPostRaw*)scanned_posts.data;
+    const size_t posts_num   = scanned_posts.sz / sizeof(JsonPostRaw);
+    if (posts_num == 0)
+        return true;
+
+    /* All posts are needed for finding the replies of the rendered ones */
+    if (backlinks_enabled) {
+        arena_reset(&scanned_strings);
+        buffer_clear(&graph_posts);
+        for (size_t i = 0; i < posts_num; i++) {
+            Post post;
+            if (!json_post_decode(&post, &posts[i], &scanned_strings) ||
+                !buffer_append(&graph_posts, (const char*)&post, sizeof(post)))
+                return false;
         }
 
-        fputc('\n', fp);
-        post_count++;
+        return render_posts_since(out,
+                                  (const Post*)graph_posts.data,
+                                  posts_num,
+                                  board,
+                                  last_seen,
+                                  last_rendered);
+    }
+
+    if (filter_enabled()) {
+        Post op;
+        arena_reset(&scanned_strings);
+        if (!json_post_decode(&op, &posts[0], &scanned_strings))
+            return false;
+        if (!filter_thread_shown(&op))
+            return true;
+    }
+
+    /* Like 'pretty_render_thread_since', stop at a post that was seen */
+    size_t start = posts_num;
+    while (start > 0 &&
+           (last_seen == 0 || get_raw_post_no(&posts[start - 1]) > last_seen))
+        start--;
+
+    if (start >= posts_num)
+        return true;
+
+    const Renderer* renderer = render_current();
+    const PostId op_no       = get_raw_post_no(&posts[0]);
+    if (start != 0 && renderer->new_replies_header != NULL)
+        renderer->new_replies_header(out, op_no);
+
+    /* Only the strings of the rendered posts are decoded */
+    arena_reset(&scanned_strings);
+    for (size_t i = start; i < posts_num; i++) {
+        Post post;
+        if (!json_post_decode(&post, &posts[i], &scanned_strings))
+            return false;
+
+        if (!filter_post_hidden(&post))
+            renderer->post(out, &post, NULL, board, op_no, i != 0);
+    }
+
+    if (last_rendered != NULL)
+        *last_rendered = get_raw_post_no(&posts[posts_num - 1]);
+
+    return true;
+}
+
+bool pretty_render_posts(Buffer* out, const Post* posts, size_t posts_num,
+                         const char* board) {
+    if (backlinks_enabled)
+        return render_posts_since(out, posts, posts_num, board, 0, NULL);
+
+    if (posts_num == 0 || !filter_thread_shown(&posts[0]))
+        return true;
+
+    const Renderer* renderer = render_current();
+    for (size_t i = 0; i < posts_num; i++)
+        if (!filter_post_hidden(&posts[i]))
+            renderer->post(out,
+                           &posts[i],
+                           NULL,
+                           board,
+                           posts[0].no,
+                           i != 0);
+
+    return true;
+}
+
+bool pretty_render_subtree(Buffer* out, cJSON* thread_json, const char* board,
+                           PostId root_no) {
+    cJSON* posts = cJSON_GetObjectItemCaseSensitive(thread_json, "posts");
+    if (!posts || !cJSON_IsArray(posts) || !collect_posts(posts))
+        return false;
+
+    const Post* collected  = (const Post*)graph_posts.data;
+    const size_t posts_num = graph_posts.sz / sizeof(Post);
+
+    /* The root is only known after building the graph, so keep every post */
+    const bool* hidden = find_hidden(collected, posts_num);
+    ReplyGraph graph;
+    const HtmlText* texts =
+      (hidden != NULL) ? build_graph(&graph, collected, posts_num, hidden, 0)
+                       : NULL;
+    if (texts == NULL)
+        return false;
+
+    const size_t root = reply_graph_find(&graph, root_no);
+    if (root == REPLY_NONE)
+        return false;
+
+    buffer_clear(&graph_marked);
+    if (!buffer_reserve(&graph_marked, posts_num * sizeof(bool)))
+        return false;
+
+    bool* marked = (bool*)graph_marked.data;
+    reply_graph_subtree(&graph, root, marked);
+
+    /* The root is not indented, so its replies stand out below it */
+    const Renderer* renderer = render_current();
+    for (size_t i = root; i < posts_num; i++) {
+        if (!marked[i] || hidden[i])
+            continue;
+
+        const HtmlText* com = (texts[i].text != NULL) ? &texts[i] : NULL;
+        renderer->post(out,
+                       &collected[i],
+                       com,
+                       board,
+                       collected[0].no,
+                       i != root);
+        if (renderer->replies != NULL)
+            renderer->replies(out, &graph, i, i != root);
     }
 
     return true;
 }
+
+void pretty_enable_backlinks(bool enable) {
+    backlinks_enabled = enable;
+}
+
+void pretty_free(void) {
+    buffer_free(&converted);
+    html_spans_free(&converted_spans);
+    buffer_free(&scanned_posts);
+    arena_free(&scanned_strings);
+    buffer_free(&graph_posts);
+    arena_free(&graph_arena);
+    buffer_free(&graph_marked);
+    buffer_free(&graph_hidden);
+}
+
+/*
+ * Write the whole buffer to the specified file, with a single call.
+ */
+static bool write_buffer(FILE* fp, const Buffer* buffer) {
+    return buffer->sz == 0 ||
+           fwrite(buffer->data, 1, buffer->sz, fp) == buffer->sz;
+}
+
+bool pretty_print_post(FILE* fp, const Post* post, const char* board,
+                       bool is_reply) {
+    static Buffer out = BUFFER_EMPTY;
+    buffer_clear(&out);
+
+    return pretty_render_post(&out, post, NULL, board, is_reply) &&
+           write_buffer(fp, &out);
+}
+
+bool pretty_print_thread(FILE* fp, cJSON* thread_json, const char* board) {
+    return pretty_print_thread_since(fp, thread_json, board, 0, NULL);
+}
+
+bool pretty_print_thread_since(FILE* fp, cJSON* thread_json,
+                               const char* board, PostId last_seen,
+                               PostId* last_rendered) {
+    static Buffer out = BUFFER_EMPTY;
+    buffer_clear(&out);
+
+    return pretty_render_thread_since(&out,
+                                      thread_json,
+                                      board,
+                                      last_seen,
+                                      last_rendered) &&
+           write_buffer(fp, &out);
+}
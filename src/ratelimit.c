@@ -0,0 +1,210 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h> /* strtod */
+#include <string.h>
+#include <time.h> /* clock_gettime, nanosleep */
+
+#include "include/ratelimit.h"
+#include "include/util.h"
+
+/*
+ * Maximum number of hosts with a specific limit, and maximum length of their
+ * names.
+ */
+#define MAX_HOSTS   16
+#define MAX_HOST_SZ 256
+
+typedef struct {
+    double rate;   /* Tokens added per second, or zero if unlimited */
+    double burst;  /* Maximum number of tokens */
+    double tokens; /* Available tokens, updated lazily */
+    uint64_t last_refill_ns;
+} Bucket;
+
+typedef struct {
+    char name[MAX_HOST_SZ];
+    Bucket bucket;
+} HostBucket;
+
+/*
+ * Bucket of the hosts without a specific limit. It starts full, like the rest.
+ */
+static Bucket default_bucket = {
+    .rate   = RATELIMIT_DEFAULT_RATE,
+    .burst  = 1.0,
+    .tokens = 1.0,
+};
+
+static HostBucket hosts[MAX_HOSTS];
+static size_t hosts_num = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void bucket_init(Bucket* bucket, double rate, double burst) {
+    bucket->rate           = rate;
+    bucket->burst          = (burst < 1.0) ? 1.0 : burst;
+    bucket->tokens         = bucket->burst;
+    bucket->last_refill_ns = 0;
+}
+
+/*
+ * Get the host of the specified URL, without the user information and the port.
+ * Returns the length of the host, which starts at '*start'.
+ */
+static size_t url_host(const char* url, const char** start) {
+    const char* scheme_end = strstr(url, "://");
+    const char* host       = (scheme_end == NULL) ? url : scheme_end + 3;
+
+    const size_t authority_len = strcspn(host, "/?#");
+    const char* at             = memchr(host, '@', authority_len);
+    if (at != NULL)
+        host = at + 1;
+
+    /* IPv6 addresses are enclosed in brackets, and they contain colons */
+    size_t len;
+    if (*host == '[') {
+        const char* end = strchr(host, ']');
+        len = (end == NULL) ? strcspn(host, "/?#") : (size_t)(end - host) + 1;
+    } else {
+        len = strcspn(host, ":/?#");
+    }
+
+    *start = host;
+    return len;
+}
+
+/*
+ * Get the bucket used for the requests to the specified URL.
+ */
+static Bucket* find_bucket(const char* url) {
+    const char* host;
+    const size_t host_len = url_host(url, &host);
+
+    for (size_t i = 0; i < hosts_num; i++)
+        if (strlen(hosts[i].name) == host_len &&
+            strncmp(hosts[i].name, host, host_len) == 0)
+            return &hosts[i].bucket;
+
+    return &default_bucket;
+}
+
+bool ratelimit_set(const char* host, double rate, double burst) {
+    if (host == NULL) {
+        bucket_init(&default_bucket, rate, burst);
+        return true;
+    }
+
+    size_t i;
+    for (i = 0; i < hosts_num; i++)
+        if (strcmp(hosts[i].name, host) == 0)
+            break;
+
+    if (i >= hosts_num) {
+        if (hosts_num >= MAX_HOSTS) {
+            ERR("Too many hosts with a rate limit (maximum %d).", MAX_HOSTS);
+            return false;
+        }
+        if (strlen(host) >= MAX_HOST_SZ) {
+            ERR("Host name too long: '%s'.", host);
+            return false;
+        }
+        strcpy(hosts[hosts_num++].name, host);
+    }
+
+    bucket_init(&hosts[i].bucket, rate, burst);
+    return true;
+}
+
+bool ratelimit_parse(const char* spec) {
+    static char host[MAX_HOST_SZ];
+
+    /* The host is optional */
+    const char* numbers = strchr(spec, '=');
+    if (numbers != NULL) {
+        const size_t host_len = numbers - spec;
+        if (host_len == 0 || host_len >= sizeof(host))
+            return false;
+        memcpy(host, spec, host_len);
+        host[host_len] = '\0';
+        numbers++;
+    } else {
+        numbers = spec;
+    }
+
+    char* endptr;
+    const double rate = strtod(numbers, &endptr);
+    if (endptr == numbers || rate < 0.0)
+        return false;
+
+    double burst = 1.0;
+    if (*endptr == ':') {
+        const char* burst_str = endptr + 1;
+        burst                 = strtod(burst_str, &endptr);
+        if (endptr == burst_str || burst < 1.0)
+            return false;
+    }
+
+    if (*endptr != '\0')
+        return false;
+
+    return ratelimit_set((spec == numbers) ? NULL : host, rate, burst);
+}
+
+long ratelimit_acquire(const char* url) {
+    Bucket* bucket = find_bucket(url);
+    if (bucket->rate <= 0.0)
+        return 0;
+
+    /* Add the tokens generated since the last call */
+    const uint64_t now = now_ns();
+    if (bucket->last_refill_ns != 0) {
+        const double elapsed = (now - bucket->last_refill_ns) / 1e9;
+        bucket->tokens += elapsed * bucket->rate;
+        if (bucket->tokens > bucket->burst)
+            bucket->tokens = bucket->burst;
+    }
+    bucket->last_refill_ns = now;
+
+    if (bucket->tokens >= 1.0) {
+        bucket->tokens -= 1.0;
+        return 0;
+    }
+
+    /* Round up, so the token is available when the caller retries */
+    const double wait_ms = (1.0 - bucket->tokens) / bucket->rate * 1e3;
+    return (long)wait_ms + 1;
+}
+
+void ratelimit_wait(const char* url) {
+    long wait_ms;
+    while ((wait_ms = ratelimit_acquire(url)) > 0) {
+        const struct timespec ts = {
+            .tv_sec  = wait_ms / 1000,
+            .tv_nsec = (wait_ms % 1000) * 1000000L,
+        };
+        nanosleep(&ts, NULL);
+    }
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "include/render.h"
+#include "include/buffer.h"
+#include "include/html.h"
+#include "include/post.h"
+#include "include/pretty.h"
+#include "include/util.h"
+
+/*
+ * Reused for the cleaned text of all posts exported by the current thread.
+ */
+static THREAD_LOCAL Buffer cleaned = BUFFER_EMPTY;
+
+/*
+ * Append a single character to the output buffer.
+ */
+static inline void append_char(Buffer* out, char c) {
+    buffer_append(out, &c, 1);
+}
+
+/*
+ * Convert the HTML of a post field into plain text, without wrapping it, and
+ * store it in 'cleaned'. Returns false if the field is missing.
+ */
+static bool clean_html(const char* html) {
+    buffer_clear(&cleaned);
+    if (html == NULL)
+        return false;
+
+    /* The plain text is never longer than the HTML */
+    const size_t html_len = strlen(html);
+    if (!buffer_reserve(&cleaned, html_len))
+        return false;
+
+    cleaned.sz = html2txt(cleaned.data, html, NULL);
+    return true;
+}
+
+/*
+ * Render a post with the pretty printer, which doesn't show its thread.
+ */
+static bool pretty_post(Buffer* out, const Post* post, const HtmlText* com,
+                        const char* board, ThreadId thread, bool is_reply) {
+    (void)thread;
+    return pretty_render_post(out, post, com, board, is_reply);
+}
+
+/*
+ * Append a string escaped for the contents of a JSON string. The characters
+ * that don't need escaping are appended in runs.
+ */
+static void append_json_escaped(Buffer* out, const char* str, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+
+    size_t run_start = 0;
+    for (size_t i = 0; i < len; i++) {
+        const unsigned char c = (unsigned char)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        buffer_append(out, &str[run_start], i - run_start);
+        run_start = i + 1;
+
+        switch (c) {
+            case '"':
+                buffer_append(out, "\\\"", 2);
+                break;
+            case '\\':
+                buffer_append(out, "\\\\", 2);
+                break;
+            case '\n':
+                buffer_append(out, "\\n", 2);
+                break;
+            case '\r':
+                buffer_append(out, "\\r", 2);
+                break;
+            case '\t':
+                buffer_append(out, "\\t", 2);
+                break;
+            default: {
+                const char escaped[] = {
+                    '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF],
+                };
+                buffer_append(out, escaped, sizeof(escaped));
+            } break;
+        }
+    }
+
+    buffer_append(out, &str[run_start], len - run_start);
+}
+
+/*
+ * Append a JSON string with the specified contents, or 'null' if it's NULL.
+ */
+static void append_json_string(Buffer* out, const char* str, size_t len) {
+    if (str == NULL) {
+        buffer_append_str(out, "null");
+        return;
+    }
+
+    append_char(out, '"');
+    append_json_escaped(out, str, len);
+    append_char(out, '"');
+}
+
+/*
+ * Render a post as a JSON object in a single line, with the plain text of its
+ * fields. Missing fields are null.
+ */
+static bool ndjson_post(Buffer* out, const Post* post, const HtmlText* com,
+                        const char* board, ThreadId thread, bool is_reply) {
+    (void)is_reply;
+
+    /* Board names are alphanumeric, so they don't need escaping */
+    buffer_printf(out,
+                  "{\"no\":%lu,\"thread\":%lu,\"board\":\"%s\","
+                  "\"time\":%lld,\"sub\":",
+                  post->no,
+                  thread,
+                  board,
+                  post->time);
+
+    if (clean_html(post->sub))
+        append_json_string(out, cleaned.data, cleaned.sz);
+    else
+        append_json_string(out, NULL, 0);
+
+    buffer_append_str(out, ",\"filename\":");
+    if (post->filename != NULL && post->ext != NULL) {
+        append_char(out, '"');
+        append_json_escaped(out, post->filename, strlen(post->filename));
+        append_json_escaped(out, post->ext, strlen(post->ext));
+        append_char(out, '"');
+    } else {
+        append_json_string(out, NULL, 0);
+    }
+
+    buffer_append_str(out, ",\"text\":");
+    if (com != NULL)
+        append_json_string(out, com->text, com->len);
+    else if (clean_html(post->com))
+        append_json_string(out, cleaned.data, cleaned.sz);
+    else
+        append_json_string(out, NULL, 0);
+
+    return buffer_append_str(out, "}\n");
+}
+
+/*
+ * Append a string escaped for a TSV field: backslashes, tabs and line breaks
+ * are replaced by their C escape sequences, so each post is a single line.
+ */
+static void append_tsv_escaped(Buffer* out, const char* str, size_t len) {
+    size_t run_start = 0;
+    for (size_t i = 0; i < len; i++) {
+        const char c = str[i];
+        if (c != '\\' && c != '\t' && c != '\n' && c != '\r')
+            continue;
+
+        buffer_append(out, &str[run_start], i - run_start);
+        run_start = i + 1;
+
+        switch (c) {
+            case '\\':
+                buffer_append(out, "\\\\", 2);
+                break;
+            case '\t':
+                buffer_append(out, "\\t", 2);
+                break;
+            case '\n':
+                buffer_append(out, "\\n", 2);
+                break;
+            default:
+                buffer_append(out, "\\r", 2);
+                break;
+        }
+    }
+
+    buffer_append(out, &str[run_start], len - run_start);
+}
+
+/*
+ * Render a post as a single line of tab-separated fields: number, thread,
+ * board, time, title, filename and text. Missing fields are empty.
+ */
+static bool tsv_post(Buffer* out, const Post* post, const HtmlText* com,
+                     const char* board, ThreadId thread, bool is_reply) {
+    (void)is_reply;
+
+    buffer_printf(out,
+                  "%lu\t%lu\t%s\t%lld\t",
+                  post->no,
+                  thread,
+                  board,
+                  post->time);
+
+    if (clean_html(post->sub))
+        append_tsv_escaped(out, cleaned.data, cleaned.sz);
+    append_char(out, '\t');
+
+    if (post->filename != NULL && post->ext != NULL) {
+        append_tsv_escaped(out, post->filename, strlen(post->filename));
+        append_tsv_escaped(out, post->ext, strlen(post->ext));
+    }
+    append_char(out, '\t');
+
+    if (com != NULL)
+        append_tsv_escaped(out, com->text, com->len);
+    else if (clean_html(post->com))
+        append_tsv_escaped(out, cleaned.data, cleaned.sz);
+
+    return buffer_append_str(out, "\n");
+}
+
+/*
+ * Renderers of each format, indexed by 'RenderFormat'.
+ */
+static const Renderer renderers[] = {
+    [RENDER_PRETTY] = {
+        .name               = "pretty",
+        .post               = pretty_post,
+        .replies            = pretty_render_replies,
+        .new_replies_header = pretty_render_new_replies_header,
+        .omitted_header     = pretty_render_omitted_header,
+        .board_header       = pretty_render_board_header,
+    },
+    [RENDER_NDJSON] = {
+        .name = "ndjson",
+        .post = ndjson_post,
+    },
+    [RENDER_TSV] = {
+        .name = "tsv",
+        .post = tsv_post,
+    },
+};
+
+/*
+ * Renderer used for all posts. See 'render_select'.
+ */
+static const Renderer* selected = &renderers[RENDER_PRETTY];
+
+void render_select(RenderFormat format) {
+    selected = &renderers[format];
+}
+
+const Renderer* render_current(void) {
+    return selected;
+}
+
+bool render_format_from_name(const char* name, RenderFormat* dst) {
+    for (size_t i = 0; i < ARRLEN(renderers); i++) {
+        if (strcmp(renderers[i].name, name) == 0) {
+            *dst = (RenderFormat)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void render_free(void) {
+    buffer_free(&cleaned);
+}
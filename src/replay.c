@@ -0,0 +1,440 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>    /* open */
+#include <sys/mman.h> /* mmap */
+#include <sys/stat.h> /* fstat */
+#include <unistd.h>   /* close */
+
+#include "include/replay.h"
+#include "include/buffer.h"
+#include "include/util.h"
+
+/*
+ * Size of the blocks of a tarball. Each file is preceded by a header block, and
+ * its contents are padded to a multiple of the block size.
+ */
+#define TAR_BLOCK_SZ 512
+
+/*
+ * Offsets and sizes of the header fields that we need, from the POSIX 'ustar'
+ * format.
+ */
+#define TAR_NAME_OFF     0
+#define TAR_NAME_SZ      100
+#define TAR_SIZE_OFF     124
+#define TAR_SIZE_SZ      12
+#define TAR_CHKSUM_OFF   148
+#define TAR_CHKSUM_SZ    8
+#define TAR_TYPEFLAG_OFF 156
+#define TAR_MAGIC_OFF    257
+#define TAR_PREFIX_OFF   345
+#define TAR_PREFIX_SZ    155
+
+/*
+ * Maximum length of the path of a file inside a tarball, including the null
+ * terminator. Files with longer paths are ignored.
+ */
+#define MAX_ENTRY_NAME 512
+
+/*
+ * Regular file inside a mapped tarball.
+ */
+typedef struct {
+    char name[MAX_ENTRY_NAME];
+    size_t name_len;
+    const char* data;
+    size_t sz;
+} TarEntry;
+
+/*
+ * The replay source is either a directory, or a mapped tarball with a list of
+ * its files. At most one of them is used.
+ */
+static char replay_dir[1024] = { '\0' };
+static struct {
+    char* map;
+    size_t map_sz;
+    TarEntry* entries;
+    size_t entries_num, entries_cap;
+} tarball = { .map = NULL };
+
+/*
+ * Directory where the responses are captured, empty if not capturing.
+ */
+static char capture_dir[1024] = { '\0' };
+
+/*
+ * Get the path of the specified URL, without the scheme, the host and the
+ * leading slash. Returns NULL if the URL has no path, or if it could escape the
+ * replay directory.
+ */
+static const char* url_key(const char* url) {
+    const char* scheme_end = strstr(url, "://");
+    const char* host       = (scheme_end == NULL) ? url : scheme_end + 3;
+    const char* path       = strchr(host, '/');
+    if (path == NULL || path[1] == '\0' || strstr(path, "..") != NULL)
+        return NULL;
+
+    return path + 1;
+}
+
+/*
+ * Parse an octal number of a tarball header, which may be surrounded by spaces
+ * or null bytes.
+ */
+static bool parse_octal(const char* field, size_t field_sz, size_t* dst) {
+    size_t i = 0;
+    while (i < field_sz && field[i] == ' ')
+        i++;
+    if (i >= field_sz || field[i] < '0' || field[i] > '7')
+        return false;
+
+    size_t value = 0;
+    for (; i < field_sz && field[i] >= '0' && field[i] <= '7'; i++)
+        value = value * 8 + (size_t)(field[i] - '0');
+
+    *dst = value;
+    return true;
+}
+
+/*
+ * Check the checksum of a tarball header, which is the sum of its bytes,
+ * counting the checksum field itself as spaces.
+ */
+static bool check_header(const char* header) {
+    size_t expected;
+    if (!parse_octal(&header[TAR_CHKSUM_OFF], TAR_CHKSUM_SZ, &expected))
+        return false;
+
+    size_t sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SZ; i++)
+        sum += (i >= TAR_CHKSUM_OFF && i < TAR_CHKSUM_OFF + TAR_CHKSUM_SZ)
+                 ? ' '
+                 : (unsigned char)header[i];
+
+    return sum == expected;
+}
+
+/*
+ * Add a regular file of the tarball to the list of entries. If 'long_name' is
+ * not NULL, it's used instead of the name in the header (GNU tar stores long
+ * names in a separate entry).
+ */
+static bool add_entry(const char* header, const char* long_name,
+                      size_t long_name_sz, const char* data, size_t sz) {
+    if (tarball.entries_num >= tarball.entries_cap) {
+        const size_t new_cap =
+          (tarball.entries_cap == 0) ? 256 : tarball.entries_cap * 2;
+        TarEntry* ptr = realloc(tarball.entries, new_cap * sizeof(TarEntry));
+        if (ptr == NULL) {
+            ERR("Couldn't grow the tarball entries to %zu elements.", new_cap);
+            return false;
+        }
+        tarball.entries     = ptr;
+        tarball.entries_cap = new_cap;
+    }
+
+    TarEntry* entry = &tarball.entries[tarball.entries_num];
+
+    const char* name   = &header[TAR_NAME_OFF];
+    const char* prefix = &header[TAR_PREFIX_OFF];
+    int written;
+    if (long_name != NULL)
+        written = snprintf(entry->name,
+                           sizeof(entry->name),
+                           "%.*s",
+                           (int)strnlen(long_name, long_name_sz),
+                           long_name);
+    else if (memcmp(&header[TAR_MAGIC_OFF], "ustar", 5) == 0 &&
+             prefix[0] != '\0')
+        written = snprintf(entry->name,
+                           sizeof(entry->name),
+                           "%.*s/%.*s",
+                           (int)strnlen(prefix, TAR_PREFIX_SZ),
+                           prefix,
+                           (int)strnlen(name, TAR_NAME_SZ),
+                           name);
+    else
+        written = snprintf(entry->name,
+                           sizeof(entry->name),
+                           "%.*s",
+                           (int)strnlen(name, TAR_NAME_SZ),
+                           name);
+
+    /* Ignore the files whose path doesn't fit */
+    if (written <= 0 || (size_t)written >= sizeof(entry->name))
+        return true;
+
+    /* Paths are compared without the leading "./" */
+    while (strncmp(entry->name, "./", 2) == 0)
+        STRMOVE(entry->name, entry->name + 2);
+
+    entry->name_len = strlen(entry->name);
+    entry->data     = data;
+    entry->sz       = sz;
+    tarball.entries_num++;
+    return true;
+}
+
+/*
+ * Map the tarball at the specified path, and build the list of its regular
+ * files.
+ */
+static bool open_tarball(const char* path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERR("Could not open replay source '%s'.", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < TAR_BLOCK_SZ) {
+        ERR("Invalid replay tarball '%s'.", path);
+        close(fd);
+        return false;
+    }
+
+    tarball.map_sz = (size_t)st.st_size;
+    tarball.map = mmap(NULL, tarball.map_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (tarball.map == MAP_FAILED) {
+        tarball.map = NULL;
+        ERR("Could not map replay tarball '%s'.", path);
+        return false;
+    }
+
+    if ((unsigned char)tarball.map[0] == 0x1F &&
+        (unsigned char)tarball.map[1] == 0x8B) {
+        ERR("Replay tarball '%s' is compressed, decompress it first.", path);
+        replay_close();
+        return false;
+    }
+
+    const char* long_name = NULL;
+    size_t long_name_sz   = 0;
+
+    size_t pos = 0;
+    while (pos + TAR_BLOCK_SZ <= tarball.map_sz) {
+        const char* header = &tarball.map[pos];
+
+        /* The end of the archive is marked by empty blocks */
+        if (header[0] == '\0')
+            break;
+
+        const size_t data_pos = pos + TAR_BLOCK_SZ;
+        size_t sz;
+        if (!check_header(header) ||
+            !parse_octal(&header[TAR_SIZE_OFF], TAR_SIZE_SZ, &sz) ||
+            sz > tarball.map_sz - data_pos) {
+            ERR("Invalid replay tarball '%s'.", path);
+            replay_close();
+            return false;
+        }
+
+        const char* data = &tarball.map[data_pos];
+        switch (header[TAR_TYPEFLAG_OFF]) {
+            case '0':
+            case '\0':
+                if (!add_entry(header, long_name, long_name_sz, data, sz)) {
+                    replay_close();
+                    return false;
+                }
+                long_name = NULL;
+                break;
+
+            case 'L':
+                long_name    = data;
+                long_name_sz = sz;
+                break;
+
+            default:
+                /* Directories, links, extended headers, etc. */
+                long_name = NULL;
+                break;
+        }
+
+        pos = data_pos + (sz + TAR_BLOCK_SZ - 1) / TAR_BLOCK_SZ * TAR_BLOCK_SZ;
+    }
+
+    return true;
+}
+
+bool replay_open(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        ERR("Could not open replay source '%s'.", path);
+        return false;
+    }
+
+    if (!S_ISDIR(st.st_mode))
+        return open_tarball(path);
+
+    const int written = snprintf(replay_dir, sizeof(replay_dir), "%s", path);
+    if (written <= 0 || (size_t)written >= sizeof(replay_dir)) {
+        replay_dir[0] = '\0';
+        return false;
+    }
+
+    return true;
+}
+
+bool replay_enabled(void) {
+    return replay_dir[0] != '\0' || tarball.map != NULL;
+}
+
+/*
+ * Find the file of the tarball with the specified path. The tarball might have
+ * been created from the parent of the capture directory, so the path can also
+ * be preceded by other directories. Files that appear later in the tarball
+ * replace earlier ones, like when extracting it.
+ */
+static const TarEntry* find_entry(const char* key) {
+    const size_t key_len = strlen(key);
+    for (size_t i = tarball.entries_num; i-- > 0;) {
+        const TarEntry* entry = &tarball.entries[i];
+        if (entry->name_len < key_len)
+            continue;
+
+        const char* suffix = &entry->name[entry->name_len - key_len];
+        if (strcmp(suffix, key) != 0)
+            continue;
+
+        if (suffix == entry->name || suffix[-1] == '/')
+            return entry;
+    }
+
+    return NULL;
+}
+
+/*
+ * Append the contents of the file at the specified path to a buffer.
+ */
+static bool load_file(const char* path, Buffer* dst) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+
+    bool result = false;
+    if (fseek(fp, 0, SEEK_END) != 0)
+        goto done;
+
+    const long file_sz = ftell(fp);
+    if (file_sz < 0 || fseek(fp, 0, SEEK_SET) != 0)
+        goto done;
+
+    const size_t sz = (size_t)file_sz;
+    if (!buffer_reserve(dst, sz) || fread(&dst->data[dst->sz], 1, sz, fp) != sz)
+        goto done;
+    dst->sz += sz;
+    dst->data[dst->sz] = '\0';
+
+    result = true;
+
+done:
+    fclose(fp);
+    return result;
+}
+
+bool replay_load(const char* url, Buffer* dst) {
+    const char* key = url_key(url);
+    if (key == NULL)
+        return false;
+
+    if (tarball.map != NULL) {
+        const TarEntry* entry = find_entry(key);
+        return entry != NULL && buffer_append(dst, entry->data, entry->sz);
+    }
+
+    char path[sizeof(replay_dir) + 256];
+    const int written = snprintf(path, sizeof(path), "%s/%s", replay_dir, key);
+    return written > 0 && (size_t)written < sizeof(path) &&
+           load_file(path, dst);
+}
+
+void replay_close(void) {
+    if (tarball.map != NULL)
+        munmap(tarball.map, tarball.map_sz);
+
+    free(tarball.entries);
+    tarball.map         = NULL;
+    tarball.map_sz      = 0;
+    tarball.entries     = NULL;
+    tarball.entries_num = 0;
+    tarball.entries_cap = 0;
+
+    replay_dir[0] = '\0';
+}
+
+bool replay_capture_init(const char* dir) {
+    const int written = snprintf(capture_dir, sizeof(capture_dir), "%s", dir);
+    if (written <= 0 || (size_t)written >= sizeof(capture_dir) ||
+        !make_dirs(capture_dir)) {
+        capture_dir[0] = '\0';
+        return false;
+    }
+
+    return true;
+}
+
+bool replay_capture_enabled(void) {
+    return capture_dir[0] != '\0';
+}
+
+bool replay_capture_begin(const char* url, FileWriter* dst) {
+    dst->fp = NULL;
+    if (!replay_capture_enabled())
+        return false;
+
+    const char* key = url_key(url);
+    if (key == NULL)
+        return false;
+
+    char path[sizeof(capture_dir) + 256];
+    const int written =
+      snprintf(path, sizeof(path), "%s/%s", capture_dir, key);
+    if (written <= 0 || (size_t)written >= sizeof(path))
+        return false;
+
+    /* Create the directories of the URL path, e.g. 'g/thread' */
+    char* last_slash   = strrchr(path, '/');
+    *last_slash        = '\0';
+    const bool has_dir = make_dirs(path);
+    *last_slash        = '/';
+
+    /* Write to a temporary file and rename it, like the cache */
+    return has_dir && file_writer_open(dst, path);
+}
+
+bool replay_capture_store(const char* url, const char* body, size_t body_sz) {
+    FileWriter writer;
+    if (!replay_capture_begin(url, &writer))
+        return false;
+
+    if (!file_writer_write(&writer, body, body_sz)) {
+        file_writer_discard(&writer);
+        return false;
+    }
+
+    return file_writer_commit(&writer);
+}
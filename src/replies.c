@@ -0,0 +1,160 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "include/replies.h"
+#include "include/arena.h"
+#include "include/html.h"
+#include "include/thread.h"
+
+/*
+ * Minimum number of slots of the hash index. Must be a power of two.
+ */
+#define MIN_SLOTS 16
+
+/*
+ * Get the first slot of a post number in the hash index. Post numbers are
+ * mostly consecutive, so they are mixed with a multiplicative hash.
+ */
+static inline size_t hash_post(PostId no, size_t mask) {
+    uint64_t hash = (uint64_t)no * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 32;
+    return (size_t)hash & mask;
+}
+
+bool reply_graph_init(ReplyGraph* graph, Arena* arena, size_t posts_max) {
+    /* Keep the load factor of the index below one half */
+    size_t slots_num = MIN_SLOTS;
+    while (slots_num < posts_max * 2)
+        slots_num *= 2;
+
+    graph->arena      = arena;
+    graph->nodes_num  = 0;
+    graph->nodes_cap  = posts_max;
+    graph->slots_mask = slots_num - 1;
+
+    graph->nodes = arena_alloc(arena, posts_max * sizeof(ReplyNode));
+    graph->slots = arena_alloc(arena, slots_num * sizeof(size_t));
+    if ((graph->nodes == NULL && posts_max > 0) || graph->slots == NULL)
+        return false;
+
+    memset(graph->slots, 0, slots_num * sizeof(size_t));
+    return true;
+}
+
+size_t reply_graph_find(const ReplyGraph* graph, PostId no) {
+    for (size_t slot = hash_post(no, graph->slots_mask);
+         graph->slots[slot] != 0;
+         slot = (slot + 1) & graph->slots_mask) {
+        const size_t pos = graph->slots[slot] - 1;
+        if (graph->nodes[pos].no == no)
+            return pos;
+    }
+
+    return REPLY_NONE;
+}
+
+/*
+ * Add the post at position 'from' to the replies of the post at position 'to'.
+ */
+static bool add_reply(ReplyGraph* graph, size_t to, size_t from) {
+    ReplyNode* target = &graph->nodes[to];
+
+    /* Replies are added in order, so repeated links are always the last one */
+    if (target->last_reply != NULL && target->last_reply->from == from)
+        return true;
+
+    ReplyEdge* edge = arena_alloc(graph->arena, sizeof(ReplyEdge));
+    if (edge == NULL)
+        return false;
+
+    edge->from = from;
+    edge->next = NULL;
+    if (target->last_reply != NULL)
+        target->last_reply->next = edge;
+    else
+        target->first_reply = edge;
+    target->last_reply = edge;
+    return true;
+}
+
+bool reply_graph_add(ReplyGraph* graph, PostId no, const HtmlSpans* spans) {
+    if (graph->nodes_num >= graph->nodes_cap)
+        return false;
+
+    const size_t pos = graph->nodes_num;
+
+    /* The post is not in the index yet, so links to itself are ignored */
+    for (size_t i = 0; spans != NULL && i < spans->num; i++) {
+        const HtmlSpan* span = &spans->data[i];
+        if (span->kind != HTML_SPAN_QUOTELINK || span->target == 0)
+            continue;
+
+        const size_t to = reply_graph_find(graph, span->target);
+        if (to != REPLY_NONE && !add_reply(graph, to, pos))
+            return false;
+    }
+
+    ReplyNode* node   = &graph->nodes[pos];
+    node->no          = no;
+    node->first_reply = NULL;
+    node->last_reply  = NULL;
+    graph->nodes_num++;
+
+    /* Posts without a number can't be quoted */
+    if (no == 0)
+        return true;
+
+    size_t slot = hash_post(no, graph->slots_mask);
+    while (graph->slots[slot] != 0)
+        slot = (slot + 1) & graph->slots_mask;
+    graph->slots[slot] = pos + 1;
+    return true;
+}
+
+size_t reply_graph_subtree(const ReplyGraph* graph, size_t root,
+                           bool* marked) {
+    memset(marked, 0, graph->nodes_num * sizeof(bool));
+    if (root >= graph->nodes_num)
+        return 0;
+
+    /*
+     * Replies always come after the post they quote, so a single forward pass
+     * reaches every descendant of the root, without a stack.
+     */
+    marked[root]      = true;
+    size_t marked_num = 1;
+    for (size_t i = root; i < graph->nodes_num; i++) {
+        if (!marked[i])
+            continue;
+
+        for (const ReplyEdge* edge = graph->nodes[i].first_reply; edge != NULL;
+             edge = edge->next) {
+            if (!marked[edge->from]) {
+                marked[edge->from] = true;
+                marked_num++;
+            }
+        }
+    }
+
+    return marked_num;
+}
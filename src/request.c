@@ -16,24 +16,30 @@
  * this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
-#include <string.h> /* memcpy */
-#include <stdlib.h> /* realloc */
+#include <string.h>  /* memcpy */
+#include <strings.h> /* strncasecmp */
 
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
 
 #include "include/request.h"
+#include "include/arena.h"
+#include "include/buffer.h"
+#include "include/cache.h"
+#include "include/jsonstream.h"
+#include "include/replay.h"
+#include "include/ratelimit.h"
+#include "include/stats.h"
 #include "include/util.h"
 #include "include/main.h"
 
 /*
- * Structure representing a buffer of arbitrary size.
+ * Share object used by all the handles created with 'request_handle_new'. The
+ * handles are only used from a single thread, so it doesn't need locking.
  */
-typedef struct {
-    char* data;
-    size_t sz;
-} Buffer;
+static CURLSH* pool = NULL;
 
 /*
  * Callback used as 'CURLOPT_WRITEFUNCTION', which will be called whenever some
@@ -53,69 +59,500 @@ static size_t data_received_callback(char* response, size_t item_sz,
      */
     Buffer* buffer = (Buffer*)user_data;
 
-    char* ptr = realloc(buffer->data, buffer->sz + real_sz + 1);
-    if (ptr == NULL) {
-        ERR("Couldn't realloc from %ld to %ld bytes.",
-              buffer->sz,
-              buffer->sz + real_sz + 1);
-        return 0;
+    return buffer_append(buffer, response, real_sz) ? real_sz : 0;
+}
+
+/*
+ * Callback used as 'CURLOPT_WRITEFUNCTION' for streaming requests. The received
+ * data is passed to the JSON stream of the request as soon as it arrives, and
+ * written to the files of the cache and the capture directory, if they are
+ * enabled, so the response is never stored in memory.
+ */
+static size_t stream_received_callback(char* response, size_t item_sz,
+                                       size_t item_num, void* user_data) {
+    const size_t real_sz = item_sz * item_num;
+    Request* req         = (Request*)user_data;
+
+    /*
+     * Error pages are not JSON, don't pass them to the stream. They are
+     * reported when the request finishes.
+     */
+    long response_code = 0;
+    curl_easy_getinfo(req->curl, CURLINFO_RESPONSE_CODE, &response_code);
+    if (response_code >= 300)
+        return real_sz;
+
+    if (!req->files_opened) {
+        req->files_opened = true;
+
+        /* Only new responses are stored in the cache, like 'request_store' */
+        if (response_code == 200)
+            cache_store_begin(req->url, &req->validators, &req->cache_file);
+        replay_capture_begin(req->url, &req->capture_file);
+    }
+
+    /* A file that can't be written is not stored, but the request goes on */
+    if (req->cache_file.fp != NULL &&
+        !file_writer_write(&req->cache_file, response, real_sz))
+        file_writer_discard(&req->cache_file);
+    if (req->capture_file.fp != NULL &&
+        !file_writer_write(&req->capture_file, response, real_sz))
+        file_writer_discard(&req->capture_file);
+
+    return json_stream_feed(req->stream, response, real_sz) ? real_sz : 0;
+}
+
+/*
+ * If the specified header line has the specified name, copy its value (without
+ * surrounding whitespace) into 'dst'. Values that don't fit are ignored.
+ */
+static void copy_header_value(char* dst, size_t dst_sz, const char* line,
+                              size_t line_sz, const char* name) {
+    const size_t name_len = strlen(name);
+    if (line_sz <= name_len || strncasecmp(line, name, name_len) != 0 ||
+        line[name_len] != ':')
+        return;
+
+    const char* value = line + name_len + 1;
+    const char* end   = line + line_sz;
+    while (value < end && (*value == ' ' || *value == '\t'))
+        value++;
+    while (end > value && (end[-1] == '\r' || end[-1] == '\n' ||
+                           end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+
+    const size_t value_len = (size_t)(end - value);
+    if (value_len >= dst_sz)
+        return;
+
+    memcpy(dst, value, value_len);
+    dst[value_len] = '\0';
+}
+
+/*
+ * Callback used as 'CURLOPT_HEADERFUNCTION', which will be called for each
+ * received header line. Used for storing the cache validators.
+ */
+static size_t header_received_callback(char* line, size_t item_sz,
+                                       size_t item_num, void* user_data) {
+    const size_t real_sz = item_sz * item_num;
+    Request* req         = (Request*)user_data;
+
+    /* A new status line means a new response (e.g. after a redirect) */
+    if (real_sz >= 5 && strncmp(line, "HTTP/", 5) == 0) {
+        req->validators.etag[0]          = '\0';
+        req->validators.last_modified[0] = '\0';
+        return real_sz;
     }
 
-    buffer->data = ptr;
-    memcpy(&buffer->data[buffer->sz], response, real_sz);
-    buffer->sz += real_sz;
-    buffer->data[buffer->sz] = '\0';
+    copy_header_value(req->validators.etag,
+                      sizeof(req->validators.etag),
+                      line,
+                      real_sz,
+                      "ETag");
+    copy_header_value(req->validators.last_modified,
+                      sizeof(req->validators.last_modified),
+                      line,
+                      real_sz,
+                      "Last-Modified");
 
     return real_sz;
 }
 
-cJSON* request_json_from_url(CURL* curl, const char* url) {
-    cJSON* result = NULL;
+/*
+ * Add the conditional request headers for the cached response of the current
+ * URL, if there is one.
+ */
+static void add_conditional_headers(Request* req) {
+    CacheValidators cached;
+    if (!cache_load_validators(req->url, &cached))
+        return;
+
+    char header[sizeof(cached.etag) + 32];
+    if (cached.etag[0] != '\0') {
+        snprintf(header, sizeof(header), "If-None-Match: %s", cached.etag);
+        req->headers = curl_slist_append(req->headers, header);
+    }
+    if (cached.last_modified[0] != '\0') {
+        snprintf(header,
+                 sizeof(header),
+                 "If-Modified-Since: %s",
+                 cached.last_modified);
+        req->headers = curl_slist_append(req->headers, header);
+    }
+
+    req->is_cached = true;
+}
+
+bool request_pool_init(void) {
+    pool = curl_share_init();
+    if (pool == NULL)
+        return false;
+
+    /* Connections can only be shared since curl 7.57.0 */
+    if (curl_share_setopt(pool, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS) !=
+          CURLSHE_OK ||
+        curl_share_setopt(pool, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION) !=
+          CURLSHE_OK ||
+        curl_share_setopt(pool, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT) !=
+          CURLSHE_OK) {
+        request_pool_free();
+        return false;
+    }
+
+    return true;
+}
+
+void request_pool_free(void) {
+    if (pool != NULL)
+        curl_share_cleanup(pool);
+    pool = NULL;
+}
+
+CURL* request_handle_new(void) {
+    CURL* curl = curl_easy_init();
+    if (curl == NULL)
+        return NULL;
+
+    if (pool != NULL)
+        curl_easy_setopt(curl, CURLOPT_SHARE, pool);
+
+    /* Use HTTP/2 for HTTPS when the server supports it */
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+
+    return curl;
+}
+
+void request_handle_set_url(CURL* curl, const char* url) {
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+
+    /*
+     * Wait for an existing connection that can multiplex the request instead
+     * of opening a new one. This is only done for HTTPS, where HTTP/2 can be
+     * negotiated; with HTTP/1 servers, especially ones that close the
+     * connection after each response, the requests would be made one at a
+     * time.
+     */
+    const bool is_https = (strncasecmp(url, "https://", 8) == 0);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, is_https ? 1L : 0L);
+}
+
+void request_init(Request* req, Arena* arena) {
+    req->curl            = NULL;
+    req->url             = NULL;
+    req->arena           = arena;
+    req->stream          = NULL;
+    req->cache_file.fp   = NULL;
+    req->capture_file.fp = NULL;
+    req->files_opened    = false;
+    req->headers         = NULL;
+    req->is_cached       = false;
+    req->status          = 0;
 
     /*
      * Main buffer used to store curl responses. The 'data' member will get
-     * reallocated as needed in 'on_curl_write'.
+     * reallocated as needed in 'data_received_callback', and it's kept for the
+     * next request.
      */
-    Buffer buffer = {
-        .data = NULL,
-        .sz   = 0,
-    };
+    req->buffer.data = NULL;
+    req->buffer.sz   = 0;
+    req->buffer.cap  = 0;
+}
+
+void request_free(Request* req) {
+    file_writer_discard(&req->cache_file);
+    file_writer_discard(&req->capture_file);
+    buffer_free(&req->buffer);
+}
+
+void request_setup(CURL* curl, Request* req, const char* url) {
+    req->curl         = curl;
+    req->url          = url;
+    req->stream       = NULL;
+    req->files_opened = false;
+    req->headers      = NULL;
+    req->is_cached    = false;
+    req->status       = 0;
+
+    /* Only written by streaming requests, closed when they finish */
+    file_writer_discard(&req->cache_file);
+    file_writer_discard(&req->capture_file);
+
+    /* The results of the previous request are no longer needed */
+    buffer_clear(&req->buffer);
+    if (req->arena != NULL)
+        arena_reset(req->arena);
+
+    req->validators.etag[0]          = '\0';
+    req->validators.last_modified[0] = '\0';
+
+    if (cache_enabled())
+        add_conditional_headers(req);
 
     /*
      * Set target URL, the callback function and the 'user_data' parameter of
      * the callback.
      */
-    curl_easy_setopt(curl, CURLOPT_URL, url);
+    request_handle_set_url(curl, url);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_received_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &req->buffer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_received_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, req);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, req->headers);
+}
+
+void request_setup_stream(CURL* curl, Request* req, const char* url,
+                          JsonStream* stream) {
+    request_setup(curl, req, url);
+    req->stream = stream;
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_received_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
+}
+
+/*
+ * Parse the response stored in the buffer of a request as JSON, measuring the
+ * time it takes.
+ */
+static cJSON* parse_response(Request* req) {
+    const uint64_t start = stats_enabled() ? stats_now_ns() : 0;
+    cJSON* result =
+      arena_parse_json(req->arena, req->buffer.data, req->buffer.sz);
+    if (stats_enabled())
+        stats_record(STATS_PARSE, stats_now_ns() - start);
+
+    return result;
+}
+
+/*
+ * Check the result of the transfer of a request. If the server reported that
+ * the cached response is still valid, it's loaded into the request buffer and
+ * 'is_not_modified' is set. The HTTP status is written to 'response_code'.
+ */
+static bool finish_transfer(CURL* curl, Request* req, CURLcode code,
+                            long* response_code, bool* is_not_modified) {
+    *response_code   = 0;
+    *is_not_modified = false;
+
+    /* The headers were only needed during the transfer */
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+    curl_slist_free_all(req->headers);
+    req->headers = NULL;
+
+    stats_record_transfer(curl, req->url, code);
 
-    /* Make request to get the JSON string */
-    const CURLcode code = curl_easy_perform(curl);
     if (code != CURLE_OK) {
         ERR("Failed to perform request to '%s': %s",
-              url,
+              req->url,
               curl_easy_strerror(code));
-        goto done;
+        return false;
+    }
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, response_code);
+
+    if (*response_code == 304 && req->is_cached) {
+        /* Not modified, use the cached body instead */
+        buffer_clear(&req->buffer);
+        if (!cache_load_body(req->url, &req->buffer)) {
+            ERR("Could not read cached response for '%s'.", req->url);
+            return false;
+        }
+
+        *is_not_modified = true;
+    } else if (*response_code >= 300) {
+        ERR("Request to '%s' failed with HTTP status %ld.",
+            req->url,
+            *response_code);
+        return false;
     }
 
+    return true;
+}
+
+bool request_finish_raw(CURL* curl, Request* req, CURLcode code) {
+    bool is_not_modified;
+    if (!finish_transfer(curl, req, code, &req->status, &is_not_modified))
+        return false;
+
     /* Make sure the callback filled the buffer with some data */
-    if (buffer.data == NULL || buffer.sz <= 0) {
+    if (req->buffer.data == NULL || req->buffer.sz <= 0) {
         ERR("Received an empty response buffer.");
-        goto done;
+        return false;
     }
 
+    return true;
+}
+
+void request_store(const char* url, long status,
+                   const CacheValidators* validators, const char* body,
+                   size_t body_sz) {
+    if (status == 200 && cache_enabled())
+        cache_store(url, validators, body, body_sz);
+
+    /* Responses from the cache are also captured, they are still current */
+    if (replay_capture_enabled())
+        replay_capture_store(url, body, body_sz);
+}
+
+cJSON* request_finish(CURL* curl, Request* req, CURLcode code) {
+    cJSON* result = NULL;
+    if (!request_finish_raw(curl, req, code))
+        goto done;
+
     /* Fill JSON object parameter with parsed response */
-    result = cJSON_Parse(buffer.data);
+    result = parse_response(req);
     if (result == NULL) {
-        ERR("Could not parse response as JSON.");
+        ERR("Could not parse response from '%s' as JSON.", req->url);
         goto done;
     }
 
+    /* Only store the responses that could be parsed */
+    request_store(req->url,
+                  req->status,
+                  &req->validators,
+                  req->buffer.data,
+                  req->buffer.sz);
+
 done:
+    buffer_clear(&req->buffer);
+    return result;
+}
+
+bool request_finish_stream(CURL* curl, Request* req, CURLcode code) {
+    bool result = false;
+
+    long response_code;
+    bool is_not_modified;
+    if (!finish_transfer(curl, req, code, &response_code, &is_not_modified))
+        goto done;
+
     /*
-     * Free the data that might have been allocated inside
-     * 'data_received_callback'.
+     * If the cached response is still valid, it was not received, so pass it
+     * to the stream now.
      */
-    free(buffer.data);
+    if (is_not_modified &&
+        !json_stream_feed(req->stream, req->buffer.data, req->buffer.sz))
+        goto done;
+
+    if (!json_stream_finish(req->stream)) {
+        ERR("Could not parse response from '%s' as JSON.", req->url);
+        goto done;
+    }
+
+    /*
+     * A received response was already written to its files, which can now
+     * replace the previous ones. A cached one is only captured.
+     */
+    if (is_not_modified) {
+        request_store(req->url,
+                      response_code,
+                      &req->validators,
+                      req->buffer.data,
+                      req->buffer.sz);
+    } else {
+        if (req->cache_file.fp != NULL)
+            file_writer_commit(&req->cache_file);
+        if (req->capture_file.fp != NULL)
+            file_writer_commit(&req->capture_file);
+    }
+
+    result = true;
+
+done:
+    /* The files of an invalid response are not stored */
+    file_writer_discard(&req->cache_file);
+    file_writer_discard(&req->capture_file);
+    buffer_clear(&req->buffer);
+    return result;
+}
+
+bool request_replay_raw(Request* req, const char* url) {
+    req->url    = url;
+    req->status = 0;
+    buffer_clear(&req->buffer);
+    if (req->arena != NULL)
+        arena_reset(req->arena);
+
+    if (!replay_load(url, &req->buffer)) {
+        ERR("No captured response for '%s'.", url);
+        return false;
+    }
+
+    req->status = 200;
+    return true;
+}
+
+cJSON* request_replay(Request* req, const char* url) {
+    cJSON* result = NULL;
+    if (!request_replay_raw(req, url))
+        goto done;
+
+    result = parse_response(req);
+    if (result == NULL)
+        ERR("Could not parse response from '%s' as JSON.", url);
+
+done:
+    buffer_clear(&req->buffer);
+    return result;
+}
+
+/*
+ * Pass the captured response for the specified URL to a JSON stream, like
+ * 'request_replay'.
+ */
+static bool replay_stream(Request* req, const char* url, JsonStream* stream) {
+    req->url = url;
+    buffer_clear(&req->buffer);
+
+    if (!replay_load(url, &req->buffer)) {
+        ERR("No captured response for '%s'.", url);
+        return false;
+    }
+
+    if (!json_stream_feed(stream, req->buffer.data, req->buffer.sz) ||
+        !json_stream_finish(stream)) {
+        ERR("Could not parse response from '%s' as JSON.", url);
+        return false;
+    }
+
+    return true;
+}
+
+cJSON* request_json_from_url(CURL* curl, const char* url) {
+    Request req;
+    request_init(&req, NULL);
+
+    cJSON* result;
+    if (replay_enabled()) {
+        result = request_replay(&req, url);
+    } else {
+        ratelimit_wait(url);
+        request_setup(curl, &req, url);
+
+        /* Make request to get the JSON string */
+        const CURLcode code = curl_easy_perform(curl);
+        result              = request_finish(curl, &req, code);
+    }
+
+    request_free(&req);
+    return result;
+}
+
+bool request_stream_from_url(CURL* curl, const char* url, JsonStream* stream) {
+    Request req;
+    request_init(&req, NULL);
+
+    bool result;
+    if (replay_enabled()) {
+        result = replay_stream(&req, url, stream);
+    } else {
+        ratelimit_wait(url);
+        request_setup_stream(curl, &req, url, stream);
+
+        const CURLcode code = curl_easy_perform(curl);
+        result              = request_finish_stream(curl, &req, code);
+    }
+
+    request_free(&req);
     return result;
 }
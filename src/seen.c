@@ -0,0 +1,261 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> /* getpid */
+
+#include "include/seen.h"
+#include "include/thread.h"
+#include "include/util.h"
+#include "include/main.h"
+
+/*
+ * First line of the state file. Files with a different first line are ignored,
+ * so the format can be changed in the future. Files of the first version, which
+ * had no board names, are loaded as threads of the default board.
+ */
+#define SEEN_MAGIC    "4cli-seen 2"
+#define SEEN_MAGIC_V1 "4cli-seen 1"
+
+/*
+ * The state file contains the magic line, followed by a line for each thread
+ * with its board, its ID and the number of its last printed post:
+ *
+ *   4cli-seen 2
+ *   <board> <thread> <post>
+ *   ...
+ */
+static char seen_path[1024] = { '\0' };
+
+/*
+ * Thread and its last printed post. The list is sorted by board, and then by
+ * thread ID, so the threads of each board are contiguous.
+ */
+typedef struct {
+    char board[MAX_BOARD_LEN + 1];
+    ThreadId thread;
+    PostId last_post;
+} SeenEntry;
+
+static SeenEntry* entries = NULL;
+static size_t entries_num = 0, entries_cap = 0;
+
+/*
+ * Compare an entry with the specified board and thread, like 'strcmp'.
+ */
+static int compare_entry(const SeenEntry* entry, const char* board,
+                         ThreadId thread) {
+    const int cmp = strcmp(entry->board, board);
+    if (cmp != 0)
+        return cmp;
+
+    return (entry->thread > thread) - (entry->thread < thread);
+}
+
+/*
+ * Find the position of the specified thread in the list, or the position where
+ * it should be inserted.
+ */
+static size_t find_entry(const char* board, ThreadId thread) {
+    size_t lo = 0, hi = entries_num;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (compare_entry(&entries[mid], board, thread) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Load the list from the state file. A missing file is not an error.
+ */
+static bool load_entries(void) {
+    FILE* fp = fopen(seen_path, "r");
+    if (fp == NULL)
+        return true;
+
+    char line[64];
+    if (fgets(line, sizeof(line), fp) == NULL) {
+        fclose(fp);
+        return true;
+    }
+
+    char board[MAX_BOARD_LEN + 1];
+    unsigned long thread, last_post;
+    if (strcmp(line, SEEN_MAGIC "\n") == 0) {
+        while (fscanf(fp, "%15s %lu %lu", board, &thread, &last_post) == 3)
+            if (!seen_set(board, thread, last_post))
+                break;
+    } else if (strcmp(line, SEEN_MAGIC_V1 "\n") == 0) {
+        while (fscanf(fp, "%lu %lu", &thread, &last_post) == 2)
+            if (!seen_set(DEFAULT_BOARD, thread, last_post))
+                break;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+bool seen_init(const char* dir) {
+    char state_dir[sizeof(seen_path) - 16];
+
+    int written;
+    if (dir != NULL) {
+        written = snprintf(state_dir, sizeof(state_dir), "%s", dir);
+    } else {
+        const char* xdg_state = getenv("XDG_STATE_HOME");
+        const char* home      = getenv("HOME");
+        if (xdg_state != NULL && *xdg_state != '\0')
+            written =
+              snprintf(state_dir, sizeof(state_dir), "%s/4cli", xdg_state);
+        else if (home != NULL && *home != '\0')
+            written = snprintf(state_dir,
+                               sizeof(state_dir),
+                               "%s/.local/state/4cli",
+                               home);
+        else
+            written = -1;
+    }
+
+    if (written <= 0 || (size_t)written >= sizeof(state_dir) ||
+        !make_dirs(state_dir))
+        return false;
+
+    snprintf(seen_path, sizeof(seen_path), "%s/seen", state_dir);
+    return load_entries();
+}
+
+bool seen_enabled(void) {
+    return seen_path[0] != '\0';
+}
+
+PostId seen_get(const char* board, ThreadId thread) {
+    const size_t pos = find_entry(board, thread);
+    if (pos < entries_num && compare_entry(&entries[pos], board, thread) == 0)
+        return entries[pos].last_post;
+
+    return 0;
+}
+
+bool seen_set(const char* board, ThreadId thread, PostId last_post) {
+    if (strlen(board) > MAX_BOARD_LEN) {
+        ERR("Board name too long: '%s'.", board);
+        return false;
+    }
+
+    const size_t pos = find_entry(board, thread);
+    if (pos < entries_num && compare_entry(&entries[pos], board, thread) == 0) {
+        entries[pos].last_post = last_post;
+        return true;
+    }
+
+    if (entries_num >= entries_cap) {
+        const size_t new_cap = (entries_cap == 0) ? 256 : entries_cap * 2;
+        SeenEntry* ptr = realloc(entries, new_cap * sizeof(SeenEntry));
+        if (ptr == NULL) {
+            ERR("Couldn't realloc the list of seen posts.");
+            return false;
+        }
+        entries     = ptr;
+        entries_cap = new_cap;
+    }
+
+    /* Keep the list sorted */
+    memmove(&entries[pos + 1],
+            &entries[pos],
+            (entries_num - pos) * sizeof(SeenEntry));
+    strcpy(entries[pos].board, board);
+    entries[pos].thread    = thread;
+    entries[pos].last_post = last_post;
+    entries_num++;
+    return true;
+}
+
+void seen_prune(const char* board, const ThreadInfo* threads,
+                size_t threads_num) {
+    /* The threads of the board are contiguous, from 'first' to 'last' */
+    const size_t first = find_entry(board, 0);
+    size_t last        = first;
+    while (last < entries_num && strcmp(entries[last].board, board) == 0)
+        last++;
+
+    /* Both lists are sorted, so they can be merged in a single pass */
+    size_t written = first, j = 0;
+    for (size_t i = first; i < last; i++) {
+        while (j < threads_num && threads[j].id < entries[i].thread)
+            j++;
+
+        if (j < threads_num && threads[j].id == entries[i].thread)
+            entries[written++] = entries[i];
+    }
+
+    /* Keep the threads of the boards after this one */
+    memmove(&entries[written],
+            &entries[last],
+            (entries_num - last) * sizeof(SeenEntry));
+    entries_num -= last - written;
+}
+
+bool seen_save(void) {
+    if (!seen_enabled())
+        return false;
+
+    char tmp_path[sizeof(seen_path) + 32];
+    const long pid = (long)getpid();
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", seen_path, pid) < 0)
+        return false;
+
+    /*
+     * Write to a temporary file and rename it, so the state file is never left
+     * incomplete.
+     */
+    FILE* fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        ERR("Could not create state file '%s'.", tmp_path);
+        return false;
+    }
+
+    bool success = fprintf(fp, SEEN_MAGIC "\n") > 0;
+    for (size_t i = 0; success && i < entries_num; i++)
+        success = fprintf(fp,
+                          "%s %lu %lu\n",
+                          entries[i].board,
+                          entries[i].thread,
+                          entries[i].last_post) > 0;
+
+    if (fclose(fp) != 0 || !success || rename(tmp_path, seen_path) != 0) {
+        ERR("Could not write state file '%s'.", seen_path);
+        remove(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+void seen_free(void) {
+    free(entries);
+    entries     = NULL;
+    entries_num = 0;
+    entries_cap = 0;
+}
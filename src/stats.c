@@ -0,0 +1,477 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>    /* getenv, strtol */
+#include <string.h>    /* memchr */
+#include <time.h>      /* clock_gettime */
+#include <unistd.h>    /* STDOUT_FILENO */
+#include <sys/ioctl.h> /* ioctl, TIOCGWINSZ */
+#include <pthread.h>
+
+#include <curl/curl.h>
+
+#include "include/stats.h"
+#include "include/util.h"
+
+/*
+ * The latencies are stored in histograms with logarithmic buckets: each power
+ * of two is divided into 2^SUB_BUCKET_BITS linear buckets, so the error of the
+ * percentiles is at most 1/8 of the value, and recording is constant-time.
+ * Values are stored in microseconds.
+ */
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS     (1 << SUB_BUCKET_BITS)
+#define BUCKETS_NUM     ((64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+typedef struct {
+    uint64_t buckets[BUCKETS_NUM];
+    uint64_t count, sum, max;
+} Histogram;
+
+static const char* const stage_names[STATS_STAGES_NUM] = {
+    [STATS_DNS] = "dns",           [STATS_CONNECT] = "connect",
+    [STATS_TLS] = "tls",           [STATS_TTFB] = "ttfb",
+    [STATS_TRANSFER] = "transfer", [STATS_REQUEST] = "request",
+    [STATS_PARSE] = "parse",       [STATS_RENDER] = "render",
+};
+
+static bool enabled   = false;
+static FILE* trace_fp = NULL;
+
+/*
+ * The parsing and rendering stages can be recorded by several threads, so the
+ * histograms are protected by a lock.
+ */
+static Histogram histograms[STATS_STAGES_NUM];
+static pthread_mutex_t histograms_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Totals of all the requests.
+ */
+static struct {
+    uint64_t requests, failed;
+    uint64_t connections;
+    uint64_t reused; /* Requests that didn't open a new connection */
+    uint64_t http2;  /* Requests that used HTTP/2 */
+    uint64_t bytes;
+} totals;
+
+/*
+ * Number of lines of the screen, if it can't be obtained from the terminal.
+ */
+#define DEFAULT_SCREEN_LINES 24
+
+/*
+ * Time until the first output, and until a whole screen was written, in
+ * nanoseconds since 'stats_init'. Zero if it didn't happen yet. Only used by
+ * the main thread.
+ */
+static struct {
+    uint64_t start_ns;
+    uint64_t first_post_ns, first_screen_ns;
+    size_t lines, screen_lines;
+} output;
+
+/*
+ * Get the number of lines of the terminal of the standard output, or of the
+ * 'LINES' variable if it's not a terminal.
+ */
+static size_t get_screen_lines(void) {
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0)
+        return size.ws_row;
+
+    const char* lines = getenv("LINES");
+    if (lines != NULL && strtol(lines, NULL, 10) > 0)
+        return (size_t)strtol(lines, NULL, 10);
+
+    return DEFAULT_SCREEN_LINES;
+}
+
+/*
+ * Get the index of the bucket for the specified value. Values lower than
+ * SUB_BUCKETS have their own bucket.
+ */
+static size_t bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS)
+        return (size_t)value;
+
+    int msb = 0;
+    for (uint64_t v = value; v > 1; v >>= 1)
+        msb++;
+
+    const int shift = msb - SUB_BUCKET_BITS;
+    return (size_t)(shift + 1) * SUB_BUCKETS +
+           (size_t)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+/*
+ * Get the highest value that is stored in the specified bucket.
+ */
+static uint64_t bucket_upper_bound(size_t idx) {
+    if (idx < SUB_BUCKETS)
+        return idx;
+
+    const int shift        = (int)(idx / SUB_BUCKETS) - 1;
+    const uint64_t sub     = idx % SUB_BUCKETS;
+    const uint64_t lower   = (SUB_BUCKETS + sub) << shift;
+    return lower + (((uint64_t)1 << shift) - 1);
+}
+
+static void record_us(StatsStage stage, uint64_t us) {
+    pthread_mutex_lock(&histograms_lock);
+
+    Histogram* histogram = &histograms[stage];
+    histogram->buckets[bucket_index(us)]++;
+    histogram->count++;
+    histogram->sum += us;
+    if (us > histogram->max)
+        histogram->max = us;
+
+    pthread_mutex_unlock(&histograms_lock);
+}
+
+/*
+ * Get the specified percentile of a histogram. The upper bound of the bucket
+ * is returned, so the result is never lower than the real value.
+ */
+static uint64_t percentile(const Histogram* histogram, unsigned percent) {
+    if (histogram->count == 0)
+        return 0;
+
+    uint64_t rank = (histogram->count * percent + 99) / 100;
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS_NUM; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            const uint64_t bound = bucket_upper_bound(i);
+            return (bound < histogram->max) ? bound : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+bool stats_init(const char* trace_path) {
+    if (trace_path != NULL) {
+        trace_fp = fopen(trace_path, "w");
+        if (trace_fp == NULL) {
+            ERR("Could not open trace file '%s'.", trace_path);
+            return false;
+        }
+    }
+
+    output.start_ns     = stats_now_ns();
+    output.screen_lines = get_screen_lines();
+
+    enabled = true;
+    return true;
+}
+
+bool stats_enabled(void) {
+    return enabled;
+}
+
+uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void stats_record(StatsStage stage, uint64_t ns) {
+    if (enabled)
+        record_us(stage, ns / 1000);
+}
+
+/*
+ * Get the name of a version of HTTP, as returned by 'CURLINFO_HTTP_VERSION'.
+ */
+static const char* http_version_name(long version) {
+    switch (version) {
+        case CURL_HTTP_VERSION_1_0:
+            return "1.0";
+        case CURL_HTTP_VERSION_1_1:
+            return "1.1";
+        case CURL_HTTP_VERSION_2_0:
+            return "2";
+        case CURL_HTTP_VERSION_3:
+            return "3";
+        default:
+            return "";
+    }
+}
+
+/*
+ * Write a string to the trace file, escaping the characters that can't appear
+ * in JSON strings.
+ */
+static void trace_string(const char* str) {
+    fputc('"', trace_fp);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', trace_fp);
+        if ((unsigned char)*str >= 0x20)
+            fputc(*str, trace_fp);
+    }
+    fputc('"', trace_fp);
+}
+
+void stats_record_transfer(CURL* curl, const char* url, CURLcode code) {
+    if (!enabled)
+        return;
+
+    /* All the times are in microseconds, since the start of the transfer */
+    curl_off_t namelookup = 0, connect = 0, appconnect = 0, pretransfer = 0,
+               starttransfer = 0, total = 0, size = 0;
+    long connects = 0, status = 0, http_version = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &size);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &http_version);
+
+    totals.requests++;
+    if (code != CURLE_OK || status >= 400)
+        totals.failed++;
+    if (code == CURLE_OK && connects == 0)
+        totals.reused++;
+    if (http_version == CURL_HTTP_VERSION_2_0)
+        totals.http2++;
+    totals.bytes += (uint64_t)size;
+
+    /* Reused connections don't resolve or connect again */
+    const curl_off_t dns_us     = namelookup;
+    const curl_off_t connect_us = (connect > namelookup) ? connect - namelookup
+                                                         : 0;
+    const curl_off_t tls_us = (appconnect > connect) ? appconnect - connect : 0;
+    if (connects > 0) {
+        totals.connections += (uint64_t)connects;
+        record_us(STATS_DNS, (uint64_t)dns_us);
+        record_us(STATS_CONNECT, (uint64_t)connect_us);
+        if (appconnect > 0)
+            record_us(STATS_TLS, (uint64_t)tls_us);
+    }
+
+    /* Failed transfers might not have received anything */
+    const curl_off_t ttfb_us =
+      (starttransfer > pretransfer) ? starttransfer - pretransfer : 0;
+    const curl_off_t transfer_us =
+      (total > starttransfer) ? total - starttransfer : 0;
+    if (starttransfer > 0) {
+        record_us(STATS_TTFB, (uint64_t)ttfb_us);
+        record_us(STATS_TRANSFER, (uint64_t)transfer_us);
+    }
+    record_us(STATS_REQUEST, (uint64_t)total);
+
+    if (trace_fp == NULL)
+        return;
+
+    fputs("{\"url\":", trace_fp);
+    trace_string(url);
+    fprintf(trace_fp,
+            ",\"code\":%d,\"status\":%ld,\"http_version\":\"%s\","
+            "\"bytes\":%lld,"
+            "\"new_connections\":%ld,\"dns_us\":%lld,\"connect_us\":%lld,"
+            "\"tls_us\":%lld,\"ttfb_us\":%lld,\"transfer_us\":%lld,"
+            "\"total_us\":%lld}\n",
+            (int)code,
+            status,
+            http_version_name(http_version),
+            (long long)size,
+            connects,
+            (long long)((connects > 0) ? dns_us : 0),
+            (long long)((connects > 0) ? connect_us : 0),
+            (long long)((connects > 0) ? tls_us : 0),
+            (long long)ttfb_us,
+            (long long)transfer_us,
+            (long long)total);
+}
+
+void stats_record_output(const char* data, size_t sz) {
+    if (!enabled || sz == 0 || output.first_screen_ns != 0)
+        return;
+
+    const uint64_t elapsed_ns = stats_now_ns() - output.start_ns;
+    if (output.first_post_ns == 0)
+        output.first_post_ns = elapsed_ns;
+
+    const char* end = data + sz;
+    for (const char* p = data;
+         (p = memchr(p, '\n', (size_t)(end - p))) != NULL;
+         p++) {
+        if (++output.lines >= output.screen_lines) {
+            output.first_screen_ns = elapsed_ns;
+            break;
+        }
+    }
+}
+
+/*
+ * Print the statistics in a human-readable format.
+ */
+static void print_text(FILE* fp) {
+    fprintf(fp,
+            COL_INFO "Requests:" COL_NORM " %llu (%llu failed), %.1f KiB "
+                     "received.\n",
+            (unsigned long long)totals.requests,
+            (unsigned long long)totals.failed,
+            totals.bytes / 1024.0);
+
+    const double reuse_rate =
+      (totals.requests == 0) ? 0 : totals.reused * 100.0 / totals.requests;
+    fprintf(fp,
+            COL_INFO "Connections:" COL_NORM " %llu opened, %.1f%% of the "
+                     "requests reused one, %llu requests over HTTP/2.\n",
+            (unsigned long long)totals.connections,
+            reuse_rate,
+            (unsigned long long)totals.http2);
+
+    if (output.first_post_ns != 0) {
+        fprintf(fp,
+                COL_INFO "Output:" COL_NORM " first post after %.3f ms, ",
+                output.first_post_ns / 1e6);
+        if (output.first_screen_ns != 0)
+            fprintf(fp,
+                    "first screen (%zu lines) after %.3f ms.\n",
+                    output.screen_lines,
+                    output.first_screen_ns / 1e6);
+        else
+            fprintf(fp,
+                    "%zu of %zu lines of the first screen.\n",
+                    output.lines,
+                    output.screen_lines);
+    }
+
+    fprintf(fp,
+            COL_INFO "Latency (ms):" COL_NORM
+                     " %6s %9s %9s %9s %9s %9s\n",
+            "count",
+            "p50",
+            "p95",
+            "p99",
+            "max",
+            "mean");
+
+    for (size_t i = 0; i < STATS_STAGES_NUM; i++) {
+        const Histogram* histogram = &histograms[i];
+        if (histogram->count == 0)
+            continue;
+
+        fprintf(fp,
+                "  %-11s %6llu %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+                stage_names[i],
+                (unsigned long long)histogram->count,
+                percentile(histogram, 50) / 1e3,
+                percentile(histogram, 95) / 1e3,
+                percentile(histogram, 99) / 1e3,
+                histogram->max / 1e3,
+                (double)histogram->sum / (double)histogram->count / 1e3);
+    }
+}
+
+/*
+ * Print the statistics as a single JSON object.
+ */
+static void print_json(FILE* fp) {
+    fprintf(fp,
+            "{\"requests\":%llu,\"failed\":%llu,\"connections\":%llu,"
+            "\"reused\":%llu,\"http2\":%llu,\"bytes\":%llu,",
+            (unsigned long long)totals.requests,
+            (unsigned long long)totals.failed,
+            (unsigned long long)totals.connections,
+            (unsigned long long)totals.reused,
+            (unsigned long long)totals.http2,
+            (unsigned long long)totals.bytes);
+
+    /* Microseconds since the start, or null if it didn't happen yet */
+    const struct {
+        const char* name;
+        uint64_t ns;
+    } first_times[] = {
+        { "first_post_us", output.first_post_ns },
+        { "first_screen_us", output.first_screen_ns },
+    };
+    for (size_t i = 0; i < ARRLEN(first_times); i++) {
+        if (first_times[i].ns != 0)
+            fprintf(fp,
+                    "\"%s\":%llu,",
+                    first_times[i].name,
+                    (unsigned long long)(first_times[i].ns / 1000));
+        else
+            fprintf(fp, "\"%s\":null,", first_times[i].name);
+    }
+
+    fputs("\"latency_us\":{", fp);
+
+    bool first = true;
+    for (size_t i = 0; i < STATS_STAGES_NUM; i++) {
+        const Histogram* histogram = &histograms[i];
+        if (histogram->count == 0)
+            continue;
+
+        fprintf(fp,
+                "%s\"%s\":{\"count\":%llu,\"p50\":%llu,\"p95\":%llu,"
+                "\"p99\":%llu,\"max\":%llu,\"mean\":%llu}",
+                first ? "" : ",",
+                stage_names[i],
+                (unsigned long long)histogram->count,
+                (unsigned long long)percentile(histogram, 50),
+                (unsigned long long)percentile(histogram, 95),
+                (unsigned long long)percentile(histogram, 99),
+                (unsigned long long)histogram->max,
+                (unsigned long long)(histogram->sum / histogram->count));
+        first = false;
+    }
+
+    fputs("}}\n", fp);
+}
+
+void stats_print(FILE* fp, StatsFormat format) {
+    if (!enabled)
+        return;
+
+    pthread_mutex_lock(&histograms_lock);
+    if (format == STATS_FORMAT_JSON)
+        print_json(fp);
+    else
+        print_text(fp);
+    pthread_mutex_unlock(&histograms_lock);
+
+    if (trace_fp != NULL)
+        fflush(trace_fp);
+}
+
+void stats_free(void) {
+    if (trace_fp != NULL)
+        fclose(trace_fp);
+
+    trace_fp = NULL;
+    enabled  = false;
+}
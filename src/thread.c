@@ -16,12 +16,16 @@
  * this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h> /* qsort, bsearch */
+
 #include <cjson/cJSON.h>
 
 #include "include/thread.h"
 #include "include/util.h"
 
-size_t thread_ids_from_json(ThreadId* dst, size_t dst_sz, cJSON* src) {
+size_t threads_from_json(ThreadInfo* dst, size_t dst_sz, cJSON* src) {
     size_t written = 0;
 
     /* Iterate each page in the array */
@@ -37,6 +41,10 @@ size_t thread_ids_from_json(ThreadId* dst, size_t dst_sz, cJSON* src) {
         /* Iterate each thread in the current page */
         cJSON* cur_thread;
         cJSON_ArrayForEach(cur_thread, threads) {
+            /* Did we reach the end if the destination list? */
+            if (written >= dst_sz)
+                return written;
+
             /* Obtain the thread number of the current element */
             cJSON* cur_thread_no =
               cJSON_GetObjectItemCaseSensitive(cur_thread, "no");
@@ -45,13 +53,82 @@ size_t thread_ids_from_json(ThreadId* dst, size_t dst_sz, cJSON* src) {
                 return 0;
             }
 
-            dst[written++] = cur_thread_no->valueint;
+            /* The other fields are optional */
+            cJSON* last_modified =
+              cJSON_GetObjectItemCaseSensitive(cur_thread, "last_modified");
+            cJSON* replies =
+              cJSON_GetObjectItemCaseSensitive(cur_thread, "replies");
 
-            /* Did we reach the end if the destination list? */
-            if (written > dst_sz)
-                return written;
+            ThreadInfo* info    = &dst[written++];
+            info->id            = (ThreadId)cur_thread_no->valuedouble;
+            info->last_modified = cJSON_IsNumber(last_modified)
+                                    ? (long)last_modified->valuedouble
+                                    : 0;
+            info->replies  = cJSON_IsNumber(replies) ? replies->valueint : 0;
+            info->position = written - 1;
         }
     }
 
     return written;
 }
+
+/*
+ * Compare two 'ThreadInfo' structures by their thread ID. Used for 'qsort' and
+ * 'bsearch'.
+ */
+static int compare_thread_ids(const void* a, const void* b) {
+    const ThreadId id_a = ((const ThreadInfo*)a)->id;
+    const ThreadId id_b = ((const ThreadInfo*)b)->id;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+void threads_sort_by_id(ThreadInfo* threads, size_t threads_num) {
+    qsort(threads, threads_num, sizeof(ThreadInfo), compare_thread_ids);
+}
+
+/*
+ * Compare two 'ThreadInfo' structures by their priority, for 'qsort'. Threads
+ * without a modification time go last.
+ */
+static int compare_thread_priorities(const void* a, const void* b) {
+    const ThreadInfo* thread_a = a;
+    const ThreadInfo* thread_b = b;
+
+    if (thread_a->last_modified != thread_b->last_modified)
+        return (thread_a->last_modified < thread_b->last_modified) ? 1 : -1;
+
+    return (thread_a->position > thread_b->position) -
+           (thread_a->position < thread_b->position);
+}
+
+void threads_sort_by_priority(ThreadInfo* threads, size_t threads_num) {
+    qsort(threads,
+          threads_num,
+          sizeof(ThreadInfo),
+          compare_thread_priorities);
+}
+
+bool thread_is_updated(const ThreadInfo* prev, size_t prev_num,
+                       const ThreadInfo* thread) {
+    const ThreadInfo* old =
+      bsearch(thread, prev, prev_num, sizeof(ThreadInfo), compare_thread_ids);
+
+    /*
+     * Threads without a modification time are always considered updated,
+     * since there is no way of knowing.
+     */
+    return old == NULL || thread->last_modified == 0 ||
+           thread->last_modified > old->last_modified;
+}
+
+void thread_mark_outdated(ThreadInfo* threads, size_t threads_num,
+                          ThreadId id) {
+    const ThreadInfo key = { .id = id };
+    ThreadInfo* thread = bsearch(&key,
+                                 threads,
+                                 threads_num,
+                                 sizeof(ThreadInfo),
+                                 compare_thread_ids);
+    if (thread != NULL)
+        thread->last_modified = -1;
+}
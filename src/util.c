@@ -0,0 +1,107 @@
+/*
+ * Copyright 2025 8dcc
+ *
+ * This file is part of 4cli.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>   /* getpid */
+#include <sys/stat.h> /* mkdir */
+
+#include "include/util.h"
+
+bool make_dirs(const char* path) {
+    char tmp[1024];
+    const int written = snprintf(tmp, sizeof(tmp), "%s", path);
+    if (written <= 0 || (size_t)written >= sizeof(tmp))
+        return false;
+
+    /*
+     * Create each parent by temporarily terminating the string at each slash,
+     * ignoring the leading one.
+     */
+    for (char* p = tmp + 1; *p != '\0'; p++) {
+        if (*p != '/')
+            continue;
+
+        *p = '\0';
+        if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+            ERR("Could not create directory '%s': %s", tmp, strerror(errno));
+            return false;
+        }
+        *p = '/';
+    }
+
+    if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+        ERR("Could not create directory '%s': %s", tmp, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool file_writer_open(FileWriter* writer, const char* path) {
+    writer->fp = NULL;
+
+    const int written =
+      snprintf(writer->path, sizeof(writer->path), "%s", path);
+    if (written <= 0 || (size_t)written >= sizeof(writer->path))
+        return false;
+    snprintf(writer->tmp_path,
+             sizeof(writer->tmp_path),
+             "%s.%ld",
+             path,
+             (long)getpid());
+
+    writer->fp = fopen(writer->tmp_path, "wb");
+    if (writer->fp == NULL) {
+        ERR("Could not create file '%s'.", writer->tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool file_writer_write(FileWriter* writer, const void* data, size_t data_sz) {
+    return writer->fp != NULL &&
+           fwrite(data, 1, data_sz, writer->fp) == data_sz;
+}
+
+bool file_writer_commit(FileWriter* writer) {
+    if (writer->fp == NULL)
+        return false;
+
+    const bool closed = fclose(writer->fp) == 0;
+    writer->fp        = NULL;
+    if (!closed || rename(writer->tmp_path, writer->path) != 0) {
+        ERR("Could not write file '%s'.", writer->path);
+        remove(writer->tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+void file_writer_discard(FileWriter* writer) {
+    if (writer->fp == NULL)
+        return;
+
+    fclose(writer->fp);
+    writer->fp = NULL;
+    remove(writer->tmp_path);
+}